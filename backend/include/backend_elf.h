@@ -1,6 +1,48 @@
 #pragma once
 
+#include <stdint.h>
+#include <stddef.h>
+
 #include "errors.h"
 #include "ir_gen.h"
 
+#define ELF_LABEL_LENGTH 32
+
+// a call from a function to a label, resolved when the program is linked
+struct CallFixup_t
+{
+    uint32_t offset;                        // of the rel32 field, from the start of the function
+    char     target[ELF_LABEL_LENGTH];
+};
+
+// machine code of one function: it does not depend on where the function is placed in
+// .text, everything that does is left to the call fixups
+struct FunctionCode_t
+{
+    uint8_t*            code;
+    size_t              size;
+    struct CallFixup_t* fixups;
+    int                 fixup_count;
+};
+
+struct CompilerState;
+
 enum Errors generate_elf_binary (struct IRGenerator_t* gen, const char* output_filename);
+
+// ========== function by function ========== //
+
+struct CompilerState* create_elf_program (void);
+
+struct CompilerState* copy_elf_program (const struct CompilerState* source);
+
+void compile_elf_ir (struct CompilerState* state, struct IRGenerator_t* gen);
+
+int compile_elf_function (struct CompilerState* state, struct IRGenerator_t* gen, struct FunctionCode_t* function);
+
+void splice_elf_function (struct CompilerState* state, const char* name, const struct FunctionCode_t* function);
+
+enum Errors link_elf_program (struct CompilerState* state, const char* output_filename);
+
+void destroy_elf_program (struct CompilerState* state);
+
+void free_function_code (struct FunctionCode_t* function);
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "x86_emitter.h"
+
+// the multiplies and divisions by a constant of backend_elf.c, for bench/arith_check: the
+// product or the quotient replaces IR register 'ir_register' and no other IR register changes.
+// 'reduced' picks the strength-reduced code, otherwise it is imul or idiv
+
+#define ELF_IR_REGISTERS 14
+
+Register elf_ir_register (int ir_register);
+
+void emit_constant_multiply (struct CodeBuffer* code, int ir_register, int64_t imm, int reduced);
+
+void emit_constant_divide   (struct CodeBuffer* code, int ir_register, int64_t imm, int reduced);
@@ -20,6 +20,7 @@ struct ElfBuilder
 // ========== elf builder management ========== //
 
 struct ElfBuilder* create_elf_builder();
+struct ElfBuilder* copy_elf_builder (const struct ElfBuilder* source);
 void destroy_elf_builder (struct ElfBuilder* builder);
 void set_entry_point (struct ElfBuilder* builder, uint64_t offset);
 
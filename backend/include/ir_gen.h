@@ -3,11 +3,13 @@
 #include "tree_io.h"
 #include "struct.h"
 #include "enum.h"
+#include "ir_registers.h"
 
 #define MAX_VAR_NAME   32
-#define MAX_IR_INSTR  256
+#define IR_START      256       // first capacity of the instruction table
 #define MAX_INSTR_LEN 128
 #define MAX_SYMBOLS    32
+#define SYMBOL_HASH_SIZE 64     // power of two, at least 2 * MAX_SYMBOLS
 
 struct Symbol
 {
@@ -18,18 +20,26 @@ struct Symbol
 struct IRGenerator_t
 {
     struct Symbol symbols[MAX_SYMBOLS];
+    int symbol_hash[SYMBOL_HASH_SIZE];      // hash index over symbols (position + 1, 0 = empty)
     int symbol_count;
-    char instructions[MAX_IR_INSTR][MAX_INSTR_LEN];
+    char (*instructions)[MAX_INSTR_LEN];    // grown on demand, instr_capacity of them
     int instr_count;
-    int reg_count;
+    int instr_capacity;
+    struct IrRegisters_t registers;         // kept from r1 up, temporaries of the statement from r13 down
+    int label_count;                        // loop and if labels are numbered in program order
+    int error;                              // set when an instruction or a register could not be added
 };
 
 void initial_ir_generator (struct IRGenerator_t* gen);
 
+void destroy_ir_generator (struct IRGenerator_t* gen);
+
 void new_register (struct IRGenerator_t* gen, char* buffer, size_t size);
 
 char* get_or_add_symbol (struct IRGenerator_t* gen, const char* name, int length);
 
+const char* lookup_symbol (struct IRGenerator_t* gen, const char* name, int length);
+
 void set_symbol_reg (struct IRGenerator_t* gen, const char* name, int length, const char* reg);
 
 void add_instruction (struct IRGenerator_t* gen, const char* instr);
@@ -23,10 +23,12 @@ struct CodeBuffer
 };
 
 struct CodeBuffer* create_code_buffer (size_t initial_capacity);
+struct CodeBuffer* copy_code_buffer (const struct CodeBuffer* source);
 void destroy_code_buffer (struct CodeBuffer* buf);
 void emit_byte  (struct CodeBuffer* buf, uint8_t byte);
 void emit_dword (struct CodeBuffer* buf, uint32_t dword);
 void emit_qword (struct CodeBuffer* buf, uint64_t qword);
+void emit_bytes (struct CodeBuffer* buf, const uint8_t* bytes, size_t count);
 
 // ========== MOV INSTRUCTIONS ========== //
 
@@ -49,6 +51,12 @@ void encode_sub_reg_reg  (struct CodeBuffer* buf, Register dst, Register src);
 void encode_imul_reg_imm (struct CodeBuffer* buf, Register dst, int32_t imm);         // imul reg, imm32
 void encode_imul_reg_reg (struct CodeBuffer* buf, Register dst, Register src);        // imul reg, reg
 void encode_idiv_reg     (struct CodeBuffer* buf, Register divisor);                  // idiv reg
+void encode_imul_reg     (struct CodeBuffer* buf, Register src);                      // imul reg  (RDX:RAX = RAX * reg)
+void encode_shl_reg_imm  (struct CodeBuffer* buf, Register dst, uint8_t imm);         // shl reg, imm8
+void encode_shr_reg_imm  (struct CodeBuffer* buf, Register dst, uint8_t imm);         // shr reg, imm8  (logical)
+void encode_sar_reg_imm  (struct CodeBuffer* buf, Register dst, uint8_t imm);         // sar reg, imm8  (arithmetic)
+void encode_lea_reg_scaled (struct CodeBuffer* buf, Register dst, Register base,
+                            Register index, uint8_t scale);                           // lea reg, [base + index * scale]
 void encode_cqo          (struct CodeBuffer* buf);                                    // cqo
 void encode_xor_reg_reg  (struct CodeBuffer* buf, Register dst, Register src);        // xor reg, reg
 void encode_inc_reg      (struct CodeBuffer* buf, Register reg);                      // inc reg
@@ -5,13 +5,16 @@
 #include <ctype.h>
 
 #include "backend_elf.h"
+#include "elf_arith.h"
 #include "elf_builder.h"
 #include "x86_emitter.h"
 #include "errors.h"
+#include "name_index.h"
 
-#define MAX_LABELS 100
+#define LABELS_START 64         // first capacity of the labels and of the calls, power of two
+#define MAX_NESTING 100         // of loops and ifs, as many jumps wait for their label
 #define MAX_VARIABLES 100
-#define MAX_LENGTH_NAME 32
+#define MAX_LENGTH_NAME ELF_LABEL_LENGTH
 
 struct Label
 {
@@ -35,16 +38,22 @@ struct PendingPatch
 struct CompilerState
 {
     struct ElfBuilder* elf;
-    struct Label labels[MAX_LABELS];
+    struct Label* labels;                           // grown on demand, label_capacity of them
+    int* label_hash;                                // hash index over labels (position + 1, 0 = empty)
     int label_count;
+    int label_capacity;                             // the hash index has twice as many slots
     struct Variable variables[MAX_VARIABLES];
     int variable_count;
-    char loop_stack[MAX_LABELS][MAX_LENGTH_NAME];   // stack of loop labels
+    char loop_stack[MAX_NESTING][MAX_LENGTH_NAME];  // stack of loop labels
     int loop_stack_depth;
-    char if_stack[MAX_LABELS][MAX_LENGTH_NAME];     // stack of if labels
+    char if_stack[MAX_NESTING][MAX_LENGTH_NAME];    // stack of if labels
     int if_stack_depth;
-    struct PendingPatch patches[MAX_LABELS];        // pending jump patches
+    struct PendingPatch patches[MAX_NESTING];       // pending jump patches
     int patch_count;
+    struct PendingPatch* calls;                     // calls, patched when the program is linked
+    int call_count;
+    int call_capacity;
+    int rdi_saved;                                  // "set rdi" pushed r5, the next call pops it
 };
 
 // ========== helper functions ========== //
@@ -73,18 +82,271 @@ static Register parse_register (const char* reg_str)
 
     int reg_num = atoi (reg_str + 1);
 
-    // map r0-r13 to x86-64 registers (skip RSP and RBP which are used for stack)
-    // r0=rax, r1=rcx, r2=rdx, r3=rbx, r4=rsi, r5=rdi, r6-r13=R8-R15
-    static const Register reg_map[] = {
+    if (reg_num >= 0 && reg_num < ELF_IR_REGISTERS)
+        return elf_ir_register (reg_num);
+
+    fprintf (stderr, "Error: register number %d out of range (0-13)\n", reg_num);
+    exit(1);
+}
+
+// map r0-r13 to x86-64 registers (skip RSP and RBP which are used for stack)
+// r0=rax, r1=rcx, r2=rdx, r3=rbx, r4=rsi, r5=rdi, r6-r13=R8-R15
+Register elf_ir_register (int ir_register)
+{
+    static const Register reg_map[ELF_IR_REGISTERS] = {
         RAX, RCX, RDX, RBX, RSI, RDI, R8, R9,
         R10, R11, R12, R13, R14, R15
     };
 
-    if (reg_num >= 0 && reg_num < 14)
-        return reg_map[reg_num];
+    assert (ir_register >= 0 && ir_register < ELF_IR_REGISTERS);
 
-    fprintf (stderr, "Error: register number %d out of range (0-13)\n", reg_num);
-    exit(1);
+    return reg_map[ir_register];
+}
+
+// ========== arithmetic on any operand ========== //
+
+typedef void (*RegRegEncoder) (struct CodeBuffer* buf, Register dst, Register src);
+
+// every general register but RSP and RBP holds an IR register, so an immediate that does not
+// fit the instruction goes through a register saved on the stack around it
+static void emit_imm_through_reg (struct CodeBuffer* code, RegRegEncoder encode, Register dst, int64_t imm)
+{
+    Register scratch = (dst == RAX) ? RCX : RAX;
+
+    encode_push_reg      (code, scratch);
+    encode_mov_reg_imm64 (code, scratch, (uint64_t) imm);
+    encode               (code, dst, scratch);
+    encode_pop_reg       (code, scratch);
+}
+
+// cmp takes a sign-extended imm32, a wider one is compared through a register: pop keeps the flags
+static void emit_cmp_imm (struct CodeBuffer* code, Register reg, int64_t imm)
+{
+    if (imm >= INT32_MIN && imm <= INT32_MAX)
+        encode_cmp_reg_imm (code, reg, (int32_t) imm);
+    else
+        emit_imm_through_reg (code, encode_cmp_reg_reg, reg, imm);
+}
+
+// the quotient is in RAX and RAX, RDX, R11 were pushed in this order: they come back, but for
+// the one the quotient goes to
+static void emit_quotient_to (struct CodeBuffer* code, Register dst)
+{
+    encode_pop_reg (code, R11);
+    if (dst == R11) encode_mov_reg_reg (code, R11, RAX);
+
+    encode_pop_reg (code, RDX);
+    if (dst == RDX) encode_mov_reg_reg (code, RDX, RAX);
+
+    if (dst != RAX && dst != RDX && dst != R11)
+        encode_mov_reg_reg (code, dst, RAX);
+
+    if (dst == RAX)
+        encode_add_reg_imm (code, RSP, 8);
+    else
+        encode_pop_reg (code, RAX);
+}
+
+// dst = dst / divisor (a register, or imm if divisor_is_reg is 0); idiv takes RAX and RDX and
+// the divisor goes to R11, all three are saved first, so no other IR register changes
+static void emit_divide (struct CodeBuffer* code, Register dst, int divisor_is_reg, Register divisor, int64_t imm)
+{
+    encode_push_reg (code, RAX);
+    encode_push_reg (code, RDX);
+    encode_push_reg (code, R11);
+
+    if (divisor_is_reg)
+    {
+        // through the stack: the divisor may be RAX and the dividend R11
+        encode_push_reg    (code, divisor);
+        encode_mov_reg_reg (code, RAX, dst);
+        encode_pop_reg     (code, R11);
+    }
+    else
+    {
+        encode_mov_reg_reg   (code, RAX, dst);
+        encode_mov_reg_imm64 (code, R11, (uint64_t) imm);
+    }
+
+    encode_cqo      (code);
+    encode_idiv_reg (code, R11);
+
+    // the quotient stays in RAX while the saved registers come back, except the one it goes to
+    emit_quotient_to (code, dst);
+}
+
+// ========== arithmetic by a constant ========== //
+
+static int trailing_zeros (uint64_t value)
+{
+    int count = 0;
+
+    while (value != 0 && (value & 1) == 0)
+    {
+        value >>= 1;
+        count++;
+    }
+
+    return count;
+}
+
+// dst = dst * imm, wrapping as imul does: 0, 1 and -1 need no multiply, and imm = +-c * 2^k with
+// c of 1, 3, 5 or 9 is a lea [dst + dst * (c - 1)], a shl and a neg
+static void emit_multiply_imm (struct CodeBuffer* code, Register dst, int64_t imm)
+{
+    if (imm == 0)
+    {
+        encode_xor_reg_reg (code, dst, dst);
+        return;
+    }
+
+    uint64_t magnitude = (imm < 0) ? 0 - (uint64_t) imm : (uint64_t) imm;
+    int      shift     = trailing_zeros (magnitude);
+    uint64_t odd       = magnitude >> shift;
+
+    if (odd == 1 || odd == 3 || odd == 5 || odd == 9)
+    {
+        if (odd != 1)
+            encode_lea_reg_scaled (code, dst, dst, dst, (uint8_t) (odd - 1));
+
+        if (shift != 0)
+            encode_shl_reg_imm (code, dst, (uint8_t) shift);
+
+        if (imm < 0)
+            encode_neg_reg (code, dst);
+
+        return;
+    }
+
+    if (imm >= INT32_MIN && imm <= INT32_MAX)
+        encode_imul_reg_imm (code, dst, (int32_t) imm);
+    else
+        emit_imm_through_reg (code, encode_imul_reg_reg, dst, imm);
+}
+
+// the multiplier and the shift that make the signed division by 'divisor' a multiply-high
+// (Hacker's Delight, 10-1); |divisor| is at least 2 and not a power of two
+static void division_magic (int64_t divisor, int64_t* magic, int* shift)
+{
+    const uint64_t two63 = UINT64_C (1) << 63;
+
+    uint64_t abs_divisor = (divisor < 0) ? 0 - (uint64_t) divisor : (uint64_t) divisor;
+    uint64_t limit       = two63 + ((uint64_t) divisor >> 63);
+    uint64_t abs_nc      = limit - 1 - limit % abs_divisor;
+
+    uint64_t q1 = two63 / abs_nc;
+    uint64_t r1 = two63 - q1 * abs_nc;
+    uint64_t q2 = two63 / abs_divisor;
+    uint64_t r2 = two63 - q2 * abs_divisor;
+
+    uint64_t delta = 0;
+    int      p     = 63;
+
+    do
+    {
+        p++;
+
+        q1 *= 2;
+        r1 *= 2;
+        if (r1 >= abs_nc)      { q1++; r1 -= abs_nc; }
+
+        q2 *= 2;
+        r2 *= 2;
+        if (r2 >= abs_divisor) { q2++; r2 -= abs_divisor; }
+
+        delta = abs_divisor - r2;
+    }
+    while (q1 < delta || (q1 == delta && r1 == 0));
+
+    *magic = (int64_t) ((divisor < 0) ? 0 - (q2 + 1) : q2 + 1);
+    *shift = p - 64;
+}
+
+// dst = dst / imm, the same quotient idiv gives, truncated towards zero. 0 and -1 still go
+// through idiv, so a division by zero and INT64_MIN / -1 trap as they did
+static void emit_divide_imm (struct CodeBuffer* code, Register dst, int64_t imm)
+{
+    if (imm == 1)
+        return;
+
+    if (imm == 0 || imm == -1)
+    {
+        emit_divide (code, dst, 0, RAX, imm);
+        return;
+    }
+
+    uint64_t magnitude = (imm < 0) ? 0 - (uint64_t) imm : (uint64_t) imm;
+
+    // 2^k: a shift rounds down, so 2^k - 1 is added to a negative dividend first
+    if ((magnitude & (magnitude - 1)) == 0)
+    {
+        int      shift   = trailing_zeros (magnitude);
+        Register scratch = (dst == RAX) ? RCX : RAX;
+
+        encode_push_reg    (code, scratch);
+        encode_mov_reg_reg (code, scratch, dst);
+
+        if (shift > 1)
+            encode_sar_reg_imm (code, scratch, 63);
+
+        encode_shr_reg_imm (code, scratch, (uint8_t) (64 - shift));
+        encode_add_reg_reg (code, dst, scratch);
+        encode_sar_reg_imm (code, dst, (uint8_t) shift);
+        encode_pop_reg     (code, scratch);
+
+        if (imm < 0)
+            encode_neg_reg (code, dst);
+
+        return;
+    }
+
+    int64_t magic = 0;
+    int     shift = 0;
+
+    division_magic (imm, &magic, &shift);
+
+    // the high half of dividend * magic, in RDX; the dividend stays in R11
+    encode_push_reg      (code, RAX);
+    encode_push_reg      (code, RDX);
+    encode_push_reg      (code, R11);
+    encode_mov_reg_reg   (code, R11, dst);
+    encode_mov_reg_imm64 (code, RAX, (uint64_t) magic);
+    encode_imul_reg      (code, R11);
+
+    if (imm > 0 && magic < 0)
+        encode_add_reg_reg (code, RDX, R11);
+    if (imm < 0 && magic > 0)
+        encode_sub_reg_reg (code, RDX, R11);
+
+    if (shift != 0)
+        encode_sar_reg_imm (code, RDX, (uint8_t) shift);
+
+    // a negative quotient is one below the truncated one
+    encode_mov_reg_reg (code, RAX, RDX);
+    encode_shr_reg_imm (code, RAX, 63);
+    encode_add_reg_reg (code, RAX, RDX);
+
+    emit_quotient_to (code, dst);
+}
+
+void emit_constant_multiply (struct CodeBuffer* code, int ir_register, int64_t imm, int reduced)
+{
+    Register dst = elf_ir_register (ir_register);
+
+    if (reduced)
+        emit_multiply_imm (code, dst, imm);
+    else
+        emit_imm_through_reg (code, encode_imul_reg_reg, dst, imm);
+}
+
+void emit_constant_divide (struct CodeBuffer* code, int ir_register, int64_t imm, int reduced)
+{
+    Register dst = elf_ir_register (ir_register);
+
+    if (reduced)
+        emit_divide_imm (code, dst, imm);
+    else
+        emit_divide (code, dst, 0, RAX, imm);
 }
 
 // ========== variable management ========== //
@@ -122,12 +384,42 @@ static struct Variable* add_variable (struct CompilerState* state, const char* n
 
 // ========== label management ========== //
 
-static struct Label* find_label (struct CompilerState* state, const char* name)
+static int label_equal (const void* table, int position, const char* str, int length)
 {
+    (void) length;
+    return strcmp (((const struct Label*) table)[position].name, str) == 0;
+}
+
+// doubles the labels, the hash index is rebuilt twice as big
+static void grow_labels (struct CompilerState* state)
+{
+    int capacity = (state->label_capacity != 0) ? 2 * state->label_capacity : LABELS_START;
+
+    struct Label* labels = (struct Label*) realloc (state->labels, (size_t) capacity * sizeof (*labels));
+    int*          hash   = (int*) calloc ((size_t) (2 * capacity), sizeof (*hash));
+
+    if (!labels || !hash)
+    {
+        fprintf (stderr, "Error: could not grow the labels to %d\n", capacity);
+        exit(1);
+    }
+
+    free (state->label_hash);
+
+    state->labels         = labels;
+    state->label_hash     = hash;
+    state->label_capacity = capacity;
+
     for (int i = 0; i < state->label_count; i++)
-        if (strcmp (state->labels[i].name, name) == 0)
-            return &state->labels[i];
-    return NULL;
+        name_index_insert (hash, 2 * capacity, labels[i].name, (int) strlen (labels[i].name), i);
+}
+
+static struct Label* find_label (struct CompilerState* state, const char* name)
+{
+    int position = name_index_find (state->label_hash, 2 * state->label_capacity, state->labels, label_equal,
+                                    name, (int) strlen (name));
+
+    return (position == -1) ? NULL : &state->labels[position];
 }
 
 static struct Label* add_label (struct CompilerState* state, const char* name)
@@ -135,15 +427,16 @@ static struct Label* add_label (struct CompilerState* state, const char* name)
     struct Label* label = find_label (state, name);
     if (label) return label;
 
-    if (state->label_count >= MAX_LABELS)
-    {
-        fprintf (stderr, "Error: too many labels\n");
-        exit(1);
-    }
+    if (state->label_count == state->label_capacity)
+        grow_labels (state);
 
-    label = &state->labels[state->label_count++];
+    label = &state->labels[state->label_count];
     strncpy (label->name, name, MAX_LENGTH_NAME - 1);
     label->name[MAX_LENGTH_NAME - 1] = '\0';
+
+    name_index_insert (state->label_hash, 2 * state->label_capacity, label->name, (int) strlen (label->name),
+                       state->label_count);
+    state->label_count++;
     label->code_offset = 0;
     label->is_resolved = 0;
 
@@ -160,6 +453,63 @@ static void resolve_label (struct CompilerState* state, const char* name, size_t
     label->is_resolved = 1;
 }
 
+// ========== calls ========== //
+
+static struct PendingPatch* add_call (struct CompilerState* state)
+{
+    if (state->call_count == state->call_capacity)
+    {
+        int capacity = (state->call_capacity != 0) ? 2 * state->call_capacity : LABELS_START;
+
+        struct PendingPatch* calls = (struct PendingPatch*) realloc (state->calls, (size_t) capacity * sizeof (*calls));
+        if (!calls)
+        {
+            fprintf (stderr, "Error: could not grow the calls to %d\n", capacity);
+            exit(1);
+        }
+
+        state->calls         = calls;
+        state->call_capacity = capacity;
+    }
+
+    return &state->calls[state->call_count++];
+}
+
+// every call is encoded with a zero offset and patched by link_calls, once all the
+// functions are placed: a function may call one that comes after it
+static void emit_call (struct CompilerState* state, const char* target)
+{
+    struct PendingPatch* call = add_call (state);
+
+    call->patch_offset = get_text_offset (state->elf) + 1;  // skip E8
+    strncpy (call->target_label, target, MAX_LENGTH_NAME - 1);
+    call->target_label[MAX_LENGTH_NAME - 1] = '\0';
+
+    encode_call_rel32 (get_text_buffer (state->elf), 0);
+}
+
+static int link_calls (struct CompilerState* state)
+{
+    struct CodeBuffer* code = get_text_buffer (state->elf);
+    int errors = 0;
+
+    for (int i = 0; i < state->call_count; i++)
+    {
+        struct Label* label = find_label (state, state->calls[i].target_label);
+        if (!label || !label->is_resolved)
+        {
+            fprintf (stderr, "Error: call to undefined function '%s'\n", state->calls[i].target_label);
+            errors++;
+            continue;
+        }
+
+        size_t patch_loc = state->calls[i].patch_offset;
+        patch_rel32 (code, patch_loc, (int32_t)(label->code_offset - (patch_loc + 4)));
+    }
+
+    return errors;
+}
+
 // ========== IR instruction compilation ========== //
 
 static void compile_ir_instruction (struct CompilerState* state, const char* instruction)
@@ -215,7 +565,15 @@ static void compile_ir_instruction (struct CompilerState* state, const char* ins
             dst_reg = parse_register (dst);
             dst_is_reg = 1;
         }
-        else if (strcmp (dst, "rdi") == 0) { dst_reg = RDI; dst_is_reg = 1; }
+        else if (strcmp (dst, "rdi") == 0)
+        {
+            // rdi is r5 as well: it is saved for the call the argument is set for
+            if (!state->rdi_saved)
+                encode_push_reg (code, RDI);
+
+            state->rdi_saved = 1;
+            dst_reg = RDI; dst_is_reg = 1;
+        }
         else if (strcmp (dst, "rsi") == 0) { dst_reg = RSI; dst_is_reg = 1; }
         else if (strcmp (dst, "rax") == 0) { dst_reg = RAX; dst_is_reg = 1; }
 
@@ -274,7 +632,12 @@ static void compile_ir_instruction (struct CompilerState* state, const char* ins
         }
         else if (is_number (src))
         {
-            encode_add_reg_imm (code, dst_reg, (uint8_t) atoi (src));
+            int64_t imm = atoll (src);
+
+            if (imm >= INT8_MIN && imm <= INT8_MAX)
+                encode_add_reg_imm (code, dst_reg, (uint8_t) imm);
+            else
+                emit_imm_through_reg (code, encode_add_reg_reg, dst_reg, imm);
         }
     }
     // ========== SUB ========== //
@@ -292,7 +655,12 @@ static void compile_ir_instruction (struct CompilerState* state, const char* ins
         }
         else if (is_number (src))
         {
-            encode_sub_reg_imm (code, dst_reg, (uint8_t) atoi (src));
+            int64_t imm = atoll (src);
+
+            if (imm >= INT8_MIN && imm <= INT8_MAX)
+                encode_sub_reg_imm (code, dst_reg, (uint8_t) imm);
+            else
+                emit_imm_through_reg (code, encode_sub_reg_reg, dst_reg, imm);
         }
     }
     // ========== MUL ========== //
@@ -310,7 +678,7 @@ static void compile_ir_instruction (struct CompilerState* state, const char* ins
         }
         else if (is_number (src))
         {
-            encode_imul_reg_imm (code, dst_reg, atoi (src));
+            emit_multiply_imm (code, dst_reg, atoll (src));
         }
     }
     // ========== DIV ========== //
@@ -319,31 +687,12 @@ static void compile_ir_instruction (struct CompilerState* state, const char* ins
         char* dst = strtok (NULL, " ,");
         char* src = strtok (NULL, " ,");
 
-        if (!dst || !src) return;
+        if (!dst || !src || !is_register (dst)) return;
 
-        if (is_register (dst) && is_register (src))
-        {
-            Register dst_reg = parse_register (dst);
-            Register src_reg = parse_register (src);
-
-            if (src_reg == RDX)
-            {
-                encode_push_reg (code, RDX);             // save divisor on stack
-                encode_mov_reg_reg (code, RAX, dst_reg);
-                encode_cqo (code);                       // rdx:rax = sign-extended dividend
-                encode_pop_reg (code, R11);              // R11 = original divisor
-                encode_idiv_reg (code, R11);             // rax = quotient, rdx = remainder
-                encode_mov_reg_reg (code, RDX, R11);     // restore RDX to divisor value
-            }
-            else
-            {
-                // cqo clobbers RDX, but src_reg is not RDX so divisor is safe
-                encode_mov_reg_reg (code, RAX, dst_reg);
-                encode_cqo (code);
-                encode_idiv_reg (code, src_reg);
-            }
-            encode_mov_reg_reg (code, dst_reg, RAX);
-        }
+        if (is_register (src))
+            emit_divide (code, parse_register (dst), 1, parse_register (src), 0);
+        else if (is_number (src))
+            emit_divide_imm (code, parse_register (dst), atoll (src));
     }
     // ========== CALL ========== //
     else if (strcmp (token, "call") == 0)
@@ -351,42 +700,15 @@ static void compile_ir_instruction (struct CompilerState* state, const char* ins
         char* func_name = strtok (NULL, " ,");
         if (!func_name) return;
 
-        // special syscall wrappers
-        if (strcmp (func_name, "gimme") == 0)
-        {
-            // call in_syscall (implemented in our runtime)
-            struct Label* label = find_label (state, "in_syscall");
-            if (label && label->is_resolved)
-            {
-                int32_t rel_offset = (int32_t)(label->code_offset - (get_text_offset (state->elf) + 5));
-                encode_call_rel32 (code, rel_offset);
-            }
-            else
-            {
-                fprintf (stderr, "Error: in_syscall label not found or not resolved\n");
-            }
-        }
-        else if (strcmp (func_name, "yap") == 0)
-        {
-            // call out_syscall
-            struct Label* label = find_label (state, "out_syscall");
-            if (label && label->is_resolved)
-            {
-                int32_t rel_offset = (int32_t)(label->code_offset - (get_text_offset (state->elf) + 5));
-                encode_call_rel32 (code, rel_offset);
-            }
-            else
-            {
-                fprintf (stderr, "Error: out_syscall label not found or not resolved\n");
-            }
-        }
-        else
+        // special syscall wrappers are calls into our runtime
+        if      (strcmp (func_name, "gimme") == 0) emit_call (state, "in_syscall");
+        else if (strcmp (func_name, "yap")   == 0) emit_call (state, "out_syscall");
+        else                                       emit_call (state, func_name);
+
+        if (state->rdi_saved)
         {
-            // regular function call
-            struct Label* label = add_label (state, func_name);
-            int32_t rel_offset = label->is_resolved ?
-                (int32_t)(label->code_offset - (get_text_offset (state->elf) + 5)) : 0;
-            encode_call_rel32 (code, rel_offset);
+            encode_pop_reg (code, RDI);
+            state->rdi_saved = 0;
         }
     }
     // ========== WHILE ========== //
@@ -398,7 +720,7 @@ static void compile_ir_instruction (struct CompilerState* state, const char* ins
         if (!condition || !label_name) return;
 
         // push loop label to stack
-        if (state->loop_stack_depth < MAX_LABELS)
+        if (state->loop_stack_depth < MAX_NESTING)
         {
             strncpy (state->loop_stack[state->loop_stack_depth], label_name, MAX_LENGTH_NAME - 1);
             state->loop_stack[state->loop_stack_depth][MAX_LENGTH_NAME - 1] = '\0';
@@ -418,7 +740,8 @@ static void compile_ir_instruction (struct CompilerState* state, const char* ins
 
         if (reg_str && op && num_str)
         {
-            char end_label[64] = {};
+            // cut to the length a label keeps, so the patch, the label and end_loop name the same
+            char end_label[MAX_LENGTH_NAME] = {};
             snprintf (end_label, sizeof (end_label), "end_loop_%s", label_name);
             add_label (state, end_label);
 
@@ -431,8 +754,7 @@ static void compile_ir_instruction (struct CompilerState* state, const char* ins
             else
             {
                 Register reg = parse_register (reg_str);
-                int32_t value = atoi (num_str);
-                encode_cmp_reg_imm (code, reg, value);
+                emit_cmp_imm (code, reg, atoll (num_str));
             }
 
             size_t jcc_offset = get_text_offset (state->elf);
@@ -445,11 +767,10 @@ static void compile_ir_instruction (struct CompilerState* state, const char* ins
             else                                 encode_jle_rel32 (code, 0); // legacy ">" or fallback
 
             // remember this jump needs patching (jcc = 0F XX, skip 2 bytes to reach rel32)
-            if (state->patch_count < MAX_LABELS)
+            if (state->patch_count < MAX_NESTING)
             {
                 state->patches[state->patch_count].patch_offset = jcc_offset + 2;
-                strncpy (state->patches[state->patch_count].target_label, end_label, MAX_LENGTH_NAME - 1);
-                state->patches[state->patch_count].target_label[MAX_LENGTH_NAME - 1] = '\0';
+                memcpy (state->patches[state->patch_count].target_label, end_label, MAX_LENGTH_NAME);
 #ifdef DEBUG
                 fprintf (stderr, "  Saving patch: jcc at 0x%lx -> %s\n", jcc_offset, end_label);
 #endif
@@ -476,7 +797,7 @@ static void compile_ir_instruction (struct CompilerState* state, const char* ins
             }
 
             // resolve end_loop label at current position
-            char end_label[64] = {};
+            char end_label[MAX_LENGTH_NAME] = {};
             snprintf (end_label, sizeof (end_label), "end_loop_%s", loop_label);
             size_t end_offset = get_text_offset (state->elf);
             resolve_label (state, end_label, end_offset);
@@ -541,7 +862,7 @@ static void compile_ir_instruction (struct CompilerState* state, const char* ins
         if (!condition || !label_name) return;
 
         // push if label to stack
-        if (state->if_stack_depth < MAX_LABELS)
+        if (state->if_stack_depth < MAX_NESTING)
         {
             strncpy (state->if_stack[state->if_stack_depth], label_name, MAX_LENGTH_NAME - 1);
             state->if_stack[state->if_stack_depth][MAX_LENGTH_NAME - 1] = '\0';
@@ -556,7 +877,7 @@ static void compile_ir_instruction (struct CompilerState* state, const char* ins
         char* op      = strtok (NULL, " ");
         char* rhs_str = strtok (NULL, " ");
 
-        char end_label[64] = {};
+        char end_label[MAX_LENGTH_NAME] = {};
         snprintf (end_label, sizeof (end_label), "end_if_%s", label_name);
         add_label (state, end_label);
 
@@ -592,8 +913,7 @@ static void compile_ir_instruction (struct CompilerState* state, const char* ins
             else
             {
                 Register reg = parse_register (reg_str);
-                int32_t value = atoi (rhs_str);
-                encode_cmp_reg_imm (code, reg, value);
+                emit_cmp_imm (code, reg, atoll (rhs_str));
                 jcc_offset = get_text_offset (state->elf);
                 if      (strcmp (op, "fr")     == 0) encode_jle_rel32 (code, 0);
                 else if (strcmp (op, "lowkey") == 0) encode_jge_rel32 (code, 0);
@@ -604,11 +924,10 @@ static void compile_ir_instruction (struct CompilerState* state, const char* ins
             }
         }
 
-        if (jcc_offset > 0 && state->patch_count < MAX_LABELS)
+        if (jcc_offset > 0 && state->patch_count < MAX_NESTING)
         {
             state->patches[state->patch_count].patch_offset = jcc_offset + 2;  // skip 0F XX
-            strncpy (state->patches[state->patch_count].target_label, end_label, MAX_LENGTH_NAME - 1);
-            state->patches[state->patch_count].target_label[MAX_LENGTH_NAME - 1] = '\0';
+            memcpy (state->patches[state->patch_count].target_label, end_label, MAX_LENGTH_NAME);
 #ifdef DEBUG
             fprintf (stderr, "  Saving if-patch: jcc at 0x%lx -> %s\n", jcc_offset, end_label);
 #endif
@@ -624,7 +943,7 @@ static void compile_ir_instruction (struct CompilerState* state, const char* ins
             char* if_label = state->if_stack[state->if_stack_depth];
 
             // resolve end_if label at current position
-            char end_label[64] = {};
+            char end_label[MAX_LENGTH_NAME] = {};
             snprintf (end_label, sizeof (end_label), "end_if_%s", if_label);
             size_t end_offset = get_text_offset (state->elf);
             resolve_label (state, end_label, end_offset);
@@ -672,6 +991,7 @@ static void emit_in_syscall (struct CompilerState* state, uint64_t buffer_addr)
     encode_push_reg (code, RDX);
     encode_push_reg (code, RSI);
     encode_push_reg (code, RDI);
+    encode_push_reg (code, R11);                        // syscall clobbers r11 (and rcx)
 
     // sys_read(0, buffer, 16)
     encode_mov_reg_imm64 (code, RAX, 0);                // rax = 0 (sys_read)
@@ -748,6 +1068,7 @@ static void emit_in_syscall (struct CompilerState* state, uint64_t buffer_addr)
     patch_rel32 (code, jz_positive + 2, (int32_t)(after_neg - (jz_positive + 6)));
 
     // restore registers and return
+    encode_pop_reg (code, R11);
     encode_pop_reg (code, RDI);
     encode_pop_reg (code, RSI);
     encode_pop_reg (code, RDX);
@@ -762,6 +1083,12 @@ static void emit_in_syscall (struct CompilerState* state, uint64_t buffer_addr)
     patch_rel32 (code, ja_error + 2, (int32_t)(error - (ja_error + 6)));
 
     encode_mov_reg_imm64 (code, RAX, (uint64_t)-1);    // rax = -1
+    encode_pop_reg (code, R11);
+    encode_pop_reg (code, RDI);
+    encode_pop_reg (code, RSI);
+    encode_pop_reg (code, RDX);
+    encode_pop_reg (code, RCX);
+    encode_pop_reg (code, RBX);
     encode_ret (code);
 }
 
@@ -777,6 +1104,9 @@ static void emit_out_syscall (struct CompilerState* state, uint64_t output_buffe
     encode_push_reg (code, RCX);
     encode_push_reg (code, RDX);
     encode_push_reg (code, RSI);
+    encode_push_reg (code, RDI);
+    encode_push_reg (code, R8);
+    encode_push_reg (code, R11);                            // syscall clobbers r11 (and rcx)
 
     encode_mov_reg_reg (code, RAX, RDI);                    // rax = input value
 
@@ -802,6 +1132,7 @@ static void emit_out_syscall (struct CompilerState* state, uint64_t output_buffe
 
     // zero case: write '0'
     encode_mov_byte_reg_ind_imm8 (code, RDI, '0');          // mov byte [rdi], '0'
+    encode_dec_reg (code, RDI);                             // dec rdi, as after every digit
     encode_inc_reg (code, RCX);                             // inc rcx
     size_t jmp_write = get_text_offset (state->elf);
     encode_jmp_rel32 (code, 0);                             // placeholder -> .write
@@ -854,6 +1185,9 @@ static void emit_out_syscall (struct CompilerState* state, uint64_t output_buffe
     encode_syscall (code);
 
     // restore saved registers
+    encode_pop_reg (code, R11);
+    encode_pop_reg (code, R8);
+    encode_pop_reg (code, RDI);
     encode_pop_reg (code, RSI);
     encode_pop_reg (code, RDX);
     encode_pop_reg (code, RCX);
@@ -901,36 +1235,192 @@ enum Errors generate_elf_binary (struct IRGenerator_t* gen, const char* output_f
     assert (gen);
     assert (output_filename);
 
-    struct CompilerState state = {};
-    state.elf = create_elf_builder();
-    state.label_count = 0;
-    state.variable_count = 0;
-    state.loop_stack_depth = 0;
-    state.patch_count = 0;
+    struct CompilerState* state = create_elf_program();
+
+    // compile user code
+    compile_elf_ir (state, gen);
+
+    return link_elf_program (state, output_filename);
+}
+
+// ========== function by function ========== //
+
+struct CompilerState* create_elf_program (void)
+{
+    struct CompilerState* state = (struct CompilerState*) calloc (1, sizeof (*state));
+    if (!state)
+    {
+        fprintf (stderr, "Error: failed to allocate compiler state\n");
+        exit(1);
+    }
+
+    grow_labels (state);
+
+    state->elf = create_elf_builder();
 
     // emit runtime functions first
-    emit_runtime_functions (&state);
+    emit_runtime_functions (state);
+
+    return state;
+}
+
+// a program with the code and the labels of 'source', compiled on without changing it
+struct CompilerState* copy_elf_program (const struct CompilerState* source)
+{
+    assert (source);
+
+    struct CompilerState* state = (struct CompilerState*) calloc (1, sizeof (*state));
+    if (!state)
+    {
+        fprintf (stderr, "Error: failed to allocate compiler state\n");
+        exit(1);
+    }
+
+    *state = *source;
+
+    state->labels     = (struct Label*) malloc ((size_t) source->label_capacity * sizeof (*state->labels));
+    state->label_hash = (int*)          malloc ((size_t) (2 * source->label_capacity) * sizeof (*state->label_hash));
+    state->calls      = NULL;
+
+    if (source->call_capacity > 0)
+        state->calls = (struct PendingPatch*) malloc ((size_t) source->call_capacity * sizeof (*state->calls));
+
+    if (!state->labels || !state->label_hash || (source->call_capacity > 0 && !state->calls))
+    {
+        fprintf (stderr, "Error: failed to copy compiler state\n");
+        exit(1);
+    }
+
+    memcpy (state->labels,     source->labels,     (size_t) source->label_count * sizeof (*state->labels));
+    memcpy (state->label_hash, source->label_hash, (size_t) (2 * source->label_capacity) * sizeof (*state->label_hash));
+
+    if (source->call_count > 0)
+        memcpy (state->calls, source->calls, (size_t) source->call_count * sizeof (*state->calls));
+
+    state->elf = copy_elf_builder (source->elf);
+
+    return state;
+}
+
+// compiles the IR in gen at the end of .text
+void compile_elf_ir (struct CompilerState* state, struct IRGenerator_t* gen)
+{
+    assert (state);
+    assert (gen);
 
-    // compile user code
     for (int i = 0; i < gen->instr_count; i++)
-        compile_ir_instruction (&state, gen->instructions[i]);
+        compile_ir_instruction (state, gen->instructions[i]);
+}
+
+// compiles the IR in gen, one function, at the end of .text and returns a copy of its code;
+// the IR keeps variables in registers, so the code refers to .data only through the runtime calls
+int compile_elf_function (struct CompilerState* state, struct IRGenerator_t* gen, struct FunctionCode_t* function)
+{
+    assert (state);
+    assert (gen);
+    assert (function);
+
+    size_t start      = get_text_offset (state->elf);
+    int    first_call = state->call_count;
+
+    compile_elf_ir (state, gen);
+
+    function->size        = get_text_offset (state->elf) - start;
+    function->fixup_count = state->call_count - first_call;
+
+    function->code   = (uint8_t*) malloc (function->size);
+    function->fixups = (struct CallFixup_t*) calloc ((size_t) function->fixup_count + 1, sizeof (*function->fixups));
+
+    if (!function->code || !function->fixups)
+    {
+        free_function_code (function);
+        return 1;
+    }
+
+    memcpy (function->code, get_text_buffer (state->elf)->data + start, function->size);
+
+    for (int i = 0; i < function->fixup_count; i++)
+    {
+        const struct PendingPatch* call = &state->calls[first_call + i];
+
+        function->fixups[i].offset = (uint32_t) (call->patch_offset - start);
+        memcpy (function->fixups[i].target, call->target_label, MAX_LENGTH_NAME);
+    }
+
+    return 0;
+}
+
+// places code compiled earlier, maybe by another run, as function 'name'
+void splice_elf_function (struct CompilerState* state, const char* name, const struct FunctionCode_t* function)
+{
+    assert (state);
+    assert (name);
+    assert (function);
+
+    size_t start = get_text_offset (state->elf);
+
+    resolve_label (state, name, start);
+    emit_bytes (get_text_buffer (state->elf), function->code, function->size);
+
+    for (int i = 0; i < function->fixup_count; i++)
+    {
+        struct PendingPatch* call = add_call (state);
+
+        call->patch_offset = start + function->fixups[i].offset;
+        memcpy (call->target_label, function->fixups[i].target, MAX_LENGTH_NAME);
+        call->target_label[MAX_LENGTH_NAME - 1] = '\0';
+    }
+}
+
+void destroy_elf_program (struct CompilerState* state)
+{
+    if (state)
+    {
+        destroy_elf_builder (state->elf);
+        free (state->labels);
+        free (state->label_hash);
+        free (state->calls);
+        free (state);
+    }
+}
+
+void free_function_code (struct FunctionCode_t* function)
+{
+    free (function->code);
+    free (function->fixups);
+
+    function->code   = NULL;
+    function->fixups = NULL;
+}
+
+// resolves the calls, adds _start and writes the executable; the state is freed
+enum Errors link_elf_program (struct CompilerState* state, const char* output_filename)
+{
+    assert (state);
+    assert (output_filename);
+
+    if (link_calls (state) != 0)
+    {
+        destroy_elf_program (state);
+        return LINK_ERROR;
+    }
 
     // create _start function after user code
-    struct CodeBuffer* code = get_text_buffer (state.elf);
-    size_t start_offset = get_text_offset (state.elf);  // save offset BEFORE adding any code
+    struct CodeBuffer* code = get_text_buffer (state->elf);
+    size_t start_offset = get_text_offset (state->elf);  // save offset BEFORE adding any code
 
 #ifdef DEBUG
     fprintf (stderr, "Creating _start at offset 0x%lx (text_size=%lu)\n", start_offset, code->size);
 #endif
 
     // resolve _start label at current position
-    resolve_label (&state, "_start", start_offset);
+    resolve_label (state, "_start", start_offset);
 
     // initialize stack: kernel should set rsp, but clear rbp for stack unwinding
     encode_xor_reg_reg (code, RBP, RBP);  // xor rbp, rbp (mark end of stack frames)
 
     // emit _start code: call carti
-    struct Label* carti_label = find_label (&state, "carti");
+    struct Label* carti_label = find_label (state, "carti");
     if (carti_label && carti_label->is_resolved)
     {
         size_t call_offset = start_offset + 3;  // after xor rbp,rbp (3 bytes)
@@ -946,7 +1436,7 @@ enum Errors generate_elf_binary (struct IRGenerator_t* gen, const char* output_f
     }
 
     // emit _start code: call hlt_syscall
-    struct Label* hlt_label = find_label (&state, "hlt_syscall");
+    struct Label* hlt_label = find_label (state, "hlt_syscall");
     if (hlt_label && hlt_label->is_resolved)
     {
         size_t call_offset = start_offset + 3 + 5;  // after xor (3) + first call (5)
@@ -970,12 +1460,12 @@ enum Errors generate_elf_binary (struct IRGenerator_t* gen, const char* output_f
     fprintf (stderr, "Setting entry point: text_offset=0x%lx, file_offset=0x%lx, vaddr=0x%lx\n",
              start_offset, file_offset, TEXT_VADDR + file_offset);
 #endif
-    set_entry_point (state.elf, file_offset);
+    set_entry_point (state->elf, file_offset);
 
     // write executable
-    int result = write_elf_executable (state.elf, output_filename);
+    int result = write_elf_executable (state->elf, output_filename);
 
-    destroy_elf_builder (state.elf);
+    destroy_elf_program (state);
 
     return (result == 0) ? NO_ERROR : FILE_OPEN_ERROR;
 }
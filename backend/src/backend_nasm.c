@@ -325,11 +325,10 @@ static void transform_to_x86 (FILE* asm_file, struct Token* tokens, int token_co
 
                 fprintf (asm_file, "\nloop_%s:\n", body_label);
 
-                char reg_str[3] = {};
+                // r0 - r13: two digits at most
+                char reg_str[4] = "r";
                 int num = 0;
-                sscanf (condition, "r%s > %d", &reg_str[1], &num);
-                reg_str[0] = 'r';
-                reg_str[2] = '\0';
+                sscanf (condition, "r%2[0-9] > %d", &reg_str[1], &num);
 
                 int reg_index = get_reg_index (reg_str);
 #ifdef DEBUG
@@ -375,10 +374,8 @@ static void transform_to_x86 (FILE* asm_file, struct Token* tokens, int token_co
                     return;
                 }
 
-                char reg_str[3] = {};
-                sscanf(condition, "r%s != %d", &reg_str[1], &(int){0});
-                reg_str[0] = 'r';
-                reg_str[2] = '\0';
+                char reg_str[4] = "r";
+                sscanf(condition, "r%2[0-9] != %d", &reg_str[1], &(int){0});
 
                 int reg_index = get_reg_index(reg_str);
                 if (reg_index >= 0 && reg_index < MAX_REGISTERS)
@@ -423,6 +420,10 @@ enum Errors generate_x86_nasm (struct IRGenerator_t* gen, const char* asm_filena
 
     struct Token tokens[MAX_TOKENS] = {};
 
+    // the variables and labels of an earlier program compiled by the same process are dropped
+    variable_count = 0;
+    stack_depth    = 0;
+
     fprintf (asm_file, "%%include \"src/io_syscalls.nasm\"\n\n");
 
     fprintf (asm_file, "section .data\n");
@@ -46,6 +46,24 @@ struct ElfBuilder* create_elf_builder()
     return builder;
 }
 
+struct ElfBuilder* copy_elf_builder (const struct ElfBuilder* source)
+{
+    assert (source);
+
+    struct ElfBuilder* builder = (struct ElfBuilder*) calloc (1, sizeof (struct ElfBuilder));
+    if (!builder)
+    {
+        fprintf (stderr, "Error: failed to allocate ElfBuilder\n");
+        exit(1);
+    }
+
+    builder->text_section = copy_code_buffer (source->text_section);
+    builder->data_section = copy_code_buffer (source->data_section);
+    builder->entry_point  = source->entry_point;
+
+    return builder;
+}
+
 void destroy_elf_builder (struct ElfBuilder* builder)
 {
     if (builder)
@@ -1,10 +1,12 @@
 #include <stdio.h>
+#include <inttypes.h>
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
 #include <ctype.h>
 
 #include "ir_gen.h"
+#include "name_index.h"
 
 // returns 1 if str looks like a virtual register ("r<digits>")
 static int is_register_str (const char* str)
@@ -15,20 +17,143 @@ static int is_register_str (const char* str)
     return str[1] != '\0';
 }
 
+// names are compared by length: they are not terminated when they point into the source
+static int name_is (const char* name, int length, const char* word)
+{
+    return (size_t) length == strlen (word) && strncmp (name, word, (size_t) length) == 0;
+}
+
+static int symbol_equal (const void* table, int position, const char* str, int length)
+{
+    const struct Symbol* symbol = &((const struct Symbol*) table)[position];
+
+    return strncmp (symbol->name, str, (size_t) length) == 0 &&
+           symbol->name[length] == '\0';
+}
+
+static int find_symbol (struct IRGenerator_t* gen, const char* name, int length)
+{
+    return name_index_find (gen->symbol_hash, SYMBOL_HASH_SIZE, gen->symbols, symbol_equal, name, length);
+}
+
+static void add_symbol (struct IRGenerator_t* gen, const char* name, int length, const char* reg)
+{
+    if (gen->symbol_count >= MAX_SYMBOLS)
+    {
+        fprintf (stderr, "Symbol table overflow\n");
+        exit (1);
+    }
+
+    int copy = (length < MAX_VAR_NAME - 1) ? length : MAX_VAR_NAME - 1;
+
+    memcpy (gen->symbols[gen->symbol_count].name, name, (size_t) copy);
+    gen->symbols[gen->symbol_count].name[copy] = '\0';
+
+    strncpy (gen->symbols[gen->symbol_count].reg,  reg,  MAX_VAR_NAME - 1);
+    name_index_insert (gen->symbol_hash, SYMBOL_HASH_SIZE, name, length, gen->symbol_count);
+    gen->symbol_count++;
+}
+
 void initial_ir_generator (struct IRGenerator_t* gen)
 {
+    memset (gen->symbol_hash, 0, sizeof (gen->symbol_hash));
     gen->symbol_count = 0;
+    gen->instructions = NULL;
     gen->instr_count = 0;
-    gen->reg_count = 0;
+    gen->instr_capacity = 0;
+    gen->registers.kept = 0;
+    gen->registers.temporaries = 0;
+    gen->label_count = 0;
+    gen->error = 0;
 }
 
-// allocate a fresh virtual register name into buffer
+void destroy_ir_generator (struct IRGenerator_t* gen)
+{
+    assert (gen);
+
+    free (gen->instructions);
+
+    gen->instructions   = NULL;
+    gen->instr_count    = 0;
+    gen->instr_capacity = 0;
+}
+
+// when the registers run out the name is still written, so that the generation runs to its end
+static void check_registers (struct IRGenerator_t* gen)
+{
+    if (ir_registers_fit (&gen->registers, 1))
+        return;
+
+    if (!gen->error)
+        fprintf (stderr, "ERROR: the program needs more than %d registers\n", IR_REGISTERS - 1);
+
+    gen->error = 1;
+}
+
+// allocate a fresh virtual register name into buffer, it is never given back
 void new_register (struct IRGenerator_t* gen, char* buffer, size_t size)
 {
     assert (gen);
     assert (buffer);
 
-    snprintf (buffer, size, "r%d", ++gen->reg_count);
+    check_registers (gen);
+    snprintf (buffer, size, "r%d", take_kept_register (&gen->registers));
+}
+
+// a register for a value inside one statement
+static void new_temporary (struct IRGenerator_t* gen, char* buffer, size_t size)
+{
+    check_registers (gen);
+    snprintf (buffer, size, "r%d", take_temporary (&gen->registers));
+}
+
+static int is_temporary_str (const struct IRGenerator_t* gen, const char* str)
+{
+    return is_register_str (str) && is_temporary (&gen->registers, atoi (str + 1));
+}
+
+static void release_register (struct IRGenerator_t* gen, const char* reg)
+{
+    if (is_register_str (reg))
+        give_back_temporary (&gen->registers, atoi (reg + 1));
+}
+
+// a condition compares a register with something: an operand the middle-end folded to a number
+// is set into a temporary first
+static char* in_register (struct IRGenerator_t* gen, char* operand)
+{
+    if (operand == NULL || is_register_str (operand))
+        return operand;
+
+    char reg  [MAX_VAR_NAME]  = {};
+    char instr[MAX_INSTR_LEN] = {};
+
+    new_temporary (gen, reg, sizeof (reg));
+    snprintf (instr, sizeof (instr), "set %s, %s", reg, operand);
+    add_instruction (gen, instr);
+
+    free (operand);
+    return strdup (reg);
+}
+
+// a loop compares its condition again at every iteration, and a call in its body uses the
+// temporaries too: a number or a temporary is set into a register of its own
+static char* loop_register (struct IRGenerator_t* gen, char* operand)
+{
+    if (operand == NULL || (is_register_str (operand) && !is_temporary_str (gen, operand)))
+        return operand;
+
+    char reg  [MAX_VAR_NAME]  = {};
+    char instr[MAX_INSTR_LEN] = {};
+
+    release_register (gen, operand);
+
+    new_register (gen, reg, sizeof (reg));
+    snprintf (instr, sizeof (instr), "set %s, %s", reg, operand);
+    add_instruction (gen, instr);
+
+    free (operand);
+    return strdup (reg);
 }
 
 // look up variable by name; return its register
@@ -38,31 +163,29 @@ char* get_or_add_symbol (struct IRGenerator_t* gen, const char* name, int length
     assert (gen);
     assert (name);
 
-    for (int i = 0; i < gen->symbol_count; i++)
-    {
-        if (strncmp (gen->symbols[i].name, name, (size_t) length) == 0 &&
-            gen->symbols[i].name[length] == '\0')
-        {
-            return strdup (gen->symbols[i].reg);
-        }
-    }
-
-    if (gen->symbol_count >= MAX_SYMBOLS)
-    {
-        fprintf (stderr, "Symbol table overflow\n");
-        exit (1);
-    }
+    int position = find_symbol (gen, name, length);
+    if (position != -1)
+        return strdup (gen->symbols[position].reg);
 
     char reg[MAX_VAR_NAME] = {};
     new_register (gen, reg, sizeof (reg));
 
-    strncpy (gen->symbols[gen->symbol_count].name, name,   MAX_VAR_NAME - 1);
-    strncpy (gen->symbols[gen->symbol_count].reg,  reg,    MAX_VAR_NAME - 1);
-    gen->symbol_count++;
+    add_symbol (gen, name, length, reg);
 
     return strdup (reg);
 }
 
+// register bound to a variable name, NULL if it has none yet
+const char* lookup_symbol (struct IRGenerator_t* gen, const char* name, int length)
+{
+    assert (gen);
+    assert (name);
+
+    int position = find_symbol (gen, name, length);
+
+    return (position != -1) ? gen->symbols[position].reg : NULL;
+}
+
 // update (or insert) the register bound to a variable name
 void set_symbol_reg (struct IRGenerator_t* gen, const char* name, int length, const char* reg)
 {
@@ -70,25 +193,14 @@ void set_symbol_reg (struct IRGenerator_t* gen, const char* name, int length, co
     assert (name);
     assert (reg);
 
-    for (int i = 0; i < gen->symbol_count; i++)
+    int position = find_symbol (gen, name, length);
+    if (position != -1)
     {
-        if (strncmp (gen->symbols[i].name, name, (size_t) length) == 0 &&
-            gen->symbols[i].name[length] == '\0')
-        {
-            strncpy (gen->symbols[i].reg, reg, MAX_VAR_NAME - 1);
-            return;
-        }
+        strncpy (gen->symbols[position].reg, reg, MAX_VAR_NAME - 1);
+        return;
     }
 
-    if (gen->symbol_count >= MAX_SYMBOLS)
-    {
-        fprintf (stderr, "Symbol table overflow\n");
-        exit (1);
-    }
-
-    strncpy (gen->symbols[gen->symbol_count].name, name, MAX_VAR_NAME - 1);
-    strncpy (gen->symbols[gen->symbol_count].reg,  reg,  MAX_VAR_NAME - 1);
-    gen->symbol_count++;
+    add_symbol (gen, name, length, reg);
 }
 
 void add_instruction (struct IRGenerator_t* gen, const char* instr)
@@ -96,15 +208,29 @@ void add_instruction (struct IRGenerator_t* gen, const char* instr)
     assert (gen);
     assert (instr);
 
-    if (gen->instr_count < MAX_IR_INSTR)
+    if (gen->instr_count == gen->instr_capacity)
     {
-        strncpy (gen->instructions[gen->instr_count++], instr, MAX_INSTR_LEN - 1);
-    }
-    else
-    {
-        fprintf (stderr, "Instruction buffer overflow\n");
-        exit (1);
+        int capacity = (gen->instr_capacity != 0) ? 2 * gen->instr_capacity : IR_START;
+
+        char (*grown)[MAX_INSTR_LEN] = (char (*)[MAX_INSTR_LEN]) realloc (gen->instructions,
+                                                                          (size_t) capacity * MAX_INSTR_LEN);
+        if (grown == NULL)
+        {
+            if (!gen->error)
+                fprintf (stderr, "ERROR: could not grow the IR to %d instructions\n", capacity);
+
+            gen->error = 1;
+            return;
+        }
+
+        gen->instructions   = grown;
+        gen->instr_capacity = capacity;
     }
+
+    char* line = gen->instructions[gen->instr_count++];
+
+    strncpy (line, instr, MAX_INSTR_LEN - 1);
+    line[MAX_INSTR_LEN - 1] = '\0';
 }
 
 // model: each variable owns one fixed register for its lifetime.
@@ -115,7 +241,9 @@ char* bypass (struct IRGenerator_t* gen, struct Node_t* node, struct Context_t*
 
     if (node == NULL) return NULL;
 
-    switch (node->type)
+    const struct NodePool_t* pool = &context->nodes;
+
+    switch (node_type (pool, node))
     {
         case FUNC:
         {
@@ -123,43 +251,48 @@ char* bypass (struct IRGenerator_t* gen, struct Node_t* node, struct Context_t*
             {
                 case FN_GLUE:
                 {
-                    bypass (gen, node->left,  context);
-                    bypass (gen, node->right, context);
+                    bypass (gen, node_left  (pool, node), context);
+                    bypass (gen, node_right (pool, node), context);
                     return NULL;
                 }
 
                 case DEF:
                 {
-                    const char* func_name = context->name_table[(int)node->left->left->value].name.str_pointer;
-                    int         func_len  = context->name_table[(int)node->left->left->value].name.length;
+                    const struct Node_t* head = node_left (pool, node);
+
+                    const char* func_name = context->name_table[(int)node_left (pool, head)->value].name.str_pointer;
+                    int         func_len  = context->name_table[(int)node_left (pool, head)->value].name.length;
                     char instr[MAX_INSTR_LEN] = {};
 
                     snprintf (instr, sizeof (instr), "function %.*s", func_len, func_name);
                     add_instruction (gen, instr);
 
                     // emit param instructions
-                    if (node->left->right &&
-                        node->left->right->type == FUNC &&
-                        (int) node->left->right->value == COMMA)
+                    struct Node_t* param = node_right (pool, head);
+
+                    if (param &&
+                        node_type (pool, param) == FUNC &&
+                        (int) param->value == COMMA)
                     {
-                        struct Node_t* param = node->left->right;
                         while (param)
                         {
-                            if (param->left && param->left->type == ID)
+                            const struct Node_t* name = node_left (pool, param);
+
+                            if (name && node_type (pool, name) == ID)
                             {
-                                const char* pname = context->name_table[(int)param->left->value].name.str_pointer;
-                                int         plen  = context->name_table[(int)param->left->value].name.length;
+                                const char* pname = context->name_table[(int)name->value].name.str_pointer;
+                                int         plen  = context->name_table[(int)name->value].name.length;
                                 char* preg = get_or_add_symbol (gen, pname, plen);
 
                                 snprintf (instr, sizeof (instr), "param %.*s, %s", plen, pname, preg);
                                 add_instruction (gen, instr);
                                 free (preg);
                             }
-                            param = param->right;
+                            param = node_right (pool, param);
                         }
                     }
 
-                    bypass (gen, node->right, context);
+                    bypass (gen, node_right (pool, node), context);
 
                     snprintf (instr, sizeof (instr), "end_function");
                     add_instruction (gen, instr);
@@ -169,17 +302,19 @@ char* bypass (struct IRGenerator_t* gen, struct Node_t* node, struct Context_t*
 
                 case CALL:
                 {
-                    const char* func_name = context->name_table[(int)node->left->value].name.str_pointer;
-                    int         func_len  = context->name_table[(int)node->left->value].name.length;
+                    const char* func_name = context->name_table[(int)node_left (pool, node)->value].name.str_pointer;
+                    int         func_len  = context->name_table[(int)node_left (pool, node)->value].name.length;
                     char instr[MAX_INSTR_LEN] = {};
 
+                    const struct Node_t* args = node_right (pool, node);
+
                     // for sqrt: evaluate argument, emit sqrt instruction, return result register
-                    if (strncmp (func_name, "sqrt", (size_t) func_len) == 0 &&
-                        node->right &&
-                        node->right->type == FUNC &&
-                        (int) node->right->value == COMMA)
+                    if (name_is (func_name, func_len, "sqrt") &&
+                        args &&
+                        node_type (pool, args) == FUNC &&
+                        (int) args->value == COMMA)
                     {
-                        struct Node_t* arg = node->right->left;
+                        struct Node_t* arg = node_left (pool, args);
                         if (arg)
                         {
                             char* arg_reg = bypass (gen, arg, context);
@@ -194,12 +329,12 @@ char* bypass (struct IRGenerator_t* gen, struct Node_t* node, struct Context_t*
                     }
 
                     // for yap: load argument into rdi before call
-                    if (strcmp (func_name, "yap") == 0 &&
-                        node->right &&
-                        node->right->type == FUNC &&
-                        (int) node->right->value == COMMA)
+                    if (name_is (func_name, func_len, "yap") &&
+                        args &&
+                        node_type (pool, args) == FUNC &&
+                        (int) args->value == COMMA)
                     {
-                        struct Node_t* arg = node->right->left;
+                        struct Node_t* arg = node_left (pool, args);
                         if (arg)
                         {
                             char* arg_reg = bypass (gen, arg, context);
@@ -207,6 +342,7 @@ char* bypass (struct IRGenerator_t* gen, struct Node_t* node, struct Context_t*
                             {
                                 snprintf (instr, sizeof (instr), "set rdi, %s", arg_reg);
                                 add_instruction (gen, instr);
+                                release_register (gen, arg_reg);
                                 free (arg_reg);
                             }
                         }
@@ -216,13 +352,13 @@ char* bypass (struct IRGenerator_t* gen, struct Node_t* node, struct Context_t*
                     add_instruction (gen, instr);
 
                     // gimme: result comes back in r0; write it into the variable's register
-                    if (strcmp (func_name, "gimme") == 0 &&
-                        node->right &&
-                        node->right->type == FUNC &&
-                        (int) node->right->value == COMMA)
+                    if (name_is (func_name, func_len, "gimme") &&
+                        args &&
+                        node_type (pool, args) == FUNC &&
+                        (int) args->value == COMMA)
                     {
-                        struct Node_t* arg = node->right->left;
-                        if (arg && arg->type == ID)
+                        struct Node_t* arg = node_left (pool, args);
+                        if (arg && node_type (pool, arg) == ID)
                         {
                             const char* vname = context->name_table[(int)arg->value].name.str_pointer;
                             int         vlen  = context->name_table[(int)arg->value].name.length;
@@ -239,13 +375,13 @@ char* bypass (struct IRGenerator_t* gen, struct Node_t* node, struct Context_t*
 
                 case COMMA:
                 {
-                    bypass (gen, node->left,  context);
-                    bypass (gen, node->right, context);
+                    bypass (gen, node_left  (pool, node), context);
+                    bypass (gen, node_right (pool, node), context);
                     return NULL;
                 }
 
                 default:
-                    fprintf (stderr, "Unknown FUNC value: %.0f\n", node->value);
+                    fprintf (stderr, "Unknown FUNC value: %" PRId64 "\n", node->value);
                     return NULL;
             }
         }
@@ -254,12 +390,19 @@ char* bypass (struct IRGenerator_t* gen, struct Node_t* node, struct Context_t*
         {
             switch ((int) node->value)
             {
+                // the temporaries of a statement are free again once it is done
                 case GLUE:
                 {
-                    char* r1 = bypass (gen, node->left,  context);
+                    int temps = gen->registers.temporaries;
+
+                    char* r1 = bypass (gen, node_left  (pool, node), context);
                     free (r1);
-                    char* r2 = bypass (gen, node->right, context);
+                    gen->registers.temporaries = temps;
+
+                    char* r2 = bypass (gen, node_right (pool, node), context);
                     free (r2);
+                    gen->registers.temporaries = temps;
+
                     return NULL;
                 }
 
@@ -267,17 +410,17 @@ char* bypass (struct IRGenerator_t* gen, struct Node_t* node, struct Context_t*
                 // rA = fixed register for a; write expr result into rA
                 case EQUAL:
                 {
-                    const char* lname = context->name_table[(int)node->left->value].name.str_pointer;
-                    int         llen  = context->name_table[(int)node->left->value].name.length;
+                    const char* lname = context->name_table[(int)node_left (pool, node)->value].name.str_pointer;
+                    int         llen  = context->name_table[(int)node_left (pool, node)->value].name.length;
 
                     // get (or allocate) lhs's own register
                     char* lreg = get_or_add_symbol (gen, lname, llen);
 
                     // fast path: rhs is a literal - emit set directly, no temp register
-                    if (node->right != NULL && node->right->type == NUM)
+                    if (node_right (pool, node) != NULL && node_type (pool, node_right (pool, node)) == NUM)
                     {
                         char instr[MAX_INSTR_LEN] = {};
-                        snprintf (instr, sizeof (instr), "set %s, %.0f", lreg, node->right->value);
+                        snprintf (instr, sizeof (instr), "set %s, %" PRId64, lreg, node_right (pool, node)->value);
                         add_instruction (gen, instr);
                         free (lreg);
                         return NULL;
@@ -285,15 +428,15 @@ char* bypass (struct IRGenerator_t* gen, struct Node_t* node, struct Context_t*
 
                     // fast path: rhs is a simple binary op - write result directly into lreg,
                     // avoiding an extra temp register
-                    struct Node_t* rhs = node->right;
+                    struct Node_t* rhs = node_right (pool, node);
                     int rhs_op = (rhs != NULL) ? (int) rhs->value : 0;
-                    if (rhs != NULL && rhs->type == OP &&
+                    if (rhs != NULL && node_type (pool, rhs) == OP &&
                         (rhs_op == ADD || rhs_op == SUB || rhs_op == MUL ||
                          rhs_op == DIV || rhs_op == POW))
                     {
                         // get operand strings (may be reg or literal)
-                        char* a = bypass (gen, rhs->left,  context);
-                        char* b = bypass (gen, rhs->right, context);
+                        char* a = bypass (gen, node_left  (pool, rhs), context);
+                        char* b = bypass (gen, node_right (pool, rhs), context);
 
                         const char* op_str = (rhs_op == ADD) ? "add" :
                                              (rhs_op == SUB) ? "sub" :
@@ -306,7 +449,7 @@ char* bypass (struct IRGenerator_t* gen, struct Node_t* node, struct Context_t*
                         if (is_register_str (b) && strcmp (b, lreg) == 0)
                         {
                             char saved[MAX_VAR_NAME] = {};
-                            new_register (gen, saved, sizeof (saved));
+                            new_temporary (gen, saved, sizeof (saved));
                             snprintf (instr, sizeof (instr), "set %s, %s", saved, b);
                             add_instruction (gen, instr);
                             free (b);
@@ -321,6 +464,8 @@ char* bypass (struct IRGenerator_t* gen, struct Node_t* node, struct Context_t*
                         snprintf (instr, sizeof (instr), "%s %s, %s", op_str, lreg, b);
                         add_instruction (gen, instr);
 
+                        release_register (gen, b);
+                        release_register (gen, a);
                         free (a);
                         free (b);
                         free (lreg);
@@ -328,7 +473,7 @@ char* bypass (struct IRGenerator_t* gen, struct Node_t* node, struct Context_t*
                     }
 
                     // evaluate rhs: for arithmetic, result is in a temp register
-                    char* rreg = bypass (gen, node->right, context);
+                    char* rreg = bypass (gen, node_right (pool, node), context);
 
                     if (rreg == NULL)
                     {
@@ -345,6 +490,7 @@ char* bypass (struct IRGenerator_t* gen, struct Node_t* node, struct Context_t*
                         add_instruction (gen, instr);
                     }
 
+                    release_register (gen, rreg);
                     free (rreg);
                     free (lreg);
                     return NULL;
@@ -356,9 +502,6 @@ char* bypass (struct IRGenerator_t* gen, struct Node_t* node, struct Context_t*
                 case DIV:
                 case POW:
                 {
-                    char* lreg = bypass (gen, node->left,  context);
-                    char* rreg = bypass (gen, node->right, context);
-
                     const char* op = NULL;
                     switch ((int) node->value)
                     {
@@ -373,52 +516,52 @@ char* bypass (struct IRGenerator_t* gen, struct Node_t* node, struct Context_t*
 
                     char instr[MAX_INSTR_LEN] = {};
 
-                    // if rreg is a literal number - emit op directly without a temp register
-                    // backend handles reg-imm variants (add rX, 4 / mul rX, 4 / etc.)
-                    if (!is_register_str (rreg))
+                    // the result is computed in a temporary: the left operand, if it is one,
+                    // else a copy of it, which keeps the variable it may be from intact
+                    char* lreg = bypass (gen, node_left (pool, node), context);
+
+                    if (!is_temporary_str (gen, lreg))
                     {
-                        // lreg may be a named-variable register - copy into a temp to avoid clobbering it
                         char tmp[MAX_VAR_NAME] = {};
-                        new_register (gen, tmp, sizeof (tmp));
+                        new_temporary (gen, tmp, sizeof (tmp));
                         snprintf (instr, sizeof (instr), "set %s, %s", tmp, lreg);
                         add_instruction (gen, instr);
-                        snprintf (instr, sizeof (instr), "%s %s, %s", op, tmp, rreg);
-                        add_instruction (gen, instr);
                         free (lreg);
-                        free (rreg);
-                        return strdup (tmp);
+                        lreg = strdup (tmp);
                     }
 
-                    // both operands are registers - copy lreg into a temp to avoid clobbering the variable
-                    char tmp[MAX_VAR_NAME] = {};
-                    new_register (gen, tmp, sizeof (tmp));
-                    snprintf (instr, sizeof (instr), "set %s, %s", tmp, lreg);
-                    add_instruction (gen, instr);
-                    snprintf (instr, sizeof (instr), "%s %s, %s", op, tmp, rreg);
+                    // backend handles reg-imm variants (add rX, 4 / mul rX, 4 / etc.)
+                    char* rreg = bypass (gen, node_right (pool, node), context);
+
+                    snprintf (instr, sizeof (instr), "%s %s, %s", op, lreg, rreg);
                     add_instruction (gen, instr);
 
-                    free (lreg);
+                    release_register (gen, rreg);
                     free (rreg);
-                    return strdup (tmp);
+                    return lreg;
                 }
 
                 case WHILE:
                 {
                     char label[64] = {};
-                    snprintf (label, sizeof (label), "body%d", rand () % 1000);
+                    snprintf (label, sizeof (label), "body%d", ++gen->label_count);
 
                     char instr[MAX_INSTR_LEN] = {};
 
-                    struct Node_t* cond = node->left;
+                    struct Node_t* cond = node_left (pool, node);
                     int cond_op = (cond != NULL) ? (int) cond->value : 0;
 
-                    if (cond != NULL && cond->type == OP &&
+                    if (cond != NULL && node_type (pool, cond) == OP &&
                         (cond_op == GT || cond_op == LT || cond_op == GTE ||
                          cond_op == NEQ || cond_op == EQ))
                     {
                         // comparison: "while rL <op> rR, label"
-                        char* lreg = bypass (gen, cond->left,  context);
-                        char* rreg = bypass (gen, cond->right, context);
+                        char* lreg = loop_register (gen, bypass (gen, node_left (pool, cond), context));
+                        char* rreg = bypass (gen, node_right (pool, cond), context);
+
+                        if (is_temporary_str (gen, rreg))
+                            rreg = loop_register (gen, rreg);
+
                         const char* op_str = (cond_op == GT)  ? "fr"     :
                                              (cond_op == LT)  ? "lowkey" :
                                              (cond_op == GTE) ? "nocap"  :
@@ -430,7 +573,7 @@ char* bypass (struct IRGenerator_t* gen, struct Node_t* node, struct Context_t*
                     }
                     else
                     {
-                        char* cond_reg = bypass (gen, cond, context);
+                        char* cond_reg = loop_register (gen, bypass (gen, cond, context));
                         if (cond_reg == NULL)
                         {
                             fprintf (stderr, "Error: condition register is NULL for WHILE\n");
@@ -441,7 +584,7 @@ char* bypass (struct IRGenerator_t* gen, struct Node_t* node, struct Context_t*
                         free (cond_reg);
                     }
 
-                    bypass (gen, node->right, context);
+                    bypass (gen, node_right (pool, node), context);
 
                     snprintf (instr, sizeof (instr), "end_while");
                     add_instruction (gen, instr);
@@ -452,32 +595,34 @@ char* bypass (struct IRGenerator_t* gen, struct Node_t* node, struct Context_t*
                 case IF:
                 {
                     char label[64] = {};
-                    snprintf (label, sizeof (label), "if_body%d", rand () % 1000);
+                    snprintf (label, sizeof (label), "if_body%d", ++gen->label_count);
 
                     char instr[MAX_INSTR_LEN] = {};
 
-                    struct Node_t* cond = node->left;
+                    struct Node_t* cond = node_left (pool, node);
                     int cond_op = (cond != NULL) ? (int) cond->value : 0;
 
-                    if (cond != NULL && cond->type == OP &&
+                    if (cond != NULL && node_type (pool, cond) == OP &&
                         (cond_op == GT || cond_op == LT || cond_op == GTE ||
                          cond_op == NEQ || cond_op == EQ))
                     {
                         // comparison: "if rL <op> rR, label"
-                        char* lreg = bypass (gen, cond->left,  context);
-                        char* rreg = bypass (gen, cond->right, context);
+                        char* lreg = in_register (gen, bypass (gen, node_left (pool, cond), context));
+                        char* rreg = bypass (gen, node_right (pool, cond), context);
                         const char* op_str = (cond_op == GT)  ? "fr"     :
                                              (cond_op == LT)  ? "lowkey" :
                                              (cond_op == GTE) ? "nocap"  :
                                              (cond_op == NEQ) ? "nah"    : "sameAs";
                         snprintf (instr, sizeof (instr), "if %s %s %s, %s", lreg, op_str, rreg, label);
                         add_instruction (gen, instr);
+                        release_register (gen, rreg);
+                        release_register (gen, lreg);
                         free (lreg);
                         free (rreg);
                     }
                     else
                     {
-                        char* cond_reg = bypass (gen, cond, context);
+                        char* cond_reg = in_register (gen, bypass (gen, cond, context));
                         if (cond_reg == NULL)
                         {
                             fprintf (stderr, "Error: condition register is NULL for IF\n");
@@ -485,10 +630,11 @@ char* bypass (struct IRGenerator_t* gen, struct Node_t* node, struct Context_t*
                         }
                         snprintf (instr, sizeof (instr), "if %s != 0, %s", cond_reg, label);
                         add_instruction (gen, instr);
+                        release_register (gen, cond_reg);
                         free (cond_reg);
                     }
 
-                    bypass (gen, node->right, context);
+                    bypass (gen, node_right (pool, node), context);
 
                     snprintf (instr, sizeof (instr), "end_if");
                     add_instruction (gen, instr);
@@ -497,7 +643,7 @@ char* bypass (struct IRGenerator_t* gen, struct Node_t* node, struct Context_t*
                 }
 
                 default:
-                    fprintf (stderr, "Unknown OP value: %.0f\n", node->value);
+                    fprintf (stderr, "Unknown OP value: %" PRId64 "\n", node->value);
                     return NULL;
             }
         }
@@ -513,12 +659,12 @@ char* bypass (struct IRGenerator_t* gen, struct Node_t* node, struct Context_t*
         {
             // return the literal as a string - no register allocated
             char* str = calloc (MAX_VAR_NAME, sizeof (char));
-            snprintf (str, MAX_VAR_NAME, "%.0f", node->value);
+            snprintf (str, MAX_VAR_NAME, "%" PRId64, node->value);
             return str;
         }
 
         default:
-            fprintf (stderr, "Unknown node type: %d\n", node->type);
+            fprintf (stderr, "Unknown node type: %d\n", node_type (pool, node));
             exit (1);
     }
 }
@@ -1,4 +1,6 @@
 #include <stdio.h>
+#include <string.h>
+#include <limits.h>
 
 #include "backend_nasm.h"
 #include "backend_elf.h"
@@ -7,27 +9,93 @@
 #include "struct.h"
 #include "keywords.h"
 #include "tree_io.h"
+#include "tree_bin.h"
 #include "file.h"
+#include "work_dir.h"
+#include "time_report.h"
 
 #define EXE_FILE        "backend/build/program"
 #define NAME_T_FILENAME "backend/Name_Table.txt"
 #define TREE_FILENAME   "backend/AST_tree.txt"
+#define BINARY_FILENAME "backend/AST_tree.bin"
 #define IR_FILENAME     "backend/program_beta.ir"
 #define NASM_FILENAME   "backend/program_beta.nasm"
 
-int main ()
+int main (int argc, const char* argv[])
 {
-    struct Context_t context = {};
+    int text  = 0;
+    int usage = 0;
+
+    const char* input    = NULL;    // binary AST, instead of the one the middle-end left in the work directory
+    const char* output   = NULL;    // the program, instead of the one in the work directory
+    const char* work_dir = NULL;
+
+    struct TimeReport_t report = {};
 
-    ctor_keywords (&context);
+    for (int i = 1; i < argc; i++)
+    {
+        if      (strcmp (argv[i], "--text")    == 0)                 text     = 1;
+        else if (strcmp (argv[i], "-o")        == 0 && i + 1 < argc) output   = argv[++i];
+        else if (strcmp (argv[i], "--workdir") == 0 && i + 1 < argc) work_dir = argv[++i];
+        else if (time_report_option (&report, argv[i]))              continue;
+        else if (argv[i][0] != '-' && input == NULL)                 input    = argv[i];
+        else                                                         usage    = 1;
+    }
 
-    int read_error = read_name_table (&context, NAME_T_FILENAME);
-    if (read_error != 0)
+    if (usage || (text && input != NULL))
+    {
+        fprintf (stderr, "Usage: %s [--text] [--workdir <dir>] [-o <program>] [--time-report[=json]] [<ast.bin>]\n", argv[0]);
+        return 1;
+    }
+
+    if (set_work_dir (work_dir) != 0)
         return 1;
 
+    char names_path [PATH_MAX] = {};
+    char tree_path  [PATH_MAX] = {};
+    char binary_path[PATH_MAX] = {};
+    char ir_path    [PATH_MAX] = {};
+    char nasm_path  [PATH_MAX] = {};
+    char exe_path   [PATH_MAX] = {};
+
+    if ((text  && (work_path (names_path, sizeof (names_path), NAME_T_FILENAME) == NULL ||
+                   work_path (tree_path,  sizeof (tree_path),  TREE_FILENAME)   == NULL)) ||
+        (!text && input  == NULL && (input  = work_path (binary_path, sizeof (binary_path), BINARY_FILENAME)) == NULL) ||
+        (output == NULL && (output = work_path (exe_path, sizeof (exe_path), EXE_FILE)) == NULL) ||
+        work_path (ir_path,   sizeof (ir_path),   IR_FILENAME)   == NULL ||
+        work_path (nasm_path, sizeof (nasm_path), NASM_FILENAME) == NULL)
+        return 1;
+
+    struct Context_t context = {};
+
+    if (ctor_keywords (&context) != 0)
+    {
+        dtor_keywords (&context);
+        return 1;
+    }
+
     struct Buffer_t buffer = {};
+    struct Node_t* root = NULL;
+
+    phase_begin (&report, "read AST");
+
+    if (text)
+    {
+        int read_error = read_name_table (&context, names_path);
+        if (read_error != 0)
+        {
+            free_context (&context);
+            return 1;
+        }
+
+        root = read_tree (&buffer, &context, tree_path);
+    }
+    else
+        root = read_binary_ast (&buffer, &context, input);
+
+    phase_end (&report, phase_nodes (&report, &context.nodes, root), -1,
+               text ? file_bytes (tree_path) + file_bytes (names_path) : file_bytes (input));
 
-    struct Node_t* root = read_tree (&buffer, &context, TREE_FILENAME);
     if (root == NULL)
     {
         fprintf (stderr, "ERROR: tree root is NULL after parsing\n");
@@ -37,19 +105,47 @@ int main ()
 
     struct IRGenerator_t gen = {};
     initial_ir_generator (&gen);
+
+    phase_begin (&report, "bypass");
+
     bypass (&gen, root, &context);
 
-    dump_ir_to_file (&gen, IR_FILENAME);
+    phase_end   (&report, -1, gen.instr_count, -1);
+
+    if (gen.error)
+    {
+        destroy_ir_generator (&gen);
+        destructor (root, &buffer, &context);
+        return 1;
+    }
+
+    phase_begin (&report, "write IR");
+
+    dump_ir_to_file (&gen, ir_path);
+
+    phase_end   (&report, -1, -1, file_bytes (ir_path));
+    phase_begin (&report, "generate_x86_nasm");
+
+    enum Errors error = generate_x86_nasm (&gen, nasm_path);
+
+    phase_end (&report, -1, -1, file_bytes (nasm_path));
 
-    enum Errors error = generate_x86_nasm (&gen, NASM_FILENAME);
     if (error != NO_ERROR)
     {
+        destroy_ir_generator (&gen);
         destructor (root, &buffer, &context);
         ERROR_MESSAGE (error)
         return (int) error;
     }
 
-    error = generate_elf_binary (&gen, EXE_FILE);
+    phase_begin (&report, "generate_elf_binary");
+
+    error = generate_elf_binary (&gen, output);
+
+    phase_end (&report, -1, -1, file_bytes (output));
+
+    destroy_ir_generator (&gen);
+
     if (error != NO_ERROR)
     {
         destructor (root, &buffer, &context);
@@ -57,6 +153,12 @@ int main ()
         return (int) error;
     }
 
+    time_report_print (&report, stderr, "backend");
+
+#ifdef DEBUG
+    node_pool_dump (stderr, &context.nodes, "backend");
+#endif
+
     destructor (root, &buffer, &context);
 
     return 0;
@@ -50,6 +50,18 @@ struct CodeBuffer* create_code_buffer (size_t initial_capacity)
     return buf;
 }
 
+struct CodeBuffer* copy_code_buffer (const struct CodeBuffer* source)
+{
+    assert (source);
+
+    struct CodeBuffer* buf = create_code_buffer (source->capacity);
+
+    memcpy (buf->data, source->data, source->size);
+    buf->size = source->size;
+
+    return buf;
+}
+
 void destroy_code_buffer (struct CodeBuffer* buf)
 {
     if (buf)
@@ -101,6 +113,13 @@ void emit_qword (struct CodeBuffer* buf, uint64_t qword)
         buf->data[buf->size++] = (uint8_t)(qword >> (i * 8));
 }
 
+void emit_bytes (struct CodeBuffer* buf, const uint8_t* bytes, size_t count)
+{
+    ensure_capacity (buf, count);
+    memcpy (buf->data + buf->size, bytes, count);
+    buf->size += count;
+}
+
 size_t get_code_position (struct CodeBuffer* buf)
 {
     return buf->size;
@@ -228,6 +247,57 @@ void encode_idiv_reg (struct CodeBuffer* buf, Register divisor)
     emit_modrm (buf, 0b11, 7, divisor & 7);     // /7 = IDIV
 }
 
+// imul reg64  (48 F7 /5) - signed RDX:RAX = RAX * reg
+void encode_imul_reg (struct CodeBuffer* buf, Register src)
+{
+    emit_rex (buf, 1, 0, 0, (src >> 3) & 1);
+    emit_byte (buf, 0xF7);                      // opcode group
+    emit_modrm (buf, 0b11, 5, src & 7);         // /5 = IMUL (one operand)
+}
+
+// shifts by an immediate  (48 C1 /ext ib)
+static void encode_shift_reg_imm (struct CodeBuffer* buf, uint8_t ext, Register dst, uint8_t imm)
+{
+    emit_rex (buf, 1, 0, 0, (dst >> 3) & 1);
+    emit_byte (buf, 0xC1);                      // opcode group: shift r/m64, imm8
+    emit_modrm (buf, 0b11, ext, dst & 7);
+    emit_byte (buf, imm);
+}
+
+// shl reg64, imm8  (48 C1 /4 ib)
+void encode_shl_reg_imm (struct CodeBuffer* buf, Register dst, uint8_t imm)
+{
+    encode_shift_reg_imm (buf, 4, dst, imm);
+}
+
+// shr reg64, imm8  (48 C1 /5 ib) - logical, zeros come in
+void encode_shr_reg_imm (struct CodeBuffer* buf, Register dst, uint8_t imm)
+{
+    encode_shift_reg_imm (buf, 5, dst, imm);
+}
+
+// sar reg64, imm8  (48 C1 /7 ib) - arithmetic, copies of the sign come in
+void encode_sar_reg_imm (struct CodeBuffer* buf, Register dst, uint8_t imm)
+{
+    encode_shift_reg_imm (buf, 7, dst, imm);
+}
+
+// lea reg64, [base + index * scale]  (48 8D /r with a SIB byte), scale is 1, 2, 4 or 8;
+// index must not be RSP, a base of RBP or R13 needs a zero disp8
+void encode_lea_reg_scaled (struct CodeBuffer* buf, Register dst, Register base, Register index, uint8_t scale)
+{
+    uint8_t scale_bits = (scale == 8) ? 3 : (scale == 4) ? 2 : (scale == 2) ? 1 : 0;
+    uint8_t mod        = ((base & 7) == 5) ? 0b01 : 0b00;
+
+    emit_rex (buf, 1, (dst >> 3) & 1, (index >> 3) & 1, (base >> 3) & 1);
+    emit_byte (buf, 0x8D);                      // opcode: LEA r64, m
+    emit_modrm (buf, mod, dst & 7, 0b100);      // rm=100: a SIB byte follows
+    emit_modrm (buf, scale_bits, index & 7, base & 7);    // SIB: scale, index, base, laid out like a ModR/M
+
+    if (mod == 0b01)
+        emit_byte (buf, 0);
+}
+
 // ========== comparisons and jumps ========== //
 
 // cmp reg64, imm32  (48 81 /7 imm32)
@@ -0,0 +1,12 @@
+#pragma once
+
+// helpers every benchmark needs: a wall clock, comparing outputs and removing work directories
+
+// seconds of CLOCK_MONOTONIC, only differences of two calls mean something
+double now_seconds (void);
+
+// 1 if both files can be read and have the same bytes
+int    same_files  (const char* first, const char* second);
+
+// the directory and everything in it, symbolic links are removed, not followed
+void   remove_tree (const char* dir);
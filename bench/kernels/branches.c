@@ -0,0 +1,317 @@
+#include <stdio.h>
+
+int main (void)
+{
+    long long n = 0;
+    long long s = 0;
+
+    if (scanf ("%lld", &n) != 1)
+        return 1;
+
+    for (long long i = n; i; i = i - 1)
+    {
+        if (i > 997)
+            s = s + i / 1;
+
+        if (i > 1994)
+            s = s + i / 2;
+
+        if (i > 2991)
+            s = s + i / 3;
+
+        if (i > 3988)
+            s = s + i / 4;
+
+        if (i > 4985)
+            s = s + i / 5;
+
+        if (i > 5982)
+            s = s + i / 6;
+
+        if (i > 6979)
+            s = s + i / 7;
+
+        if (i > 7976)
+            s = s + i / 8;
+
+        if (i > 8973)
+            s = s + i / 9;
+
+        if (i > 9970)
+            s = s + i / 10;
+
+        if (i > 10967)
+            s = s + i / 11;
+
+        if (i > 11964)
+            s = s + i / 12;
+
+        if (i > 12961)
+            s = s + i / 13;
+
+        if (i > 13958)
+            s = s + i / 14;
+
+        if (i > 14955)
+            s = s + i / 15;
+
+        if (i > 15952)
+            s = s + i / 16;
+
+        if (i > 16949)
+            s = s + i / 17;
+
+        if (i > 17946)
+            s = s + i / 18;
+
+        if (i > 18943)
+            s = s + i / 19;
+
+        if (i > 19940)
+            s = s + i / 20;
+
+        if (i > 20937)
+            s = s + i / 21;
+
+        if (i > 21934)
+            s = s + i / 22;
+
+        if (i > 22931)
+            s = s + i / 23;
+
+        if (i > 23928)
+            s = s + i / 24;
+
+        if (i > 24925)
+            s = s + i / 25;
+
+        if (i > 25922)
+            s = s + i / 26;
+
+        if (i > 26919)
+            s = s + i / 27;
+
+        if (i > 27916)
+            s = s + i / 28;
+
+        if (i > 28913)
+            s = s + i / 29;
+
+        if (i > 29910)
+            s = s + i / 30;
+
+        if (i > 30907)
+            s = s + i / 31;
+
+        if (i > 31904)
+            s = s + i / 32;
+
+        if (i > 32901)
+            s = s + i / 33;
+
+        if (i > 33898)
+            s = s + i / 34;
+
+        if (i > 34895)
+            s = s + i / 35;
+
+        if (i > 35892)
+            s = s + i / 36;
+
+        if (i > 36889)
+            s = s + i / 37;
+
+        if (i > 37886)
+            s = s + i / 38;
+
+        if (i > 38883)
+            s = s + i / 39;
+
+        if (i > 39880)
+            s = s + i / 40;
+
+        if (i > 40877)
+            s = s + i / 41;
+
+        if (i > 41874)
+            s = s + i / 42;
+
+        if (i > 42871)
+            s = s + i / 43;
+
+        if (i > 43868)
+            s = s + i / 44;
+
+        if (i > 44865)
+            s = s + i / 45;
+
+        if (i > 45862)
+            s = s + i / 46;
+
+        if (i > 46859)
+            s = s + i / 47;
+
+        if (i > 47856)
+            s = s + i / 48;
+
+        if (i > 48853)
+            s = s + i / 49;
+
+        if (i > 49850)
+            s = s + i / 50;
+
+        if (i > 50847)
+            s = s + i / 51;
+
+        if (i > 51844)
+            s = s + i / 52;
+
+        if (i > 52841)
+            s = s + i / 53;
+
+        if (i > 53838)
+            s = s + i / 54;
+
+        if (i > 54835)
+            s = s + i / 55;
+
+        if (i > 55832)
+            s = s + i / 56;
+
+        if (i > 56829)
+            s = s + i / 57;
+
+        if (i > 57826)
+            s = s + i / 58;
+
+        if (i > 58823)
+            s = s + i / 59;
+
+        if (i > 59820)
+            s = s + i / 60;
+
+        if (i > 60817)
+            s = s + i / 61;
+
+        if (i > 61814)
+            s = s + i / 62;
+
+        if (i > 62811)
+            s = s + i / 63;
+
+        if (i > 63808)
+            s = s + i / 64;
+
+        if (i > 64805)
+            s = s + i / 65;
+
+        if (i > 65802)
+            s = s + i / 66;
+
+        if (i > 66799)
+            s = s + i / 67;
+
+        if (i > 67796)
+            s = s + i / 68;
+
+        if (i > 68793)
+            s = s + i / 69;
+
+        if (i > 69790)
+            s = s + i / 70;
+
+        if (i > 70787)
+            s = s + i / 71;
+
+        if (i > 71784)
+            s = s + i / 72;
+
+        if (i > 72781)
+            s = s + i / 73;
+
+        if (i > 73778)
+            s = s + i / 74;
+
+        if (i > 74775)
+            s = s + i / 75;
+
+        if (i > 75772)
+            s = s + i / 76;
+
+        if (i > 76769)
+            s = s + i / 77;
+
+        if (i > 77766)
+            s = s + i / 78;
+
+        if (i > 78763)
+            s = s + i / 79;
+
+        if (i > 79760)
+            s = s + i / 80;
+
+        if (i > 80757)
+            s = s + i / 81;
+
+        if (i > 81754)
+            s = s + i / 82;
+
+        if (i > 82751)
+            s = s + i / 83;
+
+        if (i > 83748)
+            s = s + i / 84;
+
+        if (i > 84745)
+            s = s + i / 85;
+
+        if (i > 85742)
+            s = s + i / 86;
+
+        if (i > 86739)
+            s = s + i / 87;
+
+        if (i > 87736)
+            s = s + i / 88;
+
+        if (i > 88733)
+            s = s + i / 89;
+
+        if (i > 89730)
+            s = s + i / 90;
+
+        if (i > 90727)
+            s = s + i / 91;
+
+        if (i > 91724)
+            s = s + i / 92;
+
+        if (i > 92721)
+            s = s + i / 93;
+
+        if (i > 93718)
+            s = s + i / 94;
+
+        if (i > 94715)
+            s = s + i / 95;
+
+        if (i > 95712)
+            s = s + i / 96;
+
+        if (i > 96709)
+            s = s + i / 97;
+
+        if (i > 97706)
+            s = s + i / 98;
+
+        if (i > 98703)
+            s = s + i / 99;
+
+        if (i > 99700)
+            s = s + i / 100;
+    }
+
+    printf ("%lld\n", s);
+
+    return 0;
+}
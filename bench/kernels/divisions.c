@@ -0,0 +1,20 @@
+#include <stdio.h>
+
+int main (void)
+{
+    long long n   = 0;
+    long long sum = 0;
+
+    if (scanf ("%lld", &n) != 1)
+        return 1;
+
+    while (n)
+    {
+        sum = sum + 1000000007 / n + n / 7 - n / 3;
+        n   = n - 1;
+    }
+
+    printf ("%lld\n", sum);
+
+    return 0;
+}
@@ -0,0 +1,29 @@
+#include <stdio.h>
+
+int main (void)
+{
+    long long n   = 0;
+    long long sum = 0;
+
+    if (scanf ("%lld", &n) != 1)
+        return 1;
+
+    while (n)
+    {
+        long long k = 20;
+        long long f = 1;
+
+        while (k)
+        {
+            f = f * k;
+            k = k - 1;
+        }
+
+        sum = sum + f / 1000000000;
+        n   = n - 1;
+    }
+
+    printf ("%lld\n", sum);
+
+    return 0;
+}
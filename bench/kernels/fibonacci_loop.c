@@ -0,0 +1,32 @@
+#include <stdio.h>
+
+int main (void)
+{
+    long long n   = 0;
+    long long sum = 0;
+
+    if (scanf ("%lld", &n) != 1)
+        return 1;
+
+    while (n)
+    {
+        long long k = 40;
+        long long a = 0;
+        long long b = 1;
+
+        while (k)
+        {
+            long long temp = a;
+            a = b;
+            b = b + temp;
+            k = k - 1;
+        }
+
+        sum = sum + a / 1000;
+        n   = n - 1;
+    }
+
+    printf ("%lld\n", sum);
+
+    return 0;
+}
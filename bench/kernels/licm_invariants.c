@@ -0,0 +1,26 @@
+#include <stdio.h>
+
+int main (void)
+{
+    long long n = 0;
+    long long s = 0;
+
+    if (scanf ("%lld", &n) != 1)
+        return 1;
+
+    long long a = n / 3;
+    long long b = n / 7;
+
+    for (long long i = n; i; i = i - 1)
+    {
+        s = s + a * b;
+        s = s + a * 3 - b * 5;
+        s = s + a * a - b * b;
+        s = s + a * 7 + b * 9;
+        s = s - b * 11 + a * 13 + i;
+    }
+
+    printf ("%lld\n", s);
+
+    return 0;
+}
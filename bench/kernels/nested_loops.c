@@ -0,0 +1,19 @@
+#include <stdio.h>
+
+int main (void)
+{
+    long long n   = 0;
+    long long sum = 0;
+
+    if (scanf ("%lld", &n) != 1)
+        return 1;
+
+    for (long long i = n; i; i = i - 1)
+        for (long long j = n; j; j = j - 1)
+            if (i > j)
+                sum = sum + i * j - j;
+
+    printf ("%lld\n", sum);
+
+    return 0;
+}
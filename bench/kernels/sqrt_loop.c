@@ -0,0 +1,22 @@
+#include <stdio.h>
+#include <math.h>
+
+int main (void)
+{
+    long long n   = 0;
+    long long sum = 0;
+
+    if (scanf ("%lld", &n) != 1)
+        return 1;
+
+    // sqrt truncated to an integer, as the cook sqrt does
+    while (n)
+    {
+        sum = sum + (long long) sqrt ((double) (n * 1000));
+        n   = n - 1;
+    }
+
+    printf ("%lld\n", sum);
+
+    return 0;
+}
@@ -0,0 +1,25 @@
+#include <stdio.h>
+
+int main (void)
+{
+    long long n = 0;
+    long long s = 0;
+    long long t = 0;
+
+    if (scanf ("%lld", &n) != 1)
+        return 1;
+
+    for (long long i = n; i > n / 4 - 1; i = i - 1)
+    {
+        s = s + i * i - i / 3 + (i + 1) * (i + 2) / 5;
+        t = t + (i - 7) * (i + 11) - (s / (i + 13)) * 3;
+
+        if (s > t + i * 2)
+            s = s - (t - i * 5) / 2;
+    }
+
+    printf ("%lld\n", s);
+    printf ("%lld\n", t);
+
+    return 0;
+}
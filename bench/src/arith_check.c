@@ -0,0 +1,287 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <inttypes.h>
+#include <signal.h>
+#include <setjmp.h>
+#include <sys/mman.h>
+
+// the multiplies and divisions by a constant of the ELF backend, checked by running the code
+// they emit: every constant of a list of edge cases (0, +-1, +-2^k and their neighbours, the
+// int32 and int64 limits, odd divisors) times every dividend of the same list, into every one of
+// the 14 IR registers. Each result must be the one C '*' and '/' give and the one the unreduced
+// imul and idiv give; a division by 0 and INT64_MIN / -1 must trap on both paths, and no other
+// register may change
+
+#include "elf_arith.h"
+#include "x86_emitter.h"
+
+#define IR_REGISTERS    ELF_IR_REGISTERS
+#define MAX_VALUES      512
+#define CODE_SIZE       4096
+#define SENTINEL        UINT64_C (0x5DEECE66D0B5C3A1)
+
+enum Path_t
+{
+    REDUCED,                            // emit_multiply_imm, emit_divide_imm
+    UNREDUCED,                          // imul through a register, idiv
+    PATHS_COUNT
+};
+
+enum Operation_t
+{
+    MULTIPLY,
+    DIVIDE,
+};
+
+// what one run of the code under test left: the registers, or a trap
+struct Outcome_t
+{
+    int      trapped;
+    uint64_t registers[IR_REGISTERS];
+};
+
+typedef void (*Snippet_t) (void);
+
+static const char* const PATH_NAMES[PATHS_COUNT] = { "reduced", "unreduced" };
+
+// the IR registers are loaded from and stored to here, at an address disp32 can hold
+static uint64_t* REGISTERS = NULL;
+
+static uint8_t*   CODE = NULL;
+static sigjmp_buf TRAP_JUMP;
+
+static int  edge_values  (int64_t* values);
+static int  add_value    (int64_t* values, int count, int64_t value);
+static void build        (enum Operation_t operation, enum Path_t path, int ir_register, int64_t imm);
+static void run          (int ir_register, int64_t operand, struct Outcome_t* outcome);
+static int  check        (enum Operation_t operation, int ir_register, int64_t operand, int64_t imm,
+                          const struct Outcome_t outcomes[PATHS_COUNT]);
+static void on_trap      (int signal_number);
+
+int main (void)
+{
+    REGISTERS = (uint64_t*) mmap (NULL, IR_REGISTERS * sizeof (*REGISTERS), PROT_READ | PROT_WRITE,
+                                  MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT, -1, 0);
+    CODE      = (uint8_t*)  mmap (NULL, CODE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if (REGISTERS == MAP_FAILED || CODE == MAP_FAILED)
+    {
+        perror ("mmap");
+        return 1;
+    }
+
+    // not blocked in the handler: the jump out of it leaves the mask as it is, nothing to restore
+    struct sigaction action = { .sa_handler = on_trap, .sa_flags = SA_NODEFER };
+    sigemptyset (&action.sa_mask);
+
+    if (sigaction (SIGFPE, &action, NULL) != 0)
+    {
+        perror ("sigaction");
+        return 1;
+    }
+
+    int64_t values[MAX_VALUES] = {};
+    int     count = edge_values (values);
+
+    // every outcome of one constant and register, by path and by operand
+    static struct Outcome_t outcomes[MAX_VALUES][PATHS_COUNT];
+
+    long checked = 0;
+    long failed  = 0;
+
+    for (int operation = MULTIPLY; operation <= DIVIDE; operation++)
+        for (int c = 0; c < count; c++)
+            for (int ir_register = 0; ir_register < IR_REGISTERS; ir_register++)
+            {
+                for (int path = REDUCED; path < PATHS_COUNT; path++)
+                {
+                    build ((enum Operation_t) operation, (enum Path_t) path, ir_register, values[c]);
+
+                    for (int i = 0; i < count; i++)
+                        run (ir_register, values[i], &outcomes[i][path]);
+                }
+
+                for (int i = 0; i < count; i++)
+                {
+                    failed += check ((enum Operation_t) operation, ir_register, values[i], values[c], outcomes[i]);
+                    checked++;
+                }
+            }
+
+    printf ("arith check: %ld multiplies and divisions by %d constants into %d registers, %ld failed\n",
+            checked, count, IR_REGISTERS, failed);
+
+    return (failed == 0) ? 0 : 1;
+}
+
+// 0, +-1, +-2^k and +-(2^k +- 1) for every k, the int32 and int64 limits and some odd divisors
+static int edge_values (int64_t* values)
+{
+    static const int64_t odd[] = { 3, 5, 6, 7, 9, 10, 11, 12, 25, 100, 641, 1000, 6700417, 1000000007,
+                                   INT64_C (0x5555555555555555), INT64_C (0x7FFFFFFFFFFFFFF1) };
+
+    int count = 0;
+
+    count = add_value (values, count, 0);
+    count = add_value (values, count, INT64_MIN);
+    count = add_value (values, count, INT64_MAX);
+    count = add_value (values, count, (int64_t) INT32_MIN - 1);
+    count = add_value (values, count, (int64_t) INT32_MAX + 1);
+
+    for (int k = 0; k < 63; k++)
+    {
+        int64_t power = INT64_C (1) << k;
+
+        for (int64_t delta = -1; delta <= 1; delta++)
+        {
+            count = add_value (values, count,   power + delta);
+            count = add_value (values, count, -(power + delta));
+        }
+    }
+
+    for (size_t i = 0; i < sizeof (odd) / sizeof (odd[0]); i++)
+    {
+        count = add_value (values, count,  odd[i]);
+        count = add_value (values, count, -odd[i]);
+    }
+
+    return count;
+}
+
+static int add_value (int64_t* values, int count, int64_t value)
+{
+    for (int i = 0; i < count; i++)
+        if (values[i] == value)
+            return count;
+
+    assert (count < MAX_VALUES);
+
+    values[count] = value;
+
+    return count + 1;
+}
+
+// the code under test between a load of every IR register and a store of every one; RBP, which
+// no IR register is, keeps the frame. Made executable in CODE
+static void build (enum Operation_t operation, enum Path_t path, int ir_register, int64_t imm)
+{
+    static const Register CALLEE_SAVED[] = { RBX, RBP, R12, R13, R14, R15 };
+    const int             saved_count    = (int) (sizeof (CALLEE_SAVED) / sizeof (CALLEE_SAVED[0]));
+
+    struct CodeBuffer* code = create_code_buffer (256);
+    assert (code);
+
+    for (int i = 0; i < saved_count; i++)
+        encode_push_reg (code, CALLEE_SAVED[i]);
+
+    for (int i = 0; i < IR_REGISTERS; i++)
+        encode_mov_reg_mem (code, elf_ir_register (i), (uint64_t) (uintptr_t) &REGISTERS[i]);
+
+    if (operation == MULTIPLY)
+        emit_constant_multiply (code, ir_register, imm, path == REDUCED);
+    else
+        emit_constant_divide   (code, ir_register, imm, path == REDUCED);
+
+    for (int i = 0; i < IR_REGISTERS; i++)
+        encode_mov_mem_reg (code, (uint64_t) (uintptr_t) &REGISTERS[i], elf_ir_register (i));
+
+    for (int i = saved_count - 1; i >= 0; i--)
+        encode_pop_reg (code, CALLEE_SAVED[i]);
+
+    encode_ret (code);
+
+    assert (code->size <= CODE_SIZE);
+
+    mprotect (CODE, CODE_SIZE, PROT_READ | PROT_WRITE);
+    memcpy   (CODE, code->data, code->size);
+    mprotect (CODE, CODE_SIZE, PROT_READ | PROT_EXEC);
+
+    destroy_code_buffer (code);
+}
+
+// every register but the one under test holds a value of its own, the trap handler jumps back here
+static void run (int ir_register, int64_t operand, struct Outcome_t* outcome)
+{
+    for (int i = 0; i < IR_REGISTERS; i++)
+        REGISTERS[i] = SENTINEL * (uint64_t) (i + 1);
+
+    REGISTERS[ir_register] = (uint64_t) operand;
+
+    outcome->trapped = 0;
+
+    if (sigsetjmp (TRAP_JUMP, 0) == 0)
+    {
+        Snippet_t snippet = NULL;
+        memcpy (&snippet, &CODE, sizeof (snippet));
+
+        snippet ();
+    }
+    else
+        outcome->trapped = 1;
+
+    memcpy (outcome->registers, REGISTERS, sizeof (outcome->registers));
+}
+
+// returns 1 and prints the case if a path gave another answer than C or changed another register
+static int check (enum Operation_t operation, int ir_register, int64_t operand, int64_t imm,
+                  const struct Outcome_t outcomes[PATHS_COUNT])
+{
+    int      traps    = (operation == DIVIDE && (imm == 0 || (imm == -1 && operand == INT64_MIN)));
+    uint64_t expected = 0;
+
+    if (operation == MULTIPLY)
+        expected = (uint64_t) operand * (uint64_t) imm;
+    else if (!traps)
+        expected = (uint64_t) (operand / imm);
+
+    int failed = 0;
+
+    for (int path = REDUCED; path < PATHS_COUNT; path++)
+    {
+        const struct Outcome_t* outcome = &outcomes[path];
+
+        int wrong = (outcome->trapped != traps) || (!traps && outcome->registers[ir_register] != expected);
+
+        for (int i = 0; i < IR_REGISTERS && !wrong; i++)
+            if (i != ir_register && outcome->registers[i] != SENTINEL * (uint64_t) (i + 1))
+                wrong = 1;
+
+        if (wrong)
+        {
+            fprintf (stderr, "FAILED: r%d = %" PRId64 " %c %" PRId64 " (%s): ", ir_register, operand,
+                     (operation == MULTIPLY) ? '*' : '/', imm, PATH_NAMES[path]);
+
+            if (outcome->trapped)
+                fprintf (stderr, "trapped");
+            else
+                fprintf (stderr, "%" PRId64, (int64_t) outcome->registers[ir_register]);
+
+            if (traps)
+                fprintf (stderr, ", a trap expected\n");
+            else
+                fprintf (stderr, ", %" PRId64 " expected\n", (int64_t) expected);
+
+            failed = 1;
+        }
+    }
+
+    if (outcomes[REDUCED].trapped != outcomes[UNREDUCED].trapped ||
+        memcmp (outcomes[REDUCED].registers, outcomes[UNREDUCED].registers, sizeof (outcomes[REDUCED].registers)) != 0)
+    {
+        fprintf (stderr, "FAILED: r%d = %" PRId64 " %c %" PRId64 ": the reduced and the unreduced code differ\n",
+                 ir_register, operand, (operation == MULTIPLY) ? '*' : '/', imm);
+        failed = 1;
+    }
+
+    return failed;
+}
+
+static void on_trap (int signal_number)
+{
+    (void) signal_number;
+
+    siglongjmp (TRAP_JUMP, 1);
+}
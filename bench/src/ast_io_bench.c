@@ -0,0 +1,292 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "keywords.h"
+#include "tree_io.h"
+#include "tree_bin.h"
+#include "bench_utils.h"
+
+// AST interchange: writes and reads back one big generated tree with the text format
+// (AST_tree.txt + Name_Table.txt) and with the binary one, and checks both round trips
+
+#define DEFAULT_NODES       1000000
+#define REPEATS             5
+#define STATEMENTS_PER_FUNC 64
+#define NAMES               1000
+
+struct Format_t
+{
+    const char* name;
+
+    int            (*write) (struct Node_t* root, struct Context_t* context, const char* dir);
+    struct Node_t* (*read)  (struct Buffer_t* buffer, struct Context_t* context, const char* dir);
+};
+
+static int            write_text   (struct Node_t* root, struct Context_t* context, const char* dir);
+static struct Node_t* read_text    (struct Buffer_t* buffer, struct Context_t* context, const char* dir);
+static int            write_binary (struct Node_t* root, struct Context_t* context, const char* dir);
+static struct Node_t* read_binary  (struct Buffer_t* buffer, struct Context_t* context, const char* dir);
+
+static struct Node_t* generate_tree (struct Context_t* context, char* names, long target_nodes, long* nodes);
+static struct Node_t* node          (struct Context_t* context, int type, int64_t value,
+                                     struct Node_t* left, struct Node_t* right);
+static int            same_tree     (const struct NodePool_t* first_pool,  const struct Node_t* first,
+                                     const struct NodePool_t* second_pool, const struct Node_t* second);
+static long           files_size    (const char* dir, const char* first, const char* second);
+
+int main (int argc, const char* argv[])
+{
+    long target = (argc > 1) ? atol (argv[1]) : DEFAULT_NODES;
+    if (target <= 0)
+    {
+        fprintf (stderr, "Usage: %s [nodes]\n", argv[0]);
+        return 1;
+    }
+
+    char dir[] = "/tmp/cook_ast_XXXXXX";
+    if (mkdtemp (dir) == NULL)
+    {
+        perror ("mkdtemp");
+        return 1;
+    }
+
+    static char names[NAMES * 8] = {};
+
+    struct Context_t context = {};
+
+    if (ctor_keywords (&context) != 0)
+        return 1;
+
+    long nodes = 0;
+    struct Node_t* root = generate_tree (&context, names, target, &nodes);
+
+    const struct Format_t formats[] =
+    {
+        { "text",   write_text,   read_text   },
+        { "binary", write_binary, read_binary }
+    };
+
+    printf ("AST interchange benchmark: %ld nodes, %d names, best of %d\n", nodes, NAMES, REPEATS);
+    printf ("  %-8s %10s %10s %10s %14s %14s\n", "format", "size KB", "write ms", "read ms", "write ns/node", "read ns/node");
+
+    int status = 0;
+
+    for (size_t f = 0; f < sizeof (formats) / sizeof (formats[0]); f++)
+    {
+        double best_write = 1e30;
+        double best_read  = 1e30;
+
+        for (int repeat = 0; repeat < REPEATS && status == 0; repeat++)
+        {
+            double start = now_seconds ();
+
+            if (formats[f].write (root, &context, dir) != 0)
+            {
+                status = 1;
+                break;
+            }
+
+            double written = now_seconds ();
+
+            struct Context_t read_context = {};
+            struct Buffer_t  buffer       = {};
+
+            struct Node_t* read_root = (ctor_keywords (&read_context) == 0) ?
+                                       formats[f].read (&buffer, &read_context, dir) : NULL;
+
+            double read = now_seconds ();
+
+            if (read_root == NULL || !same_tree (&context.nodes, root, &read_context.nodes, read_root) || read_context.table_size != context.table_size)
+            {
+                fprintf (stderr, "ERROR: %s round trip changed the tree\n", formats[f].name);
+                status = 1;
+            }
+
+            if (read_root != NULL)
+                destructor (read_root, &buffer, &read_context);
+            else
+                free_context (&read_context);
+
+            if (written - start < best_write) best_write = written - start;
+            if (read    - written < best_read) best_read = read - written;
+        }
+
+        if (status != 0)
+            break;
+
+        long size = (f == 0) ? files_size (dir, "AST_tree.txt", "Name_Table.txt") :
+                               files_size (dir, "AST_tree.bin", NULL);
+
+        printf ("  %-8s %10ld %10.1f %10.1f %14.1f %14.1f\n", formats[f].name, size / 1024,
+                best_write * 1000, best_read * 1000, best_write * 1e9 / (double) nodes, best_read * 1e9 / (double) nodes);
+    }
+
+    char path[PATH_MAX] = {};
+
+    const char* const files[] = { "AST_tree.txt", "Name_Table.txt", "AST_tree.bin" };
+    for (size_t i = 0; i < sizeof (files) / sizeof (files[0]); i++)
+    {
+        snprintf (path, sizeof (path), "%s/%s", dir, files[i]);
+        remove (path);
+    }
+    rmdir (dir);
+
+    free_context (&context);
+
+    return status;
+}
+
+static int write_text (struct Node_t* root, struct Context_t* context, const char* dir)
+{
+    char tree [PATH_MAX] = {};
+    char table[PATH_MAX] = {};
+
+    snprintf (tree,  sizeof (tree),  "%s/AST_tree.txt",   dir);
+    snprintf (table, sizeof (table), "%s/Name_Table.txt", dir);
+
+    return write_ast_file (root, context, tree, 0) || write_name_table_file (context, table);
+}
+
+static struct Node_t* read_text (struct Buffer_t* buffer, struct Context_t* context, const char* dir)
+{
+    char tree [PATH_MAX] = {};
+    char table[PATH_MAX] = {};
+
+    snprintf (tree,  sizeof (tree),  "%s/AST_tree.txt",   dir);
+    snprintf (table, sizeof (table), "%s/Name_Table.txt", dir);
+
+    if (read_name_table (context, table) != 0)
+        return NULL;
+
+    return read_tree (buffer, context, tree);
+}
+
+static int write_binary (struct Node_t* root, struct Context_t* context, const char* dir)
+{
+    char path[PATH_MAX] = {};
+    snprintf (path, sizeof (path), "%s/AST_tree.bin", dir);
+
+    return write_binary_ast (root, context, path);
+}
+
+static struct Node_t* read_binary (struct Buffer_t* buffer, struct Context_t* context, const char* dir)
+{
+    char path[PATH_MAX] = {};
+    snprintf (path, sizeof (path), "%s/AST_tree.bin", dir);
+
+    return read_binary_ast (buffer, context, path);
+}
+
+// functions of STATEMENTS_PER_FUNC statements 'a is b + 7 * c', the shape the parser builds
+static struct Node_t* generate_tree (struct Context_t* context, char* names, long target_nodes, long* nodes)
+{
+    int first = context->table_size;
+
+    for (int i = 0; i < NAMES; i++)
+    {
+        char* name = &names[i * 8];
+        int length = snprintf (name, 8, "n%d", i);
+
+        add_struct_in_keywords (context, name, (enum Operations) ID, 0, length, 1);
+    }
+
+    struct Node_t* root = NULL;
+    struct Node_t* link = NULL;
+
+    long count = 0;
+    int  name  = 0;
+
+    while (count < target_nodes)
+    {
+        struct Node_t* body = NULL;
+        struct Node_t* last = NULL;
+
+        for (int statement = 0; statement < STATEMENTS_PER_FUNC; statement++)
+        {
+            int a = first + (name++) % NAMES;
+            int b = first + (name++) % NAMES;
+            int c = first + (name++) % NAMES;
+
+            struct Node_t* value  = node (context, OP, ADD, node (context, ID, b, NULL, NULL),
+                                          node (context, OP, MUL, node (context, NUM, 7, NULL, NULL),
+                                                                  node (context, ID,  c, NULL, NULL)));
+            struct Node_t* assign = node (context, OP, EQUAL, node (context, ID, a, NULL, NULL), value);
+            struct Node_t* glue   = node (context, OP, GLUE, assign, NULL);
+
+            if (last) set_right (&context->nodes, last, glue);
+            else      body        = glue;
+
+            last   = glue;
+            count += 8;
+        }
+
+        struct Node_t* def    = node (context, FUNC, DEF, node (context, FUNC, first + name % NAMES, NULL, NULL), body);
+        struct Node_t* fnglue = node (context, FUNC, FN_GLUE, def, NULL);
+
+        if (link) set_right (&context->nodes, link, fnglue);
+        else      root        = fnglue;
+
+        link   = fnglue;
+        count += 3;
+    }
+
+    *nodes = count;
+
+    return root;
+}
+
+static struct Node_t* node (struct Context_t* context, int type, int64_t value,
+                            struct Node_t* left, struct Node_t* right)
+{
+    struct Node_t* new = node_pool_alloc (&context->nodes);
+
+    set_type  (&context->nodes, new, type);
+    new->value = value;
+    set_left  (&context->nodes, new, left);
+    set_right (&context->nodes, new, right);
+
+    return new;
+}
+
+// the trees are in the pools of two contexts
+static int same_tree (const struct NodePool_t* first_pool,  const struct Node_t* first,
+                      const struct NodePool_t* second_pool, const struct Node_t* second)
+{
+    while (first != NULL && second != NULL)
+    {
+        if (node_type (first_pool, first) != node_type (second_pool, second) || first->value != second->value ||
+            !same_tree (first_pool, node_left (first_pool, first), second_pool, node_left (second_pool, second)))
+            return 0;
+
+        first  = node_right (first_pool,  first);
+        second = node_right (second_pool, second);
+    }
+
+    return first == second;
+}
+
+static long files_size (const char* dir, const char* first, const char* second)
+{
+    char path[PATH_MAX] = {};
+    struct stat st = {};
+    long size = 0;
+
+    snprintf (path, sizeof (path), "%s/%s", dir, first);
+    if (stat (path, &st) == 0)
+        size += st.st_size;
+
+    if (second != NULL)
+    {
+        snprintf (path, sizeof (path), "%s/%s", dir, second);
+        if (stat (path, &st) == 0)
+            size += st.st_size;
+    }
+
+    return size;
+}
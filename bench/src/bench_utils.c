@@ -0,0 +1,56 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <time.h>
+#include <ftw.h>
+#include <sys/stat.h>
+
+#include "bench_utils.h"
+
+static int remove_entry (const char* path, const struct stat* st, int flag, struct FTW* ftw);
+
+double now_seconds (void)
+{
+    struct timespec time = {};
+    clock_gettime (CLOCK_MONOTONIC, &time);
+
+    return (double) time.tv_sec + (double) time.tv_nsec * 1e-9;
+}
+
+int same_files (const char* first, const char* second)
+{
+    FILE* a = fopen (first,  "rb");
+    FILE* b = fopen (second, "rb");
+
+    int same = (a != NULL && b != NULL);
+
+    while (same)
+    {
+        int ca = getc (a);
+        int cb = getc (b);
+
+        same = (ca == cb);
+
+        if (ca == EOF)
+            break;
+    }
+
+    if (a != NULL) fclose (a);
+    if (b != NULL) fclose (b);
+
+    return same;
+}
+
+void remove_tree (const char* dir)
+{
+    nftw (dir, remove_entry, 8, FTW_DEPTH | FTW_PHYS);
+}
+
+static int remove_entry (const char* path, const struct stat* st, int flag, struct FTW* ftw)
+{
+    (void) st;
+    (void) flag;
+    (void) ftw;
+
+    return remove (path);
+}
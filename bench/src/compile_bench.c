@@ -0,0 +1,444 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "bench_utils.h"
+
+// compile-time scaling: generates programs of growing function count, with a fixed number of
+// statements per function, expressions of a fixed depth and nested grinding/forreal blocks,
+// and runs the three stages on each one. The backend keeps every variable of the program in a
+// register of its own, so all the functions use the same variables and a loop compares with a
+// variable or a number. Time per statement and peak memory of every stage
+// are printed and written to a CSV file; a stage whose time per statement is more than
+// SUPERLINEAR_LIMIT times its best on a smaller program is marked as superlinear
+
+#define MAX_RUNS            8
+#define STAGES_COUNT        3
+#define VARIABLES           6           // the same ones, declared at the top of every function
+#define SUPERLINEAR_LIMIT   2.0
+
+struct Shape_t
+{
+    int statements;                     // per function, the ones in nested blocks included
+    int depth;                          // of every expression
+    int nesting;                        // of the deepest block
+};
+
+struct Stage_t
+{
+    double seconds;
+    long   max_rss_kb;
+    int    status;                      // exit status, 0 if the stage worked
+    char   message[128];                // first line it printed on stderr when it failed
+};
+
+struct Run_t
+{
+    long           functions;
+    long           statements;
+    long           bytes;
+    struct Stage_t stages[STAGES_COUNT];
+};
+
+static const char* const STAGE_NAMES[STAGES_COUNT] = { "frontend", "middle_end", "backend" };
+
+static long   generate_program (const char* filename, long functions, const struct Shape_t* shape, long* bytes);
+static long   put_block        (FILE* file, int statements, int nesting, const struct Shape_t* shape);
+static void   put_expression   (FILE* file, int depth);
+static void   fixed_letters    (long number, int width, char* out);
+static int    run_stage        (const char* const argv[], const char* err_file, struct Stage_t* stage);
+static int    next_random      (int range);
+static void   print_run        (const struct Run_t* runs, int index, FILE* csv);
+
+static unsigned long random_state = 1;
+
+int main (int argc, const char* argv[])
+{
+    if (argc < 8)
+    {
+        fprintf (stderr, "Usage: %s <frontend> <middle_end> <backend> <statements> <depth> <nesting> <results.csv> [functions...]\n", argv[0]);
+        return 1;
+    }
+
+    char stages[STAGES_COUNT][PATH_MAX] = {};
+
+    for (int i = 0; i < STAGES_COUNT; i++)
+    {
+        if (realpath (argv[1 + i], stages[i]) == NULL)
+        {
+            fprintf (stderr, "ERROR: %s '%s' not found\n", STAGE_NAMES[i], argv[1 + i]);
+            return 1;
+        }
+    }
+
+    struct Shape_t shape = { .statements = atoi (argv[4]), .depth = atoi (argv[5]), .nesting = atoi (argv[6]) };
+
+    if (shape.statements < 1) shape.statements = 1;
+    if (shape.depth      < 0) shape.depth      = 0;
+    if (shape.nesting    < 0) shape.nesting    = 0;
+
+    long sizes[MAX_RUNS] = { 1, 10, 100, 1000 };
+    int  runs_count = 4;
+
+    if (argc > 8)
+    {
+        runs_count = 0;
+        for (int i = 8; i < argc && runs_count < MAX_RUNS; i++)
+            sizes[runs_count++] = atol (argv[i]);
+    }
+
+    FILE* csv = fopen (argv[7], "wb");
+    if (csv == NULL)
+    {
+        fprintf (stderr, "ERROR: could not create '%s'\n", argv[7]);
+        return 1;
+    }
+
+    char work_dir[] = "/tmp/cook_compile_XXXXXX";
+    if (mkdtemp (work_dir) == NULL)
+    {
+        perror ("mkdtemp");
+        fclose (csv);
+        return 1;
+    }
+
+    char source  [PATH_MAX] = {};
+    char err_file[PATH_MAX] = {};
+
+    snprintf (source,   sizeof (source),   "%s/program.cook", work_dir);
+    snprintf (err_file, sizeof (err_file), "%s/stderr.txt",   work_dir);
+
+    fprintf (csv, "functions,statements,bytes");
+    for (int i = 0; i < STAGES_COUNT; i++)
+        fprintf (csv, ",%s_ms,%s_ns_per_statement,%s_max_rss_kb,%s_status", STAGE_NAMES[i], STAGE_NAMES[i],
+                                                                             STAGE_NAMES[i], STAGE_NAMES[i]);
+    fprintf (csv, "\n");
+
+    printf ("compile scaling: %d statements per function, expression depth %d, nesting %d\n",
+            shape.statements, shape.depth, shape.nesting);
+    printf ("  %9s %10s %9s |", "functions", "statements", "KB");
+    for (int i = 0; i < STAGES_COUNT; i++)
+        printf (" %10s %8s %8s |", STAGE_NAMES[i], "ns/stmt", "RSS MB");
+    printf ("\n");
+
+    struct Run_t runs[MAX_RUNS] = {};
+    int status = 0;
+
+    for (int i = 0; i < runs_count && status == 0; i++)
+    {
+        struct Run_t* run = &runs[i];
+
+        run->functions  = sizes[i];
+        run->statements = generate_program (source, sizes[i], &shape, &run->bytes);
+
+        if (run->statements < 0)
+        {
+            status = 1;
+            break;
+        }
+
+        const char* const frontend  [] = { stages[0], "--workdir", work_dir, source, NULL };
+        const char* const middle_end[] = { stages[1], "--workdir", work_dir, NULL };
+        const char* const backend   [] = { stages[2], "--workdir", work_dir, NULL };
+
+        const char* const* commands[STAGES_COUNT] = { frontend, middle_end, backend };
+
+        // a stage that failed leaves nothing for the next one to time
+        for (int stage = 0; stage < STAGES_COUNT; stage++)
+        {
+            if (run_stage (commands[stage], err_file, &run->stages[stage]) != 0)
+            {
+                status = 1;
+                break;
+            }
+
+            if (run->stages[stage].status != 0)
+            {
+                for (int rest = stage + 1; rest < STAGES_COUNT; rest++)
+                    run->stages[rest].status = -1;
+                break;
+            }
+        }
+
+        print_run (runs, i, csv);
+    }
+
+    // the front of the pipeline has to take any program; the backend has a fixed number of
+    // registers, running out of them is reported but does not fail the benchmark
+    for (int stage = 0; stage < STAGES_COUNT && status == 0; stage++)
+        for (int i = 0; i < runs_count; i++)
+            if (runs[i].stages[stage].status > 0)
+            {
+                printf ("  %s fails from %ld functions on (status %d): %s\n", STAGE_NAMES[stage], runs[i].functions,
+                        runs[i].stages[stage].status, runs[i].stages[stage].message);
+
+                if (stage < STAGES_COUNT - 1)
+                    status = 1;
+
+                break;
+            }
+
+    printf ("  '!': time per statement over %.0fx the best of the smaller programs\n", SUPERLINEAR_LIMIT);
+    printf ("results written to %s\n", argv[7]);
+
+    fclose (csv);
+    remove_tree (work_dir);
+
+    return status;
+}
+
+// every function declares its variables, then runs statements over them: assignments of
+// expressions, calls of the function before it and blocks nested down to shape->nesting;
+// returns the number of statements, -1 if the file could not be written
+static long generate_program (const char* filename, long functions, const struct Shape_t* shape, long* bytes)
+{
+    FILE* file = fopen (filename, "wb");
+    if (file == NULL)
+    {
+        perror ("fopen");
+        return -1;
+    }
+
+    random_state = 1;
+
+    long statements = 0;
+    char func[8]    = {};
+    char previous[8] = {};
+
+    for (long number = 0; number < functions; number++)
+    {
+        fixed_letters (number, 4, func);
+
+        fprintf (file, "lethimcook f%s (lethimcook p)\nlesssgo\n", func);
+
+        for (int var = 0; var < VARIABLES; var++)
+        {
+            char name[4] = {};
+            fixed_letters (var, 2, name);
+
+            fprintf (file, "    lethimcook v%s is p + %d shutup\n", name, var + 1);
+        }
+
+        if (number > 0)
+        {
+            fprintf (file, "    f%s(vaa) shutup\n", previous);
+            statements++;
+        }
+
+        statements += VARIABLES + put_block (file, shape->statements, shape->nesting, shape);
+
+        fprintf (file, "    yap(vaa) shutup\nstoopit\n\n");
+        statements++;
+
+        memcpy (previous, func, sizeof (func));
+    }
+
+    fprintf (file, "lethimcook carti (lethimcook argc)\nlesssgo\n");
+
+    if (functions > 0)
+        fprintf (file, "    f%s(argc) shutup\n", previous);
+
+    fprintf (file, "    yap(argc) shutup\nstoopit\n$\n");
+
+    *bytes = ftell (file);
+
+    fclose (file);
+
+    return statements;
+}
+
+// the statements of one block; while nesting is left, every fourth one is a block holding
+// half of the statements that follow it. What a loop does not assign is invariant in it
+static long put_block (FILE* file, int statements, int nesting, const struct Shape_t* shape)
+{
+    long count = 0;
+
+    for (int i = 0; i < statements; i++)
+    {
+        int  var       = next_random (VARIABLES);
+        char target[4] = {};
+
+        fixed_letters (var, 2, target);
+
+        if (nesting > 0 && i % 4 == 1 && statements - i > 1)
+        {
+            int inner = (statements - i) / 2;
+
+            // a loop compares with a variable or a number: the value of an expression would keep
+            // a register of its own too
+            int loop = (nesting % 2 != 0);
+
+            fprintf (file, "    %s (v%s lowkey ", loop ? "grinding" : "forreal", target);
+            put_expression (file, loop ? 0 : shape->depth / 2);
+            fprintf (file, ")\n    lesssgo\n");
+
+            count += 1 + put_block (file, inner, nesting - 1, shape);
+
+            fprintf (file, "    stoopit shutup\n");
+
+            i += inner;
+            continue;
+        }
+
+        fprintf (file, "    v%s is ", target);
+        put_expression (file, shape->depth);
+        fprintf (file, " shutup\n");
+
+        count++;
+    }
+
+    return count;
+}
+
+// a full binary tree of operators, divisions are by constants; the leaves are numbers and
+// variables
+static void put_expression (FILE* file, int depth)
+{
+    if (depth == 0)
+    {
+        if (next_random (3) == 0)
+            fprintf (file, "%d", 1 + next_random (9));
+        else
+        {
+            int  var     = next_random (VARIABLES);
+            char name[4] = {};
+
+            fixed_letters (var, 2, name);
+
+            fprintf (file, "v%s", name);
+        }
+
+        return;
+    }
+
+    static const char OPERATORS[] = "+-*/";
+    char operation = OPERATORS[next_random (4)];
+
+    fprintf (file, "(");
+    put_expression (file, depth - 1);
+
+    if (operation == '/')
+        fprintf (file, " / %d", 2 + next_random (8));
+    else
+    {
+        fprintf (file, " %c ", operation);
+        put_expression (file, depth - 1);
+    }
+
+    fprintf (file, ")");
+}
+
+// the programs are the same from run to run
+static int next_random (int range)
+{
+    random_state = random_state * 6364136223846793005UL + 1442695040888963407UL;
+
+    return (int) ((random_state >> 33) % (unsigned long) range);
+}
+
+// identifiers are letters only; a fixed width keeps names of different functions apart
+static void fixed_letters (long number, int width, char* out)
+{
+    for (int i = width - 1; i >= 0; i--)
+    {
+        out[i] = (char) ('a' + number % 26);
+        number /= 26;
+    }
+
+    out[width] = '\0';
+}
+
+// returns 1 only if the stage could not be started; how it ended is in stage->status
+static int run_stage (const char* const argv[], const char* err_file, struct Stage_t* stage)
+{
+    double start = now_seconds ();
+
+    pid_t pid = fork ();
+    if (pid < 0)
+    {
+        perror ("fork");
+        return 1;
+    }
+
+    if (pid == 0)
+    {
+        int null_fd = open ("/dev/null", O_WRONLY);
+        int err_fd  = open (err_file, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+        if (null_fd >= 0) dup2 (null_fd, STDOUT_FILENO);
+        if (err_fd  >= 0) dup2 (err_fd,  STDERR_FILENO);
+
+        execv (argv[0], (char* const*) argv);
+        _exit (127);
+    }
+
+    int status = 0;
+    struct rusage usage = {};
+
+    if (wait4 (pid, &status, 0, &usage) < 0)
+    {
+        perror ("wait4");
+        return 1;
+    }
+
+    stage->seconds    = now_seconds () - start;
+    stage->max_rss_kb = usage.ru_maxrss;
+    stage->status     = WIFEXITED (status) ? WEXITSTATUS (status) : 128 + WTERMSIG (status);
+
+    if (stage->status != 0)
+    {
+        FILE* err = fopen (err_file, "rb");
+
+        if (err != NULL && fgets (stage->message, sizeof (stage->message), err) != NULL)
+            stage->message[strcspn (stage->message, "\n")] = '\0';
+
+        if (err != NULL)
+            fclose (err);
+    }
+
+    return 0;
+}
+
+static void print_run (const struct Run_t* runs, int index, FILE* csv)
+{
+    const struct Run_t* run = &runs[index];
+
+    printf ("  %9ld %10ld %9.1f |", run->functions, run->statements, (double) run->bytes / 1024);
+    fprintf (csv, "%ld,%ld,%ld", run->functions, run->statements, run->bytes);
+
+    for (int i = 0; i < STAGES_COUNT; i++)
+    {
+        const struct Stage_t* stage = &run->stages[i];
+
+        if (stage->status != 0)
+        {
+            printf (" %10s %8s %8s |", (stage->status < 0) ? "-" : "failed", "-", "-");
+            fprintf (csv, ",,,,%d", stage->status);
+            continue;
+        }
+
+        double per_statement = stage->seconds * 1e9 / (double) run->statements;
+        int    superlinear   = 0;
+
+        // small programs are dominated by the start of the process, so the best one is the reference
+        for (int before = 0; before < index; before++)
+            if (runs[before].stages[i].status == 0 &&
+                per_statement > runs[before].stages[i].seconds * 1e9 / (double) runs[before].statements * SUPERLINEAR_LIMIT)
+                superlinear = 1;
+
+        printf (" %8.1fms %8.0f %7.1f%s|", stage->seconds * 1000, per_statement,
+                (double) stage->max_rss_kb / 1024, superlinear ? "!" : " ");
+        fprintf (csv, ",%.3f,%.1f,%ld,0", stage->seconds * 1000, per_statement, stage->max_rss_kb);
+    }
+
+    printf ("\n");
+    fprintf (csv, "\n");
+}
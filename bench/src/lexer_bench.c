@@ -0,0 +1,132 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tokens.h"
+#include "bench_utils.h"
+
+// lexer throughput: the 'tokenization' of the frontend over a generated multi-megabyte program,
+// each run with a fresh context, so the identifiers enter the name table every time
+
+#define DEFAULT_MEGABYTES 16
+#define REPEATS            5
+
+static const char* const WORDS[] =
+{
+    "lethimcook", "is", "shutup", "grinding", "lesssgo", "stoopit", "nah", "nocap",
+    "sameAs", "lowkey", "yap", "gimme", "result", "numb", "temp", "discriminant", "x", "carti"
+};
+
+static const char OPERATORS[] = "+-*/^()={},<>";
+
+static char* generate_program (int length);
+static int   run_lexer        (const char* text, double* elapsed);
+
+int main (int argc, const char* argv[])
+{
+    int megabytes = (argc > 1) ? atoi (argv[1]) : DEFAULT_MEGABYTES;
+    if (megabytes <= 0 || megabytes > 1024)
+    {
+        fprintf (stderr, "Usage: %s [megabytes 1..1024]\n", argv[0]);
+        return 1;
+    }
+
+    int length = megabytes * 1024 * 1024;
+
+    char* text = generate_program (length);
+    if (text == NULL)
+    {
+        fprintf (stderr, "ERROR: can not allocate %d MB\n", megabytes);
+        return 1;
+    }
+
+    printf ("lexer benchmark: %d MB generated source, best of %d\n", megabytes, REPEATS);
+
+    double best   = 1e30;
+    int    tokens = 0;
+
+    for (int r = 0; r < REPEATS; r++)
+    {
+        double elapsed = 0;
+
+        tokens = run_lexer (text, &elapsed);
+        if (tokens < 0)
+        {
+            free (text);
+            return 1;
+        }
+
+        if (elapsed < best)
+            best = elapsed;
+    }
+
+    printf ("  %10d tokens  %8.2f ms  %8.1f MB/s\n", tokens, best * 1000, megabytes / best);
+
+    free (text);
+
+    return 0;
+}
+
+// keywords, identifiers, numbers and operators with the indentation of the examples
+static char* generate_program (int length)
+{
+    char* text = (char*) calloc ((size_t) length + 1, sizeof (char));
+    if (text == NULL)
+        return NULL;
+
+    srand (1);
+
+    int i = 0;
+    int words_count = (int) (sizeof (WORDS) / sizeof (WORDS[0]));
+
+    while (i < length - 64)
+    {
+        int indent = 4 * (rand () % 4);
+        memset (text + i, ' ', (size_t) indent);
+        i += indent;
+
+        int line_tokens = 3 + rand () % 8;
+
+        for (int t = 0; t < line_tokens; t++)
+        {
+            int kind = rand () % 4;
+
+            if (kind < 2)
+                i += sprintf (text + i, "%s ", WORDS[rand () % words_count]);
+            else if (kind == 2)
+                i += sprintf (text + i, "%d ", rand () % 100000);
+            else
+                i += sprintf (text + i, "%c ", OPERATORS[rand () % (int) (sizeof (OPERATORS) - 1)]);
+        }
+
+        text[i++] = '\n';
+    }
+
+    memset (text + i, ' ', (size_t) (length - i));
+
+    text[length - 1] = '$';
+
+    return text;
+}
+
+// returns the number of tokens or -1, the time of 'tokenization' alone in 'elapsed'
+static int run_lexer (const char* text, double* elapsed)
+{
+    struct Context_t context = {};
+
+    if (ctor_keywords (&context) != 0)
+    {
+        dtor_keywords (&context);
+        return -1;
+    }
+
+    double start = now_seconds ();
+    int error = tokenization (&context, text);
+    *elapsed = now_seconds () - start;
+
+    int tokens = context.token_count;
+
+    dtor_keywords (&context);
+
+    return (error == 0) ? tokens : -1;
+}
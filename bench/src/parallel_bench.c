@@ -0,0 +1,279 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "bench_utils.h"
+
+// parallel compile stress test: runs the three stages on the sources, every compile in a
+// work directory of its own, with 1, 2, 4 ... jobs at once. Reports the throughput against
+// one job and fails if any compile failed or produced a program that differs from the one
+// a compile alone makes
+
+#define MAX_SOURCES     64
+#define MAX_JOBS        256
+#define STAGES_COUNT    3
+
+struct Stress_t
+{
+    const char* stages[STAGES_COUNT];       // frontend, middle_end, backend
+    const char* sources[MAX_SOURCES];
+    int         sources_count;
+    char        root[PATH_MAX];             // every work directory and program is under it
+};
+
+static int    run_level    (const struct Stress_t* stress, int jobs, int compiles, double* seconds);
+static pid_t  start_job    (const struct Stress_t* stress, int compile);
+static int    run_stage    (const char* const argv[]);
+static int    check_level  (const struct Stress_t* stress, int compiles);
+static void   job_path     (const struct Stress_t* stress, char* path, const char* kind, int compile);
+
+int main (int argc, const char* argv[])
+{
+    if (argc < 7)
+    {
+        fprintf (stderr, "Usage: %s <frontend> <middle_end> <backend> <jobs> <compiles> <program.cook>...\n", argv[0]);
+        return 1;
+    }
+
+    static struct Stress_t stress = {};
+    static char paths[STAGES_COUNT + MAX_SOURCES][PATH_MAX] = {};
+
+    // the jobs leave the current directory alone, every path they get is absolute
+    for (int i = 0; i < STAGES_COUNT; i++)
+    {
+        if (realpath (argv[1 + i], paths[i]) == NULL)
+        {
+            fprintf (stderr, "ERROR: stage '%s' not found\n", argv[1 + i]);
+            return 1;
+        }
+
+        stress.stages[i] = paths[i];
+    }
+
+    int max_jobs = atoi (argv[4]);
+    int compiles = atoi (argv[5]);
+
+    if (max_jobs < 1)        max_jobs = 1;
+    if (max_jobs > MAX_JOBS) max_jobs = MAX_JOBS;
+    if (compiles < max_jobs) compiles = max_jobs;
+
+    for (int i = 6; i < argc && stress.sources_count < MAX_SOURCES; i++)
+    {
+        char* source = paths[STAGES_COUNT + stress.sources_count];
+
+        if (realpath (argv[i], source) == NULL)
+        {
+            fprintf (stderr, "ERROR: source '%s' not found\n", argv[i]);
+            return 1;
+        }
+
+        stress.sources[stress.sources_count++] = source;
+    }
+
+    snprintf (stress.root, sizeof (stress.root), "/tmp/cook_parallel_XXXXXX");
+    if (mkdtemp (stress.root) == NULL)
+    {
+        perror ("mkdtemp");
+        return 1;
+    }
+
+    int status = 0;
+
+    // the programs every parallel compile is checked against: one source at a time
+    double seconds = 0;
+    status = run_level (&stress, 1, stress.sources_count, &seconds);
+
+    for (int i = 0; i < stress.sources_count && status == 0; i++)
+    {
+        char from    [PATH_MAX] = {};
+        char to      [PATH_MAX] = {};
+        char work_dir[PATH_MAX] = {};
+
+        job_path (&stress, from,     "program",   i);
+        job_path (&stress, to,       "reference", i);
+        job_path (&stress, work_dir, "work",      i);
+
+        remove_tree (work_dir);
+
+        if (rename (from, to) != 0)
+        {
+            perror ("rename");
+            status = 1;
+        }
+    }
+
+    printf ("parallel compiles: %d sources, %d compiles per level, %ld CPUs\n",
+            stress.sources_count, compiles, sysconf (_SC_NPROCESSORS_ONLN));
+    printf ("  %6s %10s %12s %10s %12s\n", "jobs", "ms", "compiles/s", "speedup", "efficiency");
+
+    int levels[MAX_JOBS] = {};
+    int levels_count = 0;
+
+    for (int jobs = 1; jobs < max_jobs; jobs *= 2)
+        levels[levels_count++] = jobs;
+
+    levels[levels_count++] = max_jobs;
+
+    double first = 0;
+
+    for (int level = 0; level < levels_count && status == 0; level++)
+    {
+        int jobs = levels[level];
+
+        status = run_level (&stress, jobs, compiles, &seconds) ||
+                 check_level (&stress, compiles);
+
+        if (status != 0)
+            break;
+
+        double throughput = (double) compiles / seconds;
+
+        if (jobs == 1)
+            first = throughput;
+
+        printf ("  %6d %10.1f %12.1f %9.2fx %11.0f%%\n", jobs, seconds * 1000, throughput,
+                throughput / first, throughput / first / jobs * 100);
+    }
+
+    if (status == 0)
+        printf ("OK: every compile made the same program as a compile alone\n");
+
+    remove_tree (stress.root);
+
+    return status;
+}
+
+// 'compiles' compiles of the sources in turn, never more than 'jobs' of them running
+static int run_level (const struct Stress_t* stress, int jobs, int compiles, double* seconds)
+{
+    int started  = 0;
+    int finished = 0;
+    int failed   = 0;
+
+    double start = now_seconds ();
+
+    while (finished < compiles)
+    {
+        for (; started < compiles && started - finished < jobs; started++)
+            if (start_job (stress, started) < 0)
+                return 1;
+
+        int wait_status = 0;
+
+        if (wait (&wait_status) < 0)
+        {
+            perror ("wait");
+            return 1;
+        }
+
+        failed += !(WIFEXITED (wait_status) && WEXITSTATUS (wait_status) == 0);
+        finished++;
+    }
+
+    *seconds = now_seconds () - start;
+
+    if (failed != 0)
+    {
+        fprintf (stderr, "ERROR: %d of %d compiles with %d jobs failed\n", failed, compiles, jobs);
+        return 1;
+    }
+
+    return 0;
+}
+
+// one compile is a process running the stages one after another in its work directory
+static pid_t start_job (const struct Stress_t* stress, int compile)
+{
+    pid_t pid = fork ();
+
+    if (pid < 0)
+    {
+        perror ("fork");
+        return -1;
+    }
+
+    if (pid != 0)
+        return pid;
+
+    char work_dir[PATH_MAX] = {};
+    char program [PATH_MAX] = {};
+
+    job_path (stress, work_dir, "work", compile);
+    job_path (stress, program,  "program", compile);
+
+    const char* source = stress->sources[compile % stress->sources_count];
+
+    const char* const frontend  [] = { stress->stages[0], "--workdir", work_dir, source, NULL };
+    const char* const middle_end[] = { stress->stages[1], "--workdir", work_dir, NULL };
+    const char* const backend   [] = { stress->stages[2], "--workdir", work_dir, "-o", program, NULL };
+
+    _exit (run_stage (frontend) || run_stage (middle_end) || run_stage (backend));
+}
+
+static int run_stage (const char* const argv[])
+{
+    pid_t pid = fork ();
+
+    if (pid < 0)
+        return 1;
+
+    if (pid == 0)
+    {
+        int null_fd = open ("/dev/null", O_WRONLY);
+        if (null_fd >= 0)
+        {
+            dup2 (null_fd, STDOUT_FILENO);
+            dup2 (null_fd, STDERR_FILENO);
+        }
+
+        execv (argv[0], (char* const*) argv);
+        _exit (127);
+    }
+
+    int status = 0;
+
+    if (waitpid (pid, &status, 0) != pid)
+        return 1;
+
+    return !(WIFEXITED (status) && WEXITSTATUS (status) == 0);
+}
+
+static int check_level (const struct Stress_t* stress, int compiles)
+{
+    for (int i = 0; i < compiles; i++)
+    {
+        char program  [PATH_MAX] = {};
+        char reference[PATH_MAX] = {};
+
+        job_path (stress, program,   "program",   i);
+        job_path (stress, reference, "reference", i % stress->sources_count);
+
+        if (!same_files (program, reference))
+        {
+            fprintf (stderr, "ERROR: compile %d of '%s' made a different program\n",
+                     i, stress->sources[i % stress->sources_count]);
+            return 1;
+        }
+
+        // nothing a compile left is seen by the next level
+        char work_dir[PATH_MAX] = {};
+        job_path (stress, work_dir, "work", i);
+
+        remove (program);
+        remove_tree (work_dir);
+    }
+
+    return 0;
+}
+
+static void job_path (const struct Stress_t* stress, char* path, const char* kind, int compile)
+{
+    snprintf (path, PATH_MAX, "%s/%s%d", stress->root, kind, compile);
+}
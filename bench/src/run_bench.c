@@ -0,0 +1,450 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <linux/perf_event.h>
+
+#include "bench_utils.h"
+
+// runtime of the generated programs: every kernel.cook is compiled by the three stages and
+// its kernel.c twin by gcc -O0 and -O2; each binary runs RUNS times with kernel.in on stdin.
+// The best wall time, the user-space instructions retired in that run (perf_event_open, when
+// the kernel lets us) and the binary size are printed and written to a CSV file. Fails if a
+// binary does not print what the gcc -O2 one prints
+
+#define MAX_KERNELS     32
+#define MAX_RUNS        64
+#define STAGES_COUNT    3
+
+enum Variant_t
+{
+    COOK,
+    GCC_O0,
+    GCC_O2,
+    VARIANTS_COUNT
+};
+
+static const char* const VARIANT_NAMES  [VARIANTS_COUNT] = { "cook", "gcc -O0", "gcc -O2" };
+static const char* const VARIANT_COLUMNS[VARIANTS_COUNT] = { "cook", "gcc_O0",  "gcc_O2"  };
+
+struct Measure_t
+{
+    double    seconds;                  // best of the runs
+    long long instructions;             // in the best run, -1 if not counted
+    long      size;                     // of the binary, bytes
+    int       status;                   // 0 if it was built, ran and printed the right answer
+};
+
+struct Kernel_t
+{
+    char             name[NAME_MAX + 1];
+    struct Measure_t measures[VARIANTS_COUNT];
+};
+
+struct Bench_t
+{
+    const char* stages[STAGES_COUNT];   // frontend, middle_end, backend
+    int         runs;
+    int         counting;               // perf_event_open works here
+    char        root[PATH_MAX];         // binaries, outputs and work directories are under it
+};
+
+static int    build_variant (const struct Bench_t* bench, const char* kernel, enum Variant_t variant, const char* binary);
+static int    run_variant   (const struct Bench_t* bench, const char* binary, const char* input, const char* output,
+                             struct Measure_t* measure);
+static int    run_once      (const struct Bench_t* bench, const char* binary, int input_fd, int output_fd,
+                             double* seconds, long long* instructions);
+static int    open_counter  (pid_t pid);
+static int    run_command   (const char* const argv[]);
+static void   kernel_path   (char* path, const char* kernel, const char* extension);
+static void   print_kernel  (const struct Kernel_t* kernel, FILE* csv);
+static void   print_measure (const struct Measure_t* measure);
+
+int main (int argc, const char* argv[])
+{
+    if (argc < 7)
+    {
+        fprintf (stderr, "Usage: %s <frontend> <middle_end> <backend> <runs> <results.csv> <kernel.cook>...\n", argv[0]);
+        return 1;
+    }
+
+    static struct Bench_t  bench = {};
+    static struct Kernel_t kernels[MAX_KERNELS] = {};
+    static char stages[STAGES_COUNT][PATH_MAX] = {};
+
+    // the stages run in work directories of their own, every path they get is absolute
+    for (int i = 0; i < STAGES_COUNT; i++)
+    {
+        if (realpath (argv[1 + i], stages[i]) == NULL)
+        {
+            fprintf (stderr, "ERROR: stage '%s' not found\n", argv[1 + i]);
+            return 1;
+        }
+
+        bench.stages[i] = stages[i];
+    }
+
+    bench.runs = atoi (argv[4]);
+
+    if (bench.runs < 1)        bench.runs = 1;
+    if (bench.runs > MAX_RUNS) bench.runs = MAX_RUNS;
+
+    FILE* csv = fopen (argv[5], "w");
+    if (csv == NULL)
+    {
+        fprintf (stderr, "ERROR: could not open '%s'\n", argv[5]);
+        return 1;
+    }
+
+    snprintf (bench.root, sizeof (bench.root), "/tmp/cook_run_XXXXXX");
+    if (mkdtemp (bench.root) == NULL)
+    {
+        perror ("mkdtemp");
+        fclose (csv);
+        return 1;
+    }
+
+    // not every kernel lets user space count: the instructions are reported as '-' then
+    int counter = open_counter (0);
+
+    bench.counting = (counter >= 0);
+
+    if (counter >= 0)
+        close (counter);
+
+    fprintf (csv, "kernel");
+    for (int variant = 0; variant < VARIANTS_COUNT; variant++)
+        fprintf (csv, ",%s_ms,%s_instructions,%s_bytes", VARIANT_COLUMNS[variant], VARIANT_COLUMNS[variant], VARIANT_COLUMNS[variant]);
+    fprintf (csv, "\n");
+
+    printf ("runtime: best of %d runs%s\n", bench.runs, bench.counting ? "" : ", instructions not counted (perf_event_open failed)");
+    printf ("  %-16s", "kernel");
+
+    for (int variant = 0; variant < VARIANTS_COUNT; variant++)
+        printf (" | %9s %9s %8s", VARIANT_NAMES[variant], "Minstr", "KB");
+
+    printf (" | %8s %8s\n", "vs -O0", "vs -O2");
+
+    int status = 0;
+    int kernels_count = 0;
+
+    for (int i = 6; i < argc && kernels_count < MAX_KERNELS; i++)
+    {
+        char kernel[PATH_MAX] = {};
+
+        if (realpath (argv[i], kernel) == NULL)
+        {
+            fprintf (stderr, "ERROR: kernel '%s' not found\n", argv[i]);
+            status = 1;
+            continue;
+        }
+
+        // the sources and the input are found next to the .cook file
+        char* extension = strrchr (kernel, '.');
+        if (extension != NULL)
+            *extension = '\0';
+
+        struct Kernel_t* current = &kernels[kernels_count++];
+
+        const char* base = strrchr (kernel, '/');
+        snprintf (current->name, sizeof (current->name), "%s", (base != NULL) ? base + 1 : kernel);
+
+        char input[PATH_MAX] = {};
+        kernel_path (input, kernel, ".in");
+
+        // gcc -O2 goes first: what it prints is the answer the others are checked against
+        char reference[PATH_MAX] = {};
+        snprintf (reference, sizeof (reference), "%s/%s.%d.out", bench.root, current->name, GCC_O2);
+
+        const enum Variant_t order[VARIANTS_COUNT] = { GCC_O2, GCC_O0, COOK };
+
+        for (int j = 0; j < VARIANTS_COUNT; j++)
+        {
+            enum Variant_t variant = order[j];
+            struct Measure_t* measure = &current->measures[variant];
+
+            char binary[PATH_MAX] = {};
+            char output[PATH_MAX] = {};
+
+            snprintf (binary, sizeof (binary), "%s/%s.%d",     bench.root, current->name, variant);
+            snprintf (output, sizeof (output), "%s/%s.%d.out", bench.root, current->name, variant);
+
+            measure->status       = 1;
+            measure->instructions = -1;
+
+            if (build_variant (&bench, kernel, variant, binary) != 0)
+            {
+                fprintf (stderr, "ERROR: could not build '%s' with %s\n", current->name, VARIANT_NAMES[variant]);
+                continue;
+            }
+
+            struct stat st = {};
+            if (stat (binary, &st) == 0)
+                measure->size = (long) st.st_size;
+
+            if (run_variant (&bench, binary, input, output, measure) != 0)
+            {
+                fprintf (stderr, "ERROR: '%s' built with %s failed to run\n", current->name, VARIANT_NAMES[variant]);
+                continue;
+            }
+
+            if (variant != GCC_O2 && !same_files (output, reference))
+            {
+                fprintf (stderr, "ERROR: '%s' built with %s printed another answer than gcc -O2\n",
+                         current->name, VARIANT_NAMES[variant]);
+                continue;
+            }
+
+            measure->status = 0;
+        }
+
+        for (int variant = 0; variant < VARIANTS_COUNT; variant++)
+            status |= current->measures[variant].status;
+
+        print_kernel (current, csv);
+    }
+
+    fclose (csv);
+
+    remove_tree (bench.root);
+
+    printf ("results written to %s\n", argv[5]);
+
+    return status;
+}
+
+static int build_variant (const struct Bench_t* bench, const char* kernel, enum Variant_t variant, const char* binary)
+{
+    char source[PATH_MAX] = {};
+
+    if (variant != COOK)
+    {
+        kernel_path (source, kernel, ".c");
+
+        const char* const gcc[] = { "gcc", (variant == GCC_O0) ? "-O0" : "-O2", source, "-o", binary, "-lm", NULL };
+
+        return run_command (gcc);
+    }
+
+    char work_dir[PATH_MAX] = {};
+
+    kernel_path (source, kernel, ".cook");
+    snprintf (work_dir, sizeof (work_dir), "%s.work", binary);
+
+    const char* const frontend  [] = { bench->stages[0], "--workdir", work_dir, source, NULL };
+    const char* const middle_end[] = { bench->stages[1], "--workdir", work_dir, NULL };
+    const char* const backend   [] = { bench->stages[2], "--workdir", work_dir, "-o", binary, NULL };
+
+    return run_command (frontend) || run_command (middle_end) || run_command (backend);
+}
+
+static int run_variant (const struct Bench_t* bench, const char* binary, const char* input, const char* output,
+                        struct Measure_t* measure)
+{
+    measure->seconds = -1;
+
+    for (int run = 0; run < bench->runs; run++)
+    {
+        int input_fd  = open (input,  O_RDONLY);
+        int output_fd = open (output, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+        double    seconds      = 0;
+        long long instructions = -1;
+
+        int error = (input_fd < 0 || output_fd < 0) ||
+                    run_once (bench, binary, input_fd, output_fd, &seconds, &instructions) != 0;
+
+        if (input_fd  >= 0) close (input_fd);
+        if (output_fd >= 0) close (output_fd);
+
+        if (error)
+            return 1;
+
+        if (measure->seconds < 0 || seconds < measure->seconds)
+        {
+            measure->seconds      = seconds;
+            measure->instructions = instructions;
+        }
+    }
+
+    return 0;
+}
+
+// the child waits on a pipe until its counter is open: counting starts with the exec, so
+// neither the fork nor the harness are in the count
+static int run_once (const struct Bench_t* bench, const char* binary, int input_fd, int output_fd,
+                     double* seconds, long long* instructions)
+{
+    int go[2] = {};
+
+    if (pipe (go) != 0)
+    {
+        perror ("pipe");
+        return 1;
+    }
+
+    pid_t pid = fork ();
+
+    if (pid < 0)
+    {
+        perror ("fork");
+        close (go[0]);
+        close (go[1]);
+        return 1;
+    }
+
+    if (pid == 0)
+    {
+        char start = 0;
+
+        close (go[1]);
+
+        if (read (go[0], &start, 1) != 1)
+            _exit (127);
+
+        dup2 (input_fd,  STDIN_FILENO);
+        dup2 (output_fd, STDOUT_FILENO);
+
+        execl (binary, binary, (char*) NULL);
+        _exit (127);
+    }
+
+    close (go[0]);
+
+    int counter = bench->counting ? open_counter (pid) : -1;
+
+    double start = now_seconds ();
+
+    int started = (write (go[1], "", 1) == 1);
+    close (go[1]);
+
+    int wait_status = 0;
+    int waited = (waitpid (pid, &wait_status, 0) == pid);
+
+    *seconds = now_seconds () - start;
+
+    if (counter >= 0)
+    {
+        uint64_t count = 0;
+
+        if (read (counter, &count, sizeof (count)) == (ssize_t) sizeof (count))
+            *instructions = (long long) count;
+
+        close (counter);
+    }
+
+    return !(started && waited && WIFEXITED (wait_status) && WEXITSTATUS (wait_status) == 0);
+}
+
+// user-space instructions of the process (0 is the caller), counted from its next exec
+static int open_counter (pid_t pid)
+{
+    struct perf_event_attr attr = {};
+
+    attr.size           = sizeof (attr);
+    attr.type           = PERF_TYPE_HARDWARE;
+    attr.config         = PERF_COUNT_HW_INSTRUCTIONS;
+    attr.disabled       = 1;
+    attr.enable_on_exec = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv     = 1;
+
+    return (int) syscall (SYS_perf_event_open, &attr, pid, -1, -1, PERF_FLAG_FD_CLOEXEC);
+}
+
+static int run_command (const char* const argv[])
+{
+    pid_t pid = fork ();
+
+    if (pid < 0)
+        return 1;
+
+    if (pid == 0)
+    {
+        int null_fd = open ("/dev/null", O_WRONLY);
+        if (null_fd >= 0)
+        {
+            dup2 (null_fd, STDOUT_FILENO);
+            dup2 (null_fd, STDERR_FILENO);
+        }
+
+        execvp (argv[0], (char* const*) argv);
+        _exit (127);
+    }
+
+    int status = 0;
+
+    if (waitpid (pid, &status, 0) != pid)
+        return 1;
+
+    return !(WIFEXITED (status) && WEXITSTATUS (status) == 0);
+}
+
+static void kernel_path (char* path, const char* kernel, const char* extension)
+{
+    snprintf (path, PATH_MAX, "%s%s", kernel, extension);
+}
+
+static void print_kernel (const struct Kernel_t* kernel, FILE* csv)
+{
+    printf ("  %-16s", kernel->name);
+    fprintf (csv, "%s", kernel->name);
+
+    for (int variant = 0; variant < VARIANTS_COUNT; variant++)
+    {
+        const struct Measure_t* measure = &kernel->measures[variant];
+
+        print_measure (measure);
+
+        // a field is left empty when there is nothing to put in it
+        if (measure->status != 0)
+            fprintf (csv, ",,,");
+        else if (measure->instructions < 0)
+            fprintf (csv, ",%.3f,,%ld", measure->seconds * 1000, measure->size);
+        else
+            fprintf (csv, ",%.3f,%lld,%ld", measure->seconds * 1000, measure->instructions, measure->size);
+    }
+
+    // how many times slower the cook binary is than each of the gcc ones
+    printf (" |");
+
+    for (int variant = GCC_O0; variant < VARIANTS_COUNT; variant++)
+    {
+        const struct Measure_t* cook     = &kernel->measures[COOK];
+        const struct Measure_t* baseline = &kernel->measures[variant];
+
+        if (cook->status == 0 && baseline->status == 0 && baseline->seconds > 0)
+            printf (" %7.2fx", cook->seconds / baseline->seconds);
+        else
+            printf (" %8s", "-");
+    }
+
+    printf ("\n");
+    fprintf (csv, "\n");
+}
+
+static void print_measure (const struct Measure_t* measure)
+{
+    if (measure->status != 0)
+    {
+        printf (" | %9s %9s %8s", "failed", "-", "-");
+        return;
+    }
+
+    printf (" | %7.1fms", measure->seconds * 1000);
+
+    if (measure->instructions >= 0)
+        printf (" %9.1f", (double) measure->instructions / 1e6);
+    else
+        printf (" %9s", "-");
+
+    printf (" %8.1f", (double) measure->size / 1024);
+}
@@ -0,0 +1,226 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "bench_utils.h"
+
+// frontend scaling test: generates programs of growing token count, runs the frontend
+// on each one and checks that time and peak memory per token stay flat
+
+#define MAX_RUNS        8
+#define SCALING_LIMIT   4.0     // allowed growth of ns/token from the smallest to the biggest program
+
+struct Run_t
+{
+    long   tokens;
+    double seconds;
+    long   max_rss_kb;
+};
+
+static long   generate_program (const char* filename, long target_tokens);
+static void   letters          (long number, char* out);
+static int    run_frontend     (const char* frontend, const char* work_dir, struct Run_t* run);
+
+int main (int argc, const char* argv[])
+{
+    if (argc < 2)
+    {
+        fprintf (stderr, "Usage: %s <frontend> [tokens...]\n", argv[0]);
+        return 1;
+    }
+
+    char frontend[PATH_MAX] = {};
+    if (realpath (argv[1], frontend) == NULL)
+    {
+        fprintf (stderr, "ERROR: frontend '%s' not found\n", argv[1]);
+        return 1;
+    }
+
+    long sizes[MAX_RUNS] = { 10000, 100000, 1000000 };
+    int  runs_count = 3;
+
+    if (argc > 2)
+    {
+        runs_count = 0;
+        for (int i = 2; i < argc && runs_count < MAX_RUNS; i++)
+            sizes[runs_count++] = atol (argv[i]);
+    }
+
+    char work_dir[] = "/tmp/cook_scaling_XXXXXX";
+    if (mkdtemp (work_dir) == NULL)
+    {
+        perror ("mkdtemp");
+        return 1;
+    }
+
+    char path[PATH_MAX] = {};
+
+    snprintf (path, sizeof (path), "%s/log", work_dir);
+    mkdir (path, 0755);
+    snprintf (path, sizeof (path), "%s/middle_end", work_dir);
+    mkdir (path, 0755);
+    snprintf (path, sizeof (path), "%s/program.cook", work_dir);
+
+    struct Run_t runs[MAX_RUNS] = {};
+    int status = 0;
+
+    printf ("frontend scaling:\n");
+    printf ("  %10s %10s %10s %12s %10s\n", "tokens", "ms", "ns/token", "max RSS KB", "B/token");
+
+    for (int i = 0; i < runs_count; i++)
+    {
+        runs[i].tokens = generate_program (path, sizes[i]);
+
+        if (runs[i].tokens < 0 || run_frontend (frontend, work_dir, &runs[i]) != 0)
+        {
+            status = 1;
+            break;
+        }
+
+        // memory per token is measured against the smallest run, that removes the fixed part
+        double bytes_per_token = (i == 0) ? 0 :
+                                 (double) (runs[i].max_rss_kb - runs[0].max_rss_kb) * 1024 /
+                                 (double) (runs[i].tokens     - runs[0].tokens);
+
+        printf ("  %10ld %10.1f %10.1f %12ld %10.1f\n", runs[i].tokens, runs[i].seconds * 1000,
+                runs[i].seconds * 1e9 / (double) runs[i].tokens, runs[i].max_rss_kb, bytes_per_token);
+    }
+
+    if (status == 0 && runs_count > 1)
+    {
+        double first = runs[0].seconds / (double) runs[0].tokens;
+        double last  = runs[runs_count - 1].seconds / (double) runs[runs_count - 1].tokens;
+
+        if (last > first * SCALING_LIMIT)
+        {
+            printf ("FAILED: ns/token grew %.1fx (limit %.1fx)\n", last / first, SCALING_LIMIT);
+            status = 1;
+        }
+        else
+            printf ("OK: ns/token grew %.1fx (limit %.1fx)\n", last / first, SCALING_LIMIT);
+    }
+
+    remove_tree (work_dir);
+
+    return status;
+}
+
+// functions with a loop-heavy body; every function has its own names,
+// because a name belongs to the function it was declared in
+static long generate_program (const char* filename, long target_tokens)
+{
+    FILE* file = fopen (filename, "wb");
+    if (file == NULL)
+    {
+        perror ("fopen");
+        return -1;
+    }
+
+    long tokens = 0;
+    char id[16] = {};
+
+    for (long func = 0; tokens < target_tokens; func++)
+    {
+        letters (func, id);
+
+        fprintf (file, "lethimcook fun%s (lethimcook par%s)\nlesssgo\n", id, id);
+        fprintf (file, "    lethimcook va%s is par%s + 1 shutup\n", id, id);
+        fprintf (file, "    lethimcook vb%s is 0 shutup\n", id);
+        tokens += 7 + 7 + 5;
+
+        for (int loop = 0; loop < 8; loop++)
+        {
+            fprintf (file, "    grinding (va%s lowkey 100)\n    lesssgo\n", id);
+            fprintf (file, "        vb%s is vb%s + va%s * 2 shutup\n", id, id, id);
+            fprintf (file, "        va%s is va%s + 1 shutup\n", id, id);
+            fprintf (file, "    stoopit shutup\n");
+
+            fprintf (file, "    forreal (vb%s fr 1000)\n    lesssgo\n", id);
+            fprintf (file, "        vb%s is vb%s / 2 shutup\n", id, id);
+            fprintf (file, "    stoopit shutup\n");
+
+            tokens += 23 + 15;
+        }
+
+        fprintf (file, "    yap(vb%s) shutup\nstoopit\n\n", id);
+        tokens += 6;
+    }
+
+    fprintf (file, "lethimcook carti (lethimcook argc)\nlesssgo\n    yap(argc) shutup\nstoopit\n$\n");
+    tokens += 14;
+
+    fclose (file);
+
+    return tokens;
+}
+
+// identifiers are letters only
+static void letters (long number, char* out)
+{
+    int i = 0;
+
+    do
+    {
+        out[i++] = (char) ('a' + number % 26);
+        number /= 26;
+    }
+    while (number > 0 && i < 14);
+
+    out[i] = '\0';
+}
+
+static int run_frontend (const char* frontend, const char* work_dir, struct Run_t* run)
+{
+    double start = now_seconds ();
+
+    pid_t pid = fork ();
+    if (pid < 0)
+    {
+        perror ("fork");
+        return 1;
+    }
+
+    if (pid == 0)
+    {
+        if (chdir (work_dir) != 0)
+            _exit (127);
+
+        int null_fd = open ("/dev/null", O_WRONLY);
+        if (null_fd >= 0)
+        {
+            dup2 (null_fd, STDOUT_FILENO);
+            dup2 (null_fd, STDERR_FILENO);
+        }
+
+        execl (frontend, frontend, "program.cook", (char*) NULL);
+        _exit (127);
+    }
+
+    int status = 0;
+    struct rusage usage = {};
+
+    if (wait4 (pid, &status, 0, &usage) < 0)
+    {
+        perror ("wait4");
+        return 1;
+    }
+
+    run->seconds    = now_seconds () - start;
+    run->max_rss_kb = usage.ru_maxrss;
+
+    if (!WIFEXITED (status) || WEXITSTATUS (status) != 0)
+    {
+        fprintf (stderr, "ERROR: frontend failed on %ld tokens (status %d)\n", run->tokens, status);
+        return 1;
+    }
+
+    return 0;
+}
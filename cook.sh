@@ -4,24 +4,32 @@
 # Usage:
 #   ./cook.sh <file.cook>          compile only
 #   ./cook.sh <file.cook> --run    compile and run (reads from stdin)
+#   ./cook.sh <file.cook> --dump   also write the intermediate AST, name table, IR and NASM files
+#
+# other options (--cache, --cache-dir <dir>, --cache-stats, ...) are passed to the driver;
+# the compile goes through cook-client, which uses a running `cook --server` when there is one
 
 set -e
 
 if [ $# -lt 1 ]; then
-    echo "Usage: $0 <file.cook> [--run]" >&2
+    echo "Usage: $0 <file.cook> [--run] [--dump] [driver options...]" >&2
     exit 1
 fi
 
 SOURCE="$1"
+shift
+
 RUN=0
+OPTIONS=()
 
-if [ "${2}" = "--run" ]; then
-    RUN=1
-fi
+for arg in "$@"; do
+    case "$arg" in
+        --run) RUN=1 ;;
+        *)     OPTIONS+=("$arg") ;;
+    esac
+done
 
-frontend/build/frontend  "$SOURCE"
-middle_end/build/middle_end
-backend/build/backend
+driver/build/cook-client "${OPTIONS[@]}" "$SOURCE"
 
 if [ $RUN -eq 1 ]; then
     backend/build/program
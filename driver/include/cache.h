@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <limits.h>
+
+// persistent content-addressed cache of compiled programs: an entry is keyed on the source
+// text, the compiler binary and the options, and holds the files the compile produced
+// (the ELF, and with --dump the intermediate files); a hit writes them back without
+// running any stage. Entries are single files in the cache directory, least recently
+// used ones are evicted when the directory grows over its size limit. The same directory
+// keeps the code of single functions, see functions.h.
+
+#define CACHE_DEFAULT_MEGABYTES 256
+#define CACHE_MAX_FILES          16
+
+struct Cache_t
+{
+    char     dir[PATH_MAX];
+    uint64_t compiler_id;           // hash of the running compiler binary
+    size_t   max_size;              // bytes
+};
+
+int      cache_open  (struct Cache_t* cache, const char* dir, size_t max_size);
+
+uint64_t cache_compiler_id (void);
+
+uint64_t cache_key   (const struct Cache_t* cache, const char* source, size_t source_size, const char* options);
+
+int      cache_fetch (const struct Cache_t* cache, uint64_t key, const char* source, size_t source_size,
+                      const char* const paths[], int count);
+
+int      cache_store (const struct Cache_t* cache, uint64_t key, const char* source, size_t source_size,
+                      const char* const paths[], int count);
+
+int      cache_load  (const struct Cache_t* cache, uint64_t key, const char* source, size_t source_size,
+                      char** data, size_t* size);
+
+int      cache_save  (const struct Cache_t* cache, uint64_t key, const char* source, size_t source_size,
+                      const char* data, size_t size);
+
+void     cache_count_functions (const struct Cache_t* cache, long reused, long recompiled);
+
+int      cache_report (const struct Cache_t* cache, FILE* file);
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "tree_io.h"
+#include "backend_elf.h"
+
+// what every compile starts from; a server builds it once and its workers keep it over
+// all the requests they serve
+struct Warm_t
+{
+    struct Context_t      context;          // keywords already in the name table
+    struct CompilerState* program;          // runtime functions already in .text, a compile copies it
+    uint64_t              compiler_id;      // 0: computed when a cache is opened
+};
+
+int  warm_up    (struct Warm_t* warm, int identify);
+
+int  reset_warm (struct Warm_t* warm);
+
+void cool_down (struct Warm_t* warm);
+
+int  cook      (int argc, const char* argv[], struct Warm_t* warm);
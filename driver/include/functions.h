@@ -0,0 +1,15 @@
+#pragma once
+
+#include "tree_io.h"
+#include "cache.h"
+#include "backend_elf.h"
+
+// incremental compile: every function of the program is propagated and simplified, then looked
+// up in the cache on its own, keyed on its subtree and on the registers the functions before it
+// left bound. A hit splices the stored machine code in without hoisting, generating IR or
+// encoding the function again; a miss compiles the function alone and stores it. Calls
+// between functions are resolved when the program is linked, into exe_file; the program
+// is consumed either way.
+
+int compile_functions (const struct Cache_t* cache, struct Context_t* context, struct Node_t* root,
+                       struct CompilerState* program, const char* exe_file);
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <stddef.h>
+
+// what cook-client and cook --server say to each other over the socket:
+//
+// request:  "COOK 1\n", "cwd <dir>\n", "env <NAME=value>\n"..., "arg <argument>\n"..., "end\n"
+// response: "status <code> <stdout bytes> <stderr bytes>\n", then the two outputs
+//
+// the arguments are the driver's own, the server runs them in the client's directory
+
+#define PROTOCOL_VERSION    "COOK 1"
+#define PROTOCOL_MAX_REQUEST 65536
+#define PROTOCOL_MAX_ARGS    64
+
+// the environment the driver reads, sent along with every request; the server takes no other
+#define PROTOCOL_ENVIRONMENT { "COOK_CACHE_DIR", "COOK_CACHE_SIZE", "XDG_CACHE_HOME", "HOME" }
+
+int socket_path (char* path, size_t size, const char* option);
+
+int write_all_fd (int fd, const char* data, size_t size);
@@ -0,0 +1,9 @@
+#pragma once
+
+// compile server: cook --server [--socket <path>] [--workers <count>] listens on a Unix socket
+// with a number of worker processes, one per CPU by default; a worker keeps its warm state and
+// its allocators from one request to the next, so a request pays neither the process start
+// nor the set-up. A compile that ends its worker is answered all the same, and the server
+// starts a new worker in its place
+
+int run_server (int argc, const char* argv[]);
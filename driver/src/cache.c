@@ -0,0 +1,575 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+
+#include "mapped_file.h"
+#include "cache.h"
+
+#define CACHE_MAGIC     "COOKCCH"
+#define ENTRY_SUFFIX    ".entry"
+#define STATS_FILE      "stats"
+
+#define FNV_OFFSET      0xcbf29ce484222325ULL
+#define FNV_PRIME       0x00000100000001b3ULL
+
+// entry file: header | file infos | source | file contents, in the order they were stored
+struct CacheEntry_t
+{
+    char     magic[8];
+    uint64_t compiler_id;
+    uint64_t source_size;
+    uint32_t file_count;
+    uint32_t reserved;
+};
+
+struct CacheFileInfo_t
+{
+    uint64_t size;
+    uint32_t mode;
+    uint32_t reserved;
+};
+
+struct CacheStats_t
+{
+    long hits;
+    long misses;
+    long stores;
+    long evictions;
+    long reused;                    // functions spliced in from the cache
+    long recompiled;                // functions compiled and stored
+};
+
+struct EntryFile_t
+{
+    char   name[32];
+    off_t  size;
+    struct timespec used;
+};
+
+static uint64_t hash_bytes   (uint64_t hash, const char* data, size_t size);
+static int      make_dirs    (const char* dir);
+static int      entry_path   (const struct Cache_t* cache, uint64_t key, const char* suffix, char* path);
+static size_t   map_entry    (const struct Cache_t* cache, uint64_t key, const char* source, size_t source_size,
+                              int count, char** entry, size_t* map_length);
+static int      write_entry  (const struct Cache_t* cache, uint64_t key, const char* source, size_t source_size,
+                              const char* const contents[], const struct CacheFileInfo_t files[], int count);
+static int      write_all    (int fd, const char* data, size_t size);
+static int      restore_file (const char* path, const char* data, size_t size, uint32_t mode);
+static void     count_stats  (const struct Cache_t* cache, struct CacheStats_t add, struct CacheStats_t* total);
+static long     list_entries (const struct Cache_t* cache, struct EntryFile_t** entries, off_t* total_size);
+static int      compare_used (const void* first, const void* second);
+static void     evict        (const struct Cache_t* cache);
+
+int cache_open (struct Cache_t* cache, const char* dir, size_t max_size)
+{
+    if (snprintf (cache->dir, sizeof (cache->dir), "%s", dir) >= (int) sizeof (cache->dir))
+    {
+        fprintf (stderr, "ERROR: cache directory name is too long\n");
+        return 1;
+    }
+
+    if (make_dirs (cache->dir) != 0)
+    {
+        fprintf (stderr, "ERROR: could not create cache directory '%s': %s\n", cache->dir, strerror (errno));
+        return 1;
+    }
+
+    cache->max_size = max_size;
+
+    // the compiler itself is part of the key: a rebuilt compiler never sees old entries;
+    // a server identifies itself once and opens caches with the id already set
+    if (cache->compiler_id == 0)
+        cache->compiler_id = cache_compiler_id();
+
+    return (cache->compiler_id == 0);
+}
+
+uint64_t cache_compiler_id (void)
+{
+    long   exe_size   = 0;
+    size_t map_length = 0;
+
+    char* exe = map_file ("/proc/self/exe", &exe_size, &map_length);
+    if (exe == NULL)
+        return 0;
+
+    uint64_t id = hash_bytes (FNV_OFFSET, exe, (size_t) exe_size);
+
+    unmap_file (exe, map_length);
+
+    return id;
+}
+
+uint64_t cache_key (const struct Cache_t* cache, const char* source, size_t source_size, const char* options)
+{
+    uint64_t hash = hash_bytes (FNV_OFFSET, (const char*) &cache->compiler_id, sizeof (cache->compiler_id));
+
+    hash = hash_bytes (hash, options, strlen (options) + 1);
+
+    return hash_bytes (hash, source, source_size);
+}
+
+// returns 0 on a hit, after the files are written back
+int cache_fetch (const struct Cache_t* cache, uint64_t key, const char* source, size_t source_size,
+                 const char* const paths[], int count)
+{
+    char*  entry      = NULL;
+    size_t map_length = 0;
+
+    size_t offset = map_entry (cache, key, source, source_size, count, &entry, &map_length);
+    int    valid  = (offset != 0);
+
+    const struct CacheFileInfo_t* files = (const struct CacheFileInfo_t*) (entry + sizeof (struct CacheEntry_t));
+
+    for (int i = 0; valid && i < count; i++)
+    {
+        valid   = restore_file (paths[i], entry + offset, (size_t) files[i].size, files[i].mode) == 0;
+        offset += (size_t) files[i].size;
+    }
+
+    if (entry != NULL)
+        unmap_file (entry, map_length);
+
+    if (!valid)
+    {
+        count_stats (cache, (struct CacheStats_t) { .misses = 1 }, NULL);
+        return 1;
+    }
+
+    count_stats (cache, (struct CacheStats_t) { .hits = 1 }, NULL);
+
+    return 0;
+}
+
+int cache_store (const struct Cache_t* cache, uint64_t key, const char* source, size_t source_size,
+                 const char* const paths[], int count)
+{
+    if (count > CACHE_MAX_FILES)
+        return 1;
+
+    char*  contents[CACHE_MAX_FILES]    = {};
+    size_t lengths [CACHE_MAX_FILES]    = {};
+    struct CacheFileInfo_t files[CACHE_MAX_FILES] = {};
+
+    int error = 0;
+
+    for (int i = 0; i < count && !error; i++)
+    {
+        struct stat st = {};
+        long size = 0;
+
+        error = stat (paths[i], &st) != 0 ||
+                (contents[i] = map_file (paths[i], &size, &lengths[i])) == NULL;
+
+        files[i].size = (uint64_t) size;
+        files[i].mode = (uint32_t) (st.st_mode & 07777);
+    }
+
+    error = error || write_entry (cache, key, source, source_size, (const char* const*) contents, files, count) != 0;
+
+    for (int i = 0; i < count; i++)
+        unmap_file (contents[i], lengths[i]);
+
+    if (error)
+    {
+        fprintf (stderr, "WARNING: could not store the compiled program in the cache '%s'\n", cache->dir);
+        return 1;
+    }
+
+    count_stats (cache, (struct CacheStats_t) { .stores = 1 }, NULL);
+
+    evict (cache);
+
+    return 0;
+}
+
+// one in-memory blob under 'key', for the per-function entries; returns 0 on a hit with a
+// malloc'ed copy in *data, lookups are counted by cache_count_functions
+int cache_load (const struct Cache_t* cache, uint64_t key, const char* source, size_t source_size,
+                char** data, size_t* size)
+{
+    char*  entry      = NULL;
+    size_t map_length = 0;
+
+    size_t offset = map_entry (cache, key, source, source_size, 1, &entry, &map_length);
+
+    *data = NULL;
+    *size = 0;
+
+    if (offset != 0)
+    {
+        const struct CacheFileInfo_t* files = (const struct CacheFileInfo_t*) (entry + sizeof (struct CacheEntry_t));
+
+        *size = (size_t) files[0].size;
+        *data = (char*) malloc (*size + 1);
+
+        if (*data != NULL)
+            memcpy (*data, entry + offset, *size);
+    }
+
+    if (entry != NULL)
+        unmap_file (entry, map_length);
+
+    return (*data == NULL);
+}
+
+int cache_save (const struct Cache_t* cache, uint64_t key, const char* source, size_t source_size,
+                const char* data, size_t size)
+{
+    const char* contents[1] = { data };
+    struct CacheFileInfo_t files[1] = { { .size = size, .mode = 0644 } };
+
+    return write_entry (cache, key, source, source_size, contents, files, 1);
+}
+
+// adds up the function lookups of one compile; the entries it saved are evicted from here,
+// once per compile rather than once per function
+void cache_count_functions (const struct Cache_t* cache, long reused, long recompiled)
+{
+    count_stats (cache, (struct CacheStats_t) { .reused = reused, .recompiled = recompiled }, NULL);
+
+    if (recompiled != 0)
+        evict (cache);
+}
+
+int cache_report (const struct Cache_t* cache, FILE* file)
+{
+    struct CacheStats_t stats = {};
+    count_stats (cache, (struct CacheStats_t) {}, &stats);
+
+    struct EntryFile_t* entries = NULL;
+    off_t total_size = 0;
+
+    long count = list_entries (cache, &entries, &total_size);
+    free (entries);
+
+    long lookups = stats.hits + stats.misses;
+
+    fprintf (file, "cache '%s': %ld entries, %ld KB of %zu KB\n",
+                   cache->dir, count, (long) total_size / 1024, cache->max_size / 1024);
+    fprintf (file, "  hits %ld, misses %ld (hit rate %.1f%%), stores %ld, evictions %ld\n",
+                   stats.hits, stats.misses, (lookups != 0) ? 100.0 * (double) stats.hits / (double) lookups : 0.0,
+                   stats.stores, stats.evictions);
+    fprintf (file, "  functions reused %ld, recompiled %ld\n", stats.reused, stats.recompiled);
+
+    return 0;
+}
+
+// FNV-1a, eight bytes at a time and the tail byte by byte
+static uint64_t hash_bytes (uint64_t hash, const char* data, size_t size)
+{
+    size_t i = 0;
+
+    for (; i + sizeof (uint64_t) <= size; i += sizeof (uint64_t))
+    {
+        uint64_t word = 0;
+        memcpy (&word, data + i, sizeof (word));
+
+        hash = (hash ^ word) * FNV_PRIME;
+    }
+
+    for (; i < size; i++)
+        hash = (hash ^ (unsigned char) data[i]) * FNV_PRIME;
+
+    return hash;
+}
+
+static int make_dirs (const char* dir)
+{
+    char path[PATH_MAX] = {};
+    snprintf (path, sizeof (path), "%s", dir);
+
+    for (char* slash = strchr (path + 1, '/'); slash != NULL; slash = strchr (slash + 1, '/'))
+    {
+        *slash = '\0';
+
+        if (mkdir (path, 0755) != 0 && errno != EEXIST)
+            return 1;
+
+        *slash = '/';
+    }
+
+    if (mkdir (path, 0755) != 0 && errno != EEXIST)
+        return 1;
+
+    return 0;
+}
+
+static int entry_path (const struct Cache_t* cache, uint64_t key, const char* suffix, char* path)
+{
+    int written = snprintf (path, PATH_MAX, "%s/%016llx%s", cache->dir, (unsigned long long) key, suffix);
+
+    return (written < 0 || written >= PATH_MAX);
+}
+
+// maps the entry under 'key' and checks that it was made by this compiler from 'source' and
+// holds 'count' files; returns the offset of the first file's contents, 0 when there is no
+// such entry (a 64-bit key collision or a stale entry is no entry either)
+static size_t map_entry (const struct Cache_t* cache, uint64_t key, const char* source, size_t source_size,
+                         int count, char** entry, size_t* map_length)
+{
+    char path[PATH_MAX] = {};
+
+    *entry = NULL;
+
+    // a missing entry is the usual miss, map_file would report it as an error
+    if (entry_path (cache, key, ENTRY_SUFFIX, path) != 0 || access (path, R_OK) != 0)
+        return 0;
+
+    long entry_size = 0;
+
+    *entry = map_file (path, &entry_size, map_length);
+    if (*entry == NULL)
+        return 0;
+
+    struct CacheEntry_t header = {};
+    const struct CacheFileInfo_t* files = (const struct CacheFileInfo_t*) (*entry + sizeof (header));
+
+    size_t known = sizeof (header) + (size_t) count * sizeof (*files) + source_size;
+
+    if ((size_t) entry_size >= sizeof (header))
+        memcpy (&header, *entry, sizeof (header));
+
+    int valid = (size_t) entry_size >= known                                &&
+                memcmp (header.magic, CACHE_MAGIC, sizeof (header.magic)) == 0 &&
+                header.compiler_id == cache->compiler_id                   &&
+                header.source_size == source_size                          &&
+                header.file_count  == (uint32_t) count                     &&
+                memcmp (*entry + known - source_size, source, source_size) == 0;
+
+    size_t content = known;
+
+    for (int i = 0; valid && i < count; i++)
+    {
+        valid   = files[i].size <= (uint64_t) entry_size - content;
+        content += (size_t) files[i].size;
+    }
+
+    if (!valid || content != (size_t) entry_size)
+        return 0;
+
+    utimensat (AT_FDCWD, path, NULL, 0);            // recently used entries are evicted last
+
+    return known;
+}
+
+static int write_entry (const struct Cache_t* cache, uint64_t key, const char* source, size_t source_size,
+                        const char* const contents[], const struct CacheFileInfo_t files[], int count)
+{
+    char path    [PATH_MAX] = {};
+    char tmp_path[PATH_MAX] = {};
+    char suffix  [64]       = {};
+
+    snprintf (suffix, sizeof (suffix), ENTRY_SUFFIX ".%d", (int) getpid ());
+
+    if (entry_path (cache, key, ENTRY_SUFFIX, path) != 0 || entry_path (cache, key, suffix, tmp_path) != 0)
+        return 1;
+
+    struct CacheEntry_t header = { .magic       = CACHE_MAGIC,
+                                   .compiler_id = cache->compiler_id,
+                                   .source_size = source_size,
+                                   .file_count  = (uint32_t) count };
+
+    // written aside and renamed, so readers never see half an entry
+    int fd = open (tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+    int error = fd < 0 ||
+                write_all (fd, (const char*) &header, sizeof (header))                        != 0 ||
+                write_all (fd, (const char*) files,   (size_t) count * sizeof (files[0]))      != 0 ||
+                write_all (fd, source,                source_size)                            != 0;
+
+    for (int i = 0; i < count && !error; i++)
+        error = write_all (fd, contents[i], (size_t) files[i].size) != 0;
+
+    if (fd >= 0 && close (fd) != 0)
+        error = 1;
+
+    if (!error && rename (tmp_path, path) != 0)
+        error = 1;
+
+    if (error)
+        unlink (tmp_path);
+
+    return error;
+}
+
+static int write_all (int fd, const char* data, size_t size)
+{
+    while (size > 0)
+    {
+        ssize_t written = write (fd, data, size);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+                continue;
+
+            return 1;
+        }
+
+        data += written;
+        size -= (size_t) written;
+    }
+
+    return 0;
+}
+
+static int restore_file (const char* path, const char* data, size_t size, uint32_t mode)
+{
+    int fd = open (path, O_WRONLY | O_CREAT | O_TRUNC, (mode_t) mode);
+    if (fd < 0)
+    {
+        fprintf (stderr, "ERROR: could not write '%s': %s\n", path, strerror (errno));
+        return 1;
+    }
+
+    int error = write_all (fd, data, size) != 0 || fchmod (fd, (mode_t) mode) != 0;
+
+    if (close (fd) != 0)
+        error = 1;
+
+    return error;
+}
+
+// adds 'add' to the counters kept in the cache directory, under a lock: several compiles
+// can share one cache; the new totals go to 'total' if it is not NULL
+static void count_stats (const struct Cache_t* cache, struct CacheStats_t add, struct CacheStats_t* total)
+{
+    char path[PATH_MAX] = {};
+    snprintf (path, sizeof (path), "%s/" STATS_FILE, cache->dir);
+
+    int fd = open (path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0)
+        return;
+
+    flock (fd, LOCK_EX);
+
+    char text[256] = {};
+    ssize_t length = pread (fd, text, sizeof (text) - 1, 0);
+
+    struct CacheStats_t stats = {};
+
+    if (length > 0)
+        sscanf (text, "hits %ld misses %ld stores %ld evictions %ld reused %ld recompiled %ld",
+                &stats.hits, &stats.misses, &stats.stores, &stats.evictions, &stats.reused, &stats.recompiled);
+
+    stats.hits       += add.hits;
+    stats.misses     += add.misses;
+    stats.stores     += add.stores;
+    stats.evictions  += add.evictions;
+    stats.reused     += add.reused;
+    stats.recompiled += add.recompiled;
+
+    length = snprintf (text, sizeof (text), "hits %ld misses %ld stores %ld evictions %ld reused %ld recompiled %ld\n",
+                       stats.hits, stats.misses, stats.stores, stats.evictions, stats.reused, stats.recompiled);
+
+    if (ftruncate (fd, 0) == 0)
+        pwrite (fd, text, (size_t) length, 0);
+
+    flock (fd, LOCK_UN);
+    close (fd);
+
+    if (total != NULL)
+        *total = stats;
+}
+
+static long list_entries (const struct Cache_t* cache, struct EntryFile_t** entries, off_t* total_size)
+{
+    *entries    = NULL;
+    *total_size = 0;
+
+    DIR* dir = opendir (cache->dir);
+    if (dir == NULL)
+        return 0;
+
+    long count    = 0;
+    long capacity = 0;
+
+    struct dirent* item = NULL;
+
+    while ((item = readdir (dir)) != NULL)
+    {
+        size_t length = strlen (item->d_name);
+
+        if (length <= sizeof (ENTRY_SUFFIX) - 1 || length >= sizeof ((*entries)->name) ||
+            strcmp (item->d_name + length - (sizeof (ENTRY_SUFFIX) - 1), ENTRY_SUFFIX) != 0)
+            continue;
+
+        struct stat st = {};
+        if (fstatat (dirfd (dir), item->d_name, &st, 0) != 0)
+            continue;
+
+        if (count == capacity)
+        {
+            capacity = (capacity != 0) ? 2 * capacity : 64;
+
+            struct EntryFile_t* grown = (struct EntryFile_t*) realloc (*entries, (size_t) capacity * sizeof (**entries));
+            if (grown == NULL)
+                break;
+
+            *entries = grown;
+        }
+
+        struct EntryFile_t* entry = &(*entries)[count++];
+
+        memcpy (entry->name, item->d_name, length + 1);
+        entry->size = st.st_size;
+        entry->used = st.st_mtim;
+
+        *total_size += st.st_size;
+    }
+
+    closedir (dir);
+
+    return count;
+}
+
+static int compare_used (const void* first, const void* second)
+{
+    const struct timespec* a = &((const struct EntryFile_t*) first) ->used;
+    const struct timespec* b = &((const struct EntryFile_t*) second)->used;
+
+    if (a->tv_sec  != b->tv_sec)  return (a->tv_sec  < b->tv_sec)  ? -1 : 1;
+    if (a->tv_nsec != b->tv_nsec) return (a->tv_nsec < b->tv_nsec) ? -1 : 1;
+
+    return 0;
+}
+
+// least recently used entries go first until the cache fits its size limit again
+static void evict (const struct Cache_t* cache)
+{
+    struct EntryFile_t* entries = NULL;
+    off_t total_size = 0;
+
+    long count = list_entries (cache, &entries, &total_size);
+
+    if ((size_t) total_size > cache->max_size)
+    {
+        qsort (entries, (size_t) count, sizeof (*entries), compare_used);
+
+        long evicted = 0;
+
+        for (long i = 0; i < count && (size_t) total_size > cache->max_size; i++)
+        {
+            char path[PATH_MAX] = {};
+            snprintf (path, sizeof (path), "%s/%s", cache->dir, entries[i].name);
+
+            if (unlink (path) == 0)
+            {
+                total_size -= entries[i].size;
+                evicted++;
+            }
+        }
+
+        count_stats (cache, (struct CacheStats_t) { .evictions = evicted }, NULL);
+    }
+
+    free (entries);
+}
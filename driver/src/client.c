@@ -0,0 +1,187 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "protocol.h"
+
+// cook-client: the driver's command line, compiled by a running cook --server; without a
+// server it runs the driver itself, so it can always stand in for it
+
+#define DRIVER_NAME "cook"
+
+static int  connect_server (const char* option);
+static int  send_request   (int server, int argc, const char* argv[]);
+static int  read_response  (int server);
+static void run_driver     (int argc, const char* argv[]);
+
+int main (int argc, const char* argv[])
+{
+    const char* option = NULL;
+
+    // --socket is the client's own, everything else goes to the driver
+    const char* args[PROTOCOL_MAX_ARGS + 1] = { DRIVER_NAME };
+    int count = 1;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp (argv[i], "--socket") == 0 && i + 1 < argc)
+            option = argv[++i];
+        else if (count < PROTOCOL_MAX_ARGS && strchr (argv[i], '\n') == NULL)
+            args[count++] = argv[i];
+        else
+        {
+            fprintf (stderr, "ERROR: too many or unsupported arguments\n");
+            return 1;
+        }
+    }
+
+    int server = connect_server (option);
+
+    if (server < 0)
+        run_driver (count, args);
+
+    if (send_request (server, count, args) != 0)
+    {
+        fprintf (stderr, "ERROR: could not send the request to the cook server\n");
+        close (server);
+        return 1;
+    }
+
+    int status = read_response (server);
+
+    close (server);
+
+    return status;
+}
+
+static int connect_server (const char* option)
+{
+    struct sockaddr_un address = { .sun_family = AF_UNIX };
+
+    if (socket_path (address.sun_path, sizeof (address.sun_path), option) != 0)
+        return -1;
+
+    int server = socket (AF_UNIX, SOCK_STREAM, 0);
+    if (server < 0)
+        return -1;
+
+    if (connect (server, (const struct sockaddr*) &address, sizeof (address)) != 0)
+    {
+        close (server);
+        return -1;
+    }
+
+    // the request carries the directory and the environment: only a server of the same user gets them
+    struct ucred peer   = {};
+    socklen_t    length = sizeof (peer);
+
+    if (getsockopt (server, SOL_SOCKET, SO_PEERCRED, &peer, &length) != 0 || peer.uid != getuid ())
+    {
+        fprintf (stderr, "WARNING: the cook server on %s belongs to another user, not used\n", address.sun_path);
+        close (server);
+        return -1;
+    }
+
+    return server;
+}
+
+static int send_request (int server, int argc, const char* argv[])
+{
+    static char text[PROTOCOL_MAX_REQUEST] = {};
+    char cwd[PATH_MAX] = {};
+
+    if (getcwd (cwd, sizeof (cwd)) == NULL)
+        return 1;
+
+    int size = snprintf (text, sizeof (text), PROTOCOL_VERSION "\ncwd %s\n", cwd);
+
+    const char* const names[] = PROTOCOL_ENVIRONMENT;
+
+    for (size_t i = 0; i < sizeof (names) / sizeof (names[0]) && size < (int) sizeof (text); i++)
+    {
+        const char* value = getenv (names[i]);
+
+        if (value != NULL && strchr (value, '\n') == NULL)
+            size += snprintf (text + size, sizeof (text) - (size_t) size, "env %s=%s\n", names[i], value);
+    }
+
+    for (int i = 1; i < argc && size < (int) sizeof (text); i++)
+        size += snprintf (text + size, sizeof (text) - (size_t) size, "arg %s\n", argv[i]);
+
+    if (size < (int) sizeof (text))
+        size += snprintf (text + size, sizeof (text) - (size_t) size, "end\n");
+
+    if (size >= (int) sizeof (text))
+        return 1;
+
+    return write_all_fd (server, text, (size_t) size);
+}
+
+// passes the driver's output through and returns its status
+static int read_response (int server)
+{
+    FILE* stream = fdopen (dup (server), "rb");
+    if (stream == NULL)
+        return 1;
+
+    int  status   = 1;
+    long out_size = 0;
+    long err_size = 0;
+
+    if (fscanf (stream, "status %d %ld %ld", &status, &out_size, &err_size) != 3 || fgetc (stream) != '\n')
+    {
+        fprintf (stderr, "ERROR: the cook server sent a malformed response\n");
+        fclose (stream);
+        return 1;
+    }
+
+    for (long i = 0; i < out_size; i++)
+    {
+        int c = fgetc (stream);
+        if (c == EOF) break;
+        putchar (c);
+    }
+
+    for (long i = 0; i < err_size; i++)
+    {
+        int c = fgetc (stream);
+        if (c == EOF) break;
+        fputc (c, stderr);
+    }
+
+    fclose (stream);
+
+    return status;
+}
+
+// the driver is the cook binary next to this one
+static void run_driver (int argc, const char* argv[])
+{
+    char path[PATH_MAX] = {};
+
+    ssize_t length = readlink ("/proc/self/exe", path, sizeof (path) - 1);
+    char* slash = (length > 0) ? strrchr (path, '/') : NULL;
+
+    if (slash == NULL || (size_t) (slash + 1 - path) + sizeof (DRIVER_NAME) > sizeof (path))
+    {
+        fprintf (stderr, "ERROR: could not find the cook driver\n");
+        exit (1);
+    }
+
+    strcpy (slash + 1, DRIVER_NAME);
+
+    argv[argc] = NULL;
+
+    execv (path, (char* const*) (uintptr_t) argv);
+
+    fprintf (stderr, "ERROR: could not run '%s': %s\n", path, strerror (errno));
+    exit (1);
+}
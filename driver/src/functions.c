@@ -0,0 +1,333 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "functions.h"
+#include "simplification.h"
+#include "propagation.h"
+#include "licm.h"
+#include "dead_code.h"
+#include "backend_elf.h"
+#include "ir_gen.h"
+#include "errors.h"
+
+#define KEY_START_CAPACITY 4096
+
+// what a stored function leaves behind besides its code: the state of the IR generator
+// after it and the registers LICM kept for its new locals, so the functions that follow see the
+// same registers whether it was compiled or not;
+// the entry is this header | call fixups | symbols the function bound, in order | code
+struct FunctionEntry_t
+{
+    uint32_t code_size;
+    uint32_t fixup_count;
+    uint32_t symbol_count;
+    int32_t  reg_count;
+    int32_t  label_count;
+    int32_t  hoisted;
+};
+
+// serialized subtree a function is keyed on, grown as it is written
+struct KeyBuffer_t
+{
+    char*  data;
+    size_t size;
+    size_t capacity;
+};
+
+static int  put_bytes        (struct KeyBuffer_t* key, const void* data, size_t size);
+static int  put_name         (struct KeyBuffer_t* key, struct IRGenerator_t* gen, const struct Name_t* name, int binding);
+static int  put_tree         (struct KeyBuffer_t* key, struct IRGenerator_t* gen, struct Context_t* context,
+                              struct Node_t* node, int is_name);
+static int  optimize_chain   (struct Context_t* context, struct Node_t* root, struct IrRegisters_t* registers);
+static int  splice_function  (struct CompilerState* program, struct IRGenerator_t* gen, struct IrRegisters_t* registers,
+                              const char* name, char* entry, size_t size);
+static int  compile_function (const struct Cache_t* cache, struct CompilerState* program, struct IRGenerator_t* gen,
+                              struct IrRegisters_t* registers, struct Context_t* context, struct Node_t* glue,
+                              const struct KeyBuffer_t* key, uint64_t hash);
+
+int compile_functions (const struct Cache_t* cache, struct Context_t* context, struct Node_t* root,
+                       struct CompilerState* program, const char* exe_file)
+{
+    assert (cache);
+    assert (context);
+    assert (program);
+    assert (exe_file);
+
+    struct IRGenerator_t* gen = (struct IRGenerator_t*) calloc (1, sizeof (*gen));
+    struct KeyBuffer_t    key = {};
+
+    if (gen == NULL)
+    {
+        fprintf (stderr, "ERROR: could not allocate the IR generator\n");
+        destroy_elf_program (program);
+        return 1;
+    }
+
+    initial_ir_generator (gen);
+
+    const struct NodePool_t* pool = &context->nodes;
+
+    // the IR registers of the program, which LICM takes the registers of its new locals from
+    struct IrRegisters_t registers = {};
+
+    long reused     = 0;
+    long recompiled = 0;
+    int  error      = optimize_chain (context, root, &registers);
+
+    for (struct Node_t* glue = root; glue != NULL && error == 0; glue = node_right (pool, glue))
+    {
+        struct Node_t* def  = node_left (pool, glue);
+        struct Node_t* head = node_left (pool, def);
+
+        // the key is taken before LICM: a hit skips the rest of the middle-end too
+        key.size = 0;
+
+        error = put_bytes (&key, &gen->registers.kept, sizeof (gen->registers.kept)) ||
+                put_bytes (&key, &registers, sizeof (registers)) ||
+                put_tree  (&key, gen, context, def, 0);
+
+        if (error != 0)
+            break;
+
+        uint64_t hash = cache_key (cache, key.data, key.size, "function");
+
+        const struct Name_t* func = &context->name_table[(int) node_left (pool, head)->value].name;
+        char name[ELF_LABEL_LENGTH] = {};
+
+        snprintf (name, sizeof (name), "%.*s", func->length, func->str_pointer);
+
+        char*  entry = NULL;
+        size_t size  = 0;
+
+        if (cache_load (cache, hash, key.data, key.size, &entry, &size) == 0 &&
+            splice_function (program, gen, &registers, name, entry, size) == 0)
+        {
+            reused++;
+        }
+        else
+        {
+            error = compile_function (cache, program, gen, &registers, context, glue, &key, hash);
+            recompiled++;
+        }
+
+        free (entry);
+    }
+
+    enum Errors status = NO_ERROR;
+
+    if (error == 0)
+        status = link_elf_program (program, exe_file);
+    else
+        destroy_elf_program (program);
+
+    cache_count_functions (cache, reused, recompiled);
+
+#ifdef DEBUG
+    fprintf (stderr, "functions: %ld reused, %ld recompiled\n", reused, recompiled);
+#endif
+
+    free (key.data);
+    destroy_ir_generator (gen);
+    free (gen);
+
+    if (status != NO_ERROR)
+    {
+        ERROR_MESSAGE (status)
+        return (int) status;
+    }
+
+    return error;
+}
+
+// LICM takes its registers from a count of the whole program, which is made after the
+// propagation and the simplification of every function, as optimize_tree counts them
+static int optimize_chain (struct Context_t* context, struct Node_t* root, struct IrRegisters_t* registers)
+{
+    const struct NodePool_t* pool = &context->nodes;
+
+    for (struct Node_t* glue = root; glue != NULL; glue = node_right (pool, glue))
+    {
+        struct Node_t* def  = node_left (pool, glue);
+        struct Node_t* head = (def != NULL) ? node_left (pool, def) : NULL;
+
+        if (node_type (pool, glue) != FUNC || (int) glue->value != FN_GLUE ||
+            def == NULL || node_type (pool, def) != FUNC || (int) def->value != DEF || head == NULL || head->left == 0)
+        {
+            fprintf (stderr, "ERROR: the program is not a chain of function definitions\n");
+            return 1;
+        }
+
+        // the simplification may replace the definition itself, it is taken from the glue again
+        if (propagate_constants          (context, def) != 0 ||
+            simplification_of_expression (context, node_left (pool, glue), glue) != 0)
+            return 1;
+    }
+
+    return count_ir_registers (context, root, registers);
+}
+
+static int put_bytes (struct KeyBuffer_t* key, const void* data, size_t size)
+{
+    if (key->size + size > key->capacity)
+    {
+        size_t capacity = (key->capacity != 0) ? 2 * key->capacity : KEY_START_CAPACITY;
+
+        while (capacity < key->size + size)
+            capacity *= 2;
+
+        char* grown = (char*) realloc (key->data, capacity);
+        if (grown == NULL)
+        {
+            fprintf (stderr, "ERROR: could not grow the function key to %zu bytes\n", capacity);
+            return 1;
+        }
+
+        key->data     = grown;
+        key->capacity = capacity;
+    }
+
+    memcpy (key->data + key->size, data, size);
+    key->size += size;
+
+    return 0;
+}
+
+// names go in as text: their positions in the name table move when an earlier function changes;
+// a variable also brings the register it is bound to when the function starts
+static int put_name (struct KeyBuffer_t* key, struct IRGenerator_t* gen, const struct Name_t* name, int binding)
+{
+    int error = put_bytes (key, &name->length, sizeof (name->length)) ||
+                put_bytes (key, name->str_pointer, (size_t) name->length);
+
+    if (binding)
+    {
+        const char* reg = lookup_symbol (gen, name->str_pointer, name->length);
+
+        error = error || put_bytes (key, (reg != NULL) ? reg : "", (reg != NULL) ? strlen (reg) + 1 : 1);
+    }
+
+    return error;
+}
+
+// pre-order, with a marker for every missing child; the left child of a CALL is the function name
+static int put_tree (struct KeyBuffer_t* key, struct IRGenerator_t* gen, struct Context_t* context,
+                     struct Node_t* node, int is_name)
+{
+    const int8_t none = -1;
+
+    if (node == NULL)
+        return put_bytes (key, &none, sizeof (none));
+
+    const struct NodePool_t* pool = &context->nodes;
+
+    const int8_t type = (int8_t) node_type (pool, node);
+
+    int error = put_bytes (key, &type, sizeof (type));
+
+    if (type == ID || is_name)
+        error = error || put_name (key, gen, &context->name_table[(int) node->value].name, type == ID);
+    else
+        error = error || put_bytes (key, &node->value, sizeof (node->value));
+
+    int call = (type == FUNC && (int) node->value == CALL);
+
+    return error || put_tree (key, gen, context, node_left  (pool, node), call)
+                 || put_tree (key, gen, context, node_right (pool, node), 0);
+}
+
+// returns 1 if the entry does not hold what a stored function should, nothing is placed then
+static int splice_function (struct CompilerState* program, struct IRGenerator_t* gen, struct IrRegisters_t* registers,
+                            const char* name, char* entry, size_t size)
+{
+    struct FunctionEntry_t header = {};
+
+    if (size < sizeof (header))
+        return 1;
+
+    memcpy (&header, entry, sizeof (header));
+
+    size_t fixups_size  = (size_t) header.fixup_count  * sizeof (struct CallFixup_t);
+    size_t symbols_size = (size_t) header.symbol_count * sizeof (struct Symbol);
+
+    if (header.fixup_count > size || header.symbol_count > MAX_SYMBOLS || header.hoisted < 0 || header.hoisted >= IR_REGISTERS ||
+        size != sizeof (header) + fixups_size + symbols_size + header.code_size)
+        return 1;
+
+    // the entry is a malloc'ed copy: the records in it are aligned and can be used in place
+    struct Symbol* symbols = (struct Symbol*) (entry + sizeof (header) + fixups_size);
+
+    struct FunctionCode_t function = { .code        = (uint8_t*) (entry + sizeof (header) + fixups_size + symbols_size),
+                                       .size        = header.code_size,
+                                       .fixups      = (struct CallFixup_t*) (entry + sizeof (header)),
+                                       .fixup_count = (int) header.fixup_count };
+
+    splice_elf_function (program, name, &function);
+
+    for (uint32_t i = 0; i < header.symbol_count; i++)
+    {
+        symbols[i].name[MAX_VAR_NAME - 1] = '\0';
+        symbols[i].reg [MAX_VAR_NAME - 1] = '\0';
+
+        set_symbol_reg (gen, symbols[i].name, (int) strlen (symbols[i].name), symbols[i].reg);
+    }
+
+    gen->registers.kept = header.reg_count;
+    gen->label_count    = header.label_count;
+    registers->kept    += header.hoisted;
+
+    return 0;
+}
+
+static int compile_function (const struct Cache_t* cache, struct CompilerState* program, struct IRGenerator_t* gen,
+                             struct IrRegisters_t* registers, struct Context_t* context, struct Node_t* glue,
+                             const struct KeyBuffer_t* key, uint64_t hash)
+{
+    const struct NodePool_t* pool = &context->nodes;
+
+    int kept = registers->kept;
+
+    if (hoist_loop_invariants (context, node_left (pool, glue), registers) != 0 ||
+        eliminate_dead_code   (context, node_left (pool, glue)) != 0)
+        return 1;
+
+    int first_symbol = gen->symbol_count;
+
+    gen->instr_count = 0;
+    bypass (gen, node_left (pool, glue), context);
+
+    if (gen->error)
+        return 1;
+
+    struct FunctionCode_t function = {};
+
+    if (compile_elf_function (program, gen, &function) != 0)
+    {
+        fprintf (stderr, "ERROR: could not copy the code of a function\n");
+        return 1;
+    }
+
+    struct FunctionEntry_t header = { .code_size    = (uint32_t) function.size,
+                                      .fixup_count  = (uint32_t) function.fixup_count,
+                                      .symbol_count = (uint32_t) (gen->symbol_count - first_symbol),
+                                      .reg_count    = gen->registers.kept,
+                                      .label_count  = gen->label_count,
+                                      .hoisted      = registers->kept - kept };
+
+    struct KeyBuffer_t entry = {};
+
+    // a function that could not be stored is only compiled again next time
+    int error = put_bytes (&entry, &header, sizeof (header)) ||
+                put_bytes (&entry, function.fixups, (size_t) function.fixup_count * sizeof (*function.fixups)) ||
+                put_bytes (&entry, &gen->symbols[first_symbol], header.symbol_count * sizeof (gen->symbols[0])) ||
+                put_bytes (&entry, function.code, function.size);
+
+    if (error == 0)
+        cache_save (cache, hash, key->data, key->size, entry.data, entry.size);
+
+    free (entry.data);
+    free_function_code (&function);
+
+    return 0;
+}
@@ -0,0 +1,429 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+#include "tree.h"
+#include "tokens.h"
+#include "syntax.h"
+#include "buffer.h"
+#include "simplification.h"
+#include "propagation.h"
+#include "licm.h"
+#include "dead_code.h"
+#include "backend_nasm.h"
+#include "backend_elf.h"
+#include "errors.h"
+#include "ir_gen.h"
+#include "cache.h"
+#include "functions.h"
+#include "driver.h"
+#include "server.h"
+#include "work_dir.h"
+#include "time_report.h"
+#include "opt_stats.h"
+
+// the three stages in one process: the tree and the name table built by the
+// frontend are optimized and compiled in place, nothing is re-parsed
+
+#define EXE_FILE            "backend/build/program"
+
+// written only with --dump, the same files the separate stages exchange
+#define FRONT_TREE_FILENAME "middle_end/AST_tree.txt"
+#define FRONT_NAME_FILENAME "middle_end/Name_Table.txt"
+#define MID_TREE_FILENAME   "backend/AST_tree.txt"
+#define MID_NAME_FILENAME   "backend/Name_Table.txt"
+#define IR_FILENAME         "backend/program_beta.ir"
+#define NASM_FILENAME       "backend/program_beta.nasm"
+
+// the files a compile produces, in the order the cache keeps them
+enum Output_t
+{
+    EXE_OUTPUT,
+    FRONT_TREE_OUTPUT,
+    FRONT_NAME_OUTPUT,
+    MID_TREE_OUTPUT,
+    MID_NAME_OUTPUT,
+    IR_OUTPUT,
+    NASM_OUTPUT,
+    OUTPUTS_COUNT
+};
+
+struct Options_t
+{
+    const char* program_file;
+    const char* output;             // NULL: the program goes to the work directory
+    const char* work_dir;           // NULL: the source tree
+    int         dump;
+
+    int         cache;              // look the program up in the compile cache first
+    int         cache_stats;
+    const char* cache_dir;          // NULL: $COOK_CACHE_DIR or the user cache directory
+};
+
+static int parse_options     (int argc, const char* argv[], struct Options_t* options, struct TimeReport_t* report);
+static int open_cache        (const struct Options_t* options, struct Cache_t* cache);
+static int output_paths      (const struct Options_t* options, char paths[OUTPUTS_COUNT][PATH_MAX],
+                              const char* outputs[OUTPUTS_COUNT]);
+static int compile_program   (const char* string, const char* const outputs[OUTPUTS_COUNT], int dump,
+                              const struct Cache_t* cache, struct Warm_t* warm, struct TimeReport_t* report);
+static int optimize_tree     (struct Context_t* context, struct Node_t* root, struct TimeReport_t* report);
+static int generate_program  (struct CompilerState* program, struct Context_t* context, struct Node_t* root,
+                              const char* const outputs[OUTPUTS_COUNT], int dump, struct TimeReport_t* report);
+
+int main (int argc, const char* argv[])
+{
+    if (argc > 1 && strcmp (argv[1], "--server") == 0)
+        return run_server (argc, argv);
+
+    struct Warm_t warm = {};
+
+    if (warm_up (&warm, 0) != 0)
+        return 1;
+
+    int error = cook (argc, argv, &warm);
+
+    cool_down (&warm);
+
+    return error;
+}
+
+// the state every compile starts from: the keywords in the name table and the runtime
+// functions in .text; a server identifies the compiler for the cache here too
+int warm_up (struct Warm_t* warm, int identify)
+{
+    if (ctor_keywords (&warm->context) != 0)
+        return 1;
+
+    warm->program = create_elf_program();
+
+    if (identify && (warm->compiler_id = cache_compiler_id()) == 0)
+        return 1;
+
+    return 0;
+}
+
+// after a compile: the names, tokens and nodes of the program are dropped, their memory is kept
+int reset_warm (struct Warm_t* warm)
+{
+    return reset_keywords (&warm->context);
+}
+
+void cool_down (struct Warm_t* warm)
+{
+    free_context (&warm->context);
+    destroy_elf_program (warm->program);
+
+    warm->program = NULL;
+}
+
+// one run of the driver, on its command line; warm->context is left with the program in it
+int cook (int argc, const char* argv[], struct Warm_t* warm)
+{
+    struct Options_t    options = {};
+    struct TimeReport_t report  = {};
+
+    opt_stats_reset();
+
+    if (parse_options (argc, argv, &options, &report) != 0)
+    {
+        fprintf (stderr, "Usage: %s [--server [--socket <path>] [--workers <count>]] [-o <program>] [--workdir <dir>] [--dump] [--cache] [--cache-dir <dir>] [--cache-stats] [--time-report[=json]] [--opt-stats] <program.cook>\n", argv[0]);
+        return 1;
+    }
+
+    struct Cache_t cache = { .compiler_id = warm->compiler_id };
+
+    if ((options.cache || options.cache_stats) && open_cache (&options, &cache) != 0)
+        return 1;
+
+    if (options.program_file == NULL)
+        return cache_report (&cache, stdout);
+
+    char        paths  [OUTPUTS_COUNT][PATH_MAX] = {};
+    const char* outputs[OUTPUTS_COUNT]           = {};
+
+    if (output_paths (&options, paths, outputs) != 0)
+        return 1;
+
+    struct Buffer_t buffer = {};
+
+    phase_begin (&report, "read source");
+
+    const char* string = file_reader (&buffer, options.program_file);
+
+    phase_end (&report, -1, -1, buffer.file_size);
+
+    // outputs are kept by position: where they are written is not part of the key
+    int outputs_count = options.dump ? OUTPUTS_COUNT : 1;
+
+    uint64_t key = 0;
+    int error = 1;
+
+    if (string != NULL && options.cache)
+    {
+        phase_begin (&report, "cache lookup");
+
+        key   = cache_key (&cache, buffer.buffer_ptr, (size_t) buffer.file_size, options.dump ? "dump" : "");
+        error = cache_fetch (&cache, key, buffer.buffer_ptr, (size_t) buffer.file_size, outputs, outputs_count);
+
+        phase_end (&report, -1, -1, (error == 0) ? file_bytes (outputs[EXE_OUTPUT]) : -1);
+    }
+
+    if (string != NULL && error != 0)
+    {
+        error = compile_program (string, outputs, options.dump, options.cache ? &cache : NULL, warm, &report);
+
+        if (error == 0 && options.cache)
+        {
+            phase_begin (&report, "cache store");
+            cache_store (&cache, key, buffer.buffer_ptr, (size_t) buffer.file_size, outputs, outputs_count);
+            phase_end   (&report, -1, -1, -1);
+        }
+    }
+
+    time_report_print (&report, stderr, "cook");
+    opt_stats_print   (stderr, "cook");
+
+    if (options.cache_stats)
+        cache_report (&cache, stdout);
+
+    buffer_dtor (&buffer);
+
+    return error;
+}
+
+static int parse_options (int argc, const char* argv[], struct Options_t* options, struct TimeReport_t* report)
+{
+    options->cache_dir = getenv ("COOK_CACHE_DIR");
+    options->cache     = (options->cache_dir != NULL);
+
+    for (int i = 1; i < argc; i++)
+    {
+        if      (strcmp (argv[i], "--dump")        == 0) options->dump        = 1;
+        else if (strcmp (argv[i], "--cache")       == 0) options->cache       = 1;
+        else if (strcmp (argv[i], "--no-cache")    == 0) options->cache       = 0;
+        else if (strcmp (argv[i], "--cache-stats") == 0) options->cache_stats = 1;
+        else if (strcmp (argv[i], "-o")            == 0 && i + 1 < argc) options->output   = argv[++i];
+        else if (strcmp (argv[i], "--workdir")     == 0 && i + 1 < argc) options->work_dir = argv[++i];
+        else if (strcmp (argv[i], "--cache-dir")   == 0 && i + 1 < argc)
+        {
+            options->cache_dir = argv[++i];
+            options->cache     = 1;
+        }
+        else if (time_report_option (report, argv[i]) || opt_stats_option (argv[i]))
+            continue;
+        else if (argv[i][0] == '-' || options->program_file != NULL)
+            return 1;
+        else
+            options->program_file = argv[i];
+    }
+
+    // a plain --cache-stats reports on the cache without compiling
+    return (options->program_file == NULL && !options->cache_stats);
+}
+
+// the cache lives in --cache-dir, $COOK_CACHE_DIR, $XDG_CACHE_HOME/cook or ~/.cache/cook,
+// $COOK_CACHE_SIZE limits it in megabytes
+static int open_cache (const struct Options_t* options, struct Cache_t* cache)
+{
+    char dir[PATH_MAX] = {};
+
+    const char* xdg  = getenv ("XDG_CACHE_HOME");
+    const char* home = getenv ("HOME");
+
+    if      (options->cache_dir != NULL) snprintf (dir, sizeof (dir), "%s", options->cache_dir);
+    else if (xdg  != NULL && *xdg  != 0) snprintf (dir, sizeof (dir), "%s/cook", xdg);
+    else if (home != NULL && *home != 0) snprintf (dir, sizeof (dir), "%s/.cache/cook", home);
+    else
+    {
+        fprintf (stderr, "ERROR: no cache directory, set COOK_CACHE_DIR\n");
+        return 1;
+    }
+
+    const char* size = getenv ("COOK_CACHE_SIZE");
+    long megabytes = (size != NULL) ? atol (size) : CACHE_DEFAULT_MEGABYTES;
+
+    if (megabytes <= 0)
+        megabytes = CACHE_DEFAULT_MEGABYTES;
+
+    return cache_open (cache, dir, (size_t) megabytes * 1024 * 1024);
+}
+
+// -o names the program, everything else (and the program without -o) is in the work directory;
+// the dumps are only made with --dump
+static int output_paths (const struct Options_t* options, char paths[OUTPUTS_COUNT][PATH_MAX],
+                         const char* outputs[OUTPUTS_COUNT])
+{
+    const char* const names[OUTPUTS_COUNT] = { EXE_FILE, FRONT_TREE_FILENAME, FRONT_NAME_FILENAME, MID_TREE_FILENAME,
+                                               MID_NAME_FILENAME, IR_FILENAME, NASM_FILENAME };
+
+    if (set_work_dir (options->work_dir) != 0)
+        return 1;
+
+    for (int i = 0; i < OUTPUTS_COUNT; i++)
+    {
+        if (i == EXE_OUTPUT && options->output != NULL)
+            outputs[i] = options->output;
+        else if ((i == EXE_OUTPUT || options->dump) &&
+                 (outputs[i] = work_path (paths[i], PATH_MAX, names[i])) == NULL)
+            return 1;
+    }
+
+    return 0;
+}
+
+// with a cache, a program that missed it is compiled function by function, reusing the code
+// of the functions that did not change; --dump needs the IR of the whole program, so it
+// compiles everything
+static int compile_program (const char* string, const char* const outputs[OUTPUTS_COUNT], int dump,
+                            const struct Cache_t* cache, struct Warm_t* warm, struct TimeReport_t* report)
+{
+    struct Context_t*     context = &warm->context;
+    struct CompilerState* program = copy_elf_program (warm->program);
+
+    // ========== frontend ========== //
+
+    phase_begin (report, "tokenization");
+
+    int error = tokenization (context, string);
+
+    phase_end (report, -1, -1, -1);
+
+    struct Node_t* root = NULL;
+
+    if (error == 0)
+    {
+        phase_begin (report, "GetGrammar");
+
+        root  = parse_program (context);
+        error = (root == NULL);
+
+        phase_end (report, phase_nodes (report, &context->nodes, root), -1, -1);
+
+        if (error == 0 && dump)
+        {
+            phase_begin (report, "write AST");
+            write_ast_file (root, context, outputs[FRONT_TREE_OUTPUT], 0);
+            write_name_table_file (context, outputs[FRONT_NAME_OUTPUT]);
+            phase_end   (report, -1, -1, file_bytes (outputs[FRONT_TREE_OUTPUT]) + file_bytes (outputs[FRONT_NAME_OUTPUT]));
+        }
+    }
+
+    // the middle-end and the backend run function by function here, timed as one phase;
+    // both compile_functions and generate_program take the program over
+    if (error == 0 && cache != NULL && !dump)
+    {
+        phase_begin (report, "compile_functions");
+
+        error   = compile_functions (cache, context, root, program, outputs[EXE_OUTPUT]);
+        program = NULL;
+
+        phase_end (report, -1, -1, file_bytes (outputs[EXE_OUTPUT]));
+    }
+    else if (error == 0)
+    {
+        error = optimize_tree (context, root, report);
+
+        if (error == 0 && dump)
+        {
+            phase_begin (report, "write AST");
+            write_ast_file (root, context, outputs[MID_TREE_OUTPUT], 0);
+            write_name_table_file (context, outputs[MID_NAME_OUTPUT]);
+            phase_end   (report, -1, -1, file_bytes (outputs[MID_TREE_OUTPUT]) + file_bytes (outputs[MID_NAME_OUTPUT]));
+        }
+
+        if (error == 0)
+        {
+            error   = generate_program (program, context, root, outputs, dump, report);
+            program = NULL;
+        }
+    }
+
+#ifdef DEBUG
+    node_pool_dump (stderr, &context->nodes, "cook");
+#endif
+
+    destroy_elf_program (program);
+
+    return error;
+}
+
+// ========== middle-end ========== //
+
+// every pass is timed, the passes after a failed one are not run
+static int optimize_tree (struct Context_t* context, struct Node_t* root, struct TimeReport_t* report)
+{
+    phase_begin (report, "propagation");
+
+    int error = propagate_constants (context, root);
+
+    phase_end   (report, phase_nodes (report, &context->nodes, root), -1, -1);
+    phase_begin (report, "simplification");
+
+    error = error || simplification_of_expression (context, root, NULL);
+
+    phase_end   (report, phase_nodes (report, &context->nodes, root), -1, -1);
+    phase_begin (report, "licm");
+
+    struct IrRegisters_t registers = {};
+
+    error = error || count_ir_registers (context, root, &registers) ||
+            hoist_loop_invariants (context, root, &registers);
+
+    phase_end   (report, phase_nodes (report, &context->nodes, root), -1, -1);
+    phase_begin (report, "dead code");
+
+    error = error || eliminate_dead_code (context, root);
+
+    phase_end (report, phase_nodes (report, &context->nodes, root), -1, -1);
+
+    return error;
+}
+
+// ========== backend ========== //
+
+static int generate_program (struct CompilerState* program, struct Context_t* context, struct Node_t* root,
+                             const char* const outputs[OUTPUTS_COUNT], int dump, struct TimeReport_t* report)
+{
+    struct IRGenerator_t gen = {};
+    initial_ir_generator (&gen);
+
+    phase_begin (report, "bypass");
+
+    bypass (&gen, root, context);
+
+    phase_end (report, -1, gen.instr_count, -1);
+
+    int         failed = gen.error;
+    enum Errors error  = NO_ERROR;
+
+    if (!failed && dump)
+    {
+        phase_begin (report, "write IR");
+        dump_ir_to_file (&gen, outputs[IR_OUTPUT]);
+        phase_end   (report, -1, -1, file_bytes (outputs[IR_OUTPUT]));
+
+        phase_begin (report, "generate_x86_nasm");
+        error = generate_x86_nasm (&gen, outputs[NASM_OUTPUT]);
+        phase_end   (report, -1, -1, file_bytes (outputs[NASM_OUTPUT]));
+    }
+
+    // link_elf_program frees the program, whether it links or not
+    if (!failed && error == NO_ERROR)
+    {
+        phase_begin (report, "generate_elf");
+
+        compile_elf_ir (program, &gen);
+        error = link_elf_program (program, outputs[EXE_OUTPUT]);
+        program = NULL;
+
+        phase_end (report, -1, -1, file_bytes (outputs[EXE_OUTPUT]));
+    }
+
+    destroy_ir_generator (&gen);
+    destroy_elf_program  (program);
+
+    ERROR_MESSAGE (error)
+
+    return failed ? 1 : (int) error;
+}
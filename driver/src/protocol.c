@@ -0,0 +1,82 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "protocol.h"
+
+static int private_directory (const char* path);
+
+// --socket, $COOK_SOCKET, $XDG_RUNTIME_DIR/cook.sock or /tmp/cook-<uid>/cook.sock
+int socket_path (char* path, size_t size, const char* option)
+{
+    const char* variable = getenv ("COOK_SOCKET");
+    const char* runtime  = getenv ("XDG_RUNTIME_DIR");
+
+    int written = 0;
+
+    if      (option   != NULL)                     written = snprintf (path, size, "%s", option);
+    else if (variable != NULL && *variable != 0)   written = snprintf (path, size, "%s", variable);
+    else if (runtime  != NULL && *runtime  != 0)   written = snprintf (path, size, "%s/cook.sock", runtime);
+    else
+    {
+        char directory[64] = {};
+        snprintf (directory, sizeof (directory), "/tmp/cook-%d", (int) getuid ());
+
+        if (private_directory (directory) != 0)
+            return 1;
+
+        written = snprintf (path, size, "%s/cook.sock", directory);
+    }
+
+    if (written < 0 || (size_t) written >= size)
+    {
+        fprintf (stderr, "ERROR: socket path is too long\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+// anyone can create a name in /tmp first: the directory is only used if it is a real one of
+// this user that nobody else can enter
+static int private_directory (const char* path)
+{
+    if (mkdir (path, 0700) != 0 && errno != EEXIST)
+    {
+        fprintf (stderr, "ERROR: could not create '%s': %s\n", path, strerror (errno));
+        return 1;
+    }
+
+    struct stat info = {};
+
+    if (lstat (path, &info) != 0 || !S_ISDIR (info.st_mode) || info.st_uid != getuid () || (info.st_mode & 077) != 0)
+    {
+        fprintf (stderr, "ERROR: '%s' is not a private directory of this user\n", path);
+        return 1;
+    }
+
+    return 0;
+}
+
+int write_all_fd (int fd, const char* data, size_t size)
+{
+    while (size > 0)
+    {
+        ssize_t written = write (fd, data, size);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+                continue;
+
+            return 1;
+        }
+
+        data += written;
+        size -= (size_t) written;
+    }
+
+    return 0;
+}
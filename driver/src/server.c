@@ -0,0 +1,452 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <poll.h>
+
+#include "server.h"
+#include "protocol.h"
+#include "driver.h"
+
+#define COPY_CHUNK      4096
+#define MAX_WORKERS       64
+#define WORKER_REQUESTS 1000            // then the worker is replaced, with what its compiles leaked
+
+struct Request_t
+{
+    char        text[PROTOCOL_MAX_REQUEST + 1];
+    const char* cwd;
+    char*       env[PROTOCOL_MAX_ARGS];
+    int         env_count;
+    const char* argv[PROTOCOL_MAX_ARGS + 1];
+    int         argc;
+};
+
+// the request a worker is compiling, answered from exit () when a stage ends the process
+struct InFlight_t
+{
+    int   connection;               // -1: none
+    FILE* out;
+    FILE* err;
+};
+
+static volatile sig_atomic_t stopping = 0;
+
+static struct InFlight_t in_flight = { .connection = -1 };
+
+static void  stop          (int signal_number);
+static int   listen_socket (const struct sockaddr_un* address);
+static pid_t start_worker  (int listener, struct Warm_t* warm);
+static void  run_worker    (int listener, struct Warm_t* warm);
+static void  answer_exit   (int status, void* argument);
+static void  serve         (int connection, struct Warm_t* warm);
+static int   read_request  (int connection, struct Request_t* request);
+static int   run_request   (struct Request_t* request, struct Warm_t* warm);
+static int   is_forwarded  (const char* name);
+static int   send_response (int connection, int status, FILE* out, FILE* err);
+static int   send_file     (int connection, FILE* file);
+
+int run_server (int argc, const char* argv[])
+{
+    const char* option  = NULL;
+    long        workers = sysconf (_SC_NPROCESSORS_ONLN);
+
+    for (int i = 2; i < argc; i++)
+    {
+        if (strcmp (argv[i], "--socket") == 0 && i + 1 < argc)
+            option = argv[++i];
+        else if (strcmp (argv[i], "--workers") == 0 && i + 1 < argc && atol (argv[i + 1]) > 0)
+            workers = atol (argv[++i]);
+        else
+        {
+            fprintf (stderr, "Usage: %s --server [--socket <path>] [--workers <count>]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (workers < 1)           workers = 1;
+    if (workers > MAX_WORKERS) workers = MAX_WORKERS;
+
+    struct sockaddr_un address = { .sun_family = AF_UNIX };
+
+    if (socket_path (address.sun_path, sizeof (address.sun_path), option) != 0)
+        return 1;
+
+    int listener = listen_socket (&address);
+    if (listener < 0)
+        return 1;
+
+    struct Warm_t warm = {};
+
+    if (warm_up (&warm, 1) != 0)
+    {
+        fprintf (stderr, "ERROR: could not prepare the compiler state\n");
+        close (listener);
+        unlink (address.sun_path);
+        return 1;
+    }
+
+    // SIGINT and SIGTERM interrupt the wait here and the wait for a connection in the workers
+    struct sigaction action = { .sa_handler = stop };
+
+    sigaction (SIGINT,  &action, NULL);
+    sigaction (SIGTERM, &action, NULL);
+    signal    (SIGPIPE, SIG_IGN);
+
+    pid_t pids[MAX_WORKERS] = {};
+
+    for (long i = 0; i < workers; i++)
+        pids[i] = start_worker (listener, &warm);
+
+    fprintf (stderr, "cook server listening on %s, %ld workers\n", address.sun_path, workers);
+
+    // a worker that is gone, by its request limit or by a compile that ended it, is replaced
+    while (!stopping)
+    {
+        int   status = 0;
+        pid_t gone   = wait (&status);
+
+        if (gone < 0 && errno == EINTR)
+            continue;
+
+        if (gone < 0)
+        {
+            fprintf (stderr, "ERROR: no worker is left: %s\n", strerror (errno));
+            break;
+        }
+
+        if (WIFSIGNALED (status) && WTERMSIG (status) != SIGTERM && WTERMSIG (status) != SIGINT)
+            fprintf (stderr, "WARNING: a worker was killed by signal %d\n", WTERMSIG (status));
+
+        for (long i = 0; i < workers; i++)
+            if (pids[i] == gone && !stopping)
+                pids[i] = start_worker (listener, &warm);
+    }
+
+    for (long i = 0; i < workers; i++)
+        if (pids[i] > 0)
+            kill (pids[i], SIGTERM);
+
+    while (wait (NULL) > 0 || errno == EINTR)
+        continue;
+
+    close (listener);
+    unlink (address.sun_path);
+
+    cool_down (&warm);
+
+    return 0;
+}
+
+static void stop (int signal_number)
+{
+    (void) signal_number;
+
+    stopping = 1;
+}
+
+// a socket file left by a server that is gone is replaced, a live server is left alone;
+// the workers wait for the socket together, so accept must not block the ones that lose
+static int listen_socket (const struct sockaddr_un* address)
+{
+    int probe = socket (AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+    if (probe >= 0 && connect (probe, (const struct sockaddr*) address, sizeof (*address)) == 0)
+    {
+        fprintf (stderr, "ERROR: a server is already listening on %s\n", address->sun_path);
+        close (probe);
+        return -1;
+    }
+
+    if (probe >= 0)
+        close (probe);
+
+    if (errno == ECONNREFUSED)
+        unlink (address->sun_path);
+
+    int listener = socket (AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if (listener < 0)
+    {
+        fprintf (stderr, "ERROR: could not create a socket: %s\n", strerror (errno));
+        return -1;
+    }
+
+    // only the owner may compile through the socket
+    mode_t mask = umask (077);
+    int error = bind (listener, (const struct sockaddr*) address, sizeof (*address)) != 0 ||
+                listen (listener, SOMAXCONN) != 0;
+    umask (mask);
+
+    if (error)
+    {
+        fprintf (stderr, "ERROR: could not listen on %s: %s\n", address->sun_path, strerror (errno));
+        close (listener);
+        return -1;
+    }
+
+    return listener;
+}
+
+static pid_t start_worker (int listener, struct Warm_t* warm)
+{
+    fflush (NULL);
+
+    pid_t worker = fork();
+
+    if (worker == 0)
+    {
+        run_worker (listener, warm);
+
+        cool_down (warm);
+        fflush (NULL);
+        _exit (0);
+    }
+
+    if (worker < 0)
+        fprintf (stderr, "WARNING: could not start a worker: %s\n", strerror (errno));
+
+    return worker;
+}
+
+// a worker serves one request after the other with the same state: the name table, the token
+// vector and the node pool keep their memory, emptied after each compile, and every compile
+// starts from the same runtime functions; SIGINT and SIGTERM only get through while it waits,
+// so a compile that has begun is finished
+static void run_worker (int listener, struct Warm_t* warm)
+{
+    sigset_t signals = {};
+    sigset_t waiting = {};
+
+    sigemptyset (&signals);
+    sigaddset   (&signals, SIGINT);
+    sigaddset   (&signals, SIGTERM);
+    sigprocmask (SIG_BLOCK, &signals, &waiting);
+
+    on_exit (answer_exit, NULL);
+
+    for (int served = 0; !stopping && served < WORKER_REQUESTS; )
+    {
+        struct pollfd ready = { .fd = listener, .events = POLLIN };
+
+        if (ppoll (&ready, 1, NULL, &waiting) < 0)
+        {
+            if (errno == EINTR)
+                continue;
+
+            fprintf (stderr, "ERROR: a worker could not wait for requests: %s\n", strerror (errno));
+            return;
+        }
+
+        // another worker may have taken the connection first
+        int connection = accept4 (listener, NULL, NULL, SOCK_CLOEXEC);
+        if (connection < 0)
+            continue;
+
+        serve (connection, warm);
+        served++;
+
+        if (reset_warm (warm) != 0)
+            return;
+    }
+}
+
+// a stage that calls exit () ends the worker; its request still gets the status and the output
+static void answer_exit (int status, void* argument)
+{
+    (void) argument;
+
+    if (in_flight.connection < 0)
+        return;
+
+    fflush (NULL);
+
+    send_response (in_flight.connection, status, in_flight.out, in_flight.err);
+}
+
+// the compile runs in the worker itself, its output goes to two temporary files
+static void serve (int connection, struct Warm_t* warm)
+{
+    static struct Request_t request = {};
+
+    memset (&request, 0, sizeof (request));
+
+    FILE* out = tmpfile();
+    FILE* err = tmpfile();
+
+    if (out == NULL || err == NULL)
+    {
+        if (out != NULL) fclose (out);
+        if (err != NULL) fclose (err);
+
+        close (connection);
+        return;
+    }
+
+    int status = 1;
+
+    if (read_request (connection, &request) != 0)
+        fprintf (err, "ERROR: malformed request\n");
+    else
+    {
+        fflush (NULL);
+
+        int saved_out = dup (STDOUT_FILENO);
+        int saved_err = dup (STDERR_FILENO);
+
+        dup2 (fileno (out), STDOUT_FILENO);
+        dup2 (fileno (err), STDERR_FILENO);
+
+        in_flight = (struct InFlight_t) { .connection = connection, .out = out, .err = err };
+
+        status = run_request (&request, warm);
+
+        fflush (NULL);
+
+        in_flight.connection = -1;
+
+        dup2 (saved_out, STDOUT_FILENO);
+        dup2 (saved_err, STDERR_FILENO);
+
+        close (saved_out);
+        close (saved_err);
+    }
+
+    send_response (connection, status, out, err);
+
+    fclose (out);
+    fclose (err);
+    close  (connection);
+}
+
+static int read_request (int connection, struct Request_t* request)
+{
+    size_t size = 0;
+
+    while (size < PROTOCOL_MAX_REQUEST)
+    {
+        ssize_t got = read (connection, request->text + size, PROTOCOL_MAX_REQUEST - size);
+        if (got < 0 && errno == EINTR)
+            continue;
+        if (got <= 0)
+            break;
+
+        size += (size_t) got;
+        request->text[size] = '\0';
+
+        if (size >= sizeof ("\nend\n") - 1 && strcmp (request->text + size - (sizeof ("\nend\n") - 1), "\nend\n") == 0)
+            break;
+    }
+
+    request->text[size] = '\0';
+
+    request->argv[request->argc++] = "cook";
+
+    int version = 0;
+    int end     = 0;
+
+    for (char* line = strtok (request->text, "\n"); line != NULL && !end; line = strtok (NULL, "\n"))
+    {
+        if      (!version)                                          version = (strcmp (line, PROTOCOL_VERSION) == 0) ? 1 : -1;
+        else if (strncmp (line, "cwd ", 4) == 0)                    request->cwd = line + 4;
+        else if (strncmp (line, "env ", 4) == 0 &&
+                 request->env_count < PROTOCOL_MAX_ARGS)            request->env[request->env_count++] = line + 4;
+        else if (strncmp (line, "arg ", 4) == 0 &&
+                 request->argc < PROTOCOL_MAX_ARGS)                 request->argv[request->argc++] = line + 4;
+        else if (strcmp (line, "end") == 0)                         end = 1;
+        else
+            return 1;
+
+        if (version < 0)
+            return 1;
+    }
+
+    request->argv[request->argc] = NULL;
+
+    return !(version == 1 && end && request->cwd != NULL);
+}
+
+// the driver runs as if it was started by the client: in its directory and with its environment
+static int run_request (struct Request_t* request, struct Warm_t* warm)
+{
+    if (chdir (request->cwd) != 0)
+    {
+        fprintf (stderr, "ERROR: could not enter '%s': %s\n", request->cwd, strerror (errno));
+        return 1;
+    }
+
+    const char* const names[] = PROTOCOL_ENVIRONMENT;
+
+    for (size_t i = 0; i < sizeof (names) / sizeof (names[0]); i++)
+        unsetenv (names[i]);
+
+    for (int i = 0; i < request->env_count; i++)
+    {
+        char* equal = strchr (request->env[i], '=');
+
+        if (equal == NULL)
+            continue;
+
+        *equal = '\0';
+
+        // a request may not set what the client never sends, LD_PRELOAD or PATH say
+        if (!is_forwarded (request->env[i]))
+        {
+            fprintf (stderr, "ERROR: the environment variable '%s' is not accepted\n", request->env[i]);
+            return 1;
+        }
+
+        setenv (request->env[i], equal + 1, 1);
+    }
+
+    return cook (request->argc, request->argv, warm);
+}
+
+static int is_forwarded (const char* name)
+{
+    const char* const names[] = PROTOCOL_ENVIRONMENT;
+
+    for (size_t i = 0; i < sizeof (names) / sizeof (names[0]); i++)
+        if (strcmp (name, names[i]) == 0)
+            return 1;
+
+    return 0;
+}
+
+static int send_response (int connection, int status, FILE* out, FILE* err)
+{
+    fflush (out);
+    fflush (err);
+
+    long out_size = (fseek (out, 0, SEEK_END) == 0) ? ftell (out) : 0;
+    long err_size = (fseek (err, 0, SEEK_END) == 0) ? ftell (err) : 0;
+
+    char header[64] = {};
+    int  length = snprintf (header, sizeof (header), "status %d %ld %ld\n", status, out_size, err_size);
+
+    return write_all_fd (connection, header, (size_t) length) != 0 ||
+           send_file (connection, out) != 0 ||
+           send_file (connection, err) != 0;
+}
+
+static int send_file (int connection, FILE* file)
+{
+    char chunk[COPY_CHUNK] = {};
+
+    rewind (file);
+
+    size_t got = 0;
+
+    while ((got = fread (chunk, 1, sizeof (chunk), file)) > 0)
+        if (write_all_fd (connection, chunk, got) != 0)
+            return 1;
+
+    return 0;
+}
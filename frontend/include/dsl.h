@@ -1,31 +1,31 @@
 #pragma once
 
-#define _ADD(left, right)   new_node (   OP,      ADD, (left), (right) )
-#define _SUB(left, right)   new_node (   OP,      SUB, (left), (right) )
-#define _MUL(left, right)   new_node (   OP,      MUL, (left), (right) )
-#define _POW(left, right)   new_node (   OP,      POW, (left), (right) )
-#define _DIV(left, right)   new_node (   OP,      DIV, (left), (right) )
-#define _SIN(arg)           new_node (   OP,      SIN,  (arg),    NULL )
-#define _COS(arg)           new_node (   OP,      COS,  (arg),    NULL )
-#define _LN(arg)            new_node (   OP,       LN,  (arg),    NULL )
-#define _NUM(value)         new_node (  NUM,  (value),   NULL,    NULL )
-#define _ID(value)          new_node (   ID,  (value),   NULL,    NULL )
-#define _EQL(left, right)   new_node (   OP,    EQUAL, (left), (right) )
-#define _GT(left, right)    new_node (   OP,       GT, (left), (right) )
-#define _LT(left, right)    new_node (   OP,       LT, (left), (right) )
-#define _GTE(left, right)   new_node (   OP,      GTE, (left), (right) )
-#define _NEQ(left, right)   new_node (   OP,      NEQ, (left), (right) )
-#define _EQ(left, right)    new_node (   OP,       EQ, (left), (right) )
-#define _IF(left, right)    new_node (   OP,       IF, (left), (right) )
-#define _WHILE(left, right) new_node (   OP,    WHILE, (left), (right) )
-#define _FUNC(value)        new_node ( FUNC,  (value),   NULL,    NULL )
+#define _ADD(left, right)   new_node (&context->nodes,    OP,      ADD, (left), (right) )
+#define _SUB(left, right)   new_node (&context->nodes,    OP,      SUB, (left), (right) )
+#define _MUL(left, right)   new_node (&context->nodes,    OP,      MUL, (left), (right) )
+#define _POW(left, right)   new_node (&context->nodes,    OP,      POW, (left), (right) )
+#define _DIV(left, right)   new_node (&context->nodes,    OP,      DIV, (left), (right) )
+#define _SIN(arg)           new_node (&context->nodes,    OP,      SIN,  (arg),    NULL )
+#define _COS(arg)           new_node (&context->nodes,    OP,      COS,  (arg),    NULL )
+#define _LN(arg)            new_node (&context->nodes,    OP,       LN,  (arg),    NULL )
+#define _NUM(value)         new_node (&context->nodes,   NUM,  (value),   NULL,    NULL )
+#define _ID(value)          new_node (&context->nodes,    ID,  (value),   NULL,    NULL )
+#define _EQL(left, right)   new_node (&context->nodes,    OP,    EQUAL, (left), (right) )
+#define _GT(left, right)    new_node (&context->nodes,    OP,       GT, (left), (right) )
+#define _LT(left, right)    new_node (&context->nodes,    OP,       LT, (left), (right) )
+#define _GTE(left, right)   new_node (&context->nodes,    OP,      GTE, (left), (right) )
+#define _NEQ(left, right)   new_node (&context->nodes,    OP,      NEQ, (left), (right) )
+#define _EQ(left, right)    new_node (&context->nodes,    OP,       EQ, (left), (right) )
+#define _IF(left, right)    new_node (&context->nodes,    OP,       IF, (left), (right) )
+#define _WHILE(left, right) new_node (&context->nodes,    OP,    WHILE, (left), (right) )
+#define _FUNC(value)        new_node (&context->nodes,  FUNC,  (value),   NULL,    NULL )
 
-#define _CALL(left, right)  new_node ( FUNC,     CALL, (left), (right) )
+#define _CALL(left, right)  new_node (&context->nodes,  FUNC,     CALL, (left), (right) )
 
-#define _DEF(left, right)   new_node ( FUNC,      DEF, (left), (right) )
+#define _DEF(left, right)   new_node (&context->nodes,  FUNC,      DEF, (left), (right) )
 
-#define _PRM(left, right)   new_node ( FUNC,    COMMA, (left), (right) )
+#define _PRM(left, right)   new_node (&context->nodes,  FUNC,    COMMA, (left), (right) )
 
-#define _OP(left, right)    new_node (   OP,     GLUE, (left), (right) )
+#define _OP(left, right)    new_node (&context->nodes,    OP,     GLUE, (left), (right) )
 
-#define _DEFGL(left, right) new_node ( FUNC,  FN_GLUE, (left), (right) )
+#define _DEFGL(left, right) new_node (&context->nodes,  FUNC,  FN_GLUE, (left), (right) )
@@ -0,0 +1,21 @@
+#pragma once
+
+// character classification for the lexer
+// each scan_* returns the first index >= i (and <= length) whose byte is NOT of the class;
+// the runs of a source are a few bytes long, so they go one byte at a time
+
+enum CharClass
+{
+    CHAR_SPACE    = 1,
+    CHAR_ALPHA    = 2,
+    CHAR_DIGIT    = 4,
+    CHAR_OPERATOR = 8
+};
+
+extern const unsigned char CHAR_CLASS[256];
+
+#define IS_CHAR(c, class) (CHAR_CLASS[(unsigned char) (c)] & (class))
+
+int scan_spaces (const char* string, int length, int i);
+int scan_alpha  (const char* string, int length, int i);
+int scan_digits (const char* string, int length, int i);
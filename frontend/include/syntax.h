@@ -4,4 +4,7 @@ struct Token_t;
 
 struct Node_t* GetGrammar (struct Context_t* context);
 
+// GetGrammar for a process that goes on after a syntax error: NULL instead of exit ()
+struct Node_t* parse_program (struct Context_t* context);
+
 [[noreturn]] void SyntaxError (struct Context_t* context, const char* filename, const char* func, int line, int error);
@@ -3,7 +3,7 @@
 #include "struct.h"
 #include "keywords.h"
 
-enum Errors
+enum SyntaxErrors
 {
     NOT_FIND_END_OF_FILE            =   1,
     NOT_FIND_GLUE_MARK              =   2,
@@ -16,12 +16,8 @@ enum Errors
     THIS_NAME_EXIST                 = 256
 };
 
-int name_table_dump (FILE* file, struct Context_t* context);
-
 int tokenization (struct Context_t* context, const char* string);
 
-int find_number_of_keyword (struct Context_t* context, const char* str, int length);
-
 int tokens_dump (struct Context_t* context);
 
 int skip_spaces (const char* string, int length, int current_i);
@@ -0,0 +1,9 @@
+#pragma once
+
+#define MAX_THREADS 64
+
+// parses every source as its own translation unit on a pool of 'threads' workers,
+// unit 'dir/name.cook' is written to 'middle_end/name.AST_tree.bin', or with 'text'
+// to 'middle_end/name.AST_tree.txt' and 'middle_end/name.Name_Table.txt', all of them under
+// the work directory if one is set
+int compile_units (const char* sources[], int count, int threads, int text);
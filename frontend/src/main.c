@@ -1,45 +1,154 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
 
 #include "log.h"
 #include "tree.h"
 #include "tokens.h"
 #include "syntax.h"
 #include "buffer.h"
+#include "units.h"
+#include "tree_bin.h"
+#include "work_dir.h"
+#include "time_report.h"
+
+#define TREE_FILENAME     "middle_end/AST_tree.txt"
+#define NAME_T_FILENAME   "middle_end/Name_Table.txt"
+#define BINARY_FILENAME   "middle_end/AST_tree.bin"
+#define LOG_FILENAME      "log/TreeGraph.html"
 
 int main (int argc, const char* argv[])
 {
-    if (argc < 2)
+    int threads = 0;                // 0 = one per online CPU
+    int text    = 0;                // text AST and name table instead of the binary file
+    int first   = 1;
+
+    const char* output   = NULL;    // binary AST, instead of the one in the work directory
+    const char* work_dir = NULL;
+
+    struct TimeReport_t report = {};
+
+    for (; first < argc && argv[first][0] == '-'; first++)
+    {
+        if (strcmp (argv[first], "-j") == 0 && first + 1 < argc)
+            threads = atoi (argv[++first]);
+        else if (strcmp (argv[first], "--text") == 0)
+            text = 1;
+        else if (strcmp (argv[first], "-o") == 0 && first + 1 < argc)
+            output = argv[++first];
+        else if (strcmp (argv[first], "--workdir") == 0 && first + 1 < argc)
+            work_dir = argv[++first];
+        else if (!time_report_option (&report, argv[first]) && !graph_log_option (argv[first]))
+            break;
+    }
+
+    // one -o names one binary AST
+    if (argc - first < 1 || (output != NULL && (text || argc - first > 1)))
     {
-        fprintf (stderr, "Usage: %s <program.txt>\n", argv[0]);
+        fprintf (stderr, "Usage: %s [-j threads] [--text] [--workdir <dir>] [-o <ast.bin>] [--time-report[=json]] [--graph[=svg]] <program.cook> [more.cook...]\n", argv[0]);
         return 1;
     }
 
-    const char* program_file = argv[1];
+    if (set_work_dir (work_dir) != 0)
+        return 1;
+
+    // several sources are independent translation units, parsed in parallel
+    if (argc - first > 1)
+        return compile_units (&argv[first], argc - first, threads, text);
+
+    const char* program_file = argv[first];
 
-    FILE* LogFile = open_log_file ("log/TreeGraph.html");
+    char tree_path  [PATH_MAX] = {};
+    char names_path [PATH_MAX] = {};
+    char binary_path[PATH_MAX] = {};
+    char log_path   [PATH_MAX] = {};
+
+    if ((text  && (work_path (tree_path,  sizeof (tree_path),  TREE_FILENAME)   == NULL ||
+                   work_path (names_path, sizeof (names_path), NAME_T_FILENAME) == NULL)) ||
+        (!text && output == NULL && work_path (binary_path, sizeof (binary_path), BINARY_FILENAME) == NULL))
+        return 1;
+
+    if (output == NULL)
+        output = binary_path;
+
+    // the log and the graphs are only written on request
+    FILE* LogFile = NULL;
+
+    if (graph_log_mode () != GRAPH_LOG_OFF)
+    {
+        if (work_path (log_path, sizeof (log_path), LOG_FILENAME) == NULL)
+            return 1;
+
+        LogFile = open_log_file (log_path);
+    }
 
     struct  Buffer_t  buffer = {};
     struct Context_t context = {};
 
-    ctor_keywords (&context);
+    if (ctor_keywords (&context) != 0)
+    {
+        dtor_keywords (&context);
+        close_log_file (LogFile);
+        return 1;
+    }
+
+    phase_begin (&report, "read source");
 
     const char* string = file_reader (&buffer, program_file);
 
+    phase_end (&report, -1, -1, buffer.file_size);
+
+    if (string == NULL)
+    {
+        dtor_keywords (&context);
+        close_log_file (LogFile);
+        return 1;
+    }
+
+    phase_begin (&report, "tokenization");
+
     int error = tokenization (&context, string);
 
+    phase_end (&report, -1, -1, -1);
+
     if (error != 0)
+    {
+        dtor_keywords (&context);
+        buffer_dtor (&buffer);
+        close_log_file (LogFile);
         return 1;
+    }
+
+    phase_begin (&report, "GetGrammar");
 
     struct Node_t* root = GetGrammar (&context);
 
+    phase_end   (&report, phase_nodes (&report, &context.nodes, root), -1, -1);
+    phase_begin (&report, "graph dump");
+
     dump_in_log_file (root, &context, "TEST OF PROGRAMM");
 
-    write_ast_file (root, &context, "middle_end/AST_tree.txt", 0);
-    write_name_table_file (&context, "middle_end/Name_Table.txt");
+    phase_end   (&report, -1, -1, -1);
+    phase_begin (&report, "write AST");
+
+    if (text)
+        error = write_ast_file        (root, &context, tree_path, 0) ||
+                write_name_table_file (&context, names_path);
+    else
+        error = write_binary_ast (root, &context, output);
+
+    phase_end (&report, -1, -1, text ? file_bytes (tree_path) + file_bytes (names_path) : file_bytes (output));
+
+    time_report_print (&report, stderr, "frontend");
+
+#ifdef DEBUG
+    node_pool_dump (stderr, &context.nodes, "frontend");
+#endif
 
-    delete_sub_tree (root);
+    dtor_keywords (&context);
     buffer_dtor (&buffer);
     close_log_file (LogFile);
 
-    return 0;
+    return error;
 }
@@ -0,0 +1,42 @@
+#include "scan.h"
+
+// same classes as isspace / isalpha / isdigit in the "C" locale
+const unsigned char CHAR_CLASS[256] =
+{
+    ['\t'] = CHAR_SPACE, ['\n'] = CHAR_SPACE, ['\v'] = CHAR_SPACE,
+    ['\f'] = CHAR_SPACE, ['\r'] = CHAR_SPACE, [' ']  = CHAR_SPACE,
+
+    ['a' ... 'z'] = CHAR_ALPHA,
+    ['A' ... 'Z'] = CHAR_ALPHA,
+    ['0' ... '9'] = CHAR_DIGIT,
+
+    ['+'] = CHAR_OPERATOR, ['-'] = CHAR_OPERATOR, ['*'] = CHAR_OPERATOR,
+    ['/'] = CHAR_OPERATOR, ['^'] = CHAR_OPERATOR, ['('] = CHAR_OPERATOR,
+    [')'] = CHAR_OPERATOR, ['='] = CHAR_OPERATOR, ['{'] = CHAR_OPERATOR,
+    ['}'] = CHAR_OPERATOR, [','] = CHAR_OPERATOR, ['<'] = CHAR_OPERATOR,
+    ['>'] = CHAR_OPERATOR
+};
+
+int scan_spaces (const char* string, int length, int i)
+{
+    while (i < length && IS_CHAR (string[i], CHAR_SPACE))
+        i++;
+
+    return i;
+}
+
+int scan_alpha (const char* string, int length, int i)
+{
+    while (i < length && IS_CHAR (string[i], CHAR_ALPHA))
+        i++;
+
+    return i;
+}
+
+int scan_digits (const char* string, int length, int i)
+{
+    while (i < length && IS_CHAR (string[i], CHAR_DIGIT))
+        i++;
+
+    return i;
+}
@@ -1,5 +1,7 @@
 #include <stdio.h>
+#include <inttypes.h>
 #include <stdlib.h>
+#include <setjmp.h>
 
 #include "color.h"
 #include "dsl.h"
@@ -10,10 +12,7 @@
 #include "syntax.h"
 #include "assert.h"
 
-#pragma GCC diagnostic ignored "-Wfloat-equal"
-int Position =  0;
-
-#define MOVE_POSITION Position++
+#define MOVE_POSITION context->position++
 
 // ========================================= GRAMMAR ========================================= //
 //    Grammar                   ::= { FunctionDef }* '$'
@@ -59,18 +58,55 @@ void local_variable_offset_counter (struct Context_t* context);
 
 //======================== DSL FOR CURRENT TOKEN && NAME TABLE ACCESS =======================//
 
-#define _CUR_TOKEN  ( context->token[Position]     )
-#define _NEXT_TOKEN ( context->token[Position + 1] )
+#define _CUR_TOKEN  ( context->token[context->position]     )
+#define _NEXT_TOKEN ( context->token[context->position + 1] )
 
 #define _IS_OP(val) ( _CUR_TOKEN.type  == OP && \
                       _CUR_TOKEN.value == (val) )
 
-#define _CUR_NAME   ( context->name_table[ (int) _CUR_TOKEN.value ].name )
+// the type is checked too: an identifier or a number can have the value of an operator
+#define _IS_NEXT_OP(val) ( _NEXT_TOKEN.type  == OP && \
+                           _NEXT_TOKEN.value == (val) )
+
+#define _CUR_NAME   ( *current_name (context) )
 
 // CURR.type ; CURR.name ????
 
 //===========================================================================================//
 
+// only ID tokens index the name table: NUM and OP values are not positions in it,
+// for them a blank name is returned (writes to it are dropped)
+static struct Name_t* current_name (struct Context_t* context)
+{
+    if (_CUR_TOKEN.type != ID)
+    {
+        context->blank_name = (struct Name_t) {};
+        return &context->blank_name;
+    }
+
+    return &context->name_table[ (int) _CUR_TOKEN.value ].name;
+}
+
+// a syntax error returns here instead of ending the process
+struct Node_t* parse_program (struct Context_t* context)
+{
+    jmp_buf on_error;
+
+    context->syntax_error = &on_error;
+
+    if (setjmp (on_error) != 0)
+    {
+        context->syntax_error = NULL;
+        return NULL;
+    }
+
+    struct Node_t* root = GetGrammar (context);
+
+    context->syntax_error = NULL;
+
+    return root;
+}
+
 struct Node_t* GetGrammar (struct Context_t* context)
 {
     struct Node_t* node = GetFunctionDef (context);
@@ -85,7 +121,7 @@ struct Node_t* GetGrammar (struct Context_t* context)
 
         struct Node_t* right_node = _DEFGL (node, NULL);
 
-        link->right = right_node;
+        set_right (&context->nodes, link, right_node);
 
         link = right_node;
     }
@@ -117,9 +153,9 @@ static struct Node_t* GetFunctionDef (struct Context_t* context)
     struct Node_t* node       = NULL;
     struct Node_t* node_param = NULL;
 
-    // current Position is token with function name
+    // current position is token with function name
     if ( _CUR_TOKEN.type   == ID &&
-         _NEXT_TOKEN.value == OP_BR )
+         _IS_NEXT_OP (OP_BR) )
     {
         node = _FUNC (_CUR_TOKEN.value);
 
@@ -152,26 +188,19 @@ static struct Node_t* GetFunctionDef (struct Context_t* context)
     return _DEF (func_name, func_body);
 }
 
+// numbers locals and parameters in the order of the name table, restarting at every function name
 void local_variable_offset_counter (struct Context_t* context)
 {
     int count = 0;
 
     for (int i = 0; i < context->table_size; i++)
     {
-        if (context->name_table[i].name.is_keyword == 0 && context->name_table[i].name.id_type == 0)
-        {
-            for (int j = i; j < context->table_size; j++)
-            {
-                if ( context->name_table[j].name.id_type == 6 ||                                       // 20 - name table code of 'main' func
-                   ( context->name_table[j].name.id_type == 5 && context->name_table[j].name.host_func != 20 ) )
-                {
-                    context->name_table[j].name.offset = count;
-                    count++;
-                }
-            }
+        struct Name_t* name = &context->name_table[i].name;
 
+        if (name->is_keyword == 0 && name->id_type == 0)
             count = 0;
-        }
+        else if (name->id_type == LOCL || name->id_type == PARM)
+            name->offset = count++;
     }
 }
 
@@ -181,7 +210,7 @@ static struct Node_t* GetFunctionCall (struct Context_t* context)
     struct Node_t* node_param = NULL;
 
     if ( _CUR_TOKEN.type   == ID &&
-         _NEXT_TOKEN.value == OP_BR )
+         _IS_NEXT_OP (OP_BR) )
     {
         node = _FUNC (_CUR_TOKEN.value);
 
@@ -224,14 +253,14 @@ struct Node_t* GetOperation (struct Context_t* context)
 struct Node_t* GetAssignment (struct Context_t* context)
 {
 #ifdef DEBUG
-    fprintf (stderr, "\nin GetA starting (Pos = %d): cur: type = %d, value = %lg" "\n" "next: type = %d, value = %lg\n\n", Position,
+    fprintf (stderr, "\nin GetA starting (Pos = %d): cur: type = %d, value = %" PRId64 "\n" "next: type = %d, value = %" PRId64 "\n\n", context->position,
                        _CUR_TOKEN.type,  _CUR_TOKEN.value,
                       _NEXT_TOKEN.type, _NEXT_TOKEN.value );
 #endif
 
     struct Node_t* val_1 = NULL;
 
-    if ( _NEXT_TOKEN.value != OP_BR )
+    if ( !_IS_NEXT_OP (OP_BR) )
     {
         if ( _IS_OP (ADVT) )
         {
@@ -246,14 +275,14 @@ struct Node_t* GetAssignment (struct Context_t* context)
             context->name_table[context->curr_host_func].name.counter_locals++;
 
 #ifdef DEBUG
-            fprintf (stderr, "\nvalue = %lg", val_1->value);
+            fprintf (stderr, "\nvalue = %" PRId64, val_1->value);
             fprintf (stderr, "\nname = '%s'\n", context->name_table[context->name_table[(int)val_1->value].name.host_func].name.str_pointer);
 #endif
         }
         else
         {
 #ifdef DEBUG
-            fprintf (stderr, "\nPosition = %d; token_value = %lg >>> added_status = %d, is_keyword = %d\n", Position, _CUR_TOKEN.value, _CUR_NAME.added_status, _CUR_NAME.is_keyword);
+            fprintf (stderr, "\nPosition = %d; token_value = %" PRId64 " >>> added_status = %d, is_keyword = %d\n", context->position, _CUR_TOKEN.value, _CUR_NAME.added_status, _CUR_NAME.is_keyword);
 #endif
 
             if ( ( _CUR_TOKEN.type        == ID &&
@@ -346,7 +375,7 @@ static struct Node_t* GetP (struct Context_t* context)
         {
             struct Node_t* node_F = GetFunctionCall (context);
 
-            log_printf ("\n" "Im IN GetP" "\n" "CURRENT TOKEN TYPE = %d, VALUE = '%c' (%lg)",
+            log_printf ("\n" "Im IN GetP" "\n" "CURRENT TOKEN TYPE = %d, VALUE = '%c' (%" PRId64 ")",
                          _CUR_TOKEN.type, (int)_CUR_TOKEN.value, _CUR_TOKEN.value);
 
             if (node_F != NULL)
@@ -362,7 +391,7 @@ static struct Node_t* GetIdent (struct Context_t* context)
     struct Node_t* node = NULL;
 
     if ( _CUR_TOKEN.type   == ID &&
-         _NEXT_TOKEN.value != OP_BR)
+         !_IS_NEXT_OP (OP_BR))
     {
         if (_CUR_NAME.added_status == 0)
             SyntaxError (context, __FILE__, __FUNCTION__, __LINE__, UNDECLARED);
@@ -370,7 +399,7 @@ static struct Node_t* GetIdent (struct Context_t* context)
         node = _ID (_CUR_TOKEN.value);
 
 #ifdef DEBUG
-        fprintf (stderr, "\nnode [%p]: node->value = %lg\n", node, node->value);
+        fprintf (stderr, "\nnode [%p]: node->value = %" PRId64 "\n", node, node->value);
 #endif
 
         MOVE_POSITION;
@@ -496,7 +525,7 @@ static struct Node_t* CompoundOperations (struct Context_t* context)
 
             struct Node_t* right_node = _OP  (node, NULL);
 
-            link->right = right_node;
+            set_right (&context->nodes, link, right_node);
 
             link = right_node;
         }
@@ -530,7 +559,7 @@ static struct Node_t* CompoundParametersForCall (struct Context_t* context)
 
             struct Node_t* right_node = _PRM  (node, NULL);
 
-            link->right = right_node;
+            set_right (&context->nodes, link, right_node);
 
             link = right_node;
 
@@ -555,7 +584,7 @@ static struct Node_t* CompoundParametersForDef (struct Context_t* context)
     else
     {
 #ifdef DEBUG
-        fprintf (stderr, "\nPosition = %d; token_value = %lg >>> added_status = %d, is_keyword = %d\n", Position, _CUR_TOKEN.value, _CUR_NAME.added_status, _CUR_NAME.is_keyword);
+        fprintf (stderr, "\nPosition = %d; token_value = %" PRId64 " >>> added_status = %d, is_keyword = %d\n", context->position, _CUR_TOKEN.value, _CUR_NAME.added_status, _CUR_NAME.is_keyword);
 #endif
 
         if ( _CUR_TOKEN.type == ID &&
@@ -598,7 +627,7 @@ static struct Node_t* CompoundParametersForDef (struct Context_t* context)
 
             struct Node_t* right_node = _PRM  (node, NULL);
 
-            link->right = right_node;
+            set_right (&context->nodes, link, right_node);
 
             link = right_node;
 
@@ -614,24 +643,24 @@ static struct Node_t* CompoundParametersForDef (struct Context_t* context)
 
 [[noreturn]] void SyntaxError (struct Context_t* context, const char* filename, const char* func, int line, int error)
 {
-    fprintf (stderr, "\n" PURPLE_TEXT("%s: %s:%d: ") RED_TEXT("SYNTAX ERROR (code = %d) in %d position: "), filename, func, line, error, Position);
+    fprintf (stderr, "\n" PURPLE_TEXT("%s: %s:%d: ") RED_TEXT("SYNTAX ERROR (code = %d) in %d position: "), filename, func, line, error, context->position);
 
     switch (error)
     {
         case NOT_FIND_END_OF_FILE:
-            fprintf (stderr, "expected " WHITE_TEXT("'$'") " after %s\n", context->token[Position - 1].str);
+            fprintf (stderr, "expected " WHITE_TEXT("'$'") " after %s\n", context->token[context->position - 1].str);
 
             break;
 
         case NOT_FIND_GLUE_MARK:
-            if (context->token[Position - 1].type == NUM)
-                fprintf (stderr, "expected " WHITE_TEXT("'shutup'") " after " WHITE_TEXT("'%lg'")   "\n",       context->token[Position - 1].value);
-            if (context->token[Position - 1].type == OP)
-                fprintf (stderr, "expected " WHITE_TEXT("'shutup'") " after " WHITE_TEXT("'%c'")    "\n", (int) context->token[Position - 1].value);
-            if (context->token[Position - 1].type == ID)
+            if (context->token[context->position - 1].type == NUM)
+                fprintf (stderr, "expected " WHITE_TEXT("'shutup'") " after " WHITE_TEXT("'%" PRId64 "'") "\n",       context->token[context->position - 1].value);
+            if (context->token[context->position - 1].type == OP)
+                fprintf (stderr, "expected " WHITE_TEXT("'shutup'") " after " WHITE_TEXT("'%c'")    "\n", (int) context->token[context->position - 1].value);
+            if (context->token[context->position - 1].type == ID)
                 fprintf (stderr, "expected " WHITE_TEXT("'shutup'") " after " WHITE_TEXT("'%.*s'")  "\n",
-                                 (int) context->name_table[(int)context->token[Position - 1].value].name.length,
-                                       context->name_table[(int)context->token[Position - 1].value].name.str_pointer);
+                                 (int) context->name_table[(int)context->token[context->position - 1].value].name.length,
+                                       context->name_table[(int)context->token[context->position - 1].value].name.str_pointer);
 
             break;
 
@@ -644,7 +673,7 @@ static struct Node_t* CompoundParametersForDef (struct Context_t* context)
 
         case NOT_FIND_OPEN_BRACE:
             fprintf (stderr, "expected " WHITE_TEXT("'('") " before " WHITE_TEXT("'%s'")  "\n",
-                             ( (int) context->token[Position - 1].value == 'w') ? "grinding" : "forreal" );
+                             ( (int) context->token[context->position - 1].value == 'w') ? "grinding" : "forreal" );
 
             break;
 
@@ -657,18 +686,21 @@ static struct Node_t* CompoundParametersForDef (struct Context_t* context)
             fprintf (stderr, "Unknown error\n");
     }
 
+    if (context->syntax_error != NULL)
+        longjmp (*context->syntax_error, error);
+
     exit (1);
 }
 
 void dump_token (struct Context_t* context, int numb_of_token)
 {
-    fprintf (stderr, "\n" "Token number %d: token type = %d, token_value = '%c' (%lg), str = '%.20s'" "\n",
-                      Position + numb_of_token, context->token[Position + numb_of_token].type,
-                      (int) context->token[Position + numb_of_token].value, context->token[Position + numb_of_token].value,
-                            context->token[Position + numb_of_token].str );
-
-    log_printf ("\n" "Token number %d: token type = %d, token_value = '%c' (%lg), str = '%.20s'" "\n",
-                      Position + numb_of_token, context->token[Position + numb_of_token].type,
-                      (int) context->token[Position + numb_of_token].value, context->token[Position + numb_of_token].value,
-                            context->token[Position + numb_of_token].str );
+    fprintf (stderr, "\n" "Token number %d: token type = %d, token_value = '%c' (%" PRId64 "), str = '%.20s'" "\n",
+                      context->position + numb_of_token, context->token[context->position + numb_of_token].type,
+                      (int) context->token[context->position + numb_of_token].value, context->token[context->position + numb_of_token].value,
+                            context->token[context->position + numb_of_token].str );
+
+    log_printf ("\n" "Token number %d: token type = %d, token_value = '%c' (%" PRId64 "), str = '%.20s'" "\n",
+                      context->position + numb_of_token, context->token[context->position + numb_of_token].type,
+                      (int) context->token[context->position + numb_of_token].value, context->token[context->position + numb_of_token].value,
+                            context->token[context->position + numb_of_token].str );
 }
@@ -1,16 +1,19 @@
 #include <stdio.h>
+#include <inttypes.h>
 #include <sys/io.h>
 #include <stdlib.h>
-#include <ctype.h>
 #include <string.h>
 
 #include "enum.h"
 #include "keywords.h"
 #include "tokens.h"
+#include "scan.h"
 #include "syntax.h"
 #include "assert.h"
 #include "color.h"
 
+static int add_token (struct Context_t* context, int type, int64_t value, const char* str);
+
 int tokenization (struct Context_t* context, const char* string)
 {
     assert (context);
@@ -20,123 +23,123 @@ int tokenization (struct Context_t* context, const char* string)
 
     int i = 0;
 
-    int count_tokens  = 0;
+    context->token_count = 0;
 
-    while (string[i] != '$')
+    while (1)
     {
         i = skip_spaces (string, length_string, i);
 
+        if (i >= length_string)
+        {
+            fprintf (stderr, "ERROR: program must end with '$'\n");
+            return 1;
+        }
+
+        if (string[i] == '$')
+            break;
+
         int start_i = i;
+        int error = 0;
 
-        if ( isalpha(string[i]) )
+        if ( IS_CHAR (string[i], CHAR_ALPHA) )
         {
-            while ( isalpha(string[i]) )
-                i++;
+            i = scan_alpha (string, length_string, i);
 
             int end_i = i;
 
             int length = end_i - start_i;
 
-            double value = find_name (context, &string[start_i], length);
-
-            int num_keyword = find_number_of_keyword (context, &string[start_i], length);
+            int code = classify_keyword (&string[start_i], length);
 
-            if ( (int) value != -1 && num_keyword > 0 && context->name_table[num_keyword].name.is_keyword == 1)
-            {
-                context->token[count_tokens].type   = OP;
-                context->token[count_tokens].value  = value;
-                context->token[count_tokens].str    = &string[start_i];
-
-                count_tokens++;
-            }
+            if (code != -1)
+                error = add_token (context, OP, code, &string[start_i]);
             else
             {
+                int num_keyword = find_symbol_id (context, &string[start_i], length);
+
                 if (num_keyword == -1)
                 {
-                    add_struct_in_keywords (context, &string[start_i], (enum Operations) ID, 0, length, 0);
-
-                    context->token[count_tokens].type  = ID;
-                    context->token[count_tokens].value = context->table_size - 1; // before 'add_struct' table_size was table_size - 1
-                    context->token[count_tokens].str   = &string[start_i];
+                    error = add_struct_in_keywords (context, &string[start_i], (enum Operations) ID, 0, length, 0);
 
-                    count_tokens++;
+                    num_keyword = context->table_size - 1; // before 'add_struct' table_size was table_size - 1
                 }
-                else
-                {
-                    context->token[count_tokens].type  = ID;
-                    context->token[count_tokens].value = num_keyword;
-                    context->token[count_tokens].str   = &string[start_i];
 
-                    count_tokens++;
-                }
+                if (error == 0)
+                    error = add_token (context, ID, num_keyword, &string[start_i]);
             }
-
-            continue;
         }
-
-        if ( isdigit (string[i]) )
+        else if ( IS_CHAR (string[i], CHAR_DIGIT) )
         {
-            int val = 0;
+            i = scan_digits (string, length_string, i);
+
+            int64_t val = 0;
 
-            while ('0' <= string[i] && string[i] <= '9')
+            for (int digit = start_i; digit < i; digit++)
             {
-                val = val * 10 + string[i] - '0';
-                i++;
-            }
+                int64_t next = string[digit] - '0';
 
-            context->token[count_tokens].type  = NUM;
-            context->token[count_tokens].value = val;
-            context->token[count_tokens].str   = &string[start_i];
+                if (val > (INT64_MAX - next) / 10)
+                {
+                    fprintf (stderr, "ERROR: number '%.*s' does not fit in 64 bits\n", i - start_i, &string[start_i]);
+                    return 1;
+                }
 
-            count_tokens++;
+                val = val * 10 + next;
+            }
 
-            continue;
+            error = add_token (context, NUM, val, &string[start_i]);
         }
-
-        if (strchr ("+-*/^()={},<>", string[i]) != NULL)
+        else if ( IS_CHAR (string[i], CHAR_OPERATOR) )
         {
-            int value = find_name (context, &string[start_i], 1);
-
-            context->token[count_tokens].type  = OP;
-            context->token[count_tokens].value = value;
-            context->token[count_tokens].str   = &string[start_i];
-
-            count_tokens++;
+            error = add_token (context, OP, classify_keyword (&string[start_i], 1), &string[start_i]);
             i++;
         }
-    }
-
-    context->token[count_tokens].type  =  OP;
-    context->token[count_tokens].value = '$';
+        else
+        {
+            fprintf (stderr, "ERROR: unknown symbol '%c' at position %d\n", string[i], i);
+            return 1;
+        }
 
-    count_tokens++;
+        if (error != 0)
+            return 1;
+    }
 
-    return 0;
+    return add_token (context, OP, '$', &string[i]);
 }
 
-int find_number_of_keyword (struct Context_t* context, const char* str, int length)
+// appends a token to the growing vector; one zeroed token always stays
+// after the last one, so looking one token ahead of '$' is safe
+static int add_token (struct Context_t* context, int type, int64_t value, const char* str)
 {
-    for (int i = 0; i < context->table_size; i++)
-        if ( context->name_table[i].name.length == length &&
-             strncmp (str, context->name_table[i].name.str_pointer, (size_t) length) == 0 )
-            return i;
+    if (context->token_count + 2 > context->token_capacity)
+    {
+        int capacity = (context->token_capacity != 0) ? 2 * context->token_capacity : TOKENS_START;
 
-    return -1;
-}
+        struct Token_t* token = (struct Token_t*) arena_grow (&context->arena, context->token,
+                                                              (size_t) context->token_capacity * sizeof (*token),
+                                                              (size_t)                capacity * sizeof (*token));
+        if (token == NULL)
+        {
+            fprintf (stderr, "ERROR: could not grow token vector to %d tokens\n", capacity);
+            return 1;
+        }
 
-int skip_spaces (const char* string, int length, int current_i)
-{
-    int i = current_i;
+        context->token          = token;
+        context->token_capacity = capacity;
+    }
 
-    while (i < length)
-    {
-        if ( !isspace(string[i]) )
-            break;
+    struct Token_t* token = &context->token[context->token_count++];
 
-        i++;
-    }
+    token->type  = type;
+    token->value = value;
+    token->str   = str;
+
+    return 0;
+}
 
-    return i;
+int skip_spaces (const char* string, int length, int current_i)
+{
+    return scan_spaces (string, length, current_i);
 }
 
 int tokens_dump (struct Context_t* context)
@@ -149,26 +152,26 @@ int tokens_dump (struct Context_t* context)
 
     int j = 0;
 
-    while (context->token[j].type != 0)
+    while (j < context->token_count)
     {
         switch (context->token[j].type)
         {
             case OP:
-                fprintf (stderr, BLUE_TEXT("[%.2d] ") "token_type = OP  ||| ADDRESS = [%p] ||| token_value = '%c' (%lg)\n",
-                                 j, context[j].token, (int) context->token[j].value, context->token[j].value);
+                fprintf (stderr, BLUE_TEXT("[%.2d] ") "token_type = OP  ||| ADDRESS = [%p] ||| token_value = '%c' (%" PRId64 ")\n",
+                                 j, &context->token[j], (int) context->token[j].value, context->token[j].value);
                 break;
 
             case NUM:
-                fprintf (stderr, BLUE_TEXT("[%.2d] ") "token_type = NUM ||| ADDRESS = [%p] ||| token_value = %lg\n",
-                                 j, context[j].token, context->token[j].value);
+                fprintf (stderr, BLUE_TEXT("[%.2d] ") "token_type = NUM ||| ADDRESS = [%p] ||| token_value = %" PRId64 "\n",
+                                 j, &context->token[j], context->token[j].value);
                 break;
 
             case ID:
-                fprintf (stderr, BLUE_TEXT("[%.2d] ") GREEN_TEXT("token_type = ID  ||| ADDRESS = [%p] ||| token_value = ") BLUE_TEXT("[%lg]\n"),
-                                 j, context[j].token, context->token[j].value);
+                fprintf (stderr, BLUE_TEXT("[%.2d] ") GREEN_TEXT("token_type = ID  ||| ADDRESS = [%p] ||| token_value = ") BLUE_TEXT("[%" PRId64 "]\n"),
+                                 j, &context->token[j], context->token[j].value);
 
                 fprintf (stderr, GREEN_TEXT ("     ADDRESS = [%p], name = '%.*s', length = %d, is_keyword = %d\n\n"),
-                                 context[(int)context->token[j].value].name_table,
+                                 &context->name_table[(int)context->token[j].value],
                                  context->name_table[(int)context->token[j].value].name.length,
                                  context->name_table[(int)context->token[j].value].name.str_pointer,
                                  context->name_table[(int)context->token[j].value].name.length,
@@ -184,79 +187,3 @@ int tokens_dump (struct Context_t* context)
     }
     return 0;
 }
-
-int name_table_dump (FILE* file, struct Context_t* context)
-{
-    if (context == NULL)
-    {
-        fprintf (file, "context is NULL\n");
-        return 1;
-    }
-
-    // NOTE - istty (fileno(file));
-
-    int j = 0;
-    char* str = "";
-
-    if (file != stderr)
-    {
-        str = ";";
-
-        int i = 0;
-        while (i < context->table_size)
-        {
-            if (context->name_table[i].name.code == SPACE)
-                break;
-
-            i++;
-        }
-
-        j = i + 1;
-    }
-
-    while ( context->name_table[j].name.str_pointer != NULL)
-    {
-        if (context->name_table[j].name.code == SPACE)
-            fprintf (file,  "\n" "%s" YELLOW_TEXT("[%.2d]: ADDRESS = [%p], name = '%.*s'") "\n\n",
-                            str, j, context[j].name_table,
-                              (int) context->name_table[j].name.length,
-                                    context->name_table[j].name.str_pointer);
-        else
-        {
-            if (file == stderr)
-                fprintf (file,  "%s" "[%.2d]: " "ADDRESS = [%p], name = '%.*s', length = %d, is_keyword = %d, added_status = %d"
-                                "\n" "%s" "id_type = %d, host_func = %d, counter_params = %d, counter_locals = %d, offset = %d\n\n",
-                                str, j, context[j].name_table,
-                                        context->name_table[j].name.length,
-                                        context->name_table[j].name.str_pointer,
-                                        context->name_table[j].name.length,
-                                        context->name_table[j].name.is_keyword,
-                                        context->name_table[j].name.added_status,
-                                str,    context->name_table[j].name.id_type,
-                                        context->name_table[j].name.host_func,
-                                        context->name_table[j].name.counter_params,
-                                        context->name_table[j].name.counter_locals,
-                                        context->name_table[j].name.offset);
-            else // dump for asm file
-                fprintf (file,  "%s" "[%.2d]: " "ADDRESS = [%p], name = '%.*s', %*s lngth = %d, keywrd = %d, added_stts = %d "
-                                "id_type = %d, host_fnc = %02d, cntr_prms = %d, cntr_lcls = %d, offset = %d\n",
-                                str, j, context[j].name_table,
-                                        context->name_table[j].name.length,
-                                        context->name_table[j].name.str_pointer,
-                                    5 - context->name_table[j].name.length, "",
-                                        context->name_table[j].name.length,
-                                        context->name_table[j].name.is_keyword,
-                                        context->name_table[j].name.added_status,
-                                        context->name_table[j].name.id_type,
-                                        context->name_table[j].name.host_func,
-                                        context->name_table[j].name.counter_params,
-                                        context->name_table[j].name.counter_locals,
-                                        context->name_table[j].name.offset);
-        }
-
-        j++;
-    }
-
-    return 0;
-}
-
@@ -1,16 +1,20 @@
 //#define DEBUG
 
 #include <stdio.h>
+#include <inttypes.h>
 #include <assert.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdarg.h>
+#include <limits.h>
+#include <unistd.h>
 
 #include "log.h"
 #include "tree.h"
 #include "enum.h"
 #include "tokens.h"
 #include "color.h"
+#include "work_dir.h"
 
 #define MAX_WORD 100
 
@@ -20,71 +24,25 @@
     #define ON_DBG(...)
 #endif
 
-struct Node_t* new_node (int type, double value, struct Node_t* node_left, struct Node_t* node_right)
+struct Node_t* new_node (struct NodePool_t* pool, int type, int64_t value, struct Node_t* node_left, struct Node_t* node_right)
 {
-    struct Node_t* node = (struct Node_t*) calloc (1, sizeof(*node));
+    struct Node_t* node = node_pool_alloc (pool);
     if (node == NULL)
     {
         fprintf (stderr, "node is NULL after creating");
         assert (0);
     }
 
-    node->type  = type;
+    set_type (pool, node, type);
     node->value = value;
 
-    node->left  = node_left;
-    node->right = node_right;
+    set_left  (pool, node, node_left);
+    set_right (pool, node, node_right);
 
     return node;
 }
 
-int delete_sub_tree (struct Node_t* node)
-{
-    if (node->left)  delete_sub_tree (node->left);
-    if (node->right) delete_sub_tree (node->right);
-
-    delete_node (node);
-
-    return 0;
-}
-
-int delete_node (struct Node_t* node)
-{
-    if (node == NULL)
-        fprintf (stderr, "IN DELETE: node = NULL\n");
-
-    node->type  = 666;
-    node->value = 0;
-
-    node->left  = NULL;
-    node->right = NULL;
-
-    free (node);
-
-    return 0;
-}
-
-int buffer_dtor (struct Buffer_t* buffer)
-{
-    buffer->current_ptr = NULL;
-
-    free (buffer->buffer_ptr);
-
-    return 0;
-}
-
-int destructor (struct Node_t* node, struct Buffer_t* buffer)
-{
-    assert (node);
-    assert (buffer);
-
-    delete_sub_tree (node);
-    buffer_dtor (buffer);
-
-    return 0;
-}
-
-const char* get_name (double enum_value)
+const char* get_name (int64_t enum_value)
 {
     switch ( (enum Operations) enum_value)
     {
@@ -141,84 +99,96 @@ void print_tree_preorder_for_file (struct Node_t* node, struct Context_t* contex
     assert (node);
     assert (filename);
 
-    assert (node->type == NUM || node->type == OP || node->type == ID || node->type == FUNC);
+    const struct NodePool_t* pool = &context->nodes;
+
+    int type = node_type (pool, node);
 
-    if (node && node->type == NUM)
-        fprintf (filename, "node%p [shape=Mrecord; label = \" { type = %d (NUM)  | value = '' %g '' }\"; style = filled; fillcolor = \"#FFD700\"];\n",
-                 node, node->type, node->value);
+    assert (type == NUM || type == OP || type == ID || type == FUNC);
 
-    else if (node && node->type == OP && (int) node->value == GLUE)
-        fprintf (filename, "node%p [shape=Mrecord; label = \" { type = %d (OP)   | value = '' %s ''  (%lg) }\"; style = filled; fillcolor = \"#E0E0E0\"];\n",
-                 node, node->type, get_name (node->value), node->value);
+    if (node && type == NUM)
+        fprintf (filename, "node%p [shape=Mrecord; label = \" { type = %d (NUM)  | value = '' %" PRId64 " '' }\"; style = filled; fillcolor = \"#FFD700\"];\n",
+                 node, type, node->value);
 
-    else if (node && node->type == OP && (int) node->value == IF)
-        fprintf (filename, "node%p [shape=Mrecord; label = \" { type = %d (OP)   | value = '' %s ''  (%lg) }\"; style = filled; fillcolor = \"#68F29D\"];\n",
-                 node, node->type, get_name (node->value), node->value);
+    else if (node && type == OP && (int) node->value == GLUE)
+        fprintf (filename, "node%p [shape=Mrecord; label = \" { type = %d (OP)   | value = '' %s ''  (%" PRId64 ") }\"; style = filled; fillcolor = \"#E0E0E0\"];\n",
+                 node, type, get_name (node->value), node->value);
 
-    else if (node && node->type == OP && (int) node->value == WHILE)
-        fprintf (filename, "node%p [shape=Mrecord; label = \" { type = %d (OP)   | value = '' %s ''  (%lg) }\"; style = filled; fillcolor = \"#DF73DF\"];\n",
-                 node, node->type, get_name (node->value), node->value);
+    else if (node && type == OP && (int) node->value == IF)
+        fprintf (filename, "node%p [shape=Mrecord; label = \" { type = %d (OP)   | value = '' %s ''  (%" PRId64 ") }\"; style = filled; fillcolor = \"#68F29D\"];\n",
+                 node, type, get_name (node->value), node->value);
 
-    else if (node && node->type == FUNC && (int) node->value == FN_GLUE)
-        fprintf (filename, "node%p [shape=Mrecord; label = \" { type = %d (FUNC) | value = '' %s ''  (%lg) }\"; style = filled; fillcolor = \"#A0A0A0\"];\n",
-                 node, node->type, get_name (node->value), node->value);
+    else if (node && type == OP && (int) node->value == WHILE)
+        fprintf (filename, "node%p [shape=Mrecord; label = \" { type = %d (OP)   | value = '' %s ''  (%" PRId64 ") }\"; style = filled; fillcolor = \"#DF73DF\"];\n",
+                 node, type, get_name (node->value), node->value);
 
-    else if (node && node->type == FUNC && (int) node->value == COMMA)
-        fprintf (filename, "node%p [shape=Mrecord; label = \" { type = %d (FUNC) | value = '' %s ''  (%lg) }\"; style = filled; fillcolor = \"#FEAADF\"];\n",
-                 node, node->type, get_name (node->value), node->value);
+    else if (node && type == FUNC && (int) node->value == FN_GLUE)
+        fprintf (filename, "node%p [shape=Mrecord; label = \" { type = %d (FUNC) | value = '' %s ''  (%" PRId64 ") }\"; style = filled; fillcolor = \"#A0A0A0\"];\n",
+                 node, type, get_name (node->value), node->value);
 
-    else if (node && node->type == FUNC && (int) node->value == CALL)
-        fprintf (filename, "node%p [shape=Mrecord; label = \" { type = %d (FUNC) | value = '' %s ''  (%lg) }\"; style = filled; fillcolor = \"#F069F5\"];\n",
-                 node, node->type, get_name (node->value), node->value);
+    else if (node && type == FUNC && (int) node->value == COMMA)
+        fprintf (filename, "node%p [shape=Mrecord; label = \" { type = %d (FUNC) | value = '' %s ''  (%" PRId64 ") }\"; style = filled; fillcolor = \"#FEAADF\"];\n",
+                 node, type, get_name (node->value), node->value);
 
-    else if (node && node->type == FUNC && (int) node->value == DEF)
-        fprintf (filename, "node%p [shape=Mrecord; label = \" { type = %d (FUNC) | value = '' %s ''  (%lg) }\"; style = filled; fillcolor = \"#755CF7\"];\n",
-                 node, node->type, get_name (node->value), node->value);
+    else if (node && type == FUNC && (int) node->value == CALL)
+        fprintf (filename, "node%p [shape=Mrecord; label = \" { type = %d (FUNC) | value = '' %s ''  (%" PRId64 ") }\"; style = filled; fillcolor = \"#F069F5\"];\n",
+                 node, type, get_name (node->value), node->value);
 
+    else if (node && type == FUNC && (int) node->value == DEF)
+        fprintf (filename, "node%p [shape=Mrecord; label = \" { type = %d (FUNC) | value = '' %s ''  (%" PRId64 ") }\"; style = filled; fillcolor = \"#755CF7\"];\n",
+                 node, type, get_name (node->value), node->value);
 
-    else if (node && node->type == FUNC)
-        fprintf (filename, "node%p [shape=Mrecord; label = \" { type = %d (FUNC) | value = '' %.*s ''  (%lg) }\"; style = filled; fillcolor = \"#2EE31E\"];\n",
-                 node, node->type,
+
+    else if (node && type == FUNC)
+        fprintf (filename, "node%p [shape=Mrecord; label = \" { type = %d (FUNC) | value = '' %.*s ''  (%" PRId64 ") }\"; style = filled; fillcolor = \"#2EE31E\"];\n",
+                 node, type,
                  (int) context->name_table[(int)node->value].name.length,
                        context->name_table[(int)node->value].name.str_pointer,
                  node->value);
 
-    else if (node && node->type == OP)
-        fprintf (filename, "node%p [shape=Mrecord; label = \" { type = %d (OP)   | value = '' %s ''  (%lg) }\"; style = filled; fillcolor = \"#00FFDD\"];\n",
-                 node, node->type, get_name (node->value), node->value);
+    else if (node && type == OP)
+        fprintf (filename, "node%p [shape=Mrecord; label = \" { type = %d (OP)   | value = '' %s ''  (%" PRId64 ") }\"; style = filled; fillcolor = \"#00FFDD\"];\n",
+                 node, type, get_name (node->value), node->value);
 
-    else if (node && node->type == ID && context->name_table[(int)node->value].name.id_type == PARM)
-        fprintf (filename, "node%p [shape=Mrecord; label = \" { type = %d (ID)  | name = '' %.*s '' | number in name table = '' %lg '' | id_type = PARM }\"; style = filled; fillcolor = \"#FF5050\"];\n",
-                 node, node->type,
+    else if (node && type == ID && context->name_table[(int)node->value].name.id_type == PARM)
+        fprintf (filename, "node%p [shape=Mrecord; label = \" { type = %d (ID)  | name = '' %.*s '' | number in name table = '' %" PRId64 " '' | id_type = PARM }\"; style = filled; fillcolor = \"#FF5050\"];\n",
+                 node, type,
                  (int) context->name_table[(int)node->value].name.length,
                        context->name_table[(int)node->value].name.str_pointer, node->value);
 
-    else if (node && node->type == ID && context->name_table[(int)node->value].name.id_type == LOCL)
-        fprintf (filename, "node%p [shape=Mrecord; label = \" { type = %d (ID)  | name = '' %.*s '' | number in name table = '' %lg '' | id_type = LOCL }\"; style = filled; fillcolor = \"#FF5050\"];\n",
-                 node, node->type,
+    else if (node && type == ID && context->name_table[(int)node->value].name.id_type == LOCL)
+        fprintf (filename, "node%p [shape=Mrecord; label = \" { type = %d (ID)  | name = '' %.*s '' | number in name table = '' %" PRId64 " '' | id_type = LOCL }\"; style = filled; fillcolor = \"#FF5050\"];\n",
+                 node, type,
                  (int) context->name_table[(int)node->value].name.length,
                        context->name_table[(int)node->value].name.str_pointer, node->value);
 
-    else if (node && node->type == ROOT)
-        fprintf (filename, "node%p [shape=Mrecord; label = \" { type = %d (ROOT) | value = '' %lg '' | { son_node = [%p] } }\"; style = filled; fillcolor = \"#F0FFFF\"];\n",
-                 node, node->type, node->value, node->left);
+    else if (node && type == ROOT)
+        fprintf (filename, "node%p [shape=Mrecord; label = \" { type = %d (ROOT) | value = '' %" PRId64 " '' | { son_node = [%p] } }\"; style = filled; fillcolor = \"#F0FFFF\"];\n",
+                 node, type, node->value, node_left (pool, node));
 
     if (node && node->left)
-        fprintf (filename, "node%p -> node%p;\n", node, node->left);
+        fprintf (filename, "node%p -> node%p;\n", node, node_left (pool, node));
 
     if (node && node->right)
-        fprintf (filename, "node%p -> node%p;\n", node, node->right);
+        fprintf (filename, "node%p -> node%p;\n", node, node_right (pool, node));
 
-    if (node && node->left)  print_tree_preorder_for_file (node->left , context, filename);
+    if (node && node->left)  print_tree_preorder_for_file (node_left  (pool, node), context, filename);
 
-    if (node && node->right) print_tree_preorder_for_file (node->right, context, filename);
+    if (node && node->right) print_tree_preorder_for_file (node_right (pool, node), context, filename);
 }
 
-int make_graph (struct Node_t* node, struct Context_t* context)
+int make_graph (struct Node_t* node, struct Context_t* context, int dump_number)
 {
     assert (node);
 
-    FILE* graph_file = fopen ("log/graph_tree.dot", "wb");
+    char name[64] = {};
+    char path[PATH_MAX] = {};
+
+    sprintf (name, "log/graph_tree%d.dot", dump_number);
+
+    if (work_path (path, sizeof (path), name) == NULL)
+        return 1;
+
+    FILE* graph_file = fopen (path, "wb");
     if (graph_file == NULL)
     {
         fprintf(stderr, "\n" RED_TEXT("ERROR open graph_file") "\n");
@@ -240,97 +210,31 @@ int make_graph (struct Node_t* node, struct Context_t* context)
     return 0;
 }
 
+// does nothing without --graph; the graph is written by a child process on its own copy of
+// the tree, so the caller can go on changing it
 void dump_in_log_file (struct Node_t* node, struct Context_t* context, const char* reason, ...)
 {
+    if (graph_log_mode () == GRAPH_LOG_OFF)
+        return;
+
     if (node == NULL)
         fprintf (stderr, "got node == NULL in dump, reason = \"%s\"\n", reason);
 
-    make_graph (node, context);
-
     va_list args;
     va_start (args, reason);
 
-    write_log_file (reason, args);
+    int dump_number = write_log_file (reason, args);
 
     va_end (args);
-}
 
-void clean_buffer(void)
-{
-    while((getchar()) != '\n') {;}
-}
-
-void print_tree_preorder (struct Node_t* root, struct Context_t* context, FILE* file, int level)
-{
-    assert (root);
-    assert (context);
-    assert (file);
-
-    fprintf (file, "%*s{ ", level * 4, "");
-
-    fprintf (file, "%d: \"%g\" ", root->type, root->value);
-
-    if (root->left)
-        fprintf (file, "\n");
-
-    if (root->right)
-        fprintf (file, "\n");
-
-    if (root->left)  print_tree_preorder (root->left, context, file, level + 1);
+    if (node == NULL || dump_number < 0)
+        return;
 
-    if (root->right) print_tree_preorder (root->right, context, file, level + 1);
-
-    fprintf (file, "%*s} \n", (root->left) ? level * 4 : 0, "");
+    if (start_log_job () == 0)
+        _exit (make_graph (node, context, dump_number) || render_graph (dump_number));
 }
 
-int write_ast_file (struct Node_t* root, struct Context_t* context, const char* filename, int level)
-{
-    assert (context);
-    assert (filename);
-
-    if (root == NULL)
-    {
-        fprintf (stderr, RED_TEXT("ERROR: ") "File for middle-end not created - tree root not found\n");
-        return 1;
-    }
-
-    FILE* file = fopen (filename, "wb");
-    if (file == NULL)
-    {
-        fprintf (stderr, "\n" "Could not find the '%s' to be opened!" "\n", filename);
-        return 1;
-    }
-
-    print_tree_preorder (root, context, file, level);
-
-    return 0;
-}
-
-int write_name_table_file (struct Context_t* context, const char* filename)
+void clean_buffer(void)
 {
-    assert (context);
-    assert (filename);
-
-    FILE* file = fopen (filename, "wb");
-    if (file == NULL)
-    {
-        fprintf (stderr, "\n" "Could not find the '%s' to be opened!" "\n", filename);
-        return 1;
-    }
-
-    for (int i = context->keywords_offset; i < context->table_size; i++)
-        fprintf (file, "\"%.*s\" %d %d %d %d %d %d %d %d \n",
-                context->name_table[i].name.length,
-                context->name_table[i].name.str_pointer,
-                context->name_table[i].name.length,
-                context->name_table[i].name.is_keyword,
-                context->name_table[i].name.added_status,
-                context->name_table[i].name.id_type,
-                context->name_table[i].name.host_func,
-                context->name_table[i].name.counter_params,
-                context->name_table[i].name.counter_locals,
-                context->name_table[i].name.offset);
-
-    return 0;
+    while((getchar()) != '\n') {;}
 }
-
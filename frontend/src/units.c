@@ -0,0 +1,200 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <limits.h>
+
+#include "tree.h"
+#include "tokens.h"
+#include "syntax.h"
+#include "buffer.h"
+#include "units.h"
+#include "tree_bin.h"
+#include "work_dir.h"
+
+#define MAX_UNIT_PATH PATH_MAX
+
+struct Units_t
+{
+    const char** sources;
+    int*         status;
+    int          count;
+    int          text;
+
+    atomic_int   next;                  // first source no worker has taken yet
+};
+
+static void*          unit_worker  (void* arg);
+static int            compile_unit (const char* source, int text);
+static int            unit_path    (char* path, const char* source, const char* suffix);
+static const char*    unit_name    (const char* source, int* length);
+static int            same_names   (const char* sources[], int count);
+
+int compile_units (const char* sources[], int count, int threads, int text)
+{
+    if (same_names (sources, count))
+        return 1;
+
+    if (threads <= 0)
+        threads = (int) sysconf (_SC_NPROCESSORS_ONLN);
+
+    if (threads > count)       threads = count;
+    if (threads > MAX_THREADS) threads = MAX_THREADS;
+    if (threads < 1)           threads = 1;
+
+    int* status = (int*) calloc ((size_t) count, sizeof (*status));
+    if (status == NULL)
+    {
+        fprintf (stderr, "ERROR: could not allocate %d units\n", count);
+        return 1;
+    }
+
+    struct Units_t units = { .sources = sources, .status = status, .count = count, .text = text };
+    atomic_init (&units.next, 0);
+
+    pthread_t workers[MAX_THREADS] = {};
+    int started = 0;
+
+    // the calling thread is a worker too
+    for (; started < threads - 1; started++)
+        if (pthread_create (&workers[started], NULL, unit_worker, &units) != 0)
+            break;
+
+    unit_worker (&units);
+
+    for (int i = 0; i < started; i++)
+        pthread_join (workers[i], NULL);
+
+    int failed = 0;
+
+    for (int i = 0; i < count; i++)
+        if (status[i] != 0)
+        {
+            fprintf (stderr, "ERROR: unit '%s' was not compiled\n", sources[i]);
+            failed++;
+        }
+
+    free (status);
+
+    return (failed != 0);
+}
+
+static void* unit_worker (void* arg)
+{
+    struct Units_t* units = (struct Units_t*) arg;
+
+    int i = 0;
+
+    while ((i = atomic_fetch_add (&units->next, 1)) < units->count)
+        units->status[i] = compile_unit (units->sources[i], units->text);
+
+    return NULL;
+}
+
+// everything a unit owns lives in its own context and buffer, nothing is shared between workers
+static int compile_unit (const char* source, int text)
+{
+    char ast_path  [MAX_UNIT_PATH] = {};
+    char names_path[MAX_UNIT_PATH] = {};
+
+    if (unit_path (ast_path,   source, text ? "AST_tree.txt" : "AST_tree.bin") != 0 ||
+        unit_path (names_path, source, "Name_Table.txt")                      != 0)
+        return 1;
+
+    struct  Buffer_t  buffer = {};
+    struct Context_t context = {};
+
+    if (ctor_keywords (&context) != 0)
+    {
+        dtor_keywords (&context);
+        return 1;
+    }
+
+    const char* string = file_reader (&buffer, source);
+    if (string == NULL)
+    {
+        dtor_keywords (&context);
+        return 1;
+    }
+
+    int error = tokenization (&context, string);
+
+    struct Node_t* root = NULL;
+
+    if (error == 0)
+        root = parse_program (&context);
+
+    if (root == NULL)
+        error = 1;
+    else if (text)
+        error = write_ast_file        (root, &context, ast_path, 0) ||
+                write_name_table_file (&context, names_path);
+    else
+        error = write_binary_ast (root, &context, ast_path);
+
+#ifdef DEBUG
+    node_pool_dump (stderr, &context.nodes, source);
+#endif
+
+    dtor_keywords (&context);
+    buffer_dtor (&buffer);
+
+    return error;
+}
+
+// 'dir/name.cook' -> 'middle_end/name.<suffix>', in the work directory if there is one
+static int unit_path (char* path, const char* source, const char* suffix)
+{
+    int         length = 0;
+    const char* name   = unit_name (source, &length);
+
+    char unit[MAX_UNIT_PATH] = {};
+
+    int written = snprintf (unit, MAX_UNIT_PATH, "middle_end/%.*s.%s", length, name, suffix);
+    if (written < 0 || written >= MAX_UNIT_PATH)
+    {
+        fprintf (stderr, "ERROR: output name for '%s' is too long\n", source);
+        return 1;
+    }
+
+    return (work_path (path, MAX_UNIT_PATH, unit) == NULL);
+}
+
+// 'dir/name.cook' -> 'name', the part of the source the outputs are named after
+static const char* unit_name (const char* source, int* length)
+{
+    const char* name = strrchr (source, '/');
+    name = (name != NULL) ? name + 1 : source;
+
+    const char* dot = strrchr (name, '.');
+    *length = (dot != NULL && dot != name) ? (int) (dot - name) : (int) strlen (name);
+
+    return name;
+}
+
+// two units of the same name would write the same files, whichever finished last would win
+static int same_names (const char* sources[], int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        int         length = 0;
+        const char* name   = unit_name (sources[i], &length);
+
+        for (int j = i + 1; j < count; j++)
+        {
+            int         other_length = 0;
+            const char* other        = unit_name (sources[j], &other_length);
+
+            if (length == other_length && strncmp (name, other, (size_t) length) == 0)
+            {
+                fprintf (stderr, "ERROR: units '%s' and '%s' would both be written to middle_end/%.*s.*\n",
+                         sources[i], sources[j], length, name);
+                return 1;
+            }
+        }
+    }
+
+    return 0;
+}
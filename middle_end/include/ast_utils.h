@@ -0,0 +1,27 @@
+#pragma once
+
+#include "tree_io.h"
+
+// what the middle-end passes ask of the tree: the built-in functions, the calls of the program's
+// own functions, equal subtrees and the definitions of the functions
+
+// name ids of the built-ins, -1 if the program does not use one
+struct Builtins_t
+{
+    int gimme_id;
+    int sqrt_id;
+    int yap_id;
+};
+
+// called for every function definition, a value other than 0 stops the walk
+typedef int (*FunctionVisitor_t) (void* state, struct Node_t* def);
+
+void find_builtins (struct Context_t* context, struct Builtins_t* builtins);
+
+int is_call_of (const struct NodePool_t* pool, const struct Node_t* node, int name_id);
+
+int calls_program (const struct NodePool_t* pool, const struct Builtins_t* builtins, const struct Node_t* node);
+
+int same_trees (const struct NodePool_t* pool, const struct Node_t* first, const struct Node_t* second);
+
+int walk_functions (const struct NodePool_t* pool, struct Node_t* root, FunctionVisitor_t visit, void* state);
@@ -0,0 +1,9 @@
+#pragma once
+
+#include "tree_io.h"
+
+// dead code and dead store elimination: statements under a condition folded to 0 and
+// assignments no later statement reads are removed, the calls of gimme, yap and the program's
+// functions always stay
+
+int eliminate_dead_code (struct Context_t* context, struct Node_t* root);
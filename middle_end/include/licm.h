@@ -0,0 +1,11 @@
+#pragma once
+
+#include "tree_io.h"
+#include "ir_registers.h"
+
+// loop-invariant code motion: an expression in a grinding body that reads only variables the
+// loop does not write is computed once, into a new local assigned right before the loop.
+// 'registers' are the IR registers of the whole program, counted by count_ir_registers when
+// 'root' is one of its functions; a new local takes one of them
+
+int hoist_loop_invariants (struct Context_t* context, struct Node_t* root, struct IrRegisters_t* registers);
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <stdio.h>
+
+// --opt-stats: what the middle-end passes looked at and changed, summed over the compile;
+// a counter is named by its pass and by what it counts, the ones of a pass are printed together
+
+#define MAX_OPT_COUNTERS 128
+
+struct OptCounter_t
+{
+    const char* pass;
+    const char* name;
+    long        value;
+};
+
+int opt_stats_option (const char* argument);
+
+void opt_stats_reset (void);
+
+void opt_count (const char* pass, const char* name, long value);
+
+long opt_counter (const char* pass, const char* name);
+
+void opt_stats_print (FILE* file, const char* program);
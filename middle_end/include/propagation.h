@@ -0,0 +1,8 @@
+#pragma once
+
+#include "tree_io.h"
+
+// constant and copy propagation: a variable read where its value is known is replaced by the
+// number, or by the variable it was copied from; the simplification that follows folds the rest
+
+int propagate_constants (struct Context_t* context, struct Node_t* root);
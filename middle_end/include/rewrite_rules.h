@@ -0,0 +1,21 @@
+#pragma once
+
+#include "tree_io.h"
+
+// algebraic identities written as a constant table of patterns and results, "MUL(x, 1) -> x":
+// the rules are tried in table order, the first one that matches wins
+
+#define MAX_REWRITE_RULES 32
+
+// how often every rule fired, by its place in the table
+struct RuleFires_t
+{
+    long fired[MAX_REWRITE_RULES];
+};
+
+// 1 if a rule of the table is malformed, which is reported
+int check_rewrite_rules (void);
+
+int apply_rewrite_rules (struct NodePool_t* pool, uint32_t* link, struct RuleFires_t* fires);
+
+void count_rule_fires (const struct RuleFires_t* fires);
@@ -1,20 +1,14 @@
 #ifndef SIMPLIFICATION_H
 #define SIMPLIFICATION_H
 
-#include "tree.h"
+#include "tree_io.h"
 #include "log.h"
 #include "enum.h"
 
-#define MAX_OPTIMIZATIONS 100
+int eval (const struct NodePool_t* pool, const struct Node_t* node, int64_t* result);
 
-double eval (struct Node_t* node);
+void verificator (const struct NodePool_t* pool, const struct Node_t* node, const char* filename, int line);
 
-int simplification_typical_operations (struct Node_t* root, struct Node_t* parent);
-
-void verificator (struct Node_t* node, const char* filename, int line);
-
-int constant_folding (struct Node_t* root);
-
-int simplification_of_expression (struct Node_t* root, struct Node_t* parent);
+int simplification_of_expression (struct Context_t* context, struct Node_t* root, struct Node_t* parent);
 
 #endif // SIMPLIFICATION_H
@@ -0,0 +1,80 @@
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#include <ast_utils.h>
+#include <keywords.h>
+
+void find_builtins (struct Context_t* context, struct Builtins_t* builtins)
+{
+    assert (context);
+    assert (builtins);
+
+    builtins->gimme_id = find_symbol_id (context, "gimme", (int) strlen ("gimme"));
+    builtins->sqrt_id  = find_symbol_id (context, "sqrt",  (int) strlen ("sqrt"));
+    builtins->yap_id   = find_symbol_id (context, "yap",   (int) strlen ("yap"));
+}
+
+int is_call_of (const struct NodePool_t* pool, const struct Node_t* node, int name_id)
+{
+    return node_type (pool, node) == FUNC && (int) node->value == CALL && node->left != 0 &&
+           node_left (pool, node)->value == name_id;
+}
+
+// does the subtree call a function of the program, not a built-in; the right spine is walked in
+// a loop, the statement lists can be long
+int calls_program (const struct NodePool_t* pool, const struct Builtins_t* builtins, const struct Node_t* node)
+{
+    while (node != NULL)
+    {
+        if (node_type (pool, node) == FUNC && (int) node->value == CALL && !is_call_of (pool, node, builtins->gimme_id) &&
+            !is_call_of (pool, node, builtins->sqrt_id) && !is_call_of (pool, node, builtins->yap_id))
+            return 1;
+
+        if (calls_program (pool, builtins, node_left (pool, node)))
+            return 1;
+
+        node = node_right (pool, node);
+    }
+
+    return 0;
+}
+
+int same_trees (const struct NodePool_t* pool, const struct Node_t* first, const struct Node_t* second)
+{
+    if (first == NULL || second == NULL)
+        return first == second;
+
+    return node_type (pool, first) == node_type (pool, second) &&
+           first->value == second->value &&
+           same_trees (pool, node_left  (pool, first), node_left  (pool, second)) &&
+           same_trees (pool, node_right (pool, first), node_right (pool, second));
+}
+
+// the definitions hang off a chain of FN_GLUE nodes, or the root is a single definition;
+// returns what the visitor that stopped the walk returned, 0 if none did
+int walk_functions (const struct NodePool_t* pool, struct Node_t* root, FunctionVisitor_t visit, void* state)
+{
+    assert (visit);
+
+    for (struct Node_t* node = root; node != NULL; node = node_right (pool, node))
+    {
+        struct Node_t* def = node;
+
+        if (node_type (pool, node) == FUNC && (int) node->value == FN_GLUE)
+            def = node_left (pool, node);
+
+        if (def != NULL && node_type (pool, def) == FUNC && (int) def->value == DEF)
+        {
+            int stop = visit (state, def);
+
+            if (stop != 0)
+                return stop;
+        }
+
+        if (node == def)
+            return 0;
+    }
+
+    return 0;
+}
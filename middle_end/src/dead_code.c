@@ -0,0 +1,418 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include <dead_code.h>
+#include <ast_utils.h>
+#include <opt_stats.h>
+#include <keywords.h>
+
+#define ENTRY_FUNCTION "carti"          // the backend calls it, and the program ends when it returns
+#define LIST_START     64               // first capacity of the statements of one list
+
+struct DeadCode_t
+{
+    struct NodePool_t* pool;
+
+    int    vars_count;
+    size_t words;                       // of a set of variables
+
+    struct Builtins_t builtins;
+    int               entry_id;
+
+    long removed;
+    long stores;
+
+    int error;
+};
+
+static int       walk_function   (void* state, struct Node_t* def);
+static void      prune_branches  (struct DeadCode_t* state, uint32_t* list);
+static void      sweep_list      (struct DeadCode_t* state, uint32_t* list, uint64_t* live);
+static int       sweep_statement (struct DeadCode_t* state, struct Node_t* statement, uint64_t* live);
+static void      add_uses        (struct DeadCode_t* state, const struct Node_t* node, uint64_t* live);
+static void      remove_defs     (struct DeadCode_t* state, const struct Node_t* node, uint64_t* live);
+static int       is_pure         (const struct DeadCode_t* state, const struct Node_t* node);
+static void      remove_first    (struct DeadCode_t* state, uint32_t* list);
+static uint64_t* new_set         (struct DeadCode_t* state, int full);
+static void      set_variable    (const struct DeadCode_t* state, uint64_t* set, int64_t var, int value);
+static int       has_variable    (const struct DeadCode_t* state, const uint64_t* set, int64_t var);
+
+// every function is swept from its end to its start with the set of variables a later statement
+// may read: an assignment to a variable outside the set is dead. Variables of the same name are
+// one register across the functions, so only the end of the entry function reads nothing, and a
+// call of a function of the program may read everything. Counted as "dead code" in --opt-stats
+int eliminate_dead_code (struct Context_t* context, struct Node_t* root)
+{
+    assert (context);
+
+    struct DeadCode_t state = {};
+
+    state.pool       = &context->nodes;
+    state.vars_count = context->table_size;
+    state.words      = ((size_t) state.vars_count + 63) / 64 + 1;
+
+    state.entry_id = find_symbol_id (context, ENTRY_FUNCTION, (int) strlen (ENTRY_FUNCTION));
+
+    find_builtins (context, &state.builtins);
+
+    walk_functions (state.pool, root, walk_function, &state);
+
+    opt_count ("dead code", "statements removed", state.removed);
+    opt_count ("dead code", "dead stores",        state.stores);
+
+    return state.error;
+}
+
+static int walk_function (void* state, struct Node_t* def)
+{
+    struct DeadCode_t* dead = (struct DeadCode_t*) state;
+
+    const struct Node_t* name = node_left (dead->pool, def);
+
+    int entry = name != NULL && name->left != 0 && node_left (dead->pool, name)->value == dead->entry_id;
+
+    uint64_t* live = new_set (dead, !entry);
+
+    if (live == NULL)
+        return dead->error;
+
+    prune_branches (dead, &def->right);
+    sweep_list     (dead, &def->right, live);
+
+    free (live);
+
+    return dead->error;
+}
+
+// a forreal or a grinding under a condition folded to 0 goes, a forreal under any other number
+// is replaced by its body; a grinding under a number with an empty body never ends, it stays
+static void prune_branches (struct DeadCode_t* state, uint32_t* list)
+{
+    const struct NodePool_t* pool = state->pool;
+
+    for (struct Node_t* glue = node_at (pool, *list);
+         glue != NULL && node_type (pool, glue) == OP && (int) glue->value == GLUE; glue = node_at (pool, *list))
+    {
+        struct Node_t* statement = node_left (pool, glue);
+
+        int code = (statement != NULL && node_type (pool, statement) == OP) ? (int) statement->value : 0;
+
+        if (code != IF && code != WHILE)
+        {
+            list = &glue->right;
+            continue;
+        }
+
+        prune_branches (state, &statement->right);
+
+        struct Node_t* condition = node_left (pool, statement);
+
+        if (condition == NULL || node_type (pool, condition) != NUM)
+        {
+            list = &glue->right;
+            continue;
+        }
+
+        if (condition->value == 0 || (code == IF && statement->right == 0))
+        {
+            remove_first (state, list);
+            continue;
+        }
+
+        if (code == WHILE)
+        {
+            list = &glue->right;
+            continue;
+        }
+
+        // the body goes in place of the forreal, its last statement leads to the next one
+        struct Node_t* last = node_right (pool, statement);
+
+        while (last->right != 0 && node_type (pool, node_right (pool, last)) == OP &&
+               (int) node_right (pool, last)->value == GLUE)
+            last = node_right (pool, last);
+
+        if (node_type (pool, last) != OP || (int) last->value != GLUE || last->right != 0)
+        {
+            list = &glue->right;
+            continue;
+        }
+
+        last->right = glue->right;
+        *list       = statement->right;
+
+        delete_node (state->pool, condition);
+        delete_node (state->pool, statement);
+        delete_node (state->pool, glue);
+    }
+}
+
+// the statements of a list are swept from the last one; 'live' is what is read after the list
+// on the way in, and what is read from its start on the way out
+static void sweep_list (struct DeadCode_t* state, uint32_t* list, uint64_t* live)
+{
+    const struct NodePool_t* pool = state->pool;
+
+    long       count    = 0;
+    long       capacity = LIST_START;
+    uint32_t** links    = (uint32_t**) calloc ((size_t) capacity, sizeof (*links));
+
+    if (links == NULL)
+    {
+        fprintf (stderr, "ERROR: could not allocate the statements of a list\n");
+        state->error = 1;
+        return;
+    }
+
+    for (struct Node_t* glue = node_at (pool, *list);
+         glue != NULL && node_type (pool, glue) == OP && (int) glue->value == GLUE; glue = node_at (pool, *list))
+    {
+        if (count == capacity)
+        {
+            uint32_t** grown = (uint32_t**) realloc (links, 2 * (size_t) capacity * sizeof (*links));
+
+            if (grown == NULL)
+            {
+                fprintf (stderr, "ERROR: could not grow the statements of a list to %ld\n", 2 * capacity);
+                free (links);
+                state->error = 1;
+                return;
+            }
+
+            links     = grown;
+            capacity *= 2;
+        }
+
+        links[count++] = list;
+        list = &glue->right;
+    }
+
+    // a list that does not end in a glue ends in one statement, it is only read
+    if (*list != 0)
+        add_uses (state, node_at (pool, *list), live);
+
+    // a removed statement only changes the link to it, the ones before are still where they were
+    for (long i = count - 1; i >= 0 && state->error == 0; i--)
+        if (sweep_statement (state, node_left (pool, node_at (pool, *links[i])), live))
+            remove_first (state, links[i]);
+
+    free (links);
+}
+
+// updates 'live' over one statement; returns 1 if the statement does nothing that is read later
+static int sweep_statement (struct DeadCode_t* state, struct Node_t* statement, uint64_t* live)
+{
+    if (statement == NULL)
+        return 1;
+
+    const struct NodePool_t* pool = state->pool;
+
+    int type = node_type (pool, statement);
+    int code = (int) statement->value;
+
+    const struct Node_t* left  = node_left  (pool, statement);
+    const struct Node_t* right = node_right (pool, statement);
+
+    if (type == OP && code == EQUAL && left != NULL && node_type (pool, left) == ID)
+    {
+        int64_t var = left->value;
+
+        const struct Node_t* value = right;
+
+        if ((value != NULL && node_type (pool, value) == ID && value->value == var) ||
+            (!has_variable (state, live, var) && is_pure (state, value)))
+        {
+            state->stores++;
+            return 1;
+        }
+
+        set_variable (state, live, var, 0);
+        add_uses     (state, value, live);
+
+        return 0;
+    }
+
+    if (type == OP && code == IF)
+    {
+        uint64_t* body = new_set (state, 0);
+
+        if (body == NULL)
+            return 0;
+
+        memcpy (body, live, state->words * sizeof (*body));
+
+        sweep_list (state, &statement->right, body);
+
+        for (size_t i = 0; i < state->words; i++)
+            live[i] |= body[i];
+
+        free (body);
+
+        add_uses (state, left, live);
+
+        return statement->right == 0 && is_pure (state, left);
+    }
+
+    if (type == OP && code == WHILE)
+    {
+        // what the body or the condition reads is read after every iteration, so at the end of
+        // the body; what a later iteration reads first is among it already
+        add_uses (state, left,  live);
+        add_uses (state, right, live);
+
+        uint64_t* body = new_set (state, 0);
+
+        if (body == NULL)
+            return 0;
+
+        memcpy (body, live, state->words * sizeof (*body));
+
+        sweep_list (state, &statement->right, body);
+
+        free (body);
+
+        return 0;
+    }
+
+    remove_defs (state, statement, live);
+    add_uses    (state, statement, live);
+
+    return 0;
+}
+
+// the variables a subtree reads, not counting what gimme writes; a call of a function of the
+// program may read any of them
+static void add_uses (struct DeadCode_t* state, const struct Node_t* node, uint64_t* live)
+{
+    const struct NodePool_t* pool = state->pool;
+
+    while (node != NULL)
+    {
+        int type = node_type (pool, node);
+
+        if (type == ID)
+            set_variable (state, live, node->value, 1);
+
+        if (type == OP && (int) node->value == EQUAL)
+        {
+            node = node_right (pool, node);
+            continue;
+        }
+
+        if (type == FUNC && (int) node->value == CALL)
+        {
+            if (is_call_of (pool, node, state->builtins.gimme_id))
+                return;
+
+            if (!is_call_of (pool, node, state->builtins.sqrt_id) && !is_call_of (pool, node, state->builtins.yap_id))
+                memset (live, 0xFF, state->words * sizeof (*live));
+
+            node = node_right (pool, node);
+            continue;
+        }
+
+        add_uses (state, node_left (pool, node), live);
+        node = node_right (pool, node);
+    }
+}
+
+// the variables gimme writes in an expression statement
+static void remove_defs (struct DeadCode_t* state, const struct Node_t* node, uint64_t* live)
+{
+    if (node == NULL)
+        return;
+
+    const struct NodePool_t* pool = state->pool;
+
+    if (is_call_of (pool, node, state->builtins.gimme_id))
+    {
+        for (const struct Node_t* argument = node_right (pool, node); argument != NULL;
+             argument = node_right (pool, argument))
+        {
+            const struct Node_t* target = node_left (pool, argument);
+
+            if (target != NULL && node_type (pool, target) == ID)
+                set_variable (state, live, target->value, 0);
+        }
+
+        return;
+    }
+
+    remove_defs (state, node_left  (pool, node), live);
+    remove_defs (state, node_right (pool, node), live);
+}
+
+// an expression that can go unevaluated: no call but sqrt, no division that may trap
+static int is_pure (const struct DeadCode_t* state, const struct Node_t* node)
+{
+    if (node == NULL)
+        return 1;
+
+    const struct NodePool_t* pool = state->pool;
+
+    const struct Node_t* right = node_right (pool, node);
+
+    if (node_type (pool, node) == FUNC && (int) node->value == CALL && !is_call_of (pool, node, state->builtins.sqrt_id))
+        return 0;
+
+    if (node_type (pool, node) == OP && (int) node->value == DIV &&
+        (right == NULL || node_type (pool, right) != NUM || right->value == 0 || right->value == -1))
+        return 0;
+
+    return is_pure (state, node_left (pool, node)) && is_pure (state, right);
+}
+
+// unlinks the first statement of a list
+static void remove_first (struct DeadCode_t* state, uint32_t* list)
+{
+    struct Node_t* glue = node_at (state->pool, *list);
+
+    *list = glue->right;
+
+    if (glue->left != 0)
+        delete_sub_tree (state->pool, node_left (state->pool, glue));
+
+    delete_node (state->pool, glue);
+
+    state->removed++;
+}
+
+static uint64_t* new_set (struct DeadCode_t* state, int full)
+{
+    uint64_t* set = (uint64_t*) calloc (state->words, sizeof (*set));
+
+    if (set == NULL)
+    {
+        fprintf (stderr, "ERROR: could not allocate a set of %d variables\n", state->vars_count);
+        state->error = 1;
+        return NULL;
+    }
+
+    if (full)
+        memset (set, 0xFF, state->words * sizeof (*set));
+
+    return set;
+}
+
+static void set_variable (const struct DeadCode_t* state, uint64_t* set, int64_t var, int value)
+{
+    if (var < 0 || var >= state->vars_count)
+        return;
+
+    if (value)
+        set[var / 64] |=  (UINT64_C (1) << (var % 64));
+    else
+        set[var / 64] &= ~(UINT64_C (1) << (var % 64));
+}
+
+// a variable outside the name table is taken as read
+static int has_variable (const struct DeadCode_t* state, const uint64_t* set, int64_t var)
+{
+    if (var < 0 || var >= state->vars_count)
+        return 1;
+
+    return (set[var / 64] >> (var % 64)) & 1;
+}
@@ -0,0 +1,416 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include <licm.h>
+#include <ast_utils.h>
+#include <opt_stats.h>
+#include <keywords.h>
+
+#define TEMP_NAME_LENGTH 32
+#define HOISTED_START    16             // first capacity of the expressions hoisted out of one loop
+
+struct Hoisted_t
+{
+    const struct Node_t* expression;    // now the value of the assignment before the loop
+    int                  var;
+};
+
+struct Licm_t
+{
+    struct Context_t*  context;
+    struct NodePool_t* pool;            // its tree
+
+    struct Builtins_t builtins;
+    int               host_id;          // the function the walk is in, the new locals are its own
+
+    uint64_t* written;                  // the variables the loop assigns
+    size_t    words;
+
+    struct Hoisted_t* hoisted;
+    int               hoisted_count;
+    int               hoisted_capacity;
+
+    int temps;                          // the number in the last name made for a new local
+
+    struct IrRegisters_t* registers;    // what ir_gen takes for the program, new locals included
+
+    long loops;
+    long expressions;
+    long kept;                          // left in their loop, a new local would not get a register
+
+    int error;
+};
+
+static int            walk_function   (void* state, struct Node_t* def);
+static void           walk_list       (struct Licm_t* state, uint32_t* list);
+static uint32_t*      hoist_loop      (struct Licm_t* state, uint32_t* link);
+static void           hoist_in        (struct Licm_t* state, uint32_t* link, uint32_t** before);
+static int            hoisted_var     (struct Licm_t* state, struct Node_t* expression, uint32_t** before);
+static int            new_local       (struct Licm_t* state);
+static int            is_invariant    (const struct Licm_t* state, const struct Node_t* node);
+static void           mark_written    (struct Licm_t* state, const struct Node_t* node);
+static struct Node_t* make_node       (struct Licm_t* state, int type, int64_t value,
+                                       struct Node_t* left, struct Node_t* right);
+
+// the loops are handled from the innermost out: what leaves an inner loop goes to the body of
+// the outer one, where it may be invariant again. Counted as "licm" in --opt-stats
+int hoist_loop_invariants (struct Context_t* context, struct Node_t* root, struct IrRegisters_t* registers)
+{
+    assert (context);
+    assert (registers);
+
+    struct Licm_t state = {};
+
+    state.context   = context;
+    state.pool      = &context->nodes;
+    state.registers = registers;
+    state.host_id   = -1;
+
+    find_builtins (context, &state.builtins);
+
+    walk_functions (state.pool, root, walk_function, &state);
+
+    opt_count ("licm", "loops with invariants", state.loops);
+    opt_count ("licm", "expressions hoisted",   state.expressions);
+    opt_count ("licm", "kept for registers",    state.kept);
+
+    free (state.written);
+    free (state.hoisted);
+
+    return state.error;
+}
+
+static int walk_function (void* state, struct Node_t* def)
+{
+    struct Licm_t* licm = (struct Licm_t*) state;
+
+    const struct Node_t* name = node_left (licm->pool, def);
+
+    if (name != NULL && name->left != 0)
+    {
+        licm->host_id = (int) node_left (licm->pool, name)->value;
+        walk_list (licm, &def->right);
+    }
+
+    return licm->error;
+}
+
+static void walk_list (struct Licm_t* state, uint32_t* list)
+{
+    const struct NodePool_t* pool = state->pool;
+
+    for (struct Node_t* glue = node_at (pool, *list);
+         glue != NULL && node_type (pool, glue) == OP && (int) glue->value == GLUE && state->error == 0;
+         glue = node_at (pool, *list))
+    {
+        struct Node_t* statement = node_left (pool, glue);
+
+        if (statement != NULL && node_type (pool, statement) == OP)
+        {
+            if ((int) statement->value == IF)
+                walk_list (state, &statement->right);
+
+            if ((int) statement->value == WHILE)
+            {
+                walk_list (state, &statement->right);
+
+                list = hoist_loop (state, list);
+            }
+        }
+
+        list = &node_at (pool, *list)->right;
+    }
+}
+
+// the new assignments go between the statement before the loop and the loop;
+// returns the link to the loop, after them
+static uint32_t* hoist_loop (struct Licm_t* state, uint32_t* link)
+{
+    struct Node_t* loop = node_left (state->pool, node_at (state->pool, *link));
+
+    // a function of the program may assign any variable
+    if (calls_program (state->pool, &state->builtins, loop))
+        return link;
+
+    // the locals made for the inner loops are in the table now
+    size_t words = ((size_t) state->context->table_size + 63) / 64 + 1;
+
+    if (words > state->words)
+    {
+        uint64_t* written = (uint64_t*) realloc (state->written, words * sizeof (*written));
+
+        if (written == NULL)
+        {
+            fprintf (stderr, "ERROR: could not allocate a set of %d variables\n", state->context->table_size);
+            state->error = 1;
+            return link;
+        }
+
+        state->written = written;
+        state->words   = words;
+    }
+
+    memset (state->written, 0, state->words * sizeof (*state->written));
+
+    mark_written (state, loop);
+
+    state->hoisted_count = 0;
+
+    // the condition is left alone: ir_gen computes its operands once, before the loop, already
+    hoist_in (state, &loop->right, &link);
+
+    if (state->hoisted_count != 0)
+        state->loops++;
+
+    return link;
+}
+
+// replaces the largest invariant expressions of the subtree by the locals they are assigned to
+static void hoist_in (struct Licm_t* state, uint32_t* link, uint32_t** before)
+{
+    const struct NodePool_t* pool = state->pool;
+
+    struct Node_t* node = node_at (pool, *link);
+
+    if (node == NULL || state->error != 0)
+        return;
+
+    // gimme writes its argument
+    if (is_call_of (pool, node, state->builtins.gimme_id))
+        return;
+
+    int worth = (node_type (pool, node) == OP && ((int) node->value == ADD || (int) node->value == SUB ||
+                                                  (int) node->value == MUL || (int) node->value == DIV)) ||
+                is_call_of (pool, node, state->builtins.sqrt_id);
+
+    if (worth && is_invariant (state, node))
+    {
+        // the read is made first: once the expression is hoisted, nothing may fail to replace it
+        struct Node_t* read = make_node (state, ID, -1, NULL, NULL);
+
+        if (read == NULL)
+            return;
+
+        int var = hoisted_var (state, node, before);
+
+        if (var < 0)
+        {
+            delete_node (state->pool, read);
+            return;
+        }
+
+        read->value = var;
+        *link       = node_index (pool, read);
+
+        return;
+    }
+
+    // the variable an assignment writes is not an expression
+    if (!(node_type (pool, node) == OP && (int) node->value == EQUAL))
+        hoist_in (state, &node->left, before);
+
+    hoist_in (state, &node->right, before);
+}
+
+// the local an invariant expression is computed into: the same expression hoisted before is not
+// computed twice; a new one is assigned in a statement put before the loop
+static int hoisted_var (struct Licm_t* state, struct Node_t* expression, uint32_t** before)
+{
+    for (int i = 0; i < state->hoisted_count; i++)
+        if (same_trees (state->pool, state->hoisted[i].expression, expression))
+        {
+            delete_sub_tree (state->pool, expression);
+            state->expressions++;
+            return state->hoisted[i].var;
+        }
+
+    if (state->hoisted_count == state->hoisted_capacity)
+    {
+        int capacity = (state->hoisted_capacity == 0) ? HOISTED_START : 2 * state->hoisted_capacity;
+
+        struct Hoisted_t* hoisted = (struct Hoisted_t*) realloc (state->hoisted, (size_t) capacity * sizeof (*hoisted));
+
+        if (hoisted == NULL)
+        {
+            fprintf (stderr, "ERROR: could not grow the hoisted expressions to %d\n", capacity);
+            state->error = 1;
+            return -1;
+        }
+
+        state->hoisted          = hoisted;
+        state->hoisted_capacity = capacity;
+    }
+
+    // the new local keeps an IR register for the whole program, which must still have one
+    // for it next to the temporaries of its statements
+    if (!ir_registers_fit (state->registers, 1))
+    {
+        state->kept++;
+        return -1;
+    }
+
+    struct Node_t* target     = make_node (state, ID, -1,    NULL,   NULL);
+    struct Node_t* assignment = make_node (state, OP, EQUAL, target, expression);
+    struct Node_t* glue       = make_node (state, OP, GLUE,  assignment, node_at (state->pool, **before));
+
+    int var = (glue != NULL && assignment != NULL && target != NULL) ? new_local (state) : -1;
+
+    if (var < 0)
+    {
+        if (target     != NULL) delete_node (state->pool, target);
+        if (assignment != NULL) delete_node (state->pool, assignment);
+        if (glue       != NULL) delete_node (state->pool, glue);
+
+        return -1;
+    }
+
+    target->value = var;
+    take_kept_register (state->registers);
+
+    **before = node_index (state->pool, glue);
+    *before  = &glue->right;
+
+    state->hoisted[state->hoisted_count].expression = expression;
+    state->hoisted[state->hoisted_count].var        = var;
+    state->hoisted_count++;
+
+    state->expressions++;
+
+    return var;
+}
+
+// a local of the function the walk is in, named with digits no identifier of the language has
+static int new_local (struct Licm_t* state)
+{
+    struct Context_t* context = state->context;
+
+    char name[TEMP_NAME_LENGTH] = {};
+    int  length = 0;
+
+    do
+        length = snprintf (name, sizeof (name), "licm%d", ++state->temps);
+    while (find_symbol_id (context, name, length) != -1);
+
+    // the name table points into memory that lives as long as the context
+    char* str = (char*) arena_alloc (&context->arena, (size_t) length + 1);
+
+    if (str == NULL)
+    {
+        fprintf (stderr, "ERROR: could not allocate the name '%s'\n", name);
+        state->error = 1;
+        return -1;
+    }
+
+    memcpy (str, name, (size_t) length);
+
+    if (add_struct_in_keywords (context, str, (enum Operations) ID, 0, length, 1) != 0)
+    {
+        state->error = 1;
+        return -1;
+    }
+
+    int var = context->table_size - 1;
+
+    context->name_table[var].name.id_type   = LOCL;
+    context->name_table[var].name.host_func = state->host_id;
+
+    if (state->host_id >= 0)
+        context->name_table[var].name.offset = context->name_table[state->host_id].name.counter_params +
+                                               context->name_table[state->host_id].name.counter_locals++;
+
+    return var;
+}
+
+// computes the same value on every iteration, and can be computed before a loop that may not run
+static int is_invariant (const struct Licm_t* state, const struct Node_t* node)
+{
+    if (node == NULL)
+        return 0;
+
+    const struct NodePool_t* pool = state->pool;
+
+    const struct Node_t* left  = node_left  (pool, node);
+    const struct Node_t* right = node_right (pool, node);
+
+    switch (node_type (pool, node))
+    {
+        case NUM:
+            return 1;
+
+        case ID:
+            return node->value >= 0 && (size_t) node->value / 64 < state->words &&
+                   !((state->written[node->value / 64] >> (node->value % 64)) & 1);
+
+        case OP:
+            switch ((int) node->value)
+            {
+                case ADD:
+                case SUB:
+                case MUL:
+                    return is_invariant (state, left) && is_invariant (state, right);
+
+                // a division that may trap stays where it was
+                case DIV:
+                    return is_invariant (state, left) && right != NULL && node_type (pool, right) == NUM &&
+                           right->value != 0 && right->value != -1;
+
+                default:
+                    return 0;
+            }
+
+        case FUNC:
+            return is_call_of (pool, node, state->builtins.sqrt_id) && right != NULL && right->right == 0 &&
+                   is_invariant (state, node_left (pool, right));
+
+        case PARM:
+        case LOCL:
+        case ROOT:
+        default:
+            return 0;
+    }
+}
+
+// the variables the subtree assigns, by 'is' and by gimme
+static void mark_written (struct Licm_t* state, const struct Node_t* node)
+{
+    const struct NodePool_t* pool = state->pool;
+
+    while (node != NULL)
+    {
+        const struct Node_t* var = NULL;
+
+        if (node_type (pool, node) == OP && (int) node->value == EQUAL)
+            var = node_left (pool, node);
+
+        if (is_call_of (pool, node, state->builtins.gimme_id) && node->right != 0)
+            var = node_left (pool, node_right (pool, node));
+
+        if (var != NULL && node_type (pool, var) == ID && var->value >= 0 && (size_t) var->value / 64 < state->words)
+            state->written[var->value / 64] |= UINT64_C (1) << (var->value % 64);
+
+        mark_written (state, node_left (pool, node));
+        node = node_right (pool, node);
+    }
+}
+
+static struct Node_t* make_node (struct Licm_t* state, int type, int64_t value,
+                                 struct Node_t* left, struct Node_t* right)
+{
+    struct Node_t* node = node_pool_alloc (state->pool);
+    if (node == NULL)
+    {
+        fprintf (stderr, "ERROR: could not allocate a node for a hoisted expression\n");
+        state->error = 1;
+        return NULL;
+    }
+
+    set_type  (state->pool, node, type);
+    node->value = value;
+    set_left  (state->pool, node, left);
+    set_right (state->pool, node, right);
+
+    return node;
+}
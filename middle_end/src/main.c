@@ -1,42 +1,163 @@
 #include <stdio.h>
+#include <string.h>
+#include <limits.h>
 
 #include "file.h"
-#include "tree.h"
+#include "tree_io.h"
+#include "tree_bin.h"
 #include "log.h"
 #include "simplification.h"
+#include "propagation.h"
+#include "licm.h"
+#include "dead_code.h"
+#include "opt_stats.h"
+#include "work_dir.h"
+#include "time_report.h"
 
-#define NAME_T_FILENAME "middle_end/Name_Table.txt"
-#define TREE_FILENAME "middle_end/AST_tree.txt"
+#define NAME_T_FILENAME     "middle_end/Name_Table.txt"
+#define TREE_FILENAME       "middle_end/AST_tree.txt"
+#define BINARY_FILENAME     "middle_end/AST_tree.bin"
 
-int main ()
+#define OUT_NAME_T_FILENAME "backend/Name_Table.txt"
+#define OUT_TREE_FILENAME   "backend/AST_tree.txt"
+#define OUT_BINARY_FILENAME "backend/AST_tree.bin"
+
+int main (int argc, const char* argv[])
 {
-    struct Context_t context = {};
+    int text  = 0;
+    int usage = 0;
+
+    const char* input    = NULL;    // binary AST, instead of the one the frontend left in the work directory
+    const char* output   = NULL;
+    const char* work_dir = NULL;
 
-    ctor_keywords (&context);
+    struct TimeReport_t report = {};
+
+    for (int i = 1; i < argc; i++)
+    {
+        if      (strcmp (argv[i], "--text")    == 0)                 text     = 1;
+        else if (strcmp (argv[i], "-o")        == 0 && i + 1 < argc) output   = argv[++i];
+        else if (strcmp (argv[i], "--workdir") == 0 && i + 1 < argc) work_dir = argv[++i];
+        else if (time_report_option (&report, argv[i]))              continue;
+        else if (opt_stats_option (argv[i]))                         continue;
+        else if (argv[i][0] != '-' && input == NULL)                 input    = argv[i];
+        else                                                         usage    = 1;
+    }
 
-    int error = read_name_table (&context, NAME_T_FILENAME);
-    if (error != 0)
+    // the text files only live in the work directory
+    if (usage || (text && (input != NULL || output != NULL)))
+    {
+        fprintf (stderr, "Usage: %s [--text] [--workdir <dir>] [-o <ast.bin>] [--time-report[=json]] [--opt-stats] [<ast.bin>]\n", argv[0]);
         return 1;
+    }
 
-#ifdef DEBUG
-    name_table_dump (stderr, &context);
-#endif
+    if (set_work_dir (work_dir) != 0)
+        return 1;
+
+    char names_path     [PATH_MAX] = {};
+    char tree_path      [PATH_MAX] = {};
+    char binary_path    [PATH_MAX] = {};
+    char out_names_path [PATH_MAX] = {};
+    char out_tree_path  [PATH_MAX] = {};
+    char out_binary_path[PATH_MAX] = {};
+
+    if (text)
+    {
+        if (work_path (names_path,     sizeof (names_path),     NAME_T_FILENAME)     == NULL ||
+            work_path (tree_path,      sizeof (tree_path),      TREE_FILENAME)       == NULL ||
+            work_path (out_names_path, sizeof (out_names_path), OUT_NAME_T_FILENAME) == NULL ||
+            work_path (out_tree_path,  sizeof (out_tree_path),  OUT_TREE_FILENAME)   == NULL)
+            return 1;
+    }
+    else
+    {
+        if ((input  == NULL && (input  = work_path (binary_path,     sizeof (binary_path),     BINARY_FILENAME))     == NULL) ||
+            (output == NULL && (output = work_path (out_binary_path, sizeof (out_binary_path), OUT_BINARY_FILENAME)) == NULL))
+            return 1;
+    }
+
+    struct Context_t context = {};
+
+    if (ctor_keywords (&context) != 0)
+    {
+        dtor_keywords (&context);
+        return 1;
+    }
 
     struct Buffer_t buffer = {};
+    struct Node_t* root = NULL;
+
+    phase_begin (&report, "read AST");
+
+    if (text)
+    {
+        int error = read_name_table (&context, names_path);
+        if (error != 0)
+        {
+            free_context (&context);
+            return 1;
+        }
+
+        root = read_tree (&buffer, &context, tree_path);
+    }
+    else
+        root = read_binary_ast (&buffer, &context, input);
+
+    phase_end (&report, phase_nodes (&report, &context.nodes, root), -1,
+               text ? file_bytes (tree_path) + file_bytes (names_path) : file_bytes (input));
 
-    struct Node_t* root = read_tree (&buffer, &context, TREE_FILENAME);
     if (root == NULL)
     {
         fprintf (stderr, "ERROR: root is NULL\n");
+        free_context (&context);
         return 1;
     }
 
-    simplification_of_expression (root, NULL);
+#ifdef DEBUG
+    name_table_dump (stderr, &context);
+#endif
+
+    phase_begin (&report, "propagation");
+
+    int error = propagate_constants (&context, root);
+
+    phase_end   (&report, phase_nodes (&report, &context.nodes, root), -1, -1);
+    phase_begin (&report, "simplification");
 
-    write_ast_file (root, &context, "backend/AST_tree.txt", 0);
-    write_name_table_file (&context, "backend/Name_Table.txt");
+    error = error || simplification_of_expression (&context, root, NULL);
+
+    phase_end   (&report, phase_nodes (&report, &context.nodes, root), -1, -1);
+    phase_begin (&report, "licm");
+
+    struct IrRegisters_t registers = {};
+
+    error = error || count_ir_registers (&context, root, &registers) ||
+            hoist_loop_invariants (&context, root, &registers);
+
+    phase_end   (&report, phase_nodes (&report, &context.nodes, root), -1, -1);
+    phase_begin (&report, "dead code");
+
+    error = error || eliminate_dead_code (&context, root);
+
+    phase_end   (&report, phase_nodes (&report, &context.nodes, root), -1, -1);
+    phase_begin (&report, "write AST");
+
+    if (text)
+        error = error || write_ast_file        (root, &context, out_tree_path, 0) ||
+                write_name_table_file (&context, out_names_path);
+    else
+        error = error || write_binary_ast (root, &context, output);
+
+    phase_end (&report, -1, -1, text ? file_bytes (out_tree_path) + file_bytes (out_names_path) : file_bytes (output));
+
+    time_report_print (&report, stderr, "middle_end");
+    opt_stats_print   (stderr, "middle_end");
+
+#ifdef DEBUG
+    node_pool_dump (stderr, &context.nodes, "middle_end");
+#endif
 
     destructor (root, &buffer, &context);
 
-    return 0;
+    return error;
 }
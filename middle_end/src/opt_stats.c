@@ -0,0 +1,101 @@
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#include "opt_stats.h"
+
+static int OPT_STATS = 0;
+
+static struct OptCounter_t COUNTERS[MAX_OPT_COUNTERS] = {};
+static int COUNTERS_COUNT = 0;
+
+static struct OptCounter_t* find_counter (const char* pass, const char* name);
+
+int opt_stats_option (const char* argument)
+{
+    assert (argument);
+
+    if (strcmp (argument, "--opt-stats") != 0)
+        return 0;
+
+    OPT_STATS = 1;
+
+    return 1;
+}
+
+// off, with no counters; a process that compiles several programs starts each with it
+void opt_stats_reset (void)
+{
+    OPT_STATS      = 0;
+    COUNTERS_COUNT = 0;
+
+    memset (COUNTERS, 0, sizeof (COUNTERS));
+}
+
+// a counter is created on its first count, in the order the passes ran; past MAX_OPT_COUNTERS
+// new ones are dropped
+void opt_count (const char* pass, const char* name, long value)
+{
+    assert (pass);
+    assert (name);
+
+    struct OptCounter_t* counter = find_counter (pass, name);
+
+    if (counter == NULL)
+    {
+        if (COUNTERS_COUNT == MAX_OPT_COUNTERS)
+            return;
+
+        counter = &COUNTERS[COUNTERS_COUNT++];
+
+        counter->pass = pass;
+        counter->name = name;
+    }
+
+    counter->value += value;
+}
+
+long opt_counter (const char* pass, const char* name)
+{
+    const struct OptCounter_t* counter = find_counter (pass, name);
+
+    return (counter != NULL) ? counter->value : 0;
+}
+
+void opt_stats_print (FILE* file, const char* program)
+{
+    assert (file);
+    assert (program);
+
+    if (!OPT_STATS)
+        return;
+
+    fprintf (file, "optimizer stats (%s):\n", program);
+
+    for (int i = 0; i < COUNTERS_COUNT; i++)
+    {
+        // every pass once, with all of its counters under it
+        int first = 1;
+
+        for (int j = 0; j < i && first; j++)
+            first = (strcmp (COUNTERS[j].pass, COUNTERS[i].pass) != 0);
+
+        if (!first)
+            continue;
+
+        fprintf (file, "  %s\n", COUNTERS[i].pass);
+
+        for (int j = i; j < COUNTERS_COUNT; j++)
+            if (strcmp (COUNTERS[j].pass, COUNTERS[i].pass) == 0)
+                fprintf (file, "    %-32s %10ld\n", COUNTERS[j].name, COUNTERS[j].value);
+    }
+}
+
+static struct OptCounter_t* find_counter (const char* pass, const char* name)
+{
+    for (int i = 0; i < COUNTERS_COUNT; i++)
+        if (strcmp (COUNTERS[i].pass, pass) == 0 && strcmp (COUNTERS[i].name, name) == 0)
+            return &COUNTERS[i];
+
+    return NULL;
+}
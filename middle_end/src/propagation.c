@@ -0,0 +1,397 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include <propagation.h>
+#include <ast_utils.h>
+#include <simplification.h>
+#include <opt_stats.h>
+
+#define TRAIL_START 256                 // first capacity of the trail
+
+enum FactKind_t
+{
+    FACT_UNKNOWN,
+    FACT_CONST,                         // the variable holds 'value'
+    FACT_COPY,                          // the variable holds what the variable with id 'value' does
+};
+
+// what is known about a variable at the statement the walk is on; a copy holds only while its
+// source is not assigned again, and no fact outlives a call of a function of the program
+struct Fact_t
+{
+    enum FactKind_t kind;
+    int64_t         value;
+
+    long version;                       // of the source of a copy, when it was made
+    long epoch;
+};
+
+struct TrailEntry_t
+{
+    int           var;
+    struct Fact_t old;
+};
+
+struct Propagation_t
+{
+    struct NodePool_t* pool;            // of the tree walked
+
+    struct Fact_t* facts;               // by name id
+    long*          versions;            // how many times each variable was assigned
+    int            vars_count;
+
+    long epoch;                         // a call of a function of the program starts a new one
+
+    // every replaced fact, to go back to the state before a loop or an if body
+    struct TrailEntry_t* trail;
+    long                 trail_count;
+    long                 trail_capacity;
+
+    struct Fact_t* merged;              // the facts an if body ended with, while it is undone
+    long           merged_capacity;
+
+    struct Builtins_t builtins;
+
+    long constants;
+    long copies;
+
+    int error;
+};
+
+static void          walk_statements   (struct Propagation_t* state, struct Node_t* node);
+static void          walk_expression   (struct Propagation_t* state, struct Node_t* node);
+static void          substitute        (struct Propagation_t* state, struct Node_t* node);
+static void          forget_assigned   (struct Propagation_t* state, const struct Node_t* node);
+static struct Fact_t fact_of           (const struct Propagation_t* state, int var, struct Node_t* value);
+static struct Fact_t known_fact        (const struct Propagation_t* state, int var);
+static int           same_facts        (struct Fact_t first, struct Fact_t second);
+static void          assign            (struct Propagation_t* state, int var, struct Fact_t fact);
+static void          set_fact          (struct Propagation_t* state, int var, struct Fact_t fact);
+static void          undo_facts        (struct Propagation_t* state, long mark);
+static void          merge_branch      (struct Propagation_t* state, long mark);
+
+// one walk over the statements in the order they run: an assignment makes a fact, a read of a
+// variable with a fact is rewritten; an if body may not run, so after it only the facts both
+// ways agree on are kept, and a loop body forgets everything it assigns before the condition.
+// Counted as "propagation" in --opt-stats
+int propagate_constants (struct Context_t* context, struct Node_t* root)
+{
+    assert (context);
+
+    struct Propagation_t state = {};
+
+    state.pool       = &context->nodes;
+    state.vars_count = context->table_size;
+    state.facts      = (struct Fact_t*) calloc ((size_t) state.vars_count + 1, sizeof (*state.facts));
+    state.versions   = (long*)          calloc ((size_t) state.vars_count + 1, sizeof (*state.versions));
+
+    if (state.facts == NULL || state.versions == NULL)
+    {
+        fprintf (stderr, "ERROR: could not allocate the facts of %d names\n", state.vars_count);
+        free (state.facts);
+        free (state.versions);
+        return 1;
+    }
+
+    find_builtins (context, &state.builtins);
+
+    walk_statements (&state, root);
+
+    opt_count ("propagation", "constants propagated", state.constants);
+    opt_count ("propagation", "copies propagated",    state.copies);
+
+    free (state.facts);
+    free (state.versions);
+    free (state.trail);
+    free (state.merged);
+
+    return state.error;
+}
+
+static void walk_statements (struct Propagation_t* state, struct Node_t* node)
+{
+    const struct NodePool_t* pool = state->pool;
+
+    // the statement lists are walked down their right spine in a loop, they can be long
+    while (node != NULL)
+    {
+        int type = node_type (pool, node);
+        int code = (int) node->value;
+
+        struct Node_t* left  = node_left  (pool, node);
+        struct Node_t* right = node_right (pool, node);
+
+        if ((type == OP && code == GLUE) || (type == FUNC && code == FN_GLUE))
+        {
+            walk_statements (state, left);
+            node = right;
+            continue;
+        }
+
+        if (type == FUNC && code == DEF)
+        {
+            // the parameters are not known, nor is anything of another function
+            state->epoch++;
+            walk_statements (state, right);
+        }
+        else if (type == OP && code == EQUAL && left != NULL && node_type (pool, left) == ID)
+        {
+            walk_expression (state, right);
+
+            int var = (int) left->value;
+
+            assign (state, var, fact_of (state, var, right));
+        }
+        else if (type == OP && code == IF)
+        {
+            walk_expression (state, left);
+
+            long mark = state->trail_count;
+
+            walk_statements (state, right);
+            merge_branch    (state, mark);
+        }
+        else if (type == OP && code == WHILE)
+        {
+            // what holds before the condition now holds on every iteration
+            forget_assigned (state, left);
+            forget_assigned (state, right);
+
+            walk_expression (state, left);
+
+            long mark = state->trail_count;
+
+            walk_statements (state, right);
+            undo_facts      (state, mark);
+        }
+        else
+            walk_expression (state, node);
+
+        return;
+    }
+}
+
+// an expression is evaluated: its reads are rewritten, then what it writes is forgotten
+static void walk_expression (struct Propagation_t* state, struct Node_t* node)
+{
+    // the order of the reads around a call is not worth following
+    if (calls_program (state->pool, &state->builtins, node))
+        state->epoch++;
+
+    substitute      (state, node);
+    forget_assigned (state, node);
+}
+
+static void substitute (struct Propagation_t* state, struct Node_t* node)
+{
+    if (node == NULL || state->error != 0)
+        return;
+
+    struct NodePool_t* pool = state->pool;
+
+    if (node_type (pool, node) == ID)
+    {
+        struct Fact_t fact = known_fact (state, (int) node->value);
+
+        if (fact.kind == FACT_CONST)
+        {
+            set_type (pool, node, NUM);
+            node->value = fact.value;
+            state->constants++;
+        }
+        else if (fact.kind == FACT_COPY)
+        {
+            node->value = fact.value;
+            state->copies++;
+        }
+
+        return;
+    }
+
+    // gimme writes its argument
+    if (is_call_of (pool, node, state->builtins.gimme_id))
+        return;
+
+    substitute (state, node_left  (pool, node));
+    substitute (state, node_right (pool, node));
+}
+
+// every variable the subtree may assign loses its fact, and a call of a function of the program
+// loses all of them
+static void forget_assigned (struct Propagation_t* state, const struct Node_t* node)
+{
+    const struct NodePool_t* pool = state->pool;
+
+    const struct Fact_t unknown = { .kind = FACT_UNKNOWN };
+
+    while (node != NULL)
+    {
+        const struct Node_t* left = node_left (pool, node);
+
+        if (node_type (pool, node) == OP && (int) node->value == EQUAL && left != NULL && node_type (pool, left) == ID)
+            assign (state, (int) left->value, unknown);
+
+        if (is_call_of (pool, node, state->builtins.gimme_id))
+        {
+            for (const struct Node_t* argument = node_right (pool, node); argument != NULL;
+                 argument = node_right (pool, argument))
+            {
+                const struct Node_t* target = node_left (pool, argument);
+
+                if (target != NULL && node_type (pool, target) == ID)
+                    assign (state, (int) target->value, unknown);
+            }
+        }
+        else if (node_type (pool, node) == FUNC && (int) node->value == CALL &&
+                 !is_call_of (pool, node, state->builtins.sqrt_id) && !is_call_of (pool, node, state->builtins.yap_id))
+            state->epoch++;
+
+        forget_assigned (state, left);
+        node = node_right (pool, node);
+    }
+}
+
+// what the assignment of 'value' to 'var' makes known, its reads are rewritten already
+static struct Fact_t fact_of (const struct Propagation_t* state, int var, struct Node_t* value)
+{
+    struct Fact_t fact = { .kind = FACT_UNKNOWN };
+
+    int64_t number = 0;
+
+    if (value == NULL)
+        return fact;
+
+    if (node_type (state->pool, value) == ID && (int) value->value != var &&
+        value->value >= 0 && value->value < state->vars_count)
+    {
+        fact.kind    = FACT_COPY;
+        fact.value   = value->value;
+        fact.version = state->versions[value->value];
+    }
+    else if (eval (state->pool, value, &number) == 0)
+    {
+        fact.kind  = FACT_CONST;
+        fact.value = number;
+    }
+
+    return fact;
+}
+
+static struct Fact_t known_fact (const struct Propagation_t* state, int var)
+{
+    const struct Fact_t unknown = { .kind = FACT_UNKNOWN };
+
+    if (var < 0 || var >= state->vars_count)
+        return unknown;
+
+    struct Fact_t fact = state->facts[var];
+
+    if (fact.kind == FACT_UNKNOWN || fact.epoch != state->epoch ||
+        (fact.kind == FACT_COPY && state->versions[fact.value] != fact.version))
+        return unknown;
+
+    return fact;
+}
+
+static int same_facts (struct Fact_t first, struct Fact_t second)
+{
+    return first.kind == second.kind &&
+           (first.kind == FACT_UNKNOWN ||
+            (first.value == second.value && (first.kind != FACT_COPY || first.version == second.version)));
+}
+
+// a new value of 'var': the copies made from it no longer hold
+static void assign (struct Propagation_t* state, int var, struct Fact_t fact)
+{
+    if (var < 0 || var >= state->vars_count)
+        return;
+
+    state->versions[var]++;
+
+    set_fact (state, var, fact);
+}
+
+static void set_fact (struct Propagation_t* state, int var, struct Fact_t fact)
+{
+    if (state->error != 0)
+        return;
+
+    if (state->trail_count == state->trail_capacity)
+    {
+        long capacity = (state->trail_capacity == 0) ? TRAIL_START : 2 * state->trail_capacity;
+
+        struct TrailEntry_t* trail = (struct TrailEntry_t*) realloc (state->trail, (size_t) capacity * sizeof (*trail));
+
+        if (trail == NULL)
+        {
+            // nothing could be undone: no read is rewritten from here on
+            fprintf (stderr, "ERROR: could not grow the propagation trail to %ld entries\n", capacity);
+            state->error = 1;
+            return;
+        }
+
+        state->trail          = trail;
+        state->trail_capacity = capacity;
+    }
+
+    state->trail[state->trail_count].var = var;
+    state->trail[state->trail_count].old = state->facts[var];
+    state->trail_count++;
+
+    fact.epoch = state->epoch;
+    state->facts[var] = fact;
+}
+
+// back to the facts as they were at 'mark'; the versions and the epoch are not undone, so a copy
+// whose source was assigned since, or any fact from before a call, stays forgotten
+static void undo_facts (struct Propagation_t* state, long mark)
+{
+    while (state->trail_count > mark)
+    {
+        state->trail_count--;
+        state->facts[state->trail[state->trail_count].var] = state->trail[state->trail_count].old;
+    }
+}
+
+// after an if body: a variable the body changed keeps its fact only if it is the one from before
+static void merge_branch (struct Propagation_t* state, long mark)
+{
+    long top = state->trail_count;
+
+    if (state->error != 0 || top == mark)
+        return;
+
+    if (top - mark > state->merged_capacity)
+    {
+        struct Fact_t* merged = (struct Fact_t*) realloc (state->merged, (size_t) (top - mark) * sizeof (*merged));
+
+        if (merged == NULL)
+        {
+            fprintf (stderr, "ERROR: could not allocate %ld facts to merge\n", top - mark);
+            state->error = 1;
+            return;
+        }
+
+        state->merged          = merged;
+        state->merged_capacity = top - mark;
+    }
+
+    for (long i = mark; i < top; i++)
+        state->merged[i - mark] = known_fact (state, state->trail[i].var);
+
+    // the entries stay in the array: a forgotten fact is pushed at or below the one being read
+    undo_facts (state, mark);
+
+    const struct Fact_t unknown = { .kind = FACT_UNKNOWN };
+
+    for (long i = mark; i < top; i++)
+    {
+        int var = state->trail[i].var;
+
+        if (!same_facts (known_fact (state, var), state->merged[i - mark]))
+            set_fact (state, var, unknown);
+    }
+}
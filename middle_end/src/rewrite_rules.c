@@ -0,0 +1,389 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#include "rewrite_rules.h"
+#include "ast_utils.h"
+#include "simplification.h"
+#include "opt_stats.h"
+#include "enum.h"
+
+#define MAX_STEPS 8                     // nodes of a pattern or of a result, the end mark included
+
+enum StepKind_t
+{
+    STEP_END,                           // past the last node
+    STEP_OP,                            // an operation node with this code
+    STEP_NUM,                           // a number with this value
+    STEP_CONST,                         // any number, bound to the variable
+    STEP_ANY,                           // any subtree, bound to the variable
+};
+
+// x matches any subtree, c1 and c2 only a number
+enum RuleVar_t
+{
+    X,
+    C1,
+    C2,
+    VARS_COUNT,
+};
+
+// a node of a pattern or of a result; in a result, STEP_CONST and STEP_ANY stand for the
+// subtree the pattern bound to the variable
+struct Step_t
+{
+    enum StepKind_t kind;
+    int64_t         value;              // operation code, number or variable
+};
+
+// a pattern and a result are their nodes in pre-order: an operation, then its left and its
+// right subtree
+struct Rule_t
+{
+    const char*   text;                 // what --opt-stats counts its fires under
+    struct Step_t pattern[MAX_STEPS];   // the top is an operation
+    struct Step_t result [MAX_STEPS];
+};
+
+// a variable bound twice matches equal subtrees. A subtree the result does not keep must not call
+// anything: its calls would be lost. When several rules match, the first one in the table wins
+static const struct Rule_t RULES[] =
+{
+    { "MUL(x, 0)           -> 0", { { STEP_OP, MUL }, { STEP_ANY, X }, { STEP_NUM, 0 } }, { { STEP_NUM, 0 } } },
+    { "MUL(0, x)           -> 0", { { STEP_OP, MUL }, { STEP_NUM, 0 }, { STEP_ANY, X } }, { { STEP_NUM, 0 } } },
+    { "MUL(x, 1)           -> x", { { STEP_OP, MUL }, { STEP_ANY, X }, { STEP_NUM, 1 } }, { { STEP_ANY, X } } },
+    { "MUL(1, x)           -> x", { { STEP_OP, MUL }, { STEP_NUM, 1 }, { STEP_ANY, X } }, { { STEP_ANY, X } } },
+    { "ADD(x, 0)           -> x", { { STEP_OP, ADD }, { STEP_ANY, X }, { STEP_NUM, 0 } }, { { STEP_ANY, X } } },
+    { "ADD(0, x)           -> x", { { STEP_OP, ADD }, { STEP_NUM, 0 }, { STEP_ANY, X } }, { { STEP_ANY, X } } },
+    { "SUB(x, 0)           -> x", { { STEP_OP, SUB }, { STEP_ANY, X }, { STEP_NUM, 0 } }, { { STEP_ANY, X } } },
+    { "SUB(x, x)           -> 0", { { STEP_OP, SUB }, { STEP_ANY, X }, { STEP_ANY, X } }, { { STEP_NUM, 0 } } },
+    { "DIV(x, 1)           -> x", { { STEP_OP, DIV }, { STEP_ANY, X }, { STEP_NUM, 1 } }, { { STEP_ANY, X } } },
+    { "POW(x, 1)           -> x", { { STEP_OP, POW }, { STEP_ANY, X }, { STEP_NUM, 1 } }, { { STEP_ANY, X } } },
+
+    { "ADD(ADD(x, c1), c2) -> ADD(x, ADD(c1, c2))",
+      { { STEP_OP, ADD }, { STEP_OP, ADD }, { STEP_ANY, X }, { STEP_CONST, C1 }, { STEP_CONST, C2 } },
+      { { STEP_OP, ADD }, { STEP_ANY, X }, { STEP_OP, ADD }, { STEP_CONST, C1 }, { STEP_CONST, C2 } } },
+
+    { "ADD(SUB(x, c1), c2) -> ADD(x, SUB(c2, c1))",
+      { { STEP_OP, ADD }, { STEP_OP, SUB }, { STEP_ANY, X }, { STEP_CONST, C1 }, { STEP_CONST, C2 } },
+      { { STEP_OP, ADD }, { STEP_ANY, X }, { STEP_OP, SUB }, { STEP_CONST, C2 }, { STEP_CONST, C1 } } },
+
+    { "SUB(ADD(x, c1), c2) -> ADD(x, SUB(c1, c2))",
+      { { STEP_OP, SUB }, { STEP_OP, ADD }, { STEP_ANY, X }, { STEP_CONST, C1 }, { STEP_CONST, C2 } },
+      { { STEP_OP, ADD }, { STEP_ANY, X }, { STEP_OP, SUB }, { STEP_CONST, C1 }, { STEP_CONST, C2 } } },
+
+    { "SUB(SUB(x, c1), c2) -> SUB(x, ADD(c1, c2))",
+      { { STEP_OP, SUB }, { STEP_OP, SUB }, { STEP_ANY, X }, { STEP_CONST, C1 }, { STEP_CONST, C2 } },
+      { { STEP_OP, SUB }, { STEP_ANY, X }, { STEP_OP, ADD }, { STEP_CONST, C1 }, { STEP_CONST, C2 } } },
+
+    { "MUL(MUL(x, c1), c2) -> MUL(x, MUL(c1, c2))",
+      { { STEP_OP, MUL }, { STEP_OP, MUL }, { STEP_ANY, X }, { STEP_CONST, C1 }, { STEP_CONST, C2 } },
+      { { STEP_OP, MUL }, { STEP_ANY, X }, { STEP_OP, MUL }, { STEP_CONST, C1 }, { STEP_CONST, C2 } } },
+};
+
+#define RULES_COUNT ( (int) (sizeof (RULES) / sizeof (RULES[0])) )
+
+static_assert (sizeof (RULES) / sizeof (RULES[0]) <= MAX_REWRITE_RULES, "the fires of a rule are not counted");
+
+#define IS_VAR(kind) ((kind) == STEP_CONST || (kind) == STEP_ANY)
+
+// what matching a rule bound: the node every step of the pattern was tested on, and the subtree
+// of every variable
+struct Match_t
+{
+    struct Node_t* path[MAX_STEPS];
+    struct Node_t* vars[VARS_COUNT];
+    uint32_t       kept;                // the variables the result keeps
+};
+
+static int            match_rule    (const struct NodePool_t* pool, const struct Rule_t* rule, struct Node_t* node,
+                                     struct Match_t* match);
+static int            match_step    (const struct NodePool_t* pool, const struct Step_t* pattern, int* step,
+                                     struct Node_t* node, struct Match_t* match);
+static int            fits_step     (const struct NodePool_t* pool, const struct Step_t* test,
+                                     const struct Node_t* node);
+static struct Node_t* instantiate   (struct NodePool_t* pool, const struct Rule_t* rule, int* step,
+                                     const struct Match_t* match, struct Node_t* reuse);
+static void           release_built (struct NodePool_t* pool, const struct Step_t* result, int* step,
+                                     struct Node_t* node);
+static int            has_calls     (const struct NodePool_t* pool, const struct Node_t* node);
+
+// rewrites the node *link points to by the first rule that matches it; returns 1 if it did,
+// -1 if the result could not be built, the node is left as it was then
+int apply_rewrite_rules (struct NodePool_t* pool, uint32_t* link, struct RuleFires_t* fires)
+{
+    assert (pool);
+    assert (link);
+    assert (fires);
+
+    struct Node_t* node = node_at (pool, *link);
+
+    if (node == NULL || node_type (pool, node) != OP || node->left == 0 || node->right == 0)
+        return 0;
+
+    struct Match_t match = {};
+
+    int index = 0;
+
+    while (index < RULES_COUNT && !match_rule (pool, &RULES[index], node, &match))
+        index++;
+
+    if (index == RULES_COUNT)
+        return 0;
+
+    const struct Rule_t* rule = &RULES[index];
+
+    // the result is built first, into the node itself unless it is one of the subtrees: none of
+    // the nodes it keeps are released before
+    int step = 0;
+
+    struct Node_t* result = instantiate (pool, rule, &step, &match, node);
+
+    if (result == NULL)
+        return -1;
+
+    *link = node_index (pool, result);
+
+    for (int i = 0; rule->pattern[i].kind != STEP_END; i++)
+    {
+        struct Node_t* tested = match.path[i];
+
+        if (rule->pattern[i].kind == STEP_OP || rule->pattern[i].kind == STEP_NUM)
+        {
+            if (tested != result)
+                delete_node (pool, tested);
+        }
+        // a subtree bound again, or one the result drops
+        else if (match.vars[rule->pattern[i].value] != tested ||
+                 !((match.kept >> rule->pattern[i].value) & 1))
+            delete_sub_tree (pool, tested);
+    }
+
+    fires->fired[index]++;
+
+    return 1;
+}
+
+// a pattern starts with an operation, and a result keeps every variable its pattern binds at most
+// once, there is nothing to copy it from twice; both end before MAX_STEPS
+int check_rewrite_rules (void)
+{
+    for (int i = 0; i < RULES_COUNT; i++)
+    {
+        const struct Rule_t* rule = &RULES[i];
+
+        int bound[VARS_COUNT] = {};
+        int used [VARS_COUNT] = {};
+
+        int error = (rule->pattern[0].kind != STEP_OP || rule->pattern[MAX_STEPS - 1].kind != STEP_END ||
+                     rule->result [MAX_STEPS - 1].kind != STEP_END);
+
+        for (int step = 0; step < MAX_STEPS; step++)
+        {
+            if (IS_VAR (rule->pattern[step].kind)) bound[rule->pattern[step].value] = 1;
+            if (IS_VAR (rule->result [step].kind)) used [rule->result [step].value]++;
+        }
+
+        for (int var = 0; var < VARS_COUNT; var++)
+            error = error || used[var] > bound[var];
+
+        if (error)
+        {
+            fprintf (stderr, "ERROR: rewrite rule '%s' is malformed\n", rule->text);
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+// every rule that fired is counted under "rewrite rules" in --opt-stats, in table order
+void count_rule_fires (const struct RuleFires_t* fires)
+{
+    assert (fires);
+
+    for (int i = 0; i < RULES_COUNT; i++)
+        if (fires->fired[i] != 0)
+            opt_count ("rewrite rules", RULES[i].text, fires->fired[i]);
+}
+
+// the tests of the pattern on a pre-order walk of the node; returns 1 if the rule matches and holds
+static int match_rule (const struct NodePool_t* pool, const struct Rule_t* rule, struct Node_t* node,
+                       struct Match_t* match)
+{
+    // most rules are turned down by the operation at their top or by the left child, before
+    // anything is bound; the node is an operation with both children
+    if (node->value != rule->pattern[0].value || !fits_step (pool, &rule->pattern[1], node_left (pool, node)))
+        return 0;
+
+    for (int var = 0; var < VARS_COUNT; var++)
+        match->vars[var] = NULL;
+
+    int step = 0;
+
+    if (!match_step (pool, rule->pattern, &step, node, match))
+        return 0;
+
+    match->kept = 0;
+
+    for (int i = 0; rule->result[i].kind != STEP_END; i++)
+        if (IS_VAR (rule->result[i].kind))
+            match->kept |= UINT32_C (1) << rule->result[i].value;
+
+    // a subtree the result drops does not call anything
+    for (int var = 0; var < VARS_COUNT; var++)
+        if (match->vars[var] != NULL && !((match->kept >> var) & 1) && has_calls (pool, match->vars[var]))
+            return 0;
+
+    return 1;
+}
+
+// tests the node by the step of the pattern and its children by the steps after it
+static int match_step (const struct NodePool_t* pool, const struct Step_t* pattern, int* step,
+                       struct Node_t* node, struct Match_t* match)
+{
+    const struct Step_t* test = &pattern[*step];
+
+    match->path[(*step)++] = node;
+
+    if (!fits_step (pool, test, node))
+        return 0;
+
+    if (test->kind == STEP_OP)
+        return match_step (pool, pattern, step, node_left  (pool, node), match) &&
+               match_step (pool, pattern, step, node_right (pool, node), match);
+
+    if (IS_VAR (test->kind))
+    {
+        struct Node_t** bound = &match->vars[test->value];
+
+        // a variable bound again is the same subtree, which is dropped: it must not call anything
+        if (*bound != NULL)
+            return same_trees (pool, *bound, node) && !has_calls (pool, node);
+
+        *bound = node;
+    }
+
+    return 1;
+}
+
+// tests the node alone by the step, not its children
+static int fits_step (const struct NodePool_t* pool, const struct Step_t* test, const struct Node_t* node)
+{
+    switch (test->kind)
+    {
+        case STEP_OP:
+            return node_type (pool, node) == OP && node->value == test->value && node->left != 0 && node->right != 0;
+
+        case STEP_NUM:
+            return node_type (pool, node) == NUM && node->value == test->value;
+
+        case STEP_CONST:
+            return node_type (pool, node) == NUM;
+
+        case STEP_ANY:
+            return 1;
+
+        case STEP_END:
+        default:
+            return 0;
+    }
+}
+
+// builds the result, folding an operation on two numbers right away; its top goes into 'reuse'
+// if that is not NULL, once nothing can fail any more. Returns NULL if a node could not be
+// allocated, with what was built of it released and 'reuse' untouched
+static struct Node_t* instantiate (struct NodePool_t* pool, const struct Rule_t* rule, int* step,
+                                   const struct Match_t* match, struct Node_t* reuse)
+{
+    const struct Step_t* template = &rule->result[(*step)++];
+
+    if (IS_VAR (template->kind))
+        return match->vars[template->value];
+
+    struct Node_t* left  = NULL;
+    struct Node_t* right = NULL;
+
+    int left_step = *step;
+
+    if (template->kind == STEP_OP)
+    {
+        left  = instantiate (pool, rule, step, match, NULL);
+        right = (left != NULL) ? instantiate (pool, rule, step, match, NULL) : NULL;
+
+        if (right == NULL)
+        {
+            if (left != NULL)
+                release_built (pool, rule->result, &left_step, left);
+
+            return NULL;
+        }
+    }
+
+    struct Node_t* node = (reuse != NULL) ? reuse : node_pool_alloc (pool);
+    if (node == NULL)
+    {
+        fprintf (stderr, "ERROR: could not allocate a node for rewrite rule '%s'\n", rule->text);
+
+        if (left != NULL)
+        {
+            release_built (pool, rule->result, &left_step, left);
+            release_built (pool, rule->result, &left_step, right);
+        }
+
+        return NULL;
+    }
+
+    set_type  (pool, node, (template->kind == STEP_OP) ? OP : NUM);
+    node->value = template->value;
+    set_left  (pool, node, left);
+    set_right (pool, node, right);
+
+    int64_t answer = 0;
+
+    if (left != NULL && node_type (pool, left) == NUM && node_type (pool, right) == NUM &&
+        eval (pool, node, &answer) == 0)
+    {
+        delete_node (pool, left);
+        delete_node (pool, right);
+
+        set_type (pool, node, NUM);
+        node->value = answer;
+        node->left  = 0;
+        node->right = 0;
+    }
+
+    return node;
+}
+
+// releases the nodes instantiate made for the result from the step on, not the subtrees bound to
+// its variables
+static void release_built (struct NodePool_t* pool, const struct Step_t* result, int* step, struct Node_t* node)
+{
+    const struct Step_t* template = &result[(*step)++];
+
+    if (IS_VAR (template->kind))
+        return;
+
+    // a folded operation has no children left, the steps of theirs are only skipped
+    if (template->kind == STEP_OP)
+    {
+        release_built (pool, result, step, (node != NULL) ? node_left  (pool, node) : NULL);
+        release_built (pool, result, step, (node != NULL) ? node_right (pool, node) : NULL);
+    }
+
+    if (node != NULL)
+        delete_node (pool, node);
+}
+
+static int has_calls (const struct NodePool_t* pool, const struct Node_t* node)
+{
+    if (node == NULL)
+        return 0;
+
+    if (node_type (pool, node) == FUNC && (int) node->value == CALL)
+        return 1;
+
+    return has_calls (pool, node_left (pool, node)) || has_calls (pool, node_right (pool, node));
+}
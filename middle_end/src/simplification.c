@@ -1,20 +1,33 @@
 #include <stdio.h>
+#include <stdint.h>
+#include <inttypes.h>
 #include <assert.h>
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
 
 #include <simplification.h>
+#include <opt_stats.h>
+#include <rewrite_rules.h>
+#include <keywords.h>
 
-#define MAX_OPTIMIZATIONS 100
+#define STACK_START 1024
 
-#define _IS(where, what) (root && root->where &&         \
-                          root->where->type  ==  NUM  && \
-                          (int) root->where->value == (what))
-
-#define $ verificator(root, __FILE__, __LINE__);
-
-double eval (struct Node_t* node)
+// a link waiting on the simplification stack: its children are pushed when it is expanded
+struct PendingLink_t
+{
+    uint32_t* link;
+    int       expanded;
+};
+
+static int simplify_node (struct NodePool_t* pool, uint32_t* link, int sqrt_id, long* folded,
+                          struct RuleFires_t* fires);
+static int eval_sqrt     (const struct NodePool_t* pool, const struct Node_t* call, int sqrt_id, int64_t* result);
+
+// evaluates a constant subtree with the 64-bit integer semantics of the generated code:
+// the arithmetic wraps around, a division that would trap is left to the runtime;
+// returns 0 and stores the value in 'result' when the subtree can be folded
+int eval (const struct NodePool_t* pool, const struct Node_t* node, int64_t* result)
 {
 #ifdef DEBUG
     fprintf (stderr, "Starting evaluation...\n");
@@ -25,326 +38,269 @@ double eval (struct Node_t* node)
 #ifdef DEBUG
         fprintf (stderr, "ERROR: Node is NULL\n");
 #endif
-        return NAN;
+        return 1;
     }
 
-    if (node->type == NUM)
+    int type = node_type (pool, node);
+
+    if (type == NUM)
     {
-        double value = node->value;
+        *result = node->value;
 #ifdef DEBUG
-        fprintf (stderr, "node->type = NUM >>> node->value = %lg\n\n", node->value);
+        fprintf (stderr, "node->type = NUM >>> node->value = %" PRId64 "\n\n", node->value);
 #endif
 
-        return value;
+        return 0;
     }
 
-    if (node->type == ID)
+    if (type == ID)
     {
 #ifdef DEBUG
         fprintf (stderr, "node->type = ID >>> node->value = %c\n\n", (int) node->value);
 #endif
-        return NAN;
+        return 1;
     }
 
-    if (node->type == OP)
+    if (type == OP)
     {
 #ifdef DEBUG
         fprintf (stderr, "node->type = OP >>> node->value = %c\n\n", (int) node->value);
 #endif
 
+        int64_t left  = 0;
+        int64_t right = 0;
+
+        if (eval (pool, node_left (pool, node), &left) != 0 || eval (pool, node_right (pool, node), &right) != 0)
+            return 1;
+
         switch ( (int) node->value )
         {
             case ADD:
-            {
-                double res = eval (node->left) +
-                             eval (node->right);
-
-#ifdef DEBUG
-                fprintf (stderr, "case ADD: result = %lg\n\n", res);
-#endif
-                return res;
-            }
+                *result = (int64_t) ((uint64_t) left + (uint64_t) right);
+                break;
 
             case SUB:
-            {
-                double res = eval (node->left) -
-                             eval (node->right);
-#ifdef DEBUG
-                fprintf (stderr, "case SUB: result = %lg\n\n", res);
-#endif
-                return res;
-            }
-
-            case DIV:
-            {
-                double res = eval (node->left) /
-                             eval (node->right);
-#ifdef DEBUG
-                fprintf (stderr, "case DIV: result = %lg\n\n", res);
-#endif
-                return res;
-            }
+                *result = (int64_t) ((uint64_t) left - (uint64_t) right);
+                break;
 
             case MUL:
-            {
-                double res = eval (node->left) *
-                             eval (node->right);
-#ifdef DEBUG
-                fprintf (stderr, "case MUL: result = %lg\n\n", res);
-#endif
-                return res;
-            }
+                *result = (int64_t) ((uint64_t) left * (uint64_t) right);
+                break;
 
-            case SIN:
-            {
-                double res = sin ( eval (node->left) );
+            // idiv truncates towards zero, as C does
+            case DIV:
+                if (right == 0 || (left == INT64_MIN && right == -1))
+                {
 #ifdef DEBUG
-                fprintf (stderr, "case SIN: result = %lg\n\n", res);
+                    fprintf (stderr, "case DIV: %" PRId64 " / %" PRId64 " is not folded\n\n", left, right);
 #endif
-                return res;
-            }
+                    return 1;
+                }
 
-            case COS:
-            {
-                double res = cos ( eval (node->left) );
-#ifdef DEBUG
-                fprintf (stderr, "case COS: result = %lg\n\n", res);
-#endif
-                return res;
-            }
+                *result = left / right;
+                break;
+
+            // the conditions compare signed, a folded one is 1 or 0
+            case GT:  *result = (left >  right); break;
+            case LT:  *result = (left <  right); break;
+            case GTE: *result = (left >= right); break;
+            case NEQ: *result = (left != right); break;
+            case EQ:  *result = (left == right); break;
 
+            // POW, SIN, COS and LN have no code generated for them, there is nothing to agree with
             default:
-            {
 #ifdef DEBUG
-                fprintf (stderr, "Unknown operation. returned 1");
+                fprintf (stderr, "case %d: not folded\n\n", (int) node->value);
 #endif
                 return 1;
-            }
         }
+
+#ifdef DEBUG
+        fprintf (stderr, "case %d: result = %" PRId64 "\n\n", (int) node->value, *result);
+#endif
+        return 0;
     }
     else
     {
 #ifdef DEBUG
         fprintf (stderr, "ERROR with evaluation!!! Thats not a number, id or operation\n");
 #endif
-        return NAN;
+        return 1;
     }
 }
 
-int simplification_typical_operations (struct Node_t* root, struct Node_t* parent)
+void verificator (const struct NodePool_t* pool, const struct Node_t* node, const char* filename, int line)
 {
-    assert (root);
+    if (node_type (pool, node) == 0)
+        fprintf (stderr, "%s:%d: vasalam u have a problem: node [%p]: type = %d, value = %c (%" PRId64 ")\n\n",
+                 filename, line, (const void*) node, node_type (pool, node), (int) node->value, node->value);
 
-    int count_changes = 0;
+    if (node->left)  verificator (pool, node_left  (pool, node), filename, line);
+    if (node->right) verificator (pool, node_right (pool, node), filename, line);
+}
 
-    if (root->left)
-        count_changes += simplification_typical_operations (root->left, root);
+// one rewrite of the node *link points to, its children are simple already: by the first rule
+// of the table that matches, or by folding an operation on two numbers or sqrt of a number;
+// returns 1 if it did, -1 if a rule could not build its result
+static int simplify_node (struct NodePool_t* pool, uint32_t* link, int sqrt_id, long* folded,
+                          struct RuleFires_t* fires)
+{
+    struct Node_t* node = node_at (pool, *link);
 
-    if (root->right)
-        count_changes += simplification_typical_operations (root->right, root);
+    int64_t answer = 0;
 
-    if ( (root->type == OP) && ((int) root->value == MUL ))
+    if (node_type (pool, node) == OP)
     {
-        if ( _IS (left, 0) || _IS (right, 0) )
-        {
-            //dump_in_log_file (parent, "<h1> BEFORE DELETE MUL: </h1>", root->left, root->right);
-
-            delete_sub_tree (root->left);
-            delete_sub_tree (root->right);
+        int rewritten = apply_rewrite_rules (pool, link, fires);
 
-            root->type  = NUM;
-            root->value = 0;
+        if (rewritten != 0)
+            return rewritten;
 
-            root->left  = NULL;
-            root->right = NULL;
-
-            //dump_in_log_file (parent, "<h1>AFTER DELETE: delete node->left [%p], delete node->right [%p]:</h1>", root->left, root->right);
-
-            return count_changes;
-        }
+        if (node->left  == 0 || node_type (pool, node_left  (pool, node)) != NUM ||
+            node->right == 0 || node_type (pool, node_right (pool, node)) != NUM ||
+            eval (pool, node, &answer) != 0)
+            return 0;
     }
+    else if (eval_sqrt (pool, node, sqrt_id, &answer) != 0)
+        return 0;
 
-    if ( (root->type == OP) && ((int) root->value == MUL) )
-    {
-        if ( _IS (left, 1) )
-        {
-            //dump_in_log_file (parent, "<h1> BEFORE DELETE MUL: </h1>", root->left, root->right);
-
-            if (parent->left == root)
-                parent->left  = root->right;
-            else
-                parent->right = root->right;
-
-            delete_node (root->left);
-            delete_node (root);
-
-            //dump_in_log_file (parent, "<h1>AFTER DELETE: delete node->left [%p], delete node->right [%p]:</h1>", root->left, root->right);
+#ifdef DEBUG
+    fprintf (stderr, "folded node [%p]: answer = %" PRId64 "\n", node, answer);
+#endif
 
-            return count_changes;
-        }
+    delete_sub_tree (pool, node_left  (pool, node));
+    delete_sub_tree (pool, node_right (pool, node));
 
-        if ( _IS (right, 1) )
-        {
-            //dump_in_log_file (parent, "<h1> BEFORE DELETE MUL: </h1>", root->left, root->right);
+    set_type (pool, node, NUM);
+    node->value = answer;
 
-            if (parent->left == root)
-                parent->left  = root->left;
-            else
-                parent->right = root->left;
+    node->left  = 0;
+    node->right = 0;
 
-            delete_node (root->right);
-            delete_node (root);
+    (*folded)++;
 
-            //dump_in_log_file (parent, "<h1>AFTER DELETE: delete node->left [%p], delete node->right [%p]:</h1>", root->left, root->right);
+    return 1;
+}
 
-            return count_changes;
-        }
-    }
+// sqrt is cvtsi2sd, sqrtsd and cvttsd2si: the root of the nearest double, truncated; the root of
+// a negative number is NaN, which converts to INT64_MIN; returns 0 if 'call' is sqrt of a number
+static int eval_sqrt (const struct NodePool_t* pool, const struct Node_t* call, int sqrt_id, int64_t* result)
+{
+    if (node_type (pool, call) != FUNC || (int) call->value != CALL || call->left == 0 || call->right == 0)
+        return 1;
 
-    if ( (root->type == OP) && ((int) root->value == ADD))
-    {
-        if ( _IS (left, 0) )
-        {
-$           if (parent->left == root)
-                parent->left  = root->right;
-            else
-                parent->right = root->right;
-$
-            //dump_in_log_file (parent, "<h1>BEFORE DELETE ADD left:</h1>", root->left, root);
+    const struct Node_t* name  = node_left  (pool, call);
+    const struct Node_t* comma = node_right (pool, call);
 
-            delete_node (root->left);
-            delete_node (root);
+    if (name->value != sqrt_id || node_type (pool, comma) != FUNC || (int) comma->value != COMMA ||
+        comma->left == 0 || node_type (pool, node_left (pool, comma)) != NUM || comma->right != 0)
+        return 1;
 
-            //dump_in_log_file (parent, "<h1>AFTER DELETE: delete node->left [%p], delete node [%p] :</h1>", root->left, root);
+    int64_t argument = node_left (pool, comma)->value;
 
-            return count_changes;
-        }
+    *result = (argument < 0) ? INT64_MIN : (int64_t) sqrt ( (double) argument );
 
-        if ( _IS (right, 0) )
-        {
-            //dump_in_log_file (parent, "<h1>BEFORE DELETE ADD right");
+    return 0;
+}
 
-            if (parent->left == root)
-                parent->left  = root->left;
-            else
-                parent->right = root->left; //func
+// every node is rewritten once its children are: the links to the nodes are walked in post-order,
+// so a rewrite only enables rules on the parents, which come later in the walk anyway, and the
+// fixpoint is reached in one pass; a rewritten node is simplified again on the spot, the node that
+// took its place may match another rule. Counted as "simplification" in --opt-stats
+int simplification_of_expression (struct Context_t* context, struct Node_t* root, struct Node_t* parent)
+{
+    assert (context);
 
-            delete_node (root->right);
-            delete_node (root);
+    if (root == NULL)
+        return 0;
 
-            //dump_in_log_file (parent, "<h1>delete node->left [%p], delete node [%p]:</h1>", root->left, root->right);
+    if (check_rewrite_rules () != 0)
+        return 1;
 
-            return count_changes;
-        }
-    }
+    // a link is expanded the first time it is on top of the stack and simplified the second
+    // time, after the children pushed above it: that is post-order, with no list of every node
+    long                  count    = 0;
+    long                  capacity = STACK_START;
+    struct PendingLink_t* stack    = (struct PendingLink_t*) calloc ((size_t) capacity, sizeof (*stack));
 
-    if ( (root->type == OP) && ((int) root->value == POW ))
+    if (stack == NULL)
     {
-        if ( _IS (right, 1) )
-        {
-            //dump_in_log_file (parent, "<h1>BEFORE DELETE POW</h1>");
+        fprintf (stderr, "ERROR: could not allocate the simplification stack\n");
+        return 1;
+    }
 
-            if (parent->left == root)
-                parent->left  = root->left;
-            else
-                parent->right = root->left;
+    struct NodePool_t* pool = &context->nodes;
 
-            delete_node (root->right);
-            delete_node (root);
+    uint32_t top = node_index (pool, root);
 
-            //dump_in_log_file (parent, "<h1>AFTER DELETE POW</h1>");
+    stack[count++] = (struct PendingLink_t) { .link = &top };
 
-            return count_changes;
-        }
-    }
+    int sqrt_id = find_symbol_id (context, "sqrt", (int) strlen ("sqrt"));
 
-    return count_changes;
-}
-
-#undef $
-#undef _IS
-
-void verificator (struct Node_t* node, const char* filename, int line)
-{
-    if (node->type == 0)
-        fprintf (stderr, "%s:%d: vasalam u have a problem: node [%p]: type = %d, value = %c (%lg)\n\n",
-                 filename, line, node, node->type, (int) node->value, node->value);
+    long visited   = 0;
+    long rewritten = 0;
+    long folded    = 0;
 
-    if (node->left)  verificator (node->left, filename, line);
-    if (node->right) verificator (node->right, filename, line);
-}
+    struct RuleFires_t fires = {};
 
-int constant_folding (struct Node_t* root)
-{
-    assert (root);
+    int status = 0;
 
-    int count_changes = 0;
+    while (count > 0 && status >= 0)
+    {
+        struct PendingLink_t* pending = &stack[count - 1];
+        uint32_t*             link    = pending->link;
 
-    if (root->left)
-        count_changes += constant_folding (root->left);
+        if (pending->expanded)
+        {
+            count--;
+            visited++;
 
-    if (root->right)
-        count_changes += constant_folding (root->right);
+            while ((status = simplify_node (pool, link, sqrt_id, &folded, &fires)) > 0)
+                rewritten++;
 
-    if (root &&
-        root->left  != NULL &&
-        root->right != NULL &&
-        root->type == OP &&
-        root->left->type  == NUM &&
-        root->right->type == NUM)
-    {
-        double answer = eval (root);
-#ifdef DEBUG
-        fprintf (stderr, "\nlol im in if: node [%p]: type=%d, left=%g, right=%g, answer = %lg\n\n",
-                 root, root->type, root->left->value, root->right->value, answer);
-#endif
+            continue;
+        }
 
-        struct Node_t* left_to_delete  = root->left;
-        struct Node_t* right_to_delete = root->right;
+        pending->expanded = 1;
 
-        root->type = NUM;
-        root->value = answer;
+        if (count + 2 > capacity)
+        {
+            struct PendingLink_t* grown = (struct PendingLink_t*) realloc (stack, 2 * (size_t) capacity * sizeof (*stack));
 
-#ifdef DEBUG
-        fprintf (stderr, "Deleting left subtree [%p] and right subtree [%p] from node [%p]\n",
-                 left_to_delete, right_to_delete, root);
-#endif
+            if (grown == NULL)
+            {
+                fprintf (stderr, "ERROR: could not grow the simplification stack to %ld\n", 2 * capacity);
+                status = -1;
+                break;
+            }
 
-        delete_sub_tree (left_to_delete);
-        delete_sub_tree (right_to_delete);
+            stack     = grown;
+            capacity *= 2;
+        }
 
-        root->left  = NULL;
-        root->right = NULL;
+        // the left child is simplified first: it goes on top
+        struct Node_t* node = node_at (pool, *link);
 
-        count_changes++;
+        if (node->right != 0) stack[count++] = (struct PendingLink_t) { .link = &node->right };
+        if (node->left  != 0) stack[count++] = (struct PendingLink_t) { .link = &node->left  };
     }
-    else
-    {
-#ifdef DEBUG
-        fprintf (stderr, "Skipped if for node [%p]: type=%d, left_type=%d, right_type=%d\n",
-                 root, root->type, root->left ? root->left->type : -1, root->right ? root->right->type : -1);
-#endif
-    }
-
-    return count_changes;
-}
 
-int simplification_of_expression (struct Node_t* root, struct Node_t* parent)
-{
-    for (int i = 0; i < MAX_OPTIMIZATIONS; i++)
+    // the root itself was replaced: only its parent knows where it hangs
+    if (top != node_index (pool, root) && parent != NULL)
     {
-        int changes = 0;
+        if (parent->left == node_index (pool, root))
+            parent->left  = top;
+        else
+            parent->right = top;
+    }
 
-        changes += simplification_typical_operations (root, parent);
-        changes += constant_folding (root);
+    opt_count ("simplification", "nodes visited",   visited);
+    opt_count ("simplification", "nodes rewritten", rewritten);
+    opt_count ("simplification", "constants folded", folded);
 
-#ifdef DEBUG
-        fprintf (stderr, "Changes = %d\n\n", changes);
-#endif
+    count_rule_fires (&fires);
 
-        if (changes == 0)
-            break;
-    }
+    free (stack);
 
-    return 0;
+    return (status < 0) ? 1 : 0;
 }
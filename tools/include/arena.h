@@ -0,0 +1,28 @@
+#pragma once
+
+#include <stddef.h>
+
+// bump allocator: memory is zeroed, nothing is freed until arena_free ()
+// arena_grow extends the last allocation in place when it fits, otherwise
+// copies it, so vectors that double their size stay linear in total memory;
+// arena_reset empties the arena but keeps its blocks for the next allocations
+
+struct ArenaBlock_t;
+
+struct Arena_t
+{
+    struct ArenaBlock_t* head;
+    struct ArenaBlock_t* spare;         // emptied by arena_reset, zeroed
+
+    size_t allocated;           // bytes handed out
+    size_t reserved;            // bytes taken from malloc
+    long   blocks;              // malloc calls
+};
+
+void* arena_alloc (struct Arena_t* arena, size_t size);
+
+void* arena_grow  (struct Arena_t* arena, void* ptr, size_t old_size, size_t new_size);
+
+void  arena_reset (struct Arena_t* arena);
+
+void  arena_free  (struct Arena_t* arena);
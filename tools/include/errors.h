@@ -10,7 +10,8 @@ enum Errors
     FILE_OPEN_ERROR,
     FILE_CLOSE_ERROR,
     FWRITE_ERROR,
-    CALLOC_ERROR
+    CALLOC_ERROR,
+    LINK_ERROR
 };
 
 const char* ErrorsMessenger (enum Errors status);
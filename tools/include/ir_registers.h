@@ -0,0 +1,34 @@
+#pragma once
+
+#include "tree_io.h"
+#include "struct.h"
+
+// the IR registers of a program: ir_gen takes them here as it generates, and the middle-end
+// counts here, on the AST, what ir_gen will take, to know what a new variable still fits in.
+// Variables and the values loops compare keep a register for the whole program, from r1 up;
+// a statement takes temporaries from r13 down and gives them back when it is done
+
+#define IR_REGISTERS 14         // r0 - r13, the backends give each one a machine register
+
+struct IrRegisters_t
+{
+    int kept;                   // taken for the whole program: variable names, values loops compare
+    int temporaries;            // taken by the statement being generated; counted on the AST, the
+                                // most one statement takes
+};
+
+// the number of the register taken, whether it fits or not
+int  take_kept_register  (struct IrRegisters_t* registers);
+int  take_temporary      (struct IrRegisters_t* registers);
+
+// temporaries are given back in the reverse order they were taken, only the last one is
+void give_back_temporary (struct IrRegisters_t* registers, int number);
+
+int  is_temporary        (const struct IrRegisters_t* registers, int number);
+
+// 1 if 'more' registers kept for the whole program still fit next to the ones taken;
+// r0 is the return value, never given out
+int  ir_registers_fit    (const struct IrRegisters_t* registers, int more);
+
+// what ir_gen takes for the program of 'root', 1 if the count could not be made
+int  count_ir_registers  (struct Context_t* context, const struct Node_t* root, struct IrRegisters_t* registers);
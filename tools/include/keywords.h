@@ -4,7 +4,19 @@
 
 int ctor_keywords         (struct Context_t* context);
 
+void dtor_keywords        (struct Context_t* context);
+
+int reset_keywords         (struct Context_t* context);
+
+int reserve_names          (struct Context_t* context, int count);
+
 int add_struct_in_keywords (struct Context_t* context, const char* str, enum Operations code,
                              int is_keyword, int length, int added_status);
 
+int classify_keyword       (const char* str, int length);
+
 int find_name              (struct Context_t* context, const char* str, int length);
+
+int find_symbol_id         (struct Context_t* context, const char* str, int length);
+
+int index_name             (struct Context_t* context, int position);
@@ -1,5 +1,26 @@
 #pragma once
 
+#include <stdio.h>
+#include <stdarg.h>
+#include <sys/types.h>
+
+// the HTML log and the AST graphs are diagnostics, written only with --graph: the graph of a
+// dump is written by a child process while the compile goes on, and rendered by dot only with
+// --graph=svg, otherwise log/graph_treeN.dot is left to be rendered on demand
+
+#define MAX_LOG_JOBS 16
+
+enum GraphLog_t
+{
+    GRAPH_LOG_OFF,
+    GRAPH_LOG_DOT,
+    GRAPH_LOG_SVG,
+};
+
+int graph_log_option (const char* arg);
+
+enum GraphLog_t graph_log_mode (void);
+
 FILE* open_log_file (const char* filename);
 
 int log_printf (const char* message, ...);
@@ -8,4 +29,8 @@ void log_vprintf (const char* message, va_list args);
 
 int write_log_file (const char* reason_bro, va_list args);
 
+pid_t start_log_job (void);
+
+int render_graph (int dump_number);
+
 void close_log_file (FILE* file);
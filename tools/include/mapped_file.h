@@ -0,0 +1,11 @@
+#pragma once
+
+#include <stddef.h>
+
+// loads the whole file as a NUL-terminated, writable (copy-on-write) buffer
+// regular files are mapped with mmap, pipes and other streams are read with read ()
+// *map_length is the length of the mapping, or 0 when the buffer is on the heap
+
+char* map_file (const char* filename, long* size, size_t* map_length);
+
+void unmap_file (char* data, size_t map_length);
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <stdint.h>
+
+// open-addressing hash index over an external array of names
+// slots keep (position + 1) of the name in that array, 0 means empty slot
+// capacity must be a power of two and bigger than the number of names
+
+typedef int (*name_equal_t) (const void* table, int position, const char* str, int length);
+
+uint32_t hash_name (const char* str, int length);
+
+int name_index_find (const int* slots, int capacity, const void* table, name_equal_t equal,
+                     const char* str, int length);
+
+int name_index_insert (int* slots, int capacity, const char* str, int length, int position);
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <assert.h>
+
+// the nodes of one tree in one range of address space, reserved at the first allocation and
+// taken into use as the tree grows, so a node never moves: a node is known by its index in the
+// range, 0 is no node. Children are 32-bit indices and the type of a node is a byte in a row
+// next to the nodes, a node is 16 bytes. Released nodes go to a free list and are handed out
+// again, the whole tree is freed at once by node_pool_dtor, or emptied for the next one by
+// node_pool_reset
+
+#define NODE_POOL_CAPACITY (UINT32_C (1) << 28)     // nodes the range has room for, 0 included
+
+struct Node_t
+{
+    int64_t  value;             // operation code, name table index or integer constant
+
+    uint32_t left;              // indices of the children in the pool, 0 = none
+    uint32_t right;
+};
+
+static_assert (sizeof (struct Node_t) == 16, "four nodes share a cache line");
+
+struct NodePool_t
+{
+    struct Node_t* nodes;       // NULL until the first allocation
+    int8_t*        types;       // enum Type of every node, by its index
+
+    uint32_t used;              // indices handed out, 0 included
+    uint32_t committed;         // indices that can be used without taking more of the range
+
+    uint32_t free_list;         // released nodes, linked through their 'left'
+
+    long allocated;             // node_pool_alloc calls
+    long reused;                // ... served from the free list
+    long released;              // node_pool_release calls
+};
+
+// a zeroed node of type 0, NULL if the range is full
+struct Node_t* node_pool_alloc   (struct NodePool_t* pool);
+
+// 'count' zeroed nodes of type 0 at consecutive indices, never from the free list
+struct Node_t* node_pool_alloc_block (struct NodePool_t* pool, uint32_t count);
+
+void           node_pool_release (struct NodePool_t* pool, struct Node_t* node);
+
+void           node_pool_reset   (struct NodePool_t* pool);
+
+void           node_pool_dtor    (struct NodePool_t* pool);
+
+void           node_pool_dump    (FILE* file, const struct NodePool_t* pool, const char* stage);
+
+// ========== the way from a node to its children and its type ========== //
+
+static inline struct Node_t* node_at (const struct NodePool_t* pool, uint32_t index)
+{
+    return (index != 0) ? &pool->nodes[index] : NULL;
+}
+
+static inline uint32_t node_index (const struct NodePool_t* pool, const struct Node_t* node)
+{
+    return (node != NULL) ? (uint32_t) (node - pool->nodes) : 0;
+}
+
+static inline struct Node_t* node_left (const struct NodePool_t* pool, const struct Node_t* node)
+{
+    return node_at (pool, node->left);
+}
+
+static inline struct Node_t* node_right (const struct NodePool_t* pool, const struct Node_t* node)
+{
+    return node_at (pool, node->right);
+}
+
+static inline int node_type (const struct NodePool_t* pool, const struct Node_t* node)
+{
+    return pool->types[node - pool->nodes];
+}
+
+static inline void set_left (const struct NodePool_t* pool, struct Node_t* node, const struct Node_t* child)
+{
+    node->left = node_index (pool, child);
+}
+
+static inline void set_right (const struct NodePool_t* pool, struct Node_t* node, const struct Node_t* child)
+{
+    node->right = node_index (pool, child);
+}
+
+static inline void set_type (struct NodePool_t* pool, const struct Node_t* node, int type)
+{
+    pool->types[node - pool->nodes] = (int8_t) type;
+}
@@ -1,11 +1,18 @@
 #ifndef STRUCT_H
 #define STRUCT_H
 
+#include <stddef.h>
+#include <stdint.h>
+#include <setjmp.h>
+
 #include "enum.h"
+#include "arena.h"
+#include "node_pool.h"
 
-#define MAX_SIZE           1000
 #define MAX_SIZE_OPERATOR  200
 #define MAX_NAME_LENGTH    100
+#define NAME_TABLE_START    64      // first capacity of the name table, power of two
+#define TOKENS_START      1024      // first capacity of the token vector
 
 struct Token_t
 {
@@ -13,7 +20,7 @@ struct Token_t
 
     const char* str;
     int length;
-    double value;
+    int64_t value;
 
     struct Token_t* left;
     struct Token_t* right;
@@ -45,14 +52,31 @@ struct NameTable_t
 
 struct Context_t
 {
-    struct  NameTable_t name_table[MAX_SIZE];
+    struct Arena_t arena;                       // name table, its hash index and tokens live here
+
+    struct NameTable_t* name_table;
+    int name_capacity;
+
+    int* name_hash;                             // hash index over name_table (position + 1, 0 = empty)
+    int  name_hash_size;                        // power of two, 2 * name_capacity
 
     int table_size;
     int keywords_offset;
 
-    struct Token_t token[MAX_SIZE];
+    struct Token_t* token;
+    int token_count;
+    int token_capacity;
 
+    int position;                               // parser cursor in the token vector
     int curr_host_func;
+
+    struct Name_t blank_name;                   // name of tokens that are not identifiers
+    jmp_buf* syntax_error;                      // SyntaxError jumps here, exits the process if NULL
+
+    struct NodePool_t nodes;                    // AST of this context
+
+    char*  names_buffer;                        // mapped name table file, names point into it
+    size_t names_map_length;
 };
 
 #endif // STRUCT_H
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stdio.h>
+
+struct Node_t;
+struct NodePool_t;
+
+// --time-report: wall time of every phase of a compile on the monotonic clock, with the size
+// of what the phase worked on; a count that does not apply to a phase is -1
+
+#define MAX_PHASES 16
+
+enum TimeFormat_t
+{
+    TIME_REPORT_OFF,
+    TIME_REPORT_TABLE,
+    TIME_REPORT_JSON,
+};
+
+struct Phase_t
+{
+    const char* name;
+    double      seconds;
+    long        nodes;                  // AST nodes alive when the phase is over
+    long        instructions;           // IR instructions
+    long        bytes;                  // read or written
+};
+
+struct TimeReport_t
+{
+    enum TimeFormat_t format;
+
+    struct Phase_t phases[MAX_PHASES];
+    int            count;
+
+    double first_start;                 // the report covers the time from the first phase on
+    double phase_start;
+};
+
+// 1 if the argument is --time-report or --time-report=json, the format is set then
+int  time_report_option (struct TimeReport_t* report, const char* argument);
+
+void phase_begin (struct TimeReport_t* report, const char* name);
+
+void phase_end   (struct TimeReport_t* report, long nodes, long instructions, long bytes);
+
+// the nodes of the tree for phase_end; the count walks the whole tree, so it is -1 when the
+// report is off
+long phase_nodes (const struct TimeReport_t* report, const struct NodePool_t* pool, const struct Node_t* root);
+
+void time_report_print (const struct TimeReport_t* report, FILE* file, const char* program);
+
+long file_bytes (const char* filename);
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "tree_io.h"
+
+// binary interchange of the AST and the name table between separate stages, one file:
+//
+//     header | node records | node types | name records | string pool
+//
+// node records have the layout of struct Node_t in pre-order, the root first; children are
+// stored as 1-based record numbers (0 = none), each record the child of one node at most.
+// The types are one byte per record, padded to 8 bytes. Reading copies the records into
+// consecutive nodes of the pool and offsets the children, it does no parsing; names are
+// NUL-terminated strings in the pool. Native byte order.
+
+#define AST_BIN_MAGIC   "COOKAST"
+#define AST_BIN_VERSION 2
+
+struct AstBinHeader_t
+{
+    char     magic[8];
+    uint32_t version;
+    uint32_t record_size;           // sizeof (struct Node_t) of the writer
+    uint64_t node_count;
+    uint64_t name_count;
+    uint64_t pool_size;             // padded to 8 bytes
+    uint64_t checksum;              // of everything after the header
+};
+
+struct AstBinName_t
+{
+    uint32_t pool_offset;
+    int32_t  length;
+    int32_t  is_keyword;
+    int32_t  added_status;
+    int32_t  id_type;
+    int32_t  host_func;
+    int32_t  counter_params;
+    int32_t  counter_locals;
+    int32_t  offset;
+};
+
+int write_binary_ast (struct Node_t* root, struct Context_t* context, const char* filename);
+
+struct Node_t* read_binary_ast (struct Buffer_t* buffer, struct Context_t* context, const char* filename);
+
+uint64_t ast_checksum (const char* data, size_t size);
@@ -1,24 +1,17 @@
 #pragma once
 
 #include <stdio.h>
+#include <stdint.h>
 #include "struct.h"
 #include "keywords.h"
 
-struct Node_t
-{
-    int type;
-    double value;
-
-    struct Node_t* left;
-    struct Node_t* right;
-};
-
 struct Buffer_t
 {
     char* buffer_ptr;
     char* current_ptr;
 
     long file_size;
+    size_t map_length;      // 0 if buffer_ptr is on the heap
 };
 
 int read_name_table (struct Context_t* context, const char* filename);
@@ -27,11 +20,17 @@ int name_table_dump (FILE* file, struct Context_t* context);
 
 void print_tree_preorder (struct Node_t* root, struct Context_t* context, FILE* file, int level);
 
+int write_ast_file (struct Node_t* root, struct Context_t* context, const char* filename, int level);
+
+int write_name_table_file (struct Context_t* context, const char* filename);
+
 struct Node_t* read_tree (struct Buffer_t* buffer, struct Context_t* context, const char* filename);
 
-int delete_sub_tree (struct Node_t* node);
+long count_tree_nodes (const struct NodePool_t* pool, const struct Node_t* node);
+
+int delete_sub_tree (struct NodePool_t* pool, struct Node_t* node);
 
-int delete_node (struct Node_t* node);
+int delete_node (struct NodePool_t* pool, struct Node_t* node);
 
 int buffer_dtor (struct Buffer_t* buffer);
 
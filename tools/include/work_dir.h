@@ -0,0 +1,13 @@
+#pragma once
+
+#include <stddef.h>
+
+// the files a compile passes between its stages live at fixed paths relative to the source
+// tree; a work directory moves every one of them under it, so compiles that are given
+// different work directories can run at the same time
+
+int set_work_dir (const char* dir);
+
+// 'backend/AST_tree.bin' -> '<work dir>/backend/AST_tree.bin', creating the directories on
+// the way; without a work directory the name is kept. NULL if the path could not be made
+const char* work_path (char* path, size_t size, const char* name);
@@ -0,0 +1,165 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "arena.h"
+
+#define ARENA_BLOCK_SIZE (64 * 1024)
+#define ARENA_ALIGN      (_Alignof (max_align_t))
+
+struct ArenaBlock_t
+{
+    struct ArenaBlock_t* prev;
+
+    size_t used;
+    size_t capacity;
+
+    _Alignas (max_align_t) unsigned char data[];
+};
+
+static size_t align_up (size_t size)
+{
+    return (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+}
+
+static struct ArenaBlock_t* take_spare  (struct Arena_t* arena, size_t size);
+static void                 free_blocks (struct ArenaBlock_t* block);
+
+void* arena_alloc (struct Arena_t* arena, size_t size)
+{
+    assert (arena);
+
+    size = align_up (size);
+
+    struct ArenaBlock_t* block = arena->head;
+
+    if ((block == NULL || block->capacity - block->used < size) && (block = take_spare (arena, size)) == NULL)
+    {
+        size_t capacity = (size > ARENA_BLOCK_SIZE) ? size : ARENA_BLOCK_SIZE;
+
+        block = (struct ArenaBlock_t*) calloc (1, sizeof (*block) + capacity);
+        if (block == NULL)
+        {
+            fprintf (stderr, "ERROR: arena could not allocate %zu bytes\n", capacity);
+            return NULL;
+        }
+
+        block->capacity = capacity;
+        block->prev = arena->head;
+
+        arena->head = block;
+        arena->reserved += capacity;
+        arena->blocks++;
+    }
+
+    void* ptr = block->data + block->used;
+
+    block->used += size;
+    arena->allocated += size;
+
+    return ptr;
+}
+
+void* arena_grow (struct Arena_t* arena, void* ptr, size_t old_size, size_t new_size)
+{
+    assert (arena);
+
+    if (ptr == NULL)
+        return arena_alloc (arena, new_size);
+
+    if (new_size <= old_size)
+        return ptr;
+
+    size_t old_aligned = align_up (old_size);
+    size_t new_aligned = align_up (new_size);
+
+    struct ArenaBlock_t* block = arena->head;
+
+    // the last allocation of the head block: the bytes after it were never handed out, so they are zero
+    if (block != NULL && (unsigned char*) ptr + old_aligned == block->data + block->used &&
+        block->capacity - block->used >= new_aligned - old_aligned)
+    {
+        block->used += new_aligned - old_aligned;
+        arena->allocated += new_aligned - old_aligned;
+
+        return ptr;
+    }
+
+    void* fresh = arena_alloc (arena, new_size);
+    if (fresh == NULL)
+        return NULL;
+
+    memcpy (fresh, ptr, old_size);
+
+    return fresh;
+}
+
+// the used part of every block is zeroed, so the memory handed out again is zero as well
+void arena_reset (struct Arena_t* arena)
+{
+    assert (arena);
+
+    struct ArenaBlock_t* block = arena->head;
+
+    while (block != NULL)
+    {
+        struct ArenaBlock_t* prev = block->prev;
+
+        memset (block->data, 0, block->used);
+        block->used = 0;
+
+        block->prev  = arena->spare;
+        arena->spare = block;
+
+        block = prev;
+    }
+
+    arena->head = NULL;
+    arena->allocated = 0;
+}
+
+void arena_free (struct Arena_t* arena)
+{
+    assert (arena);
+
+    free_blocks (arena->head);
+    free_blocks (arena->spare);
+
+    arena->head = NULL;
+    arena->spare = NULL;
+    arena->allocated = 0;
+    arena->reserved = 0;
+    arena->blocks = 0;
+}
+
+// the first spare block 'size' bytes fit in becomes the head
+static struct ArenaBlock_t* take_spare (struct Arena_t* arena, size_t size)
+{
+    for (struct ArenaBlock_t** link = &arena->spare; *link != NULL; link = &(*link)->prev)
+    {
+        struct ArenaBlock_t* block = *link;
+
+        if (block->capacity < size)
+            continue;
+
+        *link = block->prev;
+
+        block->prev = arena->head;
+        arena->head = block;
+
+        return block;
+    }
+
+    return NULL;
+}
+
+static void free_blocks (struct ArenaBlock_t* block)
+{
+    while (block != NULL)
+    {
+        struct ArenaBlock_t* prev = block->prev;
+        free (block);
+        block = prev;
+    }
+}
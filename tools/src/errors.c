@@ -13,6 +13,7 @@ const char* ErrorsMessenger (enum Errors status)
         case FILE_CLOSE_ERROR:  return "File failed to close";
         case FWRITE_ERROR:      return "fwrite not worked well";
         case CALLOC_ERROR:      return "error in calloc";
+        case LINK_ERROR:        return "call to a function that is not defined";
 
         default:               return "UNDEFINED ERROR";
     }
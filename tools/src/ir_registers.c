@@ -0,0 +1,253 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#include "ir_registers.h"
+#include "keywords.h"
+
+// the count follows the way ir_gen.c takes registers for a statement: new_temporary for an
+// operand it computes in, loop_register for a value a loop compares; the end of a statement gives
+// its temporaries back
+
+static void walk_registers  (struct Context_t* context, const struct Node_t* node, uint64_t* named,
+                             struct IrRegisters_t* registers);
+static int  count_name      (struct Context_t* context, const struct Node_t* node, uint64_t* named);
+static int  loop_registers  (const struct NodePool_t* pool, const struct Node_t* condition);
+static int  statement_temps (const struct NodePool_t* pool, const struct Node_t* statement);
+static int  temporaries     (const struct NodePool_t* pool, const struct Node_t* node);
+static int  is_arithmetic   (const struct NodePool_t* pool, const struct Node_t* node);
+static int  is_comparison   (const struct NodePool_t* pool, const struct Node_t* node);
+
+int take_kept_register (struct IrRegisters_t* registers)
+{
+    assert (registers);
+
+    return ++registers->kept;
+}
+
+int take_temporary (struct IrRegisters_t* registers)
+{
+    assert (registers);
+
+    return IR_REGISTERS - ++registers->temporaries;
+}
+
+void give_back_temporary (struct IrRegisters_t* registers, int number)
+{
+    assert (registers);
+
+    if (registers->temporaries > 0 && number == IR_REGISTERS - registers->temporaries)
+        registers->temporaries--;
+}
+
+int is_temporary (const struct IrRegisters_t* registers, int number)
+{
+    assert (registers);
+
+    return number >= IR_REGISTERS - registers->temporaries;
+}
+
+int ir_registers_fit (const struct IrRegisters_t* registers, int more)
+{
+    assert (registers);
+
+    return registers->kept + more + registers->temporaries < IR_REGISTERS;
+}
+
+// ========== counting them on the AST ========== //
+
+int count_ir_registers (struct Context_t* context, const struct Node_t* root, struct IrRegisters_t* registers)
+{
+    assert (context);
+    assert (registers);
+
+    registers->kept        = 0;
+    registers->temporaries = 0;
+
+    uint64_t* named = (uint64_t*) calloc ((size_t) context->table_size / 64 + 1, sizeof (*named));
+
+    if (named == NULL)
+    {
+        fprintf (stderr, "ERROR: could not allocate a set of %d names\n", context->table_size);
+        return 1;
+    }
+
+    walk_registers (context, root, named, registers);
+
+    free (named);
+
+    return 0;
+}
+
+static void walk_registers (struct Context_t* context, const struct Node_t* node, uint64_t* named,
+                            struct IrRegisters_t* registers)
+{
+    const struct NodePool_t* pool = &context->nodes;
+
+    while (node != NULL)
+    {
+        int type = node_type (pool, node);
+
+        const struct Node_t* left = node_left (pool, node);
+
+        if (type == ID)
+            registers->kept += count_name (context, node, named);
+
+        if (type == OP && (int) node->value == GLUE && left != NULL)
+        {
+            int temps = statement_temps (pool, left);
+
+            if (temps > registers->temporaries)
+                registers->temporaries = temps;
+        }
+
+        if (type == OP && (int) node->value == WHILE)
+            registers->kept += loop_registers (pool, left);
+
+        // the name of a function is not a variable
+        if (type == FUNC && (int) node->value == DEF && left != NULL)
+            walk_registers (context, node_right (pool, left), named, registers);
+        else if (!(type == FUNC && (int) node->value == CALL))
+            walk_registers (context, left, named, registers);
+
+        node = node_right (pool, node);
+    }
+}
+
+// variables of the same name share a register, whatever function they are in
+static int count_name (struct Context_t* context, const struct Node_t* node, uint64_t* named)
+{
+    if (node->value < 0 || node->value >= context->table_size)
+        return 0;
+
+    const struct Name_t* name = &context->name_table[node->value].name;
+
+    int id = find_symbol_id (context, name->str_pointer, name->length);
+
+    if (id < 0 || id >= context->table_size || ((named[id / 64] >> (id % 64)) & 1))
+        return 0;
+
+    named[id / 64] |= UINT64_C (1) << (id % 64);
+
+    return 1;
+}
+
+// a loop compares its operands again at every iteration: a number or an expression is set into
+// a register of its own, a variable is compared in its own register
+static int loop_registers (const struct NodePool_t* pool, const struct Node_t* condition)
+{
+    if (condition == NULL)
+        return 0;
+
+    if (!is_comparison (pool, condition))
+        return node_type (pool, condition) != ID;
+
+    const struct Node_t* left  = node_left  (pool, condition);
+    const struct Node_t* right = node_right (pool, condition);
+
+    return (left  != NULL && node_type (pool, left)  != ID) +
+           (right != NULL && node_type (pool, right) != ID && node_type (pool, right) != NUM);
+}
+
+// the temporaries ir_gen takes for one statement, the statements of a body are counted on their own
+static int statement_temps (const struct NodePool_t* pool, const struct Node_t* statement)
+{
+    if (node_type (pool, statement) != OP)
+        return temporaries (pool, statement);
+
+    switch ((int) statement->value)
+    {
+        // 'target is a <op> b' computes in the register of the target: a stays where it is
+        // computed while b is, and a b that is the target is saved in a temporary
+        case EQUAL:
+        {
+            const struct Node_t* value = node_right (pool, statement);
+
+            if (!is_arithmetic (pool, value))
+                return temporaries (pool, value);
+
+            const struct Node_t* operand = node_right (pool, value);
+
+            int left  = temporaries (pool, node_left (pool, value));
+            int held  = (left > 0);
+            int right = held + temporaries (pool, operand);
+
+            if (operand != NULL && node_type (pool, operand) == ID && held + 1 > right)
+                right = held + 1;
+
+            return (left > right) ? left : right;
+        }
+
+        // the first operand of a loop goes to a register of its own, the one of an if to a
+        // temporary when it is a number
+        case WHILE:
+        case IF:
+        {
+            const struct Node_t* condition = node_left (pool, statement);
+
+            if (condition == NULL)
+                return 0;
+
+            if (!is_comparison (pool, condition))
+            {
+                int temps = temporaries (pool, condition);
+                return (temps == 0 && node_type (pool, condition) == NUM) ? 1 : temps;
+            }
+
+            const struct Node_t* operand = node_left (pool, condition);
+
+            int left = temporaries (pool, operand);
+
+            if (left == 0 && operand != NULL && node_type (pool, operand) == NUM)
+                left = 1;
+
+            int held  = ((int) statement->value == IF) ? (left > 0) : 0;
+            int right = held + temporaries (pool, node_right (pool, condition));
+
+            return (left > right) ? left : right;
+        }
+
+        default:
+            return temporaries (pool, statement);
+    }
+}
+
+// the most temporaries taken while the value is computed, the one it ends up in included: an
+// operation computes in the temporary of its left operand, or in a copy of it
+static int temporaries (const struct NodePool_t* pool, const struct Node_t* node)
+{
+    if (node == NULL)
+        return 0;
+
+    if (is_arithmetic (pool, node))
+    {
+        int left  = temporaries (pool, node_left (pool, node));
+        int right = 1 + temporaries (pool, node_right (pool, node));
+
+        if (left < 1)
+            left = 1;
+
+        return (left > right) ? left : right;
+    }
+
+    // a built-in works in the register of its argument
+    if (node_type (pool, node) == FUNC && (int) node->value == CALL && node->right != 0)
+        return temporaries (pool, node_left (pool, node_right (pool, node)));
+
+    return 0;
+}
+
+static int is_arithmetic (const struct NodePool_t* pool, const struct Node_t* node)
+{
+    return node != NULL && node_type (pool, node) == OP &&
+           ((int) node->value == ADD || (int) node->value == SUB || (int) node->value == MUL ||
+            (int) node->value == DIV || (int) node->value == POW);
+}
+
+static int is_comparison (const struct NodePool_t* pool, const struct Node_t* node)
+{
+    return node_type (pool, node) == OP &&
+           ((int) node->value == GT  || (int) node->value == LT || (int) node->value == GTE ||
+            (int) node->value == NEQ || (int) node->value == EQ);
+}
@@ -1,76 +1,246 @@
 #include <stdio.h>
-#include <stdlib.h>
 #include <string.h>
 
 #include "keywords.h"
+#include "name_index.h"
 
+static int  name_equal     (const void* table, int position, const char* str, int length);
+static void forget_program (struct Context_t* context);
+
+// keywords and operators are recognized by classify_keyword and never enter the name table,
+// only built-in functions live there: they are called like user functions, so they need IDs
 int ctor_keywords (struct Context_t* context)
 {
     context->table_size = 0;
 
-    add_struct_in_keywords (context,                 "sin",   SIN  , 1, strlen (                "sin"), 0);
-    add_struct_in_keywords (context,                 "cos",   COS  , 1, strlen (                "cos"), 0);
-    add_struct_in_keywords (context,                  "ln",    LN  , 1, strlen (                 "ln"), 0);
-    add_struct_in_keywords (context,                   "+",   ADD  , 1, strlen (                  "+"), 0);
-    add_struct_in_keywords (context,                   "-",   SUB  , 1, strlen (                  "-"), 0);
-    add_struct_in_keywords (context,                   "*",   MUL  , 1, strlen (                  "*"), 0);
-    add_struct_in_keywords (context,                   "/",   DIV  , 1, strlen (                  "/"), 0);
-    add_struct_in_keywords (context,                   "^",   POW  , 1, strlen (                  "^"), 0);
-    add_struct_in_keywords (context,                   "(",  OP_BR , 1, strlen (                  "("), 0);
-    add_struct_in_keywords (context,                   ")",  CL_BR , 1, strlen (                  ")"), 0);
-    add_struct_in_keywords (context,             "lesssgo", OP_F_BR, 1, strlen (            "lesssgo"), 0);
-    add_struct_in_keywords (context,             "stoopit", CL_F_BR, 1, strlen (            "stoopit"), 0);
-    add_struct_in_keywords (context,                  "is",  EQUAL , 1, strlen (                 "is"), 0);
-    add_struct_in_keywords (context,             "forreal",   IF   , 1, strlen (            "forreal"), 0);
-    add_struct_in_keywords (context,            "grinding",  WHILE , 1, strlen (          "grinding"), 0);
-    add_struct_in_keywords (context,          "lethimcook",  ADVT  , 1, strlen (         "lethimcook"), 0);
-    add_struct_in_keywords (context,                   ",",  COMMA , 1, strlen (                  ","), 0);
-    add_struct_in_keywords (context,              "shutup",  GLUE  , 1, strlen (             "shutup"), 0);
-    add_struct_in_keywords (context, "SPACE_FOR_ADDED_OBJ",  SPACE , 1, strlen ("SPACE_FOR_ADDED_OBJ"), 0);
-
-    // comparison operators
-    add_struct_in_keywords (context,     "fr",  GT , 1, strlen (    "fr"), 0);
-    add_struct_in_keywords (context, "lowkey",  LT , 1, strlen ("lowkey"), 0);
-    add_struct_in_keywords (context,  "nocap",  GTE, 1, strlen ( "nocap"), 0);
-    add_struct_in_keywords (context,    "nah",  NEQ, 1, strlen (   "nah"), 0);
-    add_struct_in_keywords (context, "sameAs",  EQ , 1, strlen ("sameAs"), 0);
+    if (reserve_names (context, NAME_TABLE_START) != 0)
+        return 1;
 
     // built-in functions: registered as IDs with added_status=1
-    add_struct_in_keywords (context,     "yap",  (enum Operations) ID, 0, strlen (    "yap"), 1);
-    add_struct_in_keywords (context,   "gimme",  (enum Operations) ID, 0, strlen (  "gimme"), 1);
-    add_struct_in_keywords (context,    "sqrt",  (enum Operations) ID, 0, strlen (   "sqrt"), 1);
+    if (add_struct_in_keywords (context,     "yap",  (enum Operations) ID, 0, strlen (    "yap"), 1) != 0 ||
+        add_struct_in_keywords (context,   "gimme",  (enum Operations) ID, 0, strlen (  "gimme"), 1) != 0 ||
+        add_struct_in_keywords (context,    "sqrt",  (enum Operations) ID, 0, strlen (   "sqrt"), 1) != 0)
+        return 1;
 
     context->keywords_offset = context->table_size;
 
     return 0;
 }
 
+#define KEYWORD(word, code)  if ( sizeof (word) - 1 == (size_t) length &&               \
+                                  memcmp (str, (word), sizeof (word) - 1) == 0 )        \
+                                 return (code);
+
+// returns operation code of keyword / operator or -1
+// dispatch on length and first character: every (length, first char) pair
+// selects at most two candidates, so one or two memcmp per word
+int classify_keyword (const char* str, int length)
+{
+    switch (length)
+    {
+        case 1:
+            switch (str[0])
+            {
+                case '+': return ADD;
+                case '-': return SUB;
+                case '*': return MUL;
+                case '/': return DIV;
+                case '^': return POW;
+                case '(': return OP_BR;
+                case ')': return CL_BR;
+                case ',': return COMMA;
+
+                default:  return -1;
+            }
+
+        case 2:
+            switch (str[0])
+            {
+                case 'l': KEYWORD ("ln", LN)    break;
+                case 'i': KEYWORD ("is", EQUAL) break;
+                case 'f': KEYWORD ("fr", GT)    break;
+
+                default: break;
+            }
+            break;
+
+        case 3:
+            switch (str[0])
+            {
+                case 's': KEYWORD ("sin", SIN) break;
+                case 'c': KEYWORD ("cos", COS) break;
+                case 'n': KEYWORD ("nah", NEQ) break;
+
+                default: break;
+            }
+            break;
+
+        case 5:
+            KEYWORD ("nocap", GTE)
+            break;
+
+        case 6:
+            switch (str[0])
+            {
+                case 's': KEYWORD ("shutup", GLUE)
+                          KEYWORD ("sameAs", EQ)   break;
+                case 'l': KEYWORD ("lowkey", LT)   break;
+
+                default: break;
+            }
+            break;
+
+        case 7:
+            switch (str[0])
+            {
+                case 'l': KEYWORD ("lesssgo", OP_F_BR) break;
+                case 's': KEYWORD ("stoopit", CL_F_BR) break;
+                case 'f': KEYWORD ("forreal", IF)      break;
+
+                default: break;
+            }
+            break;
+
+        case 8:
+            KEYWORD ("grinding", WHILE)
+            break;
+
+        case 10:
+            KEYWORD ("lethimcook", ADVT)
+            break;
+
+        default:
+            break;
+    }
+
+    return -1;
+}
+
+#undef KEYWORD
+
+// returns 1 if the name is already in the table or the table cannot grow, the table is unchanged then
 int add_struct_in_keywords (struct Context_t* context, const char* str, enum Operations code,
                              int is_keyword, int length, int added_status)
 {
     if (find_name (context, str, length) != -1)
     {
         fprintf (stderr, "ERROR: keyword \"%.*s\" already exists in name table\n", length, str);
-        exit(1);
+        return 1;
     }
 
+    if (reserve_names (context, context->table_size + 1) != 0)
+        return 1;
+
     context->name_table[context->table_size].name.str_pointer  = str;
     context->name_table[context->table_size].name.code         = code;
     context->name_table[context->table_size].name.is_keyword   = is_keyword;
     context->name_table[context->table_size].name.length       = length;
     context->name_table[context->table_size].name.added_status = added_status;
 
+    if (index_name (context, context->table_size) != 0)
+        return 1;
+
     context->table_size++;
 
     return 0;
 }
 
+// grows the name table to at least 'count' names, the hash index is rebuilt twice as big
+int reserve_names (struct Context_t* context, int count)
+{
+    if (count <= context->name_capacity)
+        return 0;
+
+    int capacity = (context->name_capacity != 0) ? context->name_capacity : NAME_TABLE_START;
+    while (capacity < count)
+        capacity *= 2;
+
+    struct NameTable_t* table = (struct NameTable_t*) arena_grow (&context->arena, context->name_table,
+                                                                  (size_t) context->name_capacity * sizeof (*table),
+                                                                  (size_t)                capacity * sizeof (*table));
+    int* hash = (int*) arena_alloc (&context->arena, (size_t) (2 * capacity) * sizeof (*hash));
+
+    if (table == NULL || hash == NULL)
+    {
+        fprintf (stderr, "ERROR: could not grow name table to %d names\n", capacity);
+        return 1;
+    }
+
+    context->name_table     = table;
+    context->name_capacity  = capacity;
+    context->name_hash      = hash;
+    context->name_hash_size = 2 * capacity;
+
+    for (int position = 0; position < context->table_size; position++)
+        index_name (context, position);
+
+    return 0;
+}
+
+// frees everything the context owns: names, tokens and AST nodes
+void dtor_keywords (struct Context_t* context)
+{
+    arena_free (&context->arena);
+    node_pool_dtor (&context->nodes);
+
+    forget_program (context);
+}
+
+// the context as ctor_keywords left it, for the next program; the memory of the names,
+// the tokens and the nodes is kept and handed out again
+int reset_keywords (struct Context_t* context)
+{
+    arena_reset (&context->arena);
+    node_pool_reset (&context->nodes);
+
+    forget_program (context);
+
+    return ctor_keywords (context);
+}
+
+static void forget_program (struct Context_t* context)
+{
+    context->name_table     = NULL;
+    context->name_capacity  = 0;
+    context->name_hash      = NULL;
+    context->name_hash_size = 0;
+
+    context->token          = NULL;
+    context->token_count    = 0;
+    context->token_capacity = 0;
+
+    context->table_size      = 0;
+    context->keywords_offset = 0;
+
+    context->position       = 0;
+    context->curr_host_func = 0;
+}
+
+int index_name (struct Context_t* context, int position)
+{
+    const struct Name_t* name = &context->name_table[position].name;
+
+    return name_index_insert (context->name_hash, context->name_hash_size, name->str_pointer, name->length, position);
+}
+
+int find_symbol_id (struct Context_t* context, const char* str, int length)
+{
+    return name_index_find (context->name_hash, context->name_hash_size, context->name_table, name_equal, str, length);
+}
+
 int find_name (struct Context_t* context, const char* str, int length)
 {
-    for (int i = 0; i < context->table_size; i++)
-        if (context->name_table[i].name.length == length &&
-            strncmp (str, context->name_table[i].name.str_pointer, (size_t) length) == 0)
-            return context->name_table[i].name.code;
+    int id = find_symbol_id (context, str, length);
+    if (id == -1)
+        return -1;
 
-    return -1;
+    return context->name_table[id].name.code;
+}
+
+static int name_equal (const void* table, int position, const char* str, int length)
+{
+    const struct Name_t* name = &((const struct NameTable_t*) table)[position].name;
+
+    return name->length == length &&
+           strncmp (str, name->str_pointer, (size_t) length) == 0;
 }
@@ -2,13 +2,46 @@
 #include <stdarg.h>
 #include <assert.h>
 #include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/wait.h>
 
 #include "log.h"
+#include "work_dir.h"
 
 static FILE* LOG_FILE = NULL;
 
+static enum GraphLog_t GRAPH_LOG = GRAPH_LOG_OFF;
+
+static pid_t LOG_JOBS[MAX_LOG_JOBS] = {};
+static int   LOG_JOBS_COUNT = 0;
+
+static void wait_log_jobs (void);
+
+// --graph writes the log and the dot files, --graph=svg renders them too; returns 1 if the
+// argument was one of them
+int graph_log_option (const char* arg)
+{
+    if      (strcmp (arg, "--graph")     == 0) GRAPH_LOG = GRAPH_LOG_DOT;
+    else if (strcmp (arg, "--graph=svg") == 0) GRAPH_LOG = GRAPH_LOG_SVG;
+    else
+        return 0;
+
+    return 1;
+}
+
+enum GraphLog_t graph_log_mode (void)
+{
+    return GRAPH_LOG;
+}
+
+// without an open log file (no --graph, or several units parsed at once) the messages are dropped
 void log_vprintf (const char* message, va_list args)
 {
+    if (LOG_FILE == NULL)
+        return;
+
     vfprintf (LOG_FILE, message, args);
 }
 
@@ -38,8 +71,15 @@ FILE* open_log_file (const char* filename)
     return LOG_FILE;
 }
 
+// the entry of one dump: the reason and its graph, by name, the page sits next to the pictures;
+// returns the number of the dump, its graph is log/graph_treeN.dot, -1 without a log
 int write_log_file (const char* reason, va_list args)
 {
+    static int dump_number = 1;
+
+    if (LOG_FILE == NULL)
+        return -1;
+
     log_printf ("<pre>\n");
 
     log_printf ("<body style=\"background-color: #AFEEEE\">");
@@ -48,14 +88,60 @@ int write_log_file (const char* reason, va_list args)
     log_vprintf (reason, args);
     log_printf ("</h2> <br> <hr>\n\n");
 
-    static int dump_number = 1;
-    static char       way[50] = {};
-    static char  filename[50] = {};
-    char    command_name[200] = {};
+    if (GRAPH_LOG == GRAPH_LOG_SVG)
+        log_printf ("\n\n<img src=\"graph_tree%d.svg\">", dump_number);
+    else
+        log_printf ("\n\n<a href=\"graph_tree%d.dot\">graph_tree%d.dot</a> (dot -Tsvg -O to render)", dump_number, dump_number);
+
+    // the log is flushed before a job is forked, or the child would write it again on exit
+    fflush (LOG_FILE);
+
+    return dump_number++;
+}
 
-    sprintf (way, "log/");
-    sprintf (filename, "graph_tree%d.svg", dump_number++);
-    sprintf (command_name, "dot log/graph_tree.dot -Tsvg -o %s%s", way, filename);
+// forks the process that writes a dump: 0 in the child, which ends with _exit, the pid in the
+// parent, -1 if the dump is not written at all
+pid_t start_log_job (void)
+{
+    // no more than MAX_LOG_JOBS at once: the running ones are waited for first
+    if (LOG_JOBS_COUNT == MAX_LOG_JOBS)
+        wait_log_jobs ();
+
+    fflush (NULL);
+
+    pid_t pid = fork ();
+
+    if (pid < 0)
+    {
+        fprintf (stderr, "WARNING: could not start the graph dump\n");
+        return -1;
+    }
+
+    if (pid > 0)
+        LOG_JOBS[LOG_JOBS_COUNT++] = pid;
+
+    return pid;
+}
+
+int render_graph (int dump_number)
+{
+    if (GRAPH_LOG != GRAPH_LOG_SVG)
+        return 0;
+
+    char   graph_name[64] = {};
+    char   image_name[64] = {};
+    char   graph[PATH_MAX] = {};
+    char   image[PATH_MAX] = {};
+    char   command_name[3 * PATH_MAX] = {};
+
+    sprintf (graph_name, "log/graph_tree%d.dot", dump_number);
+    sprintf (image_name, "log/graph_tree%d.svg", dump_number);
+
+    if (work_path (graph, sizeof (graph), graph_name) == NULL ||
+        work_path (image, sizeof (image), image_name) == NULL)
+        return 1;
+
+    snprintf (command_name, sizeof (command_name), "dot '%s' -Tsvg -o '%s'", graph, image);
 
     int result = system( command_name);
     if (result == -1)
@@ -74,14 +160,25 @@ int write_log_file (const char* reason, va_list args)
     }
 #endif
 
-    log_printf ("\n\n<img src=\"%s\">", filename);
+    return 0;
+}
 
-    fflush (LOG_FILE);
+static void wait_log_jobs (void)
+{
+    for (int i = 0; i < LOG_JOBS_COUNT; i++)
+        waitpid (LOG_JOBS[i], NULL, 0);
 
-    return 0;
+    LOG_JOBS_COUNT = 0;
 }
 
+// the graphs are all written when the log is closed
 void close_log_file (FILE* file)
 {
-    fclose (file);
+    wait_log_jobs ();
+
+    if (file != NULL)
+        fclose (file);
+
+    if (file == LOG_FILE)
+        LOG_FILE = NULL;
 }
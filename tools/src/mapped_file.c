@@ -0,0 +1,127 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "mapped_file.h"
+
+#define READ_CHUNK 65536
+
+static char* read_stream (int fd, long* size);
+
+char* map_file (const char* filename, long* size, size_t* map_length)
+{
+    assert (filename);
+    assert (size);
+    assert (map_length);
+
+    *size = 0;
+    *map_length = 0;
+
+    int fd = open (filename, O_RDONLY);
+    if (fd == -1)
+    {
+        fprintf (stderr, "\n" "Could not find the '%s' to be opened!" "\n", filename);
+        return NULL;
+    }
+
+    struct stat st = {};
+    if (fstat (fd, &st) != 0)
+    {
+        perror ("fstat");
+        close (fd);
+        return NULL;
+    }
+
+    long page_size = sysconf (_SC_PAGESIZE);
+
+    // the byte after the end must be readable and zero: it is inside the last page
+    // unless the size is a multiple of the page size, then the file is read instead
+    if (!S_ISREG (st.st_mode) || st.st_size == 0 || st.st_size % page_size == 0)
+    {
+        char* data = read_stream (fd, size);
+        close (fd);
+        return data;
+    }
+
+    size_t length = (size_t) st.st_size + 1;
+
+    char* data = (char*) mmap (NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close (fd);
+
+    if (data == MAP_FAILED)
+    {
+        perror ("mmap");
+        return NULL;
+    }
+
+    madvise (data, length, MADV_SEQUENTIAL);
+
+    *size = (long) st.st_size;
+    *map_length = length;
+
+    return data;
+}
+
+void unmap_file (char* data, size_t map_length)
+{
+    if (data == NULL)
+        return;
+
+    if (map_length != 0)
+        munmap (data, map_length);
+    else
+        free (data);
+}
+
+static char* read_stream (int fd, long* size)
+{
+    size_t capacity = READ_CHUNK;
+    size_t used = 0;
+
+    char* data = (char*) malloc (capacity + 1);
+    if (data == NULL)
+    {
+        fprintf (stderr, "ERROR: could not allocate buffer for file\n");
+        return NULL;
+    }
+
+    while (1)
+    {
+        if (used == capacity)
+        {
+            capacity *= 2;
+
+            char* grown = (char*) realloc (data, capacity + 1);
+            if (grown == NULL)
+            {
+                fprintf (stderr, "ERROR: could not allocate buffer for file\n");
+                free (data);
+                return NULL;
+            }
+
+            data = grown;
+        }
+
+        ssize_t count = read (fd, data + used, capacity - used);
+        if (count == 0)
+            break;
+
+        if (count < 0)
+        {
+            perror ("read");
+            free (data);
+            return NULL;
+        }
+
+        used += (size_t) count;
+    }
+
+    data[used] = '\0';
+    *size = (long) used;
+
+    return data;
+}
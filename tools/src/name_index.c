@@ -0,0 +1,67 @@
+#include <stdio.h>
+#include <assert.h>
+
+#include "name_index.h"
+
+// FNV-1a
+uint32_t hash_name (const char* str, int length)
+{
+    assert (str);
+
+    uint32_t hash = 2166136261u;
+
+    for (int i = 0; i < length; i++)
+    {
+        hash ^= (unsigned char) str[i];
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+// returns position of the name in table or -1
+int name_index_find (const int* slots, int capacity, const void* table, name_equal_t equal,
+                     const char* str, int length)
+{
+    assert (slots);
+    assert (equal);
+
+    uint32_t mask = (uint32_t) capacity - 1;
+    uint32_t slot = hash_name (str, length) & mask;
+
+    for (int probe = 0; probe < capacity; probe++)
+    {
+        if (slots[slot] == 0)
+            return -1;
+
+        int position = slots[slot] - 1;
+        if (equal (table, position, str, length))
+            return position;
+
+        slot = (slot + 1) & mask;
+    }
+
+    return -1;
+}
+
+int name_index_insert (int* slots, int capacity, const char* str, int length, int position)
+{
+    assert (slots);
+
+    uint32_t mask = (uint32_t) capacity - 1;
+    uint32_t slot = hash_name (str, length) & mask;
+
+    for (int probe = 0; probe < capacity; probe++)
+    {
+        if (slots[slot] == 0)
+        {
+            slots[slot] = position + 1;
+            return 0;
+        }
+
+        slot = (slot + 1) & mask;
+    }
+
+    fprintf (stderr, "ERROR: name index overflow (capacity = %d)\n", capacity);
+    return 1;
+}
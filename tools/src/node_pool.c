@@ -0,0 +1,149 @@
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <sys/mman.h>
+
+#include "node_pool.h"
+
+#define COMMIT_STEP (UINT32_C (1) << 16)        // nodes taken into use at once, the row of their
+                                                // types stays a whole number of pages
+
+// the nodes, then the row of their types
+#define RANGE_SIZE ((size_t) NODE_POOL_CAPACITY * (sizeof (struct Node_t) + sizeof (int8_t)))
+
+static int reserve_range (struct NodePool_t* pool);
+static int commit_step   (struct NodePool_t* pool);
+
+struct Node_t* node_pool_alloc (struct NodePool_t* pool)
+{
+    assert (pool);
+
+    uint32_t index = pool->free_list;
+
+    if (index == 0)
+        return node_pool_alloc_block (pool, 1);
+
+    pool->free_list = pool->nodes[index].left;
+
+    pool->nodes[index] = (struct Node_t) {};
+    pool->types[index] = 0;
+
+    pool->reused++;
+    pool->allocated++;
+
+    return &pool->nodes[index];
+}
+
+struct Node_t* node_pool_alloc_block (struct NodePool_t* pool, uint32_t count)
+{
+    assert (pool);
+
+    if (pool->nodes == NULL && reserve_range (pool) != 0)
+        return NULL;
+
+    if (count > NODE_POOL_CAPACITY - pool->used)
+    {
+        fprintf (stderr, "ERROR: a tree has more than %u nodes\n", NODE_POOL_CAPACITY - 1);
+        return NULL;
+    }
+
+    while (pool->used + count > pool->committed)
+        if (commit_step (pool) != 0)
+            return NULL;
+
+    uint32_t index = pool->used;
+
+    pool->used      += count;
+    pool->allocated += count;
+
+    return &pool->nodes[index];
+}
+
+void node_pool_release (struct NodePool_t* pool, struct Node_t* node)
+{
+    assert (pool);
+
+    if (node == NULL)
+        return;
+
+    node->left = pool->free_list;
+    pool->free_list = node_index (pool, node);
+
+    pool->released++;
+}
+
+// the nodes handed out are zeroed, so the ones handed out again are zero as well
+void node_pool_reset (struct NodePool_t* pool)
+{
+    assert (pool);
+
+    if (pool->nodes == NULL)
+        return;
+
+    memset (pool->nodes, 0, pool->used * sizeof (*pool->nodes));
+    memset (pool->types, 0, pool->used * sizeof (*pool->types));
+
+    pool->used      = 1;
+    pool->free_list = 0;
+}
+
+void node_pool_dtor (struct NodePool_t* pool)
+{
+    assert (pool);
+
+    if (pool->nodes != NULL)
+        munmap (pool->nodes, RANGE_SIZE);
+
+    pool->nodes     = NULL;
+    pool->types     = NULL;
+    pool->used      = 0;
+    pool->committed = 0;
+    pool->free_list = 0;
+}
+
+// the bytes the nodes and their types take: one calloc per node before the pool
+void node_pool_dump (FILE* file, const struct NodePool_t* pool, const char* stage)
+{
+    assert (file);
+    assert (pool);
+
+    fprintf (file, "%s: %ld nodes (%ld reused, %ld released), %u slots of %zu bytes, %zu KB\n",
+                   stage, pool->allocated, pool->reused, pool->released, pool->used,
+                   sizeof (struct Node_t) + sizeof (int8_t),
+                   (size_t) pool->committed * (sizeof (struct Node_t) + sizeof (int8_t)) / 1024);
+}
+
+// the range costs no memory until it is taken into use: it is mapped with no access
+static int reserve_range (struct NodePool_t* pool)
+{
+    void* range = mmap (NULL, RANGE_SIZE, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+
+    if (range == MAP_FAILED)
+    {
+        perror ("ERROR: could not reserve the node pool");
+        return 1;
+    }
+
+    pool->nodes     = (struct Node_t*) range;
+    pool->types     = (int8_t*) (pool->nodes + NODE_POOL_CAPACITY);
+    pool->used      = 1;            // index 0 is no node
+    pool->committed = 0;
+
+    return 0;
+}
+
+static int commit_step (struct NodePool_t* pool)
+{
+    if (mprotect (pool->nodes + pool->committed, COMMIT_STEP * sizeof (*pool->nodes),
+                  PROT_READ | PROT_WRITE) != 0 ||
+        mprotect (pool->types + pool->committed, COMMIT_STEP * sizeof (*pool->types),
+                  PROT_READ | PROT_WRITE) != 0)
+    {
+        perror ("ERROR: could not grow the node pool");
+        return 1;
+    }
+
+    pool->committed += COMMIT_STEP;
+
+    return 0;
+}
@@ -0,0 +1,165 @@
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#include "time_report.h"
+#include "tree_io.h"
+
+static double now_seconds (void);
+static void   print_count (FILE* file, long count, int json);
+static void   print_json_string (FILE* file, const char* str);
+
+int time_report_option (struct TimeReport_t* report, const char* argument)
+{
+    assert (report);
+    assert (argument);
+
+    if      (strcmp (argument, "--time-report")      == 0) report->format = TIME_REPORT_TABLE;
+    else if (strcmp (argument, "--time-report=json") == 0) report->format = TIME_REPORT_JSON;
+    else
+        return 0;
+
+    return 1;
+}
+
+// without --time-report the phases are not even timed
+void phase_begin (struct TimeReport_t* report, const char* name)
+{
+    assert (report);
+
+    if (report->format == TIME_REPORT_OFF || report->count >= MAX_PHASES)
+        return;
+
+    report->phase_start = now_seconds();
+
+    if (report->count == 0)
+        report->first_start = report->phase_start;
+
+    report->phases[report->count].name = name;
+}
+
+void phase_end (struct TimeReport_t* report, long nodes, long instructions, long bytes)
+{
+    assert (report);
+
+    if (report->format == TIME_REPORT_OFF || report->count >= MAX_PHASES)
+        return;
+
+    struct Phase_t* phase = &report->phases[report->count++];
+
+    phase->seconds      = now_seconds() - report->phase_start;
+    phase->nodes        = nodes;
+    phase->instructions = instructions;
+    phase->bytes        = bytes;
+}
+
+long phase_nodes (const struct TimeReport_t* report, const struct NodePool_t* pool, const struct Node_t* root)
+{
+    assert (report);
+
+    if (report->format == TIME_REPORT_OFF)
+        return -1;
+
+    return count_tree_nodes (pool, root);
+}
+
+// the total is the wall time since the first phase began, the time between phases included
+void time_report_print (const struct TimeReport_t* report, FILE* file, const char* program)
+{
+    assert (report);
+    assert (file);
+    assert (program);
+
+    if (report->format == TIME_REPORT_OFF || report->count == 0)
+        return;
+
+    double total = now_seconds() - report->first_start;
+    int    json  = (report->format == TIME_REPORT_JSON);
+
+    if (json)
+    {
+        fprintf (file, "{\"program\": ");
+        print_json_string (file, program);
+        fprintf (file, ", \"total_ms\": %.3f, \"phases\": [", total * 1000);
+    }
+    else
+    {
+        fprintf (file, "time report (%s):\n", program);
+        fprintf (file, "  %-20s %10s %8s %10s %10s %10s\n", "phase", "ms", "share", "nodes", "instrs", "bytes");
+    }
+
+    for (int i = 0; i < report->count; i++)
+    {
+        const struct Phase_t* phase = &report->phases[i];
+        double share = (total > 0) ? phase->seconds / total * 100 : 0;
+
+        if (json)
+        {
+            fprintf (file, "%s\n  {\"name\": ", (i > 0) ? "," : "");
+            print_json_string (file, phase->name);
+            fprintf (file, ", \"ms\": %.3f, \"share\": %.1f, \"nodes\": ", phase->seconds * 1000, share);
+        }
+        else
+            fprintf (file, "  %-20s %10.3f %7.1f%% ", phase->name, phase->seconds * 1000, share);
+
+        print_count (file, phase->nodes, json);
+        fputs (json ? ", \"instructions\": " : " ", file);
+        print_count (file, phase->instructions, json);
+        fputs (json ? ", \"bytes\": " : " ", file);
+        print_count (file, phase->bytes, json);
+        fputs (json ? "}" : "\n", file);
+    }
+
+    if (json)
+        fprintf (file, "\n]}\n");
+    else
+        fprintf (file, "  %-20s %10.3f %7.1f%%\n", "total", total * 1000, 100.0);
+}
+
+long file_bytes (const char* filename)
+{
+    struct stat st = {};
+
+    return (filename != NULL && stat (filename, &st) == 0) ? (long) st.st_size : -1;
+}
+
+static void print_count (FILE* file, long count, int json)
+{
+    if (json && count < 0)
+        fprintf (file, "null");
+    else if (json)
+        fprintf (file, "%ld", count);
+    else if (count < 0)
+        fprintf (file, "%10s", "-");
+    else
+        fprintf (file, "%10ld", count);
+}
+
+// a path may hold any byte but NUL: quotes, backslashes and control characters are escaped,
+// other bytes are copied, so a UTF-8 path stays readable
+static void print_json_string (FILE* file, const char* str)
+{
+    fputc ('"', file);
+
+    for (const unsigned char* c = (const unsigned char*) str; *c != '\0'; c++)
+    {
+        if (*c == '"' || *c == '\\')
+            fprintf (file, "\\%c", *c);
+        else if (*c < 0x20)
+            fprintf (file, "\\u%04x", *c);
+        else
+            fputc (*c, file);
+    }
+
+    fputc ('"', file);
+}
+
+static double now_seconds (void)
+{
+    struct timespec time = {};
+    clock_gettime (CLOCK_MONOTONIC, &time);
+
+    return (double) time.tv_sec + (double) time.tv_nsec * 1e-9;
+}
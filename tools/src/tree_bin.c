@@ -0,0 +1,321 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "keywords.h"
+#include "mapped_file.h"
+#include "tree_bin.h"
+
+static_assert (sizeof (struct AstBinHeader_t) % 8 == 0, "node records must stay aligned");
+
+#define FNV_OFFSET 0xcbf29ce484222325ULL
+#define FNV_PRIME  0x00000100000001b3ULL
+
+static uint64_t       count_nodes  (const struct NodePool_t* pool, const struct Node_t* node);
+static uint32_t       pack_node    (const struct NodePool_t* pool, const struct Node_t* node,
+                                    struct Node_t* records, int8_t* types, uint32_t* next);
+static struct Node_t* copy_nodes   (struct NodePool_t* pool, const struct Node_t* records, const int8_t* types,
+                                    uint32_t node_count, int table_size);
+static int            link_child   (uint64_t* linked, uint32_t child);
+static struct Node_t* binary_error (struct Buffer_t* buffer, const char* filename, const char* reason);
+
+int write_binary_ast (struct Node_t* root, struct Context_t* context, const char* filename)
+{
+    assert (context);
+    assert (filename);
+
+    if (root == NULL)
+    {
+        fprintf (stderr, "ERROR: File '%s' not created - tree root not found\n", filename);
+        return 1;
+    }
+
+    const struct NodePool_t* nodes = &context->nodes;
+
+    uint64_t node_count = count_nodes (nodes, root);
+    uint64_t types_size = (node_count + 7) & ~(uint64_t) 7;
+    uint64_t name_count = (uint64_t) (context->table_size - context->keywords_offset);
+
+    uint64_t pool_size = 0;
+
+    for (int i = context->keywords_offset; i < context->table_size; i++)
+        pool_size += (uint64_t) context->name_table[i].name.length + 1;
+
+    pool_size = (pool_size + 7) & ~(uint64_t) 7;
+
+    size_t body_size = node_count * sizeof (struct Node_t) + types_size +
+                       name_count * sizeof (struct AstBinName_t) + pool_size;
+
+    // 'body' ends up byte-for-byte in the file, padding included, so it starts zeroed
+    char* body = (char*) calloc (1, body_size);
+    if (body == NULL)
+    {
+        fprintf (stderr, "ERROR: could not allocate %zu bytes for '%s'\n", body_size, filename);
+        return 1;
+    }
+
+    struct Node_t*       records = (struct Node_t*)       body;
+    int8_t*              types   = (int8_t*)              (body + node_count * sizeof (struct Node_t));
+    struct AstBinName_t* names   = (struct AstBinName_t*) ((char*) types + types_size);
+    char*                pool    = (char*) (names + name_count);
+
+    uint32_t next = 0;
+    pack_node (nodes, root, records, types, &next);
+
+    uint32_t pool_offset = 0;
+
+    for (int i = context->keywords_offset; i < context->table_size; i++)
+    {
+        const struct Name_t* name = &context->name_table[i].name;
+
+        *names++ = (struct AstBinName_t) { .pool_offset    = pool_offset,
+                                           .length         = name->length,
+                                           .is_keyword     = name->is_keyword,
+                                           .added_status   = name->added_status,
+                                           .id_type        = name->id_type,
+                                           .host_func      = name->host_func,
+                                           .counter_params = name->counter_params,
+                                           .counter_locals = name->counter_locals,
+                                           .offset         = name->offset };
+
+        memcpy (pool + pool_offset, name->str_pointer, (size_t) name->length);
+        pool_offset += (uint32_t) name->length + 1;
+    }
+
+    struct AstBinHeader_t header = { .magic       = AST_BIN_MAGIC,
+                                     .version     = AST_BIN_VERSION,
+                                     .record_size = sizeof (struct Node_t),
+                                     .node_count  = node_count,
+                                     .name_count  = name_count,
+                                     .pool_size   = pool_size,
+                                     .checksum    = ast_checksum (body, body_size) };
+
+    FILE* file = fopen (filename, "wb");
+    if (file == NULL)
+    {
+        fprintf (stderr, "\n" "Could not find the '%s' to be opened!" "\n", filename);
+        free (body);
+        return 1;
+    }
+
+    int error = fwrite (&header, sizeof (header), 1, file) != 1 ||
+                fwrite (body,    body_size,       1, file) != 1;
+
+    error |= (fclose (file) != 0);
+    free (body);
+
+    if (error)
+        fprintf (stderr, "ERROR: could not write '%s'\n", filename);
+
+    return error;
+}
+
+struct Node_t* read_binary_ast (struct Buffer_t* buffer, struct Context_t* context, const char* filename)
+{
+    assert (buffer);
+    assert (context);
+    assert (filename);
+
+    buffer->buffer_ptr = map_file (filename, &buffer->file_size, &buffer->map_length);
+    if (buffer->buffer_ptr == NULL)
+        return NULL;
+
+    buffer->current_ptr = buffer->buffer_ptr;
+
+    uint64_t file_size = (uint64_t) buffer->file_size;
+
+    struct AstBinHeader_t header = {};
+
+    if (file_size < sizeof (header))
+        return binary_error (buffer, filename, "too short");
+
+    memcpy (&header, buffer->buffer_ptr, sizeof (header));
+
+    if (memcmp (header.magic, AST_BIN_MAGIC, sizeof (header.magic)) != 0)
+        return binary_error (buffer, filename, "not a binary AST");
+
+    if (header.version != AST_BIN_VERSION || header.record_size != sizeof (struct Node_t))
+        return binary_error (buffer, filename, "written by another version of the compiler");
+
+    // every count is checked against the file size first, so the products cannot overflow
+    uint64_t body_size = file_size - sizeof (header);
+
+    if (header.node_count == 0 ||
+        header.node_count >= NODE_POOL_CAPACITY                      ||
+        header.name_count > body_size / sizeof (struct AstBinName_t) ||
+        header.node_count * sizeof (struct Node_t) + ((header.node_count + 7) & ~(uint64_t) 7) +
+        header.name_count * sizeof (struct AstBinName_t) + header.pool_size != body_size)
+        return binary_error (buffer, filename, "sizes do not match the file");
+
+    char* body = buffer->buffer_ptr + sizeof (header);
+
+    if (ast_checksum (body, body_size) != header.checksum)
+        return binary_error (buffer, filename, "checksum mismatch");
+
+    uint64_t types_size = (header.node_count + 7) & ~(uint64_t) 7;
+
+    struct Node_t*       records = (struct Node_t*)       body;
+    int8_t*              types   = (int8_t*)              (body + header.node_count * sizeof (struct Node_t));
+    struct AstBinName_t* names   = (struct AstBinName_t*) ((char*) types + types_size);
+    const char*          pool    = (const char*) (names + header.name_count);
+
+    if (reserve_names (context, context->table_size + (int) header.name_count) != 0)
+        return binary_error (buffer, filename, "name table too big");
+
+    for (uint64_t i = 0; i < header.name_count; i++)
+    {
+        if (names[i].length < 0 || (uint64_t) names[i].pool_offset + (uint64_t) names[i].length >= header.pool_size)
+            return binary_error (buffer, filename, "name outside the string pool");
+
+        struct Name_t* name = &context->name_table[context->table_size].name;
+
+        name->str_pointer    = pool + names[i].pool_offset;
+        name->length         = names[i].length;
+        name->is_keyword     = names[i].is_keyword;
+        name->added_status   = names[i].added_status;
+        name->id_type        = names[i].id_type;
+        name->host_func      = names[i].host_func;
+        name->counter_params = names[i].counter_params;
+        name->counter_locals = names[i].counter_locals;
+        name->offset         = names[i].offset;
+        name->code           = 1; // for dump
+
+        if (index_name (context, context->table_size) != 0)
+            return binary_error (buffer, filename, "name table too big");
+
+        context->table_size++;
+    }
+
+    struct Node_t* root = copy_nodes (&context->nodes, records, types, (uint32_t) header.node_count,
+                                      context->table_size);
+    if (root == NULL)
+        return binary_error (buffer, filename, "broken node record");
+
+    return root;
+}
+
+// FNV-1a over 64-bit words, the size is a multiple of 8
+uint64_t ast_checksum (const char* data, size_t size)
+{
+    uint64_t hash = FNV_OFFSET;
+
+    for (size_t i = 0; i + sizeof (uint64_t) <= size; i += sizeof (uint64_t))
+    {
+        uint64_t word = 0;
+        memcpy (&word, data + i, sizeof (word));
+
+        hash = (hash ^ word) * FNV_PRIME;
+    }
+
+    return hash;
+}
+
+static uint64_t count_nodes (const struct NodePool_t* pool, const struct Node_t* node)
+{
+    uint64_t count = 1;
+
+    if (node->left)  count += count_nodes (pool, node_left  (pool, node));
+    if (node->right) count += count_nodes (pool, node_right (pool, node));
+
+    return count;
+}
+
+// returns the 1-based record number of 'node'
+static uint32_t pack_node (const struct NodePool_t* pool, const struct Node_t* node,
+                           struct Node_t* records, int8_t* types, uint32_t* next)
+{
+    uint32_t number = ++*next;
+    struct Node_t* record = &records[number - 1];
+
+    types[number - 1] = (int8_t) node_type (pool, node);
+    record->value     = node->value;
+
+    record->left  = (node->left)  ? pack_node (pool, node_left  (pool, node), records, types, next) : 0;
+    record->right = (node->right) ? pack_node (pool, node_right (pool, node), records, types, next) : 0;
+
+    return number;
+}
+
+// the records go to consecutive nodes of the pool, so a record number becomes an index by an
+// offset. A child always comes after its parent in pre-order, so links only point forward and
+// there is no cycle; each node is also a child once at most, so no subtree is shared, since a
+// pass that frees or rewrites a node would otherwise meet it again
+static struct Node_t* copy_nodes (struct NodePool_t* pool, const struct Node_t* records, const int8_t* types,
+                                  uint32_t node_count, int table_size)
+{
+    uint64_t* linked = (uint64_t*) calloc ((size_t) (node_count / 64 + 1), sizeof (*linked));
+    if (linked == NULL)
+        return NULL;
+
+    struct Node_t* nodes = node_pool_alloc_block (pool, node_count);
+    if (nodes == NULL)
+    {
+        free (linked);
+        return NULL;
+    }
+
+    uint32_t offset = node_index (pool, nodes) - 1;
+
+    int error = 0;
+
+    for (uint32_t i = 0; i < node_count && error == 0; i++)
+    {
+        uint32_t left  = records[i].left;
+        uint32_t right = records[i].right;
+
+        if ((left  != 0 && (left  <= i + 1 || left  > node_count)) ||
+            (right != 0 && (right <= i + 1 || right > node_count)))
+            error = 1;
+        else if (types[i] == ID && (records[i].value < 0 || records[i].value >= table_size))
+            error = 1;
+        else
+        {
+            error = link_child (linked, left) || link_child (linked, right);
+
+            nodes[i].value = records[i].value;
+            nodes[i].left  = (left  != 0) ? left  + offset : 0;
+            nodes[i].right = (right != 0) ? right + offset : 0;
+        }
+    }
+
+    free (linked);
+
+    if (error)
+    {
+        for (uint32_t i = node_count; i > 0; i--)
+            node_pool_release (pool, &nodes[i - 1]);
+
+        return NULL;
+    }
+
+    memcpy (pool->types + offset + 1, types, node_count);
+
+    return nodes;
+}
+
+// marks record 'child' (1-based, 0 is no child) as linked, 1 if it already was
+static int link_child (uint64_t* linked, uint32_t child)
+{
+    if (child == 0)
+        return 0;
+
+    uint64_t word = (child - 1) / 64;
+    uint64_t bit  = (uint64_t) 1 << ((child - 1) % 64);
+
+    if (linked[word] & bit)
+        return 1;
+
+    linked[word] |= bit;
+
+    return 0;
+}
+
+static struct Node_t* binary_error (struct Buffer_t* buffer, const char* filename, const char* reason)
+{
+    fprintf (stderr, "ERROR: \"%s\": %s\n", filename, reason);
+
+    buffer_dtor (buffer);
+
+    return NULL;
+}
@@ -3,15 +3,15 @@
 #endif
 
 #include <stdio.h>
-#include <sys/stat.h>
+#include <inttypes.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
-#include <stdint.h>
 
 #include "assert.h"
 #include "color.h"
 #include "file.h"
+#include "mapped_file.h"
 #include "keywords.h"
 #include "tree_io.h"
 
@@ -22,79 +22,105 @@
 #endif
 
 static void skip_spaces (char** ptr);
+static int read_int (char** ptr, int* value);
+static int name_table_error (struct Context_t* context, const char* filename);
 static struct Node_t* read_node (int level, struct Buffer_t* buffer, struct Context_t* context);
-static struct Node_t* new_node ();
+static struct Node_t* new_node (struct NodePool_t* pool);
+
+// fields after the quoted name: length, is_keyword, added_status, id_type,
+// host_func, counter_params, counter_locals, offset
+#define NAME_FIELDS 8
 
 int read_name_table (struct Context_t* context, const char* filename)
 {
     long num_symb = 0;
-    char* buffer = MakeBuffer (filename, &num_symb);
+    size_t map_length = 0;
+
+    char* buffer = map_file (filename, &num_symb, &map_length);
     if (buffer == NULL)
         return 1;
 
+    context->names_buffer     = buffer;
+    context->names_map_length = map_length;
+
     char* current = buffer;
     int size = context->table_size;
 
-    while (*current)
+    while (1)
     {
+        skip_spaces (&current);
+
         if (*current != '\"')
             break;
 
-        char name[MAX_NAME_LENGTH] = {};
-        int length = 0;
-        int is_keyword = 0;
-        int added_status = 0;
-        int id_type = 0;
-        int host_func = 0;
-        int counter_params = 0;
-        int counter_locals = 0;
-        int offset = 0;
-        int offset_read = 0;
-
-        int items_read = sscanf (current, " \"%50[^\"]\" %d %d %d %d %d %d %d %d %n",
-                                name,
-                                &length,
-                                &is_keyword,
-                                &added_status,
-                                &id_type,
-                                &host_func,
-                                &counter_params,
-                                &counter_locals, &offset, &offset_read);
-
-        if (items_read != 9)
-        {
-            fprintf (stderr, "ERROR: not corrected format in \"%s\"\n", filename);
-            free (buffer);
+        char* name = current + 1;
+        char* name_end = strchr (name, '\"');
+        if (name_end == NULL)
+            return name_table_error (context, filename);
 
-            return 1;
-        }
+        *name_end = '\0';             // the name is used in place as a C string
+        current = name_end + 1;
 
-        char* name_copy = strdup (name);
-        if (!name_copy)
-        {
-            fprintf (stderr, "ERROR: could not allocated memory for word\n");
-            free (buffer);
+        int fields[NAME_FIELDS] = {};
 
-            return 1;
-        }
+        for (int i = 0; i < NAME_FIELDS; i++)
+            if (read_int (&current, &fields[i]) != 0)
+                return name_table_error (context, filename);
 
-        context->name_table[size].name.str_pointer = name_copy;
-        context->name_table[size].name.length = length;
-        context->name_table[size].name.is_keyword = is_keyword;
-        context->name_table[size].name.added_status = added_status;
-        context->name_table[size].name.id_type = id_type;
-        context->name_table[size].name.host_func = host_func;
-        context->name_table[size].name.counter_params = counter_params;
-        context->name_table[size].name.counter_locals = counter_locals;
-        context->name_table[size].name.offset = offset;
+        if (reserve_names (context, size + 1) != 0)
+            return name_table_error (context, filename);
+
+        context->name_table[size].name.str_pointer = name;
+        context->name_table[size].name.length = fields[0];
+        context->name_table[size].name.is_keyword = fields[1];
+        context->name_table[size].name.added_status = fields[2];
+        context->name_table[size].name.id_type = fields[3];
+        context->name_table[size].name.host_func = fields[4];
+        context->name_table[size].name.counter_params = fields[5];
+        context->name_table[size].name.counter_locals = fields[6];
+        context->name_table[size].name.offset = fields[7];
         context->name_table[size].name.code = 1; // for dump
 
+        if (index_name (context, size) != 0)
+            return name_table_error (context, filename);
+
         size++;
-        current += offset_read;
+        context->table_size = size;
     }
 
-    context->table_size = size;
-    free (buffer);
+    return 0;
+}
+
+#undef NAME_FIELDS
+
+static int name_table_error (struct Context_t* context, const char* filename)
+{
+    fprintf (stderr, "ERROR: not corrected format in \"%s\"\n", filename);
+
+    for (int i = context->keywords_offset; i < context->table_size; i++)
+        context->name_table[i].name.str_pointer = NULL;
+
+    context->table_size = context->keywords_offset;
+
+    unmap_file (context->names_buffer, context->names_map_length);
+
+    context->names_buffer     = NULL;
+    context->names_map_length = 0;
+
+    return 1;
+}
+
+// strtol without the copy sscanf makes, leading spaces are skipped
+static int read_int (char** ptr, int* value)
+{
+    char* end = NULL;
+    long number = strtol (*ptr, &end, 10);
+
+    if (end == *ptr)
+        return 1;
+
+    *value = (int) number;
+    *ptr = end;
 
     return 0;
 }
@@ -113,24 +139,14 @@ int name_table_dump (FILE* file, struct Context_t* context)
     if (file != stderr)
     {
         str = ";";
-
-        int i = 0;
-        while (i < context->table_size)
-        {
-            if (context->name_table[i].name.code == SPACE)
-                break;
-
-            i++;
-        }
-
-        j = i + 1;
+        j = context->keywords_offset;
     }
 
-    while ( context->name_table[j].name.str_pointer != NULL)
+    while (j < context->table_size)
     {
         if (context->name_table[j].name.code == SPACE)
             fprintf (file,  "\n" "%s" YELLOW_TEXT("[%.2d]: ADDRESS = [%p], name = '%.*s'") "\n\n",
-                            str, j, context[j].name_table,
+                            str, j, &context->name_table[j],
                               (int) context->name_table[j].name.length,
                                     context->name_table[j].name.str_pointer);
         else
@@ -138,7 +154,7 @@ int name_table_dump (FILE* file, struct Context_t* context)
             if (file == stderr)
                 fprintf (file,  "%s" "[%.2d]: " "ADDRESS = [%p], name = '%.*s', length = %d, is_keyword = %d, added_status = %d"
                                 "\n" "%s" "id_type = %d, host_func = %d, counter_params = %d, counter_locals = %d, offset = %d\n\n",
-                                str, j, context[j].name_table,
+                                str, j, &context->name_table[j],
                                         context->name_table[j].name.length,
                                         context->name_table[j].name.str_pointer,
                                         context->name_table[j].name.length,
@@ -152,7 +168,7 @@ int name_table_dump (FILE* file, struct Context_t* context)
             else // dump for asm file
                 fprintf (file,  "%s" "[%.2d]: " "ADDRESS = [%p], name = '%.*s', %*s lngth = %d, keywrd = %d, added_stts = %d "
                                 "id_type = %d, host_fnc = %02d, cntr_prms = %d, cntr_lcls = %d, offset = %d\n",
-                                str, j, context[j].name_table,
+                                str, j, &context->name_table[j],
                                         context->name_table[j].name.length,
                                         context->name_table[j].name.str_pointer,
                                     5 - context->name_table[j].name.length, "",
@@ -185,46 +201,11 @@ struct Node_t* read_tree (struct Buffer_t* buffer, struct Context_t* context, co
 
     ON_DEBUG ( fprintf (stderr, "Starting read_tree. Filename = %s\n", filename); )
 
-    FILE* file = OpenFile (filename, "rb");
-    if (file == NULL)
-        return NULL;
-
-    struct stat st = {};
-    if (fstat (fileno (file), &st) != 0)
-    {
-        fprintf (stderr, "Failed to get file stats for %s. Return NULL.\n", filename);
-        CloseFile (file);
-        return NULL;
-    }
-
-    long file_size = st.st_size;
-
-    buffer->buffer_ptr = (char*) calloc ( (size_t) file_size + 1, sizeof(buffer->buffer_ptr[0]));
+    buffer->buffer_ptr = map_file (filename, &buffer->file_size, &buffer->map_length);
     if (buffer->buffer_ptr == NULL)
-    {
-        fprintf ( stderr, "Could not allocate buffer for file %s. Return NULL.\n", filename);
-        CloseFile (file);
-        return NULL;
-    }
-
-    size_t count = fread (buffer->buffer_ptr, sizeof(buffer->buffer_ptr[0]), (size_t) file_size, file);
-    if ((long) count != file_size)
-    {
-        fprintf (stderr, "Read error: expected %ld bytes, but got %zu\n", file_size, count);
-        free (buffer->buffer_ptr);
-        CloseFile (file);
         return NULL;
-    }
-
-    enum Errors err = CloseFile (file);
-    if (err != NO_ERROR)
-    {
-        free (buffer->buffer_ptr);
-        return NULL;
-    }
 
     buffer->current_ptr = buffer->buffer_ptr;
-    buffer->file_size = file_size;
 
     ON_DEBUG ( fprintf ( stderr, "Successfully read file %s. Starting node parsing.\n", filename); )
 
@@ -243,46 +224,61 @@ static struct Node_t* read_node (int level, struct Buffer_t* buffer, struct Cont
     ON_DEBUG ( INDENT; fprintf (stderr, YELLOW_TEXT("Starting read_node(). Cur = <%.40s...>, [%p]. buffer_ptr = [%p]\n"),
                buffer->current_ptr,  buffer->current_ptr, buffer->buffer_ptr); )
 
-    int offset = 0;
-    if (sscanf(buffer->current_ptr, " { %n", &offset) != 0 || offset <= 0)
+    if (*buffer->current_ptr != '{')
     {
-        fprintf (stderr, "No '{' found: offset = %d. Return NULL.\n", offset);
+        fprintf (stderr, "No '{' found. Return NULL.\n");
         return NULL;
     }
 
-    buffer->current_ptr += offset;
+    buffer->current_ptr++;
 
     ON_DEBUG ( INDENT; fprintf (stderr, GREEN_TEXT("Got an '{'. Creating a node. Cur = <%.40s...>, [%p]. buffer_ptr = [%p]\n"),
                buffer->current_ptr,  buffer->current_ptr, buffer->buffer_ptr); )
 
-    struct Node_t* node = new_node ();
+    struct NodePool_t* pool = &context->nodes;
 
+    struct Node_t* node = new_node (pool);
+    if (node == NULL)
+        return NULL;
+
+    // <type>: "<value>", parsed in place
     int type = 0;
-    char value_str[MAX_NAME_LENGTH] = {};
-    offset = 0;
+    char* value_str = NULL;
 
-    if (sscanf (buffer->current_ptr, " %d: \"%[^\"]\"%n", &type, value_str, &offset) != 2 || offset <= 0)
+    if (read_int (&buffer->current_ptr, &type) != 0 || *buffer->current_ptr != ':')
     {
-        free (node);
+        node_pool_release (pool, node);
         fprintf (stderr, "Failed to parse type and value. Return NULL.\n");
         return NULL;
     }
 
-    buffer->current_ptr += offset;
-    node->type = type;
+    buffer->current_ptr++;
+    skip_spaces (&buffer->current_ptr);
+
+    char* value_end = (*buffer->current_ptr == '\"') ? strchr (buffer->current_ptr + 1, '\"') : NULL;
+    if (value_end == NULL)
+    {
+        node_pool_release (pool, node);
+        fprintf (stderr, "Failed to parse type and value. Return NULL.\n");
+        return NULL;
+    }
+
+    value_str = buffer->current_ptr + 1;
+    buffer->current_ptr = value_end + 1;
+    set_type (pool, node, type);
 
     ON_DEBUG ( INDENT; fprintf (stderr, LIGHT_BLUE_TEXT("Shifted CURRENT_PTR: type = '%d'. Cur = <%.40s...>, [%p]. buffer_ptr = [%p]\n"),
-               node->type, buffer->current_ptr, buffer->current_ptr, buffer->buffer_ptr); )
+               node_type (pool, node), buffer->current_ptr, buffer->current_ptr, buffer->buffer_ptr); )
 
     switch (type)
     {
         case NUM:
-            node->value = atof (value_str);
-            ON_DEBUG ( INDENT; fprintf (stderr, "Parsed NUM: value = %g.\n", node->value); )
+            node->value = strtoll (value_str, NULL, 10);
+            ON_DEBUG ( INDENT; fprintf (stderr, "Parsed NUM: value = %" PRId64 ".\n", node->value); )
             break;
         case OP:
-            node->value = (double) atoi (value_str);
-            ON_DEBUG ( INDENT; fprintf (stderr, "Parsed OP: value = %g.\n", node->value); )
+            node->value = strtoll (value_str, NULL, 10);
+            ON_DEBUG ( INDENT; fprintf (stderr, "Parsed OP: value = %" PRId64 ".\n", node->value); )
             break;
         case ID:
         {
@@ -290,12 +286,12 @@ static struct Node_t* read_node (int level, struct Buffer_t* buffer, struct Cont
 
             if (index >= 0 && index < context->table_size)
             {
-                node->value = (double) index;
-                ON_DEBUG ( INDENT; fprintf (stderr, "Parsed ID: index = %d, value = %g.\n", index, node->value); )
+                node->value = index;
+                ON_DEBUG ( INDENT; fprintf (stderr, "Parsed ID: index = %d, value = %" PRId64 ".\n", index, node->value); )
             }
             else
             {
-                free (node);
+                node_pool_release (pool, node);
                 fprintf (stderr, "Invalid ID index: %d. Return NULL.\n", index);
                 return NULL;
             }
@@ -304,8 +300,8 @@ static struct Node_t* read_node (int level, struct Buffer_t* buffer, struct Cont
         }
 
         default:
-            node->value = atoi(value_str);
-            ON_DEBUG ( INDENT; fprintf (stderr, "Parsed default: value = %g.\n", node->value); )
+            node->value = strtoll (value_str, NULL, 10);
+            ON_DEBUG ( INDENT; fprintf (stderr, "Parsed default: value = %" PRId64 ".\n", node->value); )
             break;
     }
 
@@ -315,42 +311,45 @@ static struct Node_t* read_node (int level, struct Buffer_t* buffer, struct Cont
     {
         buffer->current_ptr++;
 
-        ON_DEBUG ( INDENT; fprintf (stderr, PURPLE_TEXT("Got a '}', SHORT Node END (data = '%g'). Return node. Cur = <%.40s...>, [%p]. buffer_ptr = [%p]\n"),
+        ON_DEBUG ( INDENT; fprintf (stderr, PURPLE_TEXT("Got a '}', SHORT Node END (data = '%" PRId64 "'). Return node. Cur = <%.40s...>, [%p]. buffer_ptr = [%p]\n"),
                    node->value, buffer->current_ptr, buffer->current_ptr, buffer->buffer_ptr); )
 
         return node;
     }
 
-    node->left = read_node (level + 1, buffer, context);
-    if (node->left == NULL)
+    struct Node_t* left = read_node (level + 1, buffer, context);
+    if (left == NULL)
     {
         fprintf (stderr, "Left subtree is NULL. Return NULL.\n");
 
-        free (node);
+        node_pool_release (pool, node);
         return NULL;
     }
 
+    set_left (pool, node, left);
+
     skip_spaces (&buffer->current_ptr);
 
     if (*buffer->current_ptr == '}')
     {
         buffer->current_ptr++;
 
-        ON_DEBUG ( INDENT; fprintf (stderr, BLUE_TEXT("Got a '}', SINGLE Node END (value = '%g'). Return node. Cur = <%.40s...>, [%p]. buffer_ptr = [%p]\n"),
+        ON_DEBUG ( INDENT; fprintf (stderr, BLUE_TEXT("Got a '}', SINGLE Node END (value = '%" PRId64 "'). Return node. Cur = <%.40s...>, [%p]. buffer_ptr = [%p]\n"),
                    node->value, buffer->current_ptr, buffer->current_ptr, buffer->buffer_ptr);)
         return node;
     }
 
-    node->right = read_node (level + 1, buffer, context);
-    if (node->right == NULL)
+    struct Node_t* right = read_node (level + 1, buffer, context);
+    if (right == NULL)
     {
         fprintf (stderr, "Right subtree is NULL. Return NULL.\n");
 
-        free (node->left);
-        free (node);
+        delete_sub_tree (pool, node);
         return NULL;
     }
 
+    set_right (pool, node, right);
+
     skip_spaces (&buffer->current_ptr);
 
     if (*buffer->current_ptr != '}')
@@ -358,13 +357,11 @@ static struct Node_t* read_node (int level, struct Buffer_t* buffer, struct Cont
         fprintf (stderr, "Does NOT get '}'. Syntax error. Return NULL. Cur = %.20s..., [%p]. buffer_ptr = [%p]\n",
                  buffer->current_ptr, buffer->current_ptr, buffer->buffer_ptr);
 
-        free (node->left);
-        free (node->right);
-        free (node);
+        delete_sub_tree (pool, node);
         return NULL;
     }
 
-    ON_DEBUG ( INDENT; fprintf (stderr, WHITE_TEXT("Got a '}', FULL Node END (value = '%g'). Return node. Cur = <%.40s...>, [%p]. buffer_ptr = [%p]\n"),
+    ON_DEBUG ( INDENT; fprintf (stderr, WHITE_TEXT("Got a '}', FULL Node END (value = '%" PRId64 "'). Return node. Cur = <%.40s...>, [%p]. buffer_ptr = [%p]\n"),
                node->value, buffer->current_ptr, buffer->current_ptr, buffer->buffer_ptr); )
 
     buffer->current_ptr++;
@@ -372,16 +369,16 @@ static struct Node_t* read_node (int level, struct Buffer_t* buffer, struct Cont
     return node;
 }
 
-static struct Node_t* new_node ()
+static struct Node_t* new_node (struct NodePool_t* pool)
 {
-    struct Node_t* node = (struct Node_t*) calloc (1, sizeof(*node));
-    assert (node && "Failed to allocate node");
-
-    node->type = ROOT;
-    node->value = 0;
+    struct Node_t* node = node_pool_alloc (pool);
+    if (node == NULL)
+    {
+        fprintf (stderr, "Failed to allocate node. Return NULL.\n");
+        return NULL;
+    }
 
-    node->left = NULL;
-    node->right = NULL;
+    set_type (pool, node, ROOT);
 
     return node;
 }
@@ -392,9 +389,13 @@ void print_tree_preorder (struct Node_t* root, struct Context_t* context, FILE*
     assert (context);
     assert (file);
 
+    const struct NodePool_t* pool = &context->nodes;
+
+    int type = node_type (pool, root);
+
     fprintf (file, "%*s{ ", level * 4, "");
 
-    fprintf (file, "%d: \"%g\" ", root->type, root->value);
+    fprintf (file, "%d: \"%" PRId64 "\" ", type, root->value);
 
     if (root->left)
         fprintf (file, "\n");
@@ -402,22 +403,91 @@ void print_tree_preorder (struct Node_t* root, struct Context_t* context, FILE*
     if (root->right)
         fprintf (file, "\n");
 
-    if (root->left)  print_tree_preorder (root->left, context, file, level + 1);
+    if (root->left)  print_tree_preorder (node_left (pool, root), context, file, level + 1);
+
+    // statement and parameter lists continue at the same indentation, otherwise a long
+    // list is written with indentation growing along it - quadratic in the program size
+    int is_list = ( type == OP   && (int) root->value == GLUE    ) ||
+                  ( type == FUNC && (int) root->value == FN_GLUE ) ||
+                  ( type == FUNC && (int) root->value == COMMA   );
 
-    if (root->right) print_tree_preorder (root->right, context, file, level + 1);
+    if (root->right) print_tree_preorder (node_right (pool, root), context, file, is_list ? level : level + 1);
 
     fprintf (file, "%*s} \n", (root->left) ? level * 4 : 0, "");
 }
 
-int delete_sub_tree (struct Node_t* node)
+int write_ast_file (struct Node_t* root, struct Context_t* context, const char* filename, int level)
+{
+    assert (context);
+    assert (filename);
+
+    if (root == NULL)
+    {
+        fprintf (stderr, RED_TEXT("ERROR: ") "File '%s' not created - tree root not found\n", filename);
+        return 1;
+    }
+
+    FILE* file = fopen (filename, "wb");
+    if (file == NULL)
+    {
+        fprintf (stderr, "\n" "Could not find the '%s' to be opened!" "\n", filename);
+        return 1;
+    }
+
+    print_tree_preorder (root, context, file, level);
+
+    fclose (file);
+
+    return 0;
+}
+
+int write_name_table_file (struct Context_t* context, const char* filename)
+{
+    assert (context);
+    assert (filename);
+
+    FILE* file = fopen (filename, "wb");
+    if (file == NULL)
+    {
+        fprintf (stderr, "\n" "Could not find the '%s' to be opened!" "\n", filename);
+        return 1;
+    }
+
+    for (int i = context->keywords_offset; i < context->table_size; i++)
+        fprintf (file, "\"%.*s\" %d %d %d %d %d %d %d %d \n",
+                context->name_table[i].name.length,
+                context->name_table[i].name.str_pointer,
+                context->name_table[i].name.length,
+                context->name_table[i].name.is_keyword,
+                context->name_table[i].name.added_status,
+                context->name_table[i].name.id_type,
+                context->name_table[i].name.host_func,
+                context->name_table[i].name.counter_params,
+                context->name_table[i].name.counter_locals,
+                context->name_table[i].name.offset);
+
+    fclose (file);
+
+    return 0;
+}
+
+long count_tree_nodes (const struct NodePool_t* pool, const struct Node_t* node)
 {
-    if (node->left)  delete_sub_tree (node->left);
-    if (node->right) delete_sub_tree (node->right);
+    if (node == NULL)
+        return 0;
 
-    return delete_node (node);
+    return 1 + count_tree_nodes (pool, node_left (pool, node)) + count_tree_nodes (pool, node_right (pool, node));
 }
 
-int delete_node (struct Node_t* node)
+int delete_sub_tree (struct NodePool_t* pool, struct Node_t* node)
+{
+    if (node->left)  delete_sub_tree (pool, node_left  (pool, node));
+    if (node->right) delete_sub_tree (pool, node_right (pool, node));
+
+    return delete_node (pool, node);
+}
+
+int delete_node (struct NodePool_t* pool, struct Node_t* node)
 {
     if (node == NULL)
     {
@@ -425,7 +495,7 @@ int delete_node (struct Node_t* node)
         return -1;
     }
 
-    free (node);
+    node_pool_release (pool, node);
     return 0;
 }
 
@@ -433,7 +503,8 @@ int buffer_dtor (struct Buffer_t* buffer)
 {
     buffer->current_ptr = NULL;
 
-    free (buffer->buffer_ptr);
+    unmap_file (buffer->buffer_ptr, buffer->map_length);
+    buffer->buffer_ptr = NULL;
 
     return 0;
 }
@@ -441,14 +512,14 @@ int buffer_dtor (struct Buffer_t* buffer)
 int destructor (struct Node_t* node, struct Buffer_t* buffer, struct Context_t* context)
 {
     assert (node);
+    (void) node;
     assert (buffer);
 
 #ifdef DEBUG
     fprintf (stderr, "\nDestructor starting...\n");
 #endif
 
-    free_context (context);
-    delete_sub_tree (node);
+    free_context (context);     // the tree goes with the node pool of the context
     buffer_dtor (buffer);
 
     return 0;
@@ -458,21 +529,13 @@ void free_context (struct Context_t* context)
 {
     if (context)
     {
-        for (int i = context->keywords_offset; i < context->table_size; i++)
-        {
-            if (context->name_table[i].name.str_pointer)
-            {
-#ifdef DEBUG
-                fprintf (stderr, "Freed str_pointer [%p] at index %d in name_table\n", context->name_table[i].name.str_pointer, i);
-#endif
-                uintptr_t str_ptr = (uintptr_t) context->name_table[i].name.str_pointer;
-                free ((void*) str_ptr);
-                context->name_table[i].name.str_pointer = NULL;
-            }
-        }
+        unmap_file (context->names_buffer, context->names_map_length);
+
+        context->names_buffer     = NULL;
+        context->names_map_length = 0;
+
+        dtor_keywords (context);
 
-        context->table_size = 0;
-        context->keywords_offset = 0;
         context->curr_host_func = 0;
     }
 }
@@ -0,0 +1,70 @@
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#include <limits.h>
+#include <sys/stat.h>
+
+#include "work_dir.h"
+
+static char WORK_DIR[PATH_MAX] = {};
+
+static int make_dirs (char* path);
+
+// NULL or "" goes back to the source tree
+int set_work_dir (const char* dir)
+{
+    if (dir == NULL)
+        dir = "";
+
+    int written = snprintf (WORK_DIR, sizeof (WORK_DIR), "%s", dir);
+    if (written < 0 || (size_t) written >= sizeof (WORK_DIR))
+    {
+        fprintf (stderr, "ERROR: work directory '%s' is too long\n", dir);
+        WORK_DIR[0] = '\0';
+        return 1;
+    }
+
+    return 0;
+}
+
+const char* work_path (char* path, size_t size, const char* name)
+{
+    assert (path);
+    assert (name);
+
+    int written = (WORK_DIR[0] != '\0') ? snprintf (path, size, "%s/%s", WORK_DIR, name)
+                                        : snprintf (path, size, "%s", name);
+
+    if (written < 0 || (size_t) written >= size)
+    {
+        fprintf (stderr, "ERROR: path of '%s' in the work directory is too long\n", name);
+        return NULL;
+    }
+
+    if (WORK_DIR[0] != '\0' && make_dirs (path) != 0)
+        return NULL;
+
+    return path;
+}
+
+// every directory of the path but the last component, like mkdir -p
+static int make_dirs (char* path)
+{
+    for (char* slash = strchr (path + 1, '/'); slash != NULL; slash = strchr (slash + 1, '/'))
+    {
+        *slash = '\0';
+
+        int error = (mkdir (path, 0755) != 0 && errno != EEXIST);
+
+        if (error)
+            fprintf (stderr, "ERROR: could not create '%s': %s\n", path, strerror (errno));
+
+        *slash = '/';
+
+        if (error)
+            return 1;
+    }
+
+    return 0;
+}